@@ -15,6 +15,10 @@
 // Enable VERY_DEBUG if you are having memory bugs to detect things like heap corruption earlier.
 // #define VERY_DEBUG 1
 
+// Enable ENABLE_RENDER_THREAD to render the previous frame on its own thread while the game
+// updates the next one. Costs one frame of latency.
+// #define ENABLE_RENDER_THREAD 1
+
 typedef struct Context_Extra
 {
 	int monkee;
@@ -43,6 +47,7 @@ typedef struct Context_Extra
 // #include "oogabooga/examples/custom_shader.c"
 // #include "oogabooga/examples/growing_array_example.c"
 // #include "oogabooga/examples/input_example.c"
+// #include "oogabooga/examples/benchmarks.c"
 
 // This is where you swap in your own project!
 // #include "entry_yourepicgamename.c"
@@ -5,7 +5,15 @@
 		
 	bool audio_open_source_stream(Audio_Source *src, string path, Allocator allocator);
 	bool audio_open_source_load(Audio_Source *src, string path, Allocator allocator);
+	bool audio_open_source_map(Audio_Source *src, string path, Allocator allocator); // WAV only, see below
 	void audio_source_destroy(Audio_Source *src);
+	
+		Loading WAV files in the output format is zero-copy, the file is mapped instead of read.
+		That goes for audio_open_source_load too: the source then keeps a read-only mapping of
+		the file until audio_source_destroy, and on windows the file can't be written, moved or
+		deleted while it's mapped.
+		audio_open_source_map maps WAV files in any format and converts per callback instead of
+		up front, trading a little CPU for not keeping a converted copy (big ambient beds).
 
 		Playing audio (the simple way):
 		
@@ -31,12 +39,33 @@
 	void    audio_player_clear_source(Audio_Player *p);
 	void    audio_player_set_looping(Audio_Player *p, bool looping);
 	
+		Rendering without an audio device (headless builds, benchmarks, tests):
+		
+	void audio_init_offline(Audio_Format format); // Headless only, sets audio_output_format
+	bool audio_render_offline(void *output, u64 number_of_frames, Audio_Format format, u64 frames_per_callback, Audio_Render_Stats *stats);
+	bool audio_render_offline_to_wav(string path, u64 number_of_frames, Audio_Format format, u64 frames_per_callback, Audio_Render_Stats *stats);
+	void audio_print_render_stats(Audio_Render_Stats stats);
+	bool wav_write_file(string path, void *frames, u64 number_of_frames, Audio_Format format);
+	
 		Configuring playback:
 		
 	player->config.enable_spacialization = true/false;
 	player->config.position_ndc          = v3(...);
 	player->config.volume                = ...; // (1.0 by default)
 	player->config.playback_speed        = ...; // (1.0 by default)
+	player->config.resample_quality      = ...; // (AUDIO_RESAMPLE_QUALITY_DEFAULT by default, see audio_default_resample_quality)
+	player->config.bus                   = ...; // (AUDIO_BUS_MASTER by default)
+	
+		Buses (voices mix into a bus, buses into their parent, master into the device):
+	
+	Audio_Bus   *audio_get_bus(Audio_Bus_Id id); // AUDIO_BUS_MASTER, AUDIO_BUS_MUSIC, AUDIO_BUS_SFX, AUDIO_BUS_UI or a user bus
+	Audio_Bus_Id audio_bus_create(Audio_Bus_Id parent);
+	
+	bus->config.volume            = ...; // (1.0 by default)
+	bus->config.lowpass_cutoff_hz = ...; // (0, off by default)
+	bus->config.compressor        = ...; // (.enabled = false by default)
+	bus->config.enable_limiter    = ...; // (false by default)
+	bus->config.limiter_ceiling   = ...; // (1.0 by default)
 	
 */
 
@@ -90,6 +119,7 @@ typedef enum Audio_Decoder_Kind {
 typedef enum Audio_Source_Kind {
 	AUDIO_SOURCE_FILE_STREAM,
 	AUDIO_SOURCE_MEMORY, // Raw pcm frames
+	AUDIO_SOURCE_MAPPED, // Raw pcm frames in another format, converted when sampled
 } Audio_Source_Kind;
 
 typedef struct {
@@ -122,6 +152,8 @@ typedef struct Wav_Stream {
 	Wav_Subformat_Guid sub_format;
 } Wav_Stream;
 
+typedef struct Ogg_Decode_Cursor Ogg_Decode_Cursor;
+
 typedef struct Audio_Source {
 
 	Audio_Source_Kind kind;
@@ -146,9 +178,17 @@ typedef struct Audio_Source {
 	// memory usage, but it's definitely suboptimal.
 	string ogg_raw;
 	
+	// Sequential decode state so we don't seek every callback, see ogg_cursor_read_frames
+	Ogg_Decode_Cursor *ogg_cursor;
+	
 	// For memory source
 	void *pcm_frames;
 	
+	// For mapped sources, and memory sources that are just a view into a mapped file.
+	// pcm_frames points into the mapping, mapped_format is what it's stored as.
+	Os_File_Mapping mapping;
+	Audio_Format mapped_format;
+	
 	Mutex mutex_for_destroy; // This should ONLY be used so a source isnt sampled on audio thread while it's being destroyed
 	
 } Audio_Source;
@@ -378,8 +418,7 @@ wav_read_frames(Wav_Stream *wav, Audio_Format format, void *frames,
 		
 		u64 new_size = get_next_power_of_two(required_size);
 		
-		raw_buffer = alloc(get_heap_allocator(), new_size);
-		memset(raw_buffer, 0, new_size);
+		raw_buffer = alloc_zeroed(get_heap_allocator(), new_size);
 		raw_buffer_size = new_size;
 	}
 	if (!convert_buffer || required_size > convert_buffer_size) {
@@ -387,8 +426,7 @@ wav_read_frames(Wav_Stream *wav, Audio_Format format, void *frames,
 		
 		u64 new_size = get_next_power_of_two(required_size);
 		
-		convert_buffer = alloc(get_heap_allocator(), new_size);
-		memset(convert_buffer, 0, new_size);
+		convert_buffer = alloc_zeroed(get_heap_allocator(), new_size);
 		convert_buffer_size = new_size;
 	}
 	
@@ -527,7 +565,7 @@ wav_load_file(string path, void **frames, Audio_Format format, u64 *number_of_fr
 	u64 comp_size = get_audio_bit_width_byte_size(format.bit_width);
 	u64 frame_size = comp_size*format.channels;
 	
-	*frames = alloc(allocator, *number_of_frames*frame_size);
+	*frames = alloc_uninitialized(allocator, *number_of_frames*frame_size);
 	
 	u64 read = wav_read_frames(&wav, format, *frames, *number_of_frames);
 	if (read != *number_of_frames) {
@@ -541,11 +579,49 @@ wav_load_file(string path, void **frames, Audio_Format format, u64 *number_of_fr
 	return true;
 }
 
+// Maps 16-bit pcm and 32-bit float wav files. Other bit widths need decoding per sample, so
+// those are left to wav_load_file. So are files where the samples don't start on a multiple of
+// the sample size (float wavs with an 18 byte fmt chunk put them at 46), since the mixer reads
+// them as f32/s16.
+bool
+wav_map_file(string path, Os_File_Mapping *mapping, Audio_Format *format, void **pcm_frames, 
+             u64 *number_of_frames) {
+	Wav_Stream wav;
+	u64 ignored_number_of_frames;
+	if (!wav_open_file(path, &wav, 0, &ignored_number_of_frames)) return false;
+	wav_close(&wav);
+	
+	bool is_s16 = wav.format == 0x0001 && wav.bits_per_sample == 16 && wav.valid_bits_per_sample == 16;
+	bool is_f32 = wav.format == 0x0003 && wav.bits_per_sample == 32;
+	if (!is_s16 && !is_f32) return false;
+	
+	// The mapping itself starts on a page
+	u64 sample_size = is_f32 ? sizeof(f32) : sizeof(s16);
+	if (wav.pcm_start % sample_size != 0) return false;
+	
+	if (!os_file_map(path, mapping)) return false;
+	
+	*format = (Audio_Format){ is_f32 ? AUDIO_BITS_32 : AUDIO_BITS_16, wav.channels, wav.sample_rate };
+	u64 frame_size = get_audio_bit_width_byte_size(format->bit_width)*wav.channels;
+	
+	// Don't trust the data chunk size on truncated files
+	u64 frames_in_file = mapping->size > wav.pcm_start ? (mapping->size-wav.pcm_start)/frame_size : 0;
+	
+	*number_of_frames = min(wav.number_of_frames, frames_in_file);
+	*pcm_frames = (u8*)mapping->data + wav.pcm_start;
+	
+	return true;
+}
+
 
 int
 audio_source_get_frames(Audio_Source *src, u64 first_frame_index, 
 					             u64 number_of_frames, void *output_buffer);
 
+Ogg_Decode_Cursor *ogg_cursor_create(Allocator allocator);
+void ogg_cursor_destroy(Ogg_Decode_Cursor *cursor, Allocator allocator);
+int  ogg_cursor_read_frames(Audio_Source *src, u64 first_frame_index, u64 number_of_frames, void *output_buffer);
+
 
 bool
 audio_open_source_stream_format(Audio_Source *src, string path, Audio_Format format, 
@@ -580,16 +656,23 @@ audio_open_source_stream_format(Audio_Source *src, string path, Audio_Format for
 		ok = os_read_entire_file(path, &src->ogg_raw, src->allocator);
 		if (!ok) return false;
 		
-		third_party_allocator = src->allocator;
+		Third_Party_Scope scope = third_party_scope_begin(src->allocator);
 		int err = 0;
 		src->ogg = stb_vorbis_open_memory(src->ogg_raw.data, src->ogg_raw.count, &err, 0);
-		third_party_allocator = ZERO(Allocator);
+		u64 ogg_length = 0;
+		if (err == 0 && src->ogg) ogg_length = stb_vorbis_stream_length_in_samples(src->ogg);
+		third_party_scope_end(scope);
 		
 		if (err != 0 || src->ogg == 0) return false;
 		
-		third_party_allocator = src->allocator;
-		src->number_of_frames = stb_vorbis_stream_length_in_samples(src->ogg);
-		third_party_allocator = ZERO(Allocator);
+		// Length in source format frames, not file frames
+		src->number_of_frames = ogg_length;
+		if ((u64)src->ogg->sample_rate != (u64)src->format.sample_rate) {
+			f64 ratio = (f64)src->format.sample_rate/(f64)src->ogg->sample_rate;
+			src->number_of_frames = (u64)round((f64)ogg_length*ratio);
+		}
+		
+		src->ogg_cursor = ogg_cursor_create(src->allocator);
 	} else {
 		log_error("Error in audio_open_source_stream(): Unrecognized audio format in file '%s'. We currently support WAV and OGG (Vorbis).", path);
 		return false;
@@ -631,6 +714,21 @@ audio_open_source_load_format(Audio_Source *src, string path, Audio_Format forma
 	
 	if (check_wav_header(header)) {
 		src->decoder = AUDIO_DECODER_WAV;
+		
+		// Already stored in the format we want, so just point into the file instead of
+		// reading & converting a copy of it.
+		Audio_Format mapped_format;
+		void *mapped_frames;
+		u64 mapped_number_of_frames;
+		if (wav_map_file(path, &src->mapping, &mapped_format, &mapped_frames, &mapped_number_of_frames)) {
+			if (bytes_match(&mapped_format, &src->format, sizeof(Audio_Format))) {
+				src->pcm_frames = mapped_frames;
+				src->number_of_frames = mapped_number_of_frames;
+				return true;
+			}
+			os_file_unmap(&src->mapping);
+		}
+		
 		ok = wav_load_file(path, &src->pcm_frames, src->format, &src->number_of_frames, src->allocator);
 		if (!ok) return false;
 	} else if (check_ogg_header(header)) {
@@ -639,16 +737,23 @@ audio_open_source_load_format(Audio_Source *src, string path, Audio_Format forma
 		ok = os_read_entire_file(path, &src->ogg_raw, src->allocator);
 		if (!ok) return false;
 		
-		third_party_allocator = src->allocator;
+		Third_Party_Scope scope = third_party_scope_begin(src->allocator);
 		int err = 0;
 		src->ogg = stb_vorbis_open_memory(src->ogg_raw.data, src->ogg_raw.count, &err, 0);
-		third_party_allocator = ZERO(Allocator);
+		u64 ogg_length = 0;
+		if (err == 0 && src->ogg) ogg_length = stb_vorbis_stream_length_in_samples(src->ogg);
+		third_party_scope_end(scope);
 		
 		if (err != 0 || src->ogg == 0) return false;
 		
-		third_party_allocator = src->allocator;
-		src->number_of_frames = stb_vorbis_stream_length_in_samples(src->ogg);
-		third_party_allocator = ZERO(Allocator);
+		// Length in source format frames, not file frames
+		src->number_of_frames = ogg_length;
+		if ((u64)src->ogg->sample_rate != (u64)src->format.sample_rate) {
+			f64 ratio = (f64)src->format.sample_rate/(f64)src->ogg->sample_rate;
+			src->number_of_frames = (u64)round((f64)ogg_length*ratio);
+		}
+		
+		src->ogg_cursor = ogg_cursor_create(src->allocator);
 		
 		src->pcm_frames = alloc(src->allocator, src->number_of_frames*frame_size);
 		int retrieved = audio_source_get_frames(
@@ -659,9 +764,13 @@ audio_open_source_load_format(Audio_Source *src, string path, Audio_Format forma
 		);
 		
 		
-		third_party_allocator = src->allocator;
+		scope = third_party_scope_begin(src->allocator);
 		stb_vorbis_close(src->ogg);
-		third_party_allocator = ZERO(Allocator);
+		third_party_scope_end(scope);
+		
+		ogg_cursor_destroy(src->ogg_cursor, src->allocator);
+		src->ogg_cursor = 0;
+		dealloc_string(src->allocator, src->ogg_raw);
 		
 		if (retrieved != src->number_of_frames) {
 			dealloc(src->allocator, src->pcm_frames);
@@ -674,6 +783,8 @@ audio_open_source_load_format(Audio_Source *src, string path, Audio_Format forma
 	
 	return true;
 }
+// WAV files already in the output format are mapped instead of read, and stay mapped (and
+// locked on windows) until audio_source_destroy.
 bool
 audio_open_source_load(Audio_Source *src, string path, Allocator allocator) {
 	mutex_acquire_or_wait(&audio_init_mutex);
@@ -682,6 +793,50 @@ audio_open_source_load(Audio_Source *src, string path, Allocator allocator) {
 	return audio_open_source_load_format(src, path, format, allocator);
 }
 
+bool
+audio_open_source_map_format(Audio_Source *src, string path, Audio_Format format, 
+							 Allocator allocator) {
+	*src = ZERO(Audio_Source);
+	
+	Audio_Format mapped_format;
+	void *mapped_frames;
+	u64 mapped_number_of_frames;
+	if (!wav_map_file(path, &src->mapping, &mapped_format, &mapped_frames, &mapped_number_of_frames)) {
+		// Ogg, 24-bit wav etc. need actual decoding so those are loaded like normal
+		return audio_open_source_load_format(src, path, format, allocator);
+	}
+	
+	src->uid = next_audio_source_uid;
+	next_audio_source_uid += 1;
+	
+	mutex_init(&src->mutex_for_destroy);
+	
+	src->allocator = allocator;
+	src->decoder = AUDIO_DECODER_WAV;
+	src->pcm_frames = mapped_frames;
+	src->number_of_frames = mapped_number_of_frames;
+	src->mapped_format = mapped_format;
+	
+	// Sample rate stays the file's. Players resample with their own resampler anyway, which
+	// sounds better than converting the rate here per callback.
+	src->format = (Audio_Format){ format.bit_width, format.channels, mapped_format.sample_rate };
+	
+	if (bytes_match(&mapped_format, &src->format, sizeof(Audio_Format))) {
+		src->kind = AUDIO_SOURCE_MEMORY;
+	} else {
+		src->kind = AUDIO_SOURCE_MAPPED;
+	}
+	
+	return true;
+}
+bool
+audio_open_source_map(Audio_Source *src, string path, Allocator allocator) {
+	mutex_acquire_or_wait(&audio_init_mutex);
+	Audio_Format format = audio_output_format;
+	mutex_release(&audio_init_mutex);
+	return audio_open_source_map_format(src, path, format, allocator);
+}
+
 void 
 audio_source_destroy(Audio_Source *src) {
 
@@ -689,7 +844,7 @@ audio_source_destroy(Audio_Source *src) {
 
 	switch (src->kind) {
 		case AUDIO_SOURCE_FILE_STREAM: {
-			third_party_allocator = src->allocator;
+			Third_Party_Scope scope = third_party_scope_begin(src->allocator);
 			switch (src->decoder) {
 				case AUDIO_DECODER_WAV: {
 					wav_close(&src->wav);
@@ -697,15 +852,18 @@ audio_source_destroy(Audio_Source *src) {
 				}
 				case AUDIO_DECODER_OGG: {
 					stb_vorbis_close(src->ogg);
+					ogg_cursor_destroy(src->ogg_cursor, src->allocator);
 					dealloc_string(src->allocator, src->ogg_raw);
 					break;
 				}
 			}
-			third_party_allocator = ZERO(Allocator);
+			third_party_scope_end(scope);
 			break;
 		}
-		case AUDIO_SOURCE_MEMORY: {
-			dealloc(src->allocator, src->pcm_frames);
+		case AUDIO_SOURCE_MEMORY:
+		case AUDIO_SOURCE_MAPPED: {
+			if (src->mapping.data) os_file_unmap(&src->mapping);
+			else                   dealloc(src->allocator, src->pcm_frames);
 			break;
 		}
 	}
@@ -731,83 +889,7 @@ audio_source_get_frames(Audio_Source *src, u64 first_frame_index,
 		
 	} break; // case AUDIO_DECODER_WAV:
 	case AUDIO_DECODER_OGG:  {
-		f64 ratio = (f64)src->ogg->sample_rate/(f64)src->format.sample_rate;
-		
-		third_party_allocator = src->allocator;
-		bool seek_ok = stb_vorbis_seek(src->ogg, round(first_frame_index*ratio));
-		third_party_allocator = ZERO(Allocator);
-		assert(seek_ok);
-		
-		// We need to convert sample rate & channels for vorbis
-		
-		u64 comp_size = get_audio_bit_width_byte_size(src->format.bit_width);
-		u64 frame_size = src->format.channels*comp_size;
-		
-		u64 convert_frame_size = max(src->format.channels, src->ogg->channels)*comp_size;
-		u64 required_size = convert_frame_size*number_of_frames;
-		
-		// #Cleanup #Memory refactor intermediate buffers
-		local_persist thread_local void *convert_buffer = 0;
-		local_persist thread_local u64  convert_buffer_size = 0;
-		if (!convert_buffer || required_size > convert_buffer_size) {
-			if (convert_buffer) dealloc(get_heap_allocator(), convert_buffer);
-			
-			u64 new_size = get_next_power_of_two(required_size);
-			
-			convert_buffer = alloc(get_heap_allocator(), new_size);
-			memset(convert_buffer, 0, new_size);
-			convert_buffer_size = new_size;
-		}
-		
-		u64 number_of_frames_to_sample = number_of_frames;
-		void *target_buffer = output_buffer;
-		
-		if (src->ogg->sample_rate != src->format.sample_rate 
-		    || src->ogg->channels != src->format.channels) {
-			number_of_frames_to_sample = (u64)round(ratio * (f32)number_of_frames);
-			target_buffer = convert_buffer;
-		}
-		
-		third_party_allocator = src->allocator;
-		
-		// Unfortunately, vorbis only converts o a different channel count if that differing
-		// channel count is 2. So we might as well just deal with it ourselves.
-		
-		switch(src->format.bit_width) {
-		case AUDIO_BITS_32: {
-			retrieved = stb_vorbis_get_samples_float_interleaved(
-				src->ogg, 
-				src->ogg->channels, 
-				(f32*)target_buffer, 
-				number_of_frames_to_sample * src->ogg->channels
-			);
-			break;
-		}
-		case AUDIO_BITS_16: {
-			retrieved = stb_vorbis_get_samples_short_interleaved(
-				src->ogg, 
-				src->ogg->channels, 
-				(s16*)target_buffer, 
-				number_of_frames_to_sample * src->ogg->channels
-			); 
-			break;
-		}
-		default: panic("Invalid bits value");
-		}
-		third_party_allocator = ZERO(Allocator);
-		
-		if (src->ogg->sample_rate != src->format.sample_rate 
-		    || src->ogg->channels != src->format.channels) {
-		    
-			retrieved = convert_frames(
-				output_buffer, 
-				src->format,
-				convert_buffer, 
-				(Audio_Format){src->format.bit_width, src->ogg->channels, src->ogg->sample_rate},
-				number_of_frames
-			);
-		}
-		
+		retrieved = ogg_cursor_read_frames(src, first_frame_index, number_of_frames, output_buffer);
 	} break; // case AUDIO_DECODER_OGG:
 	default: panic("Invalid decoder value");
 	}
@@ -815,6 +897,26 @@ audio_source_get_frames(Audio_Source *src, u64 first_frame_index,
 	return retrieved;
 }
 
+void
+audio_source_copy_pcm_frames(Audio_Source *src, void *dst, u64 first_frame_index, u64 number_of_frames) {
+	if (src->kind == AUDIO_SOURCE_MEMORY) {
+		u64 frame_size = get_audio_bit_width_byte_size(src->format.bit_width)*src->format.channels;
+		memcpy(dst, (u8*)src->pcm_frames + first_frame_index*frame_size, number_of_frames*frame_size);
+	} else {
+		assert(src->kind == AUDIO_SOURCE_MAPPED);
+		assert(src->mapped_format.sample_rate == src->format.sample_rate);
+		
+		u64 mapped_frame_size = get_audio_bit_width_byte_size(src->mapped_format.bit_width)*src->mapped_format.channels;
+		convert_frames(
+			dst, 
+			src->format, 
+			(u8*)src->pcm_frames + first_frame_index*mapped_frame_size, 
+			src->mapped_format, 
+			number_of_frames
+		);
+	}
+}
+
 u64 // New frame index 
 audio_source_sample_next_frames(Audio_Source *src, u64 first_frame_index, u64 number_of_frames, 
 						   void *output_buffer, bool looping) {
@@ -824,7 +926,9 @@ audio_source_sample_next_frames(Audio_Source *src, u64 first_frame_index, u64 nu
     u64 output_size = number_of_frames * frame_size;
     
     if (first_frame_index == src->number_of_frames) {
-    	return first_frame_index;
+    	if (!looping) return first_frame_index;
+    	// Looping players parked at the end (:PhaseCancellation) start over instead of getting stuck there
+    	first_frame_index = 0;
     }
     
 	assert(first_frame_index < src->number_of_frames, "Invalid first_frame_index");
@@ -854,7 +958,7 @@ audio_source_sample_next_frames(Audio_Source *src, u64 first_frame_index, u64 nu
 					number_of_frames-num_retrieved, 
 					dst_remain
 				);
-				new_index = number_of_frames-num_retrieved;
+				new_index = num_retrieved;
 			} else {
 				memset(dst_remain, 0, frame_size * (number_of_frames - num_retrieved));
 			}	
@@ -862,11 +966,11 @@ audio_source_sample_next_frames(Audio_Source *src, u64 first_frame_index, u64 nu
 		
 		break; // case AUDIO_SOURCE_FILE_STREAM
 	}
-	case AUDIO_SOURCE_MEMORY: {
+	case AUDIO_SOURCE_MEMORY:
+	case AUDIO_SOURCE_MAPPED: {
 		s64 first_number_of_frames = min(number_of_frames, src->number_of_frames-first_frame_index);
-		void *src_pcm_start = (u8*)src->pcm_frames + first_frame_index*frame_size;
 		
-		memcpy(output_buffer, src_pcm_start, first_number_of_frames*frame_size);
+		audio_source_copy_pcm_frames(src, output_buffer, first_frame_index, first_number_of_frames);
 		new_index += first_number_of_frames;
 		
 		s64 remainder = number_of_frames-first_number_of_frames;
@@ -874,7 +978,7 @@ audio_source_sample_next_frames(Audio_Source *src, u64 first_frame_index, u64 nu
 			void *dst_remain = (u8*)output_buffer + first_number_of_frames*frame_size;
 			
 			if (looping) {
-				memcpy(dst_remain, src->pcm_frames, frame_size*remainder);
+				audio_source_copy_pcm_frames(src, dst_remain, 0, remainder);
 				new_index = remainder;
 			} else {
 				memset(dst_remain, 0, frame_size*remainder);
@@ -914,6 +1018,7 @@ mix_frames(void *dst, void *src, u64 frame_count, Audio_Format format) {
             switch (format.bit_width) {
                 case AUDIO_BITS_32: {
                 	*((f32*)dst_sample) += *((f32*)src_sample);
+                	break;
             	}
                 case AUDIO_BITS_16: {
                     s16 dst_int = *((s16*)dst_sample);
@@ -1009,6 +1114,36 @@ resample_frames(void *dst, Audio_Format dst_format,
     
 }
 
+void
+convert_s16_to_f32(f32 *dst, s16 *src, u64 sample_count) {
+	u64 i = 0;
+#if SIMD_ENABLE_SSE2
+	__m128 scale = _mm_set1_ps(1.0f/32768.0f);
+	for (; i + 8 <= sample_count; i += 8) {
+		__m128i x  = _mm_loadu_si128((__m128i*)(src+i));
+		// Sign extend by putting each sample in the high half and shifting it back down
+		__m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(x, x), 16);
+		__m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(x, x), 16);
+		_mm_storeu_ps(dst+i,   _mm_mul_ps(_mm_cvtepi32_ps(lo), scale));
+		_mm_storeu_ps(dst+i+4, _mm_mul_ps(_mm_cvtepi32_ps(hi), scale));
+	}
+#endif
+	for (; i < sample_count; i++) dst[i] = (f32)src[i] * (1.0f/32768.0f);
+}
+void
+convert_f32_to_s16(s16 *dst, f32 *src, u64 sample_count) {
+	u64 i = 0;
+#if SIMD_ENABLE_SSE2
+	__m128 scale = _mm_set1_ps(32768.0f);
+	for (; i + 8 <= sample_count; i += 8) {
+		__m128i lo = _mm_cvttps_epi32(_mm_mul_ps(_mm_loadu_ps(src+i),   scale));
+		__m128i hi = _mm_cvttps_epi32(_mm_mul_ps(_mm_loadu_ps(src+i+4), scale));
+		_mm_storeu_si128((__m128i*)(dst+i), _mm_packs_epi32(lo, hi)); // Saturates
+	}
+#endif
+	for (; i < sample_count; i++) dst[i] = (s16)clamp(src[i]*32768.0f, -32768.0f, 32767.0f);
+}
+
 // Assumes dst buffer is large enough
 int // Returns outputted number of frames
 convert_frames(void *dst, Audio_Format dst_format, 
@@ -1034,8 +1169,13 @@ convert_frames(void *dst, Audio_Format dst_format,
 	bool need_sample_conversion 
 		= dst_format.channels != src_format.channels 
 	   || dst_format.bit_width != src_format.bit_width;
-	// #Speed #Simd
-	if (need_sample_conversion) {
+	if (need_sample_conversion && dst_format.channels == src_format.channels) {
+		// Only the bit width differs, which is the common case (s16 files, f32 mixing)
+		u64 sample_count = src_frame_count*src_format.channels;
+		if (src_format.bit_width == AUDIO_BITS_16) convert_s16_to_f32(dst, src, sample_count);
+		else                                       convert_f32_to_s16(dst, src, sample_count);
+	} else if (need_sample_conversion) {
+		// #Speed #Simd
 		for (u64 src_frame_index = 0; src_frame_index < src_frame_count; src_frame_index++) {
 	        void *src_frame = ((u8*)src) + src_frame_index*src_frame_size;
 	        void *dst_frame = ((u8*)dst) + src_frame_index*dst_frame_size;
@@ -1138,6 +1278,721 @@ convert_frames(void *dst, Audio_Format dst_format,
 
 
 
+///
+// Resampling
+
+// Stateful windowed-sinc resampler, one per player.
+// The old path rounded number_of_output_frames*ratio every callback and linearly interpolated
+// within that one buffer, so any playback_speed that didn't divide evenly drifted and clicked
+// at buffer boundaries. This keeps the fractional read position and the tail of the previous
+// input between calls, so consecutive callbacks are one continuous signal.
+// The filter is a polyphase table (AUDIO_RESAMPLE_PHASES rows of taps) and we interpolate
+// between the two nearest rows, so any ratio works, not just "nice" ones.
+
+typedef enum Audio_Resample_Quality {
+	AUDIO_RESAMPLE_QUALITY_DEFAULT = 0, // Uses audio_default_resample_quality
+	AUDIO_RESAMPLE_QUALITY_LINEAR,      // 2 taps. Cheapest, aliases audibly when pitching up.
+	AUDIO_RESAMPLE_QUALITY_LOW,         // 8 taps
+	AUDIO_RESAMPLE_QUALITY_MEDIUM,      // 16 taps
+	AUDIO_RESAMPLE_QUALITY_HIGH,        // 32 taps
+	
+	AUDIO_RESAMPLE_QUALITY_COUNT,
+} Audio_Resample_Quality;
+
+#define AUDIO_RESAMPLE_PHASES 128
+// Lowpass cutoff is quantized so we only ever build a handful of tables when the
+// playback speed changes continuously.
+#define AUDIO_RESAMPLE_CUTOFF_STEPS 32
+
+typedef struct Audio_Resample_Kernel {
+	u64 taps; // Always a multiple of 4 so the dot product can go wide
+	f32 *coefficients; // (AUDIO_RESAMPLE_PHASES+1) rows of taps
+} Audio_Resample_Kernel;
+
+typedef struct Audio_Resampler {
+	Audio_Resample_Quality quality; // Resolved quality the history was set up for
+	u64 channels;
+	u64 taps;
+	f64 position; // Fractional read position in the history, carried between calls
+	f32 *planar;  // channels*capacity, channel c starts at planar+c*capacity
+	u64 capacity;
+	bool initted;
+} Audio_Resampler;
+
+// #Global
+ogb_instance Audio_Resample_Quality audio_default_resample_quality;
+ogb_instance Audio_Resample_Kernel audio_resample_kernels[AUDIO_RESAMPLE_QUALITY_COUNT][AUDIO_RESAMPLE_CUTOFF_STEPS+1];
+ogb_instance Spinlock audio_resample_kernel_lock;
+
+#if !OOGABOOGA_LINK_EXTERNAL_INSTANCE
+Audio_Resample_Quality audio_default_resample_quality = AUDIO_RESAMPLE_QUALITY_MEDIUM;
+Audio_Resample_Kernel audio_resample_kernels[AUDIO_RESAMPLE_QUALITY_COUNT][AUDIO_RESAMPLE_CUTOFF_STEPS+1] = {0};
+Spinlock audio_resample_kernel_lock = {0};
+#endif
+
+u64
+audio_resample_quality_get_taps(Audio_Resample_Quality quality) {
+	switch (quality) {
+		// Linear is 4 wide with zeroes on the edges so it can go through the same path
+		case AUDIO_RESAMPLE_QUALITY_LINEAR: return 4;
+		case AUDIO_RESAMPLE_QUALITY_LOW:    return 8;
+		case AUDIO_RESAMPLE_QUALITY_MEDIUM: return 16;
+		case AUDIO_RESAMPLE_QUALITY_HIGH:   return 32;
+		default: panic("Unhandled resample quality");
+	}
+	return 0;
+}
+
+Audio_Resample_Kernel *
+audio_resample_get_kernel(Audio_Resample_Quality quality, f64 step) {
+	assert(quality > AUDIO_RESAMPLE_QUALITY_DEFAULT && quality < AUDIO_RESAMPLE_QUALITY_COUNT);
+	
+	// When step > 1 we are reading faster than we output, so everything above the output
+	// nyquist needs to go or it folds back down.
+	f64 cutoff = step > 1.0 ? 1.0/step : 1.0;
+	u64 cutoff_step = (u64)round(cutoff*AUDIO_RESAMPLE_CUTOFF_STEPS);
+	cutoff_step = clamp(cutoff_step, 1, AUDIO_RESAMPLE_CUTOFF_STEPS);
+	
+	Audio_Resample_Kernel *kernel = &audio_resample_kernels[quality][cutoff_step];
+	
+	if (kernel->coefficients) return kernel;
+	
+	spinlock_acquire_or_wait(&audio_resample_kernel_lock);
+	
+	if (!kernel->coefficients) {
+		u64 taps = audio_resample_quality_get_taps(quality);
+		s64 half = taps/2;
+		f32 *coefficients = alloc_uninitialized(get_heap_allocator(), (AUDIO_RESAMPLE_PHASES+1)*taps*sizeof(f32));
+		
+		// Leave a little headroom below nyquist, the window isn't infinitely steep.
+		f64 fc = ((f64)cutoff_step/(f64)AUDIO_RESAMPLE_CUTOFF_STEPS)*0.95;
+		
+		for (u64 phase = 0; phase <= AUDIO_RESAMPLE_PHASES; phase++) {
+			f64 frac = (f64)phase/(f64)AUDIO_RESAMPLE_PHASES;
+			f32 *row = coefficients + phase*taps;
+			
+			f64 sum = 0;
+			for (u64 j = 0; j < taps; j++) {
+				// Distance from the tap to the point we are reconstructing
+				f64 x = (f64)((s64)j - (half-1)) - frac;
+				f64 h;
+				if (quality == AUDIO_RESAMPLE_QUALITY_LINEAR) {
+					h = max(0.0, 1.0 - fabs(x));
+				} else {
+					f64 sinc = x == 0.0 ? 1.0 : sin(PI64*fc*x)/(PI64*fc*x);
+					// Blackman
+					f64 w = 0.0;
+					if (fabs(x) < (f64)half) {
+						f64 n = (x/(f64)half + 1.0)*0.5;
+						w = 0.42 - 0.5*cos(TAU64*n) + 0.08*cos(2.0*TAU64*n);
+					}
+					h = fc*sinc*w;
+				}
+				row[j] = (f32)h;
+				sum += h;
+			}
+			
+			// Normalize each row to unity gain so DC/low frequencies don't wobble with the phase
+			if (sum != 0.0) {
+				for (u64 j = 0; j < taps; j++) row[j] = (f32)((f64)row[j]/sum);
+			}
+		}
+		
+		kernel->taps = taps;
+		MEMORY_BARRIER;
+		kernel->coefficients = coefficients;
+	}
+	
+	spinlock_release(&audio_resample_kernel_lock);
+	
+	return kernel;
+}
+
+inline f32
+audio_resample_dot(f32 *samples, f32 *row0, f32 *row1, f32 t, u64 taps) {
+#if ENABLE_SIMD
+	#if SIMD_ENABLE_AVX
+	if (taps % 8 == 0) {
+		__m256 acc = _mm256_setzero_ps();
+		__m256 vt  = _mm256_set1_ps(t);
+		for (u64 j = 0; j < taps; j += 8) {
+			__m256 c0 = _mm256_loadu_ps(row0+j);
+			__m256 c1 = _mm256_loadu_ps(row1+j);
+			__m256 c  = _mm256_add_ps(c0, _mm256_mul_ps(_mm256_sub_ps(c1, c0), vt));
+			acc = _mm256_add_ps(acc, _mm256_mul_ps(_mm256_loadu_ps(samples+j), c));
+		}
+		__m128 lo = _mm256_castps256_ps128(acc);
+		__m128 hi = _mm256_extractf128_ps(acc, 1);
+		__m128 sum4 = _mm_add_ps(lo, hi);
+		__m128 shuf = _mm_shuffle_ps(sum4, sum4, _MM_SHUFFLE(2, 3, 0, 1));
+		__m128 sums = _mm_add_ps(sum4, shuf);
+		shuf = _mm_movehl_ps(shuf, sums);
+		sums = _mm_add_ss(sums, shuf);
+		return _mm_cvtss_f32(sums);
+	}
+	#endif
+	__m128 acc = _mm_setzero_ps();
+	__m128 vt  = _mm_set1_ps(t);
+	for (u64 j = 0; j < taps; j += 4) {
+		__m128 c0 = _mm_loadu_ps(row0+j);
+		__m128 c1 = _mm_loadu_ps(row1+j);
+		__m128 c  = _mm_add_ps(c0, _mm_mul_ps(_mm_sub_ps(c1, c0), vt));
+		acc = _mm_add_ps(acc, _mm_mul_ps(_mm_loadu_ps(samples+j), c));
+	}
+	__m128 shuf = _mm_shuffle_ps(acc, acc, _MM_SHUFFLE(2, 3, 0, 1));
+	__m128 sums = _mm_add_ps(acc, shuf);
+	shuf = _mm_movehl_ps(shuf, sums);
+	sums = _mm_add_ss(sums, shuf);
+	return _mm_cvtss_f32(sums);
+#else
+	f32 acc = 0;
+	for (u64 j = 0; j < taps; j++) {
+		acc += samples[j] * (row0[j] + (row1[j]-row0[j])*t);
+	}
+	return acc;
+#endif
+}
+
+void
+audio_resampler_reset(Audio_Resampler *r) {
+	r->initted = false;
+}
+
+void
+audio_resampler_destroy(Audio_Resampler *r) {
+	if (r->planar) dealloc(get_heap_allocator(), r->planar);
+	*r = ZERO(Audio_Resampler);
+}
+
+void
+audio_resampler_setup(Audio_Resampler *r, Audio_Resample_Quality quality, u64 channels) {
+	if (quality == AUDIO_RESAMPLE_QUALITY_DEFAULT) quality = audio_default_resample_quality;
+	assert(quality > AUDIO_RESAMPLE_QUALITY_DEFAULT && quality < AUDIO_RESAMPLE_QUALITY_COUNT, "Invalid resample quality");
+	
+	if (r->initted && r->quality == quality && r->channels == channels) return;
+	
+	u64 taps = audio_resample_quality_get_taps(quality);
+	
+	// The planar buffer is laid out for the old channel count and taps. If that changed, let
+	// audio_resampler_process make a new one, otherwise just clear the history.
+	if (r->planar) {
+		if (r->channels != channels || r->taps != taps) {
+			dealloc(get_heap_allocator(), r->planar);
+			r->planar   = 0;
+			r->capacity = 0;
+		} else {
+			memset(r->planar, 0, r->channels*r->capacity*sizeof(f32));
+		}
+	}
+	
+	r->quality  = quality;
+	r->channels = channels;
+	r->taps     = taps;
+	
+	// History is the last taps input frames, which start as silence.
+	// First output frame is centered so its leftmost tap lands on history[0].
+	r->position = (f64)(r->taps/2 - 1);
+	
+	r->initted = true;
+}
+
+// How many input frames the next audio_resampler_process needs to produce
+// number_of_output_frames. Varies by +-1 between calls since the phase carries over.
+u64
+audio_resampler_get_required_input_frames(Audio_Resampler *r, Audio_Resample_Quality quality, 
+                                          u64 channels, f64 step, u64 number_of_output_frames) {
+	audio_resampler_setup(r, quality, channels);
+	
+	if (number_of_output_frames == 0) return 0;
+	
+	f64 last_position = r->position + (f64)(number_of_output_frames-1)*step;
+	s64 required = (s64)floor(last_position) + (s64)(r->taps/2) + 1 - (s64)r->taps;
+	
+	return (u64)max(required, 0);
+}
+
+// How many output frames number_of_input_frames more input is enough for. The inverse of
+// audio_resampler_get_required_input_frames, for when input comes in chunks we don't control.
+u64
+audio_resampler_get_available_output_frames(Audio_Resampler *r, Audio_Resample_Quality quality, 
+                                            u64 channels, f64 step, u64 number_of_input_frames) {
+	audio_resampler_setup(r, quality, channels);
+	
+	f64 x = ((f64)number_of_input_frames + (f64)(r->taps - r->taps/2) - r->position)/step;
+	if (x <= 0.0) return 0;
+	
+	u64 count = (u64)ceil(x);
+	while (count > 0 && audio_resampler_get_required_input_frames(r, quality, channels, step, count) > number_of_input_frames) {
+		count -= 1;
+	}
+	return count;
+}
+
+// Input and output are interleaved f32 with r->channels channels.
+// number_of_input_frames must be what audio_resampler_get_required_input_frames returned.
+void
+audio_resampler_process(Audio_Resampler *r, f32 *input, u64 number_of_input_frames, 
+                        f32 *output, u64 number_of_output_frames, f64 step) {
+	assert(r->initted, "Call audio_resampler_get_required_input_frames first");
+	assert(step > 0.0);
+	
+	u64 taps = r->taps;
+	u64 total_frames = taps + number_of_input_frames;
+	
+	if (total_frames > r->capacity) {
+		u64 new_capacity = get_next_power_of_two(total_frames);
+		f32 *new_planar = alloc_uninitialized(get_heap_allocator(), r->channels*new_capacity*sizeof(f32));
+		for (u64 c = 0; c < r->channels; c++) {
+			if (r->planar) {
+				memcpy(new_planar + c*new_capacity, r->planar + c*r->capacity, taps*sizeof(f32));
+			} else {
+				memset(new_planar + c*new_capacity, 0, taps*sizeof(f32));
+			}
+		}
+		if (r->planar) dealloc(get_heap_allocator(), r->planar);
+		r->planar   = new_planar;
+		r->capacity = new_capacity;
+	}
+	
+	// Deinterleave after the history so each channel is contiguous for the dot product
+	for (u64 f = 0; f < number_of_input_frames; f++) {
+		for (u64 c = 0; c < r->channels; c++) {
+			r->planar[c*r->capacity + taps + f] = input[f*r->channels + c];
+		}
+	}
+	
+	Audio_Resample_Kernel *kernel = audio_resample_get_kernel(r->quality, step);
+	assert(kernel->taps == taps);
+	
+	u64 half = taps/2;
+	for (u64 f = 0; f < number_of_output_frames; f++) {
+		f64 p = r->position + (f64)f*step;
+		u64 i = (u64)p;
+		f64 phase = (p - (f64)i)*AUDIO_RESAMPLE_PHASES;
+		u64 phase_index = (u64)phase;
+		f32 t = (f32)(phase - (f64)phase_index);
+		
+		f32 *row0 = kernel->coefficients + phase_index*taps;
+		f32 *row1 = row0 + taps;
+		
+		u64 first = i - (half-1);
+		assert(first + taps <= total_frames);
+		
+		for (u64 c = 0; c < r->channels; c++) {
+			output[f*r->channels + c] = audio_resample_dot(r->planar + c*r->capacity + first, row0, row1, t, taps);
+		}
+	}
+	
+	// Keep the last taps frames as history for the next call
+	for (u64 c = 0; c < r->channels; c++) {
+		f32 *channel = r->planar + c*r->capacity;
+		memmove(channel, channel + number_of_input_frames, taps*sizeof(f32));
+	}
+	r->position += (f64)number_of_output_frames*step - (f64)number_of_input_frames;
+}
+
+
+///
+// Ogg decode cursor
+
+// stb_vorbis_seek re-decodes from the previous page, so seeking on every callback (what we
+// used to do) made streamed music several times more expensive than the decode itself.
+// Playback is sequential almost always, so we keep a cursor per source and only seek when
+// the requested frame isn't where the cursor is (start, loop, set_time_stamp, or two players
+// sharing one streamed source).
+// Packets are decoded whole with stb_vorbis_get_frame_float and converted to the source
+// format once, into a small cache that callbacks read from.
+// If the file rate differs from the source rate, the stateful resampler goes in between, so
+// there's no per-callback rounding. A seek lands up to (taps/2+1) file frames early in that
+// case because of the filter delay, which is well under a millisecond.
+
+typedef struct Ogg_Decode_Cursor {
+	bool valid;
+	bool end_of_stream;
+	u64 next_frame_index; // In source format frames, which frame cache[cache_read] is
+	
+	// Decoded & converted to the source format, waiting to be read
+	u8 *cache;
+	u64 cache_capacity; // Frames
+	u64 cache_read;
+	u64 cache_count;
+	
+	// f32 with source channel count, at the file rate, waiting for the resampler
+	f32 *pending;
+	u64 pending_capacity; // Frames
+	u64 pending_count;
+	f32 *resampled;
+	u64 resampled_capacity; // Frames
+	Audio_Resampler resampler;
+	
+} Ogg_Decode_Cursor;
+
+void
+ogg_cursor_grow(void **buffer, u64 *capacity_frames, u64 required_frames, u64 frame_size, 
+                u64 frames_to_keep, Allocator allocator) {
+	if (*buffer && *capacity_frames >= required_frames) return;
+	
+	u64 new_capacity = get_next_power_of_two(max(required_frames, 1024));
+	void *new_buffer = alloc_uninitialized(allocator, new_capacity*frame_size);
+	if (*buffer) {
+		memcpy(new_buffer, *buffer, frames_to_keep*frame_size);
+		dealloc(allocator, *buffer);
+	}
+	*buffer = new_buffer;
+	*capacity_frames = new_capacity;
+}
+
+Ogg_Decode_Cursor *
+ogg_cursor_create(Allocator allocator) {
+	Ogg_Decode_Cursor *cursor = alloc(allocator, sizeof(Ogg_Decode_Cursor));
+	*cursor = ZERO(Ogg_Decode_Cursor);
+	return cursor;
+}
+
+void
+ogg_cursor_destroy(Ogg_Decode_Cursor *cursor, Allocator allocator) {
+	if (!cursor) return;
+	if (cursor->cache)     dealloc(allocator, cursor->cache);
+	if (cursor->pending)   dealloc(allocator, cursor->pending);
+	if (cursor->resampled) dealloc(allocator, cursor->resampled);
+	audio_resampler_destroy(&cursor->resampler);
+	dealloc(allocator, cursor);
+}
+
+// Planar f32 from vorbis to interleaved f32 with dst_channels, same rules as convert_frames:
+// mono goes to every channel, missing channels get the average, fewer channels get the average.
+void
+ogg_interleave_packet(f32 *dst, u64 dst_channels, f32 **planar, u64 src_channels, u64 number_of_frames) {
+	if (dst_channels == src_channels) {
+		for (u64 c = 0; c < src_channels; c++) {
+			f32 *in = planar[c];
+			for (u64 f = 0; f < number_of_frames; f++) dst[f*dst_channels+c] = in[f];
+		}
+		return;
+	}
+	
+	f32 inv_src_channels = 1.0f/(f32)src_channels;
+	for (u64 f = 0; f < number_of_frames; f++) {
+		f32 avg = 0;
+		for (u64 c = 0; c < src_channels; c++) avg += planar[c][f];
+		avg *= inv_src_channels;
+		
+		for (u64 c = 0; c < dst_channels; c++) {
+			if (src_channels == 1 || dst_channels < src_channels || c >= src_channels) {
+				dst[f*dst_channels+c] = avg;
+			} else {
+				dst[f*dst_channels+c] = planar[c][f];
+			}
+		}
+	}
+}
+
+// Next packet straight out of stb_vorbis' buffers, no copy. Also picks up what's left in
+// the buffers after a seek, which lands in the middle of a packet.
+int
+ogg_cursor_next_packet(stb_vorbis *ogg, f32 **planar) {
+	int n = ogg->channel_buffer_end - ogg->channel_buffer_start;
+	if (n <= 0) {
+		int channels;
+		f32 **outputs;
+		n = stb_vorbis_get_frame_float(ogg, &channels, &outputs);
+		if (n <= 0) return 0;
+	}
+	
+	for (int c = 0; c < ogg->channels; c++) {
+		planar[c] = ogg->channel_buffers[c] + ogg->channel_buffer_start;
+	}
+	ogg->channel_buffer_start = ogg->channel_buffer_end;
+	
+	return n;
+}
+
+// Decodes one packet into the cache. Returns false at end of stream.
+bool
+ogg_cursor_decode_packet(Audio_Source *src) {
+	Ogg_Decode_Cursor *cursor = src->ogg_cursor;
+	stb_vorbis *ogg = src->ogg;
+	
+	u64 channels   = src->format.channels;
+	u64 comp_size  = get_audio_bit_width_byte_size(src->format.bit_width);
+	u64 frame_size = comp_size*channels;
+	bool need_resample = (u64)ogg->sample_rate != (u64)src->format.sample_rate;
+	
+	if (cursor->end_of_stream) return false;
+	
+	f32 *planar[STB_VORBIS_MAX_CHANNELS];
+	Third_Party_Scope scope = third_party_scope_begin(src->allocator);
+	int n = ogg_cursor_next_packet(ogg, planar);
+	third_party_scope_end(scope);
+	
+	if (n <= 0) {
+		cursor->end_of_stream = true;
+		if (!need_resample) return false;
+		
+		// Flush what's still in the resampler history with silence
+		u64 flush = cursor->resampler.taps;
+		ogg_cursor_grow((void**)&cursor->pending, &cursor->pending_capacity, cursor->pending_count+flush, 
+		                sizeof(f32)*channels, cursor->pending_count, src->allocator);
+		memset(cursor->pending + cursor->pending_count*channels, 0, flush*sizeof(f32)*channels);
+		cursor->pending_count += flush;
+	} else {
+		// Convert channels once for the whole packet
+		ogg_cursor_grow((void**)&cursor->pending, &cursor->pending_capacity, cursor->pending_count+n, 
+		                sizeof(f32)*channels, cursor->pending_count, src->allocator);
+		ogg_interleave_packet(cursor->pending + cursor->pending_count*channels, channels, planar, ogg->channels, n);
+		cursor->pending_count += n;
+	}
+	
+	f32 *frames = cursor->pending;
+	u64 number_of_frames = cursor->pending_count;
+	
+	if (need_resample) {
+		f64 step = (f64)ogg->sample_rate/(f64)src->format.sample_rate;
+		u64 output_frames = audio_resampler_get_available_output_frames(
+			&cursor->resampler, 
+			AUDIO_RESAMPLE_QUALITY_DEFAULT, 
+			channels, 
+			step, 
+			cursor->pending_count
+		);
+		u64 input_frames = audio_resampler_get_required_input_frames(
+			&cursor->resampler, 
+			AUDIO_RESAMPLE_QUALITY_DEFAULT, 
+			channels, 
+			step, 
+			output_frames
+		);
+		assert(input_frames <= cursor->pending_count);
+		
+		ogg_cursor_grow((void**)&cursor->resampled, &cursor->resampled_capacity, output_frames, 
+		                sizeof(f32)*channels, 0, src->allocator);
+		audio_resampler_process(&cursor->resampler, cursor->pending, input_frames, cursor->resampled, output_frames, step);
+		
+		// Keep what the resampler didn't need yet for the next packet
+		cursor->pending_count -= input_frames;
+		memmove(cursor->pending, cursor->pending + input_frames*channels, cursor->pending_count*sizeof(f32)*channels);
+		
+		frames = cursor->resampled;
+		number_of_frames = output_frames;
+	} else {
+		cursor->pending_count = 0;
+	}
+	
+	// Append to the cache, compacting what's already been read first
+	if (cursor->cache_read > 0) {
+		memmove(cursor->cache, cursor->cache + cursor->cache_read*frame_size, cursor->cache_count*frame_size);
+		cursor->cache_read = 0;
+	}
+	ogg_cursor_grow((void**)&cursor->cache, &cursor->cache_capacity, cursor->cache_count+number_of_frames, 
+	                frame_size, cursor->cache_count, src->allocator);
+	
+	u8 *dst = cursor->cache + cursor->cache_count*frame_size;
+	switch (src->format.bit_width) {
+		case AUDIO_BITS_32: {
+			memcpy(dst, frames, number_of_frames*frame_size);
+			break;
+		}
+		case AUDIO_BITS_16: {
+			u64 sample_count = number_of_frames*channels;
+			for (u64 i = 0; i < sample_count; i++) {
+				f32 s = clamp(frames[i], -1.0f, 1.0f);
+				((s16*)dst)[i] = (s16)(s*32767.0f);
+			}
+			break;
+		}
+		default: panic("Invalid bits value");
+	}
+	cursor->cache_count += number_of_frames;
+	
+	return n > 0 || number_of_frames > 0;
+}
+
+int
+ogg_cursor_read_frames(Audio_Source *src, u64 first_frame_index, u64 number_of_frames, void *output_buffer) {
+	Ogg_Decode_Cursor *cursor = src->ogg_cursor;
+	stb_vorbis *ogg = src->ogg;
+	
+	u64 frame_size = get_audio_bit_width_byte_size(src->format.bit_width)*src->format.channels;
+	
+	if (!cursor->valid || first_frame_index != cursor->next_frame_index) {
+		f64 ratio = (f64)ogg->sample_rate/(f64)src->format.sample_rate;
+		
+		Third_Party_Scope scope = third_party_scope_begin(src->allocator);
+		u64 ogg_length = stb_vorbis_stream_length_in_samples(ogg);
+		u64 ogg_frame = min((u64)((f64)first_frame_index*ratio), ogg_length > 0 ? ogg_length-1 : 0);
+		bool seek_ok = stb_vorbis_seek(ogg, (unsigned int)ogg_frame);
+		third_party_scope_end(scope);
+		assert(seek_ok);
+		
+		cursor->cache_read    = 0;
+		cursor->cache_count   = 0;
+		cursor->pending_count = 0;
+		cursor->end_of_stream = false;
+		audio_resampler_reset(&cursor->resampler);
+		cursor->next_frame_index = first_frame_index;
+		cursor->valid = true;
+	}
+	
+	u64 frames_left_in_source = src->number_of_frames > first_frame_index ? src->number_of_frames-first_frame_index : 0;
+	u64 frames_to_read = min(number_of_frames, frames_left_in_source);
+	
+	u64 read = 0;
+	while (read < frames_to_read) {
+		if (cursor->cache_count == 0) {
+			if (!ogg_cursor_decode_packet(src)) {
+				// Rounding in the resampled length can leave us a frame or two short of
+				// number_of_frames, those are silence so the player still reaches the end.
+				memset((u8*)output_buffer + read*frame_size, 0, (frames_to_read-read)*frame_size);
+				read = frames_to_read;
+				break;
+			}
+			continue;
+		}
+		
+		u64 n = min(cursor->cache_count, frames_to_read-read);
+		memcpy((u8*)output_buffer + read*frame_size, cursor->cache + cursor->cache_read*frame_size, n*frame_size);
+		cursor->cache_read  += n;
+		cursor->cache_count -= n;
+		read += n;
+	}
+	
+	cursor->next_frame_index = first_frame_index + read;
+	
+	return (int)read;
+}
+
+///
+// Buses
+
+// Players mix into a bus, buses mix into their parent bus and master goes to the device.
+// Bus effects run once on the submix instead of once per voice, so a pause menu low-pass on
+// the sfx bus costs the same whether 3 or 300 sounds are playing.
+// Zero-initialized player configs go to master, which behaves exactly like before buses.
+
+typedef u32 Audio_Bus_Id;
+enum {
+	AUDIO_BUS_MASTER = 0,
+	AUDIO_BUS_MUSIC,
+	AUDIO_BUS_SFX,
+	AUDIO_BUS_UI,
+	
+	AUDIO_BUS_FIRST_USER,
+};
+#define AUDIO_MAX_BUSES 64
+
+typedef struct Audio_Compressor_Config {
+	bool enabled;
+	float32 threshold_db; // Level where gain reduction starts
+	float32 ratio;        // 4 means 4 dB over threshold comes out as 1 dB over
+	float32 attack_ms;
+	float32 release_ms;
+	float32 makeup_db;
+} Audio_Compressor_Config;
+
+typedef struct Audio_Bus_Config {
+	float32 volume;             // (1.0 by default)
+	float32 lowpass_cutoff_hz;  // 0 to disable
+	Audio_Compressor_Config compressor;
+	bool enable_limiter;        // Hard ceiling after everything else, so the bus never clips
+	float32 limiter_ceiling;    // Linear, (1.0 by default)
+} Audio_Bus_Config;
+
+typedef struct Audio_Bus {
+	// This is safe to set whenever
+	Audio_Bus_Config config;
+	
+	// You shouldn't touch these, they belong to the mixer
+	Audio_Bus_Id parent;
+	bool has_input; // Any voice or child bus mixed into us this callback
+	f32 *buffer;    // f32 with output channel count
+	u64 buffer_size;
+	f32 last_volume; // For ramping so volume changes don't zipper
+	
+	f32 lowpass_cutoff_hz; // What the coefficients below were computed for
+	f32 lowpass_sample_rate;
+	f32 b0, b1, b2, a1, a2;
+	f32 lowpass_state[8][4]; // Per channel x1, x2, y1, y2
+	
+	f32 compressor_envelope_db;
+	f32 limiter_gain;
+} Audio_Bus;
+
+// #Global
+ogb_instance Audio_Bus audio_buses[AUDIO_MAX_BUSES];
+ogb_instance volatile u64 audio_bus_count;
+ogb_instance Spinlock audio_bus_create_lock;
+
+#if !OOGABOOGA_LINK_EXTERNAL_INSTANCE
+Audio_Bus audio_buses[AUDIO_MAX_BUSES] = {0};
+volatile u64 audio_bus_count = 0;
+Spinlock audio_bus_create_lock = {0};
+#endif
+
+Audio_Bus_Config
+audio_bus_default_config() {
+	Audio_Bus_Config config = ZERO(Audio_Bus_Config);
+	config.volume = 1.0;
+	config.limiter_ceiling = 1.0;
+	config.compressor.threshold_db = -12.0;
+	config.compressor.ratio = 4.0;
+	config.compressor.attack_ms = 5.0;
+	config.compressor.release_ms = 100.0;
+	return config;
+}
+
+void
+audio_buses_init_if_needed() {
+	if (audio_bus_count != 0) return;
+	
+	spinlock_acquire_or_wait(&audio_bus_create_lock);
+	if (audio_bus_count == 0) {
+		for (Audio_Bus_Id id = 0; id < AUDIO_BUS_FIRST_USER; id++) {
+			audio_buses[id] = ZERO(Audio_Bus);
+			audio_buses[id].config = audio_bus_default_config();
+			audio_buses[id].last_volume = 1.0;
+			audio_buses[id].limiter_gain = 1.0;
+			audio_buses[id].parent = AUDIO_BUS_MASTER;
+		}
+		MEMORY_BARRIER;
+		audio_bus_count = AUDIO_BUS_FIRST_USER;
+	}
+	spinlock_release(&audio_bus_create_lock);
+}
+
+Audio_Bus *
+audio_get_bus(Audio_Bus_Id id) {
+	audio_buses_init_if_needed();
+	assert(id < audio_bus_count, "Invalid audio bus id %d", id);
+	return &audio_buses[id];
+}
+
+// The parent has to exist already, which is what keeps the graph a tree where every
+// bus comes after its parent. The mixer relies on that for its processing order.
+Audio_Bus_Id
+audio_bus_create(Audio_Bus_Id parent) {
+	audio_buses_init_if_needed();
+	
+	spinlock_acquire_or_wait(&audio_bus_create_lock);
+	
+	assert(parent < audio_bus_count, "Invalid parent audio bus %d", parent);
+	assert(audio_bus_count < AUDIO_MAX_BUSES, "Too many audio buses (AUDIO_MAX_BUSES is %d)", AUDIO_MAX_BUSES);
+	
+	Audio_Bus_Id id = (Audio_Bus_Id)audio_bus_count;
+	audio_buses[id] = ZERO(Audio_Bus);
+	audio_buses[id].config = audio_bus_default_config();
+	audio_buses[id].last_volume = 1.0;
+	audio_buses[id].limiter_gain = 1.0;
+	audio_buses[id].parent = parent;
+	
+	// Mixer reads the count without locking, so the bus must be complete before it's visible
+	MEMORY_BARRIER;
+	audio_bus_count = id+1;
+	
+	spinlock_release(&audio_bus_create_lock);
+	
+	return id;
+}
+
 #define AUDIO_SMOOTH_TRANSITION_TIME_MS 40
 
 typedef enum Audio_Player_State {
@@ -1150,6 +2005,8 @@ typedef struct Audio_Playback_Config {
 	bool enable_spacialization;
 	float32 volume;
 	float32 playback_speed;
+	Audio_Resample_Quality resample_quality; // Only matters when playback_speed != 1 or source rate != output rate
+	Audio_Bus_Id bus; // (AUDIO_BUS_MASTER by default)
 } Audio_Playback_Config;
 
 typedef struct Audio_Player {
@@ -1167,7 +2024,11 @@ typedef struct Audio_Player {
 	bool release_when_done;
 	// I think we only need to sync when audio thread samples the source, which should be
 	// fairly quick and low contention, hence a spinlock.
-	Spinlock sample_lock; 
+	Padded_Spinlock sample_lock; // Padded so players next to each other in memory don't share it
+	
+	// Only touched by the audio thread
+	Audio_Resampler resampler;
+	u64 resampler_next_frame_index; // If frame_index isn't this we seeked, so history is stale
 	
 	// #Cleanup
 	DEPRECATED(Vector3 position, "Use player->config.position_ndc instead"); // ndc space -1 to 1
@@ -1178,6 +2039,8 @@ typedef struct Audio_Player {
 	// This is safe to set whenever
 	Audio_Playback_Config config;
 	
+	struct Audio_Player *next_free; // Internal, for reusing released players
+	
 } Audio_Player;
 #define AUDIO_PLAYERS_PER_BLOCK 128
 typedef struct Audio_Player_Block {
@@ -1188,49 +2051,75 @@ typedef struct Audio_Player_Block {
 
 // #Global
 ogb_instance Audio_Player_Block audio_player_block;
+// Released players, so getting one doesn't scan every block. Players are released on the
+// audio thread and gotten on whatever thread plays stuff.
+ogb_instance Audio_Player *audio_player_free_list;
+ogb_instance bool audio_player_free_list_initted;
+ogb_instance Spinlock audio_player_free_list_lock;
 
 #if !OOGABOOGA_LINK_EXTERNAL_INSTANCE
 Audio_Player_Block audio_player_block = {0};
+Audio_Player *audio_player_free_list = 0;
+bool audio_player_free_list_initted = false;
+Spinlock audio_player_free_list_lock;
 #endif
 
+// Assumes audio_player_free_list_lock is held
+void
+audio_player_block_add_to_free_list(Audio_Player_Block *block, u64 first_index) {
+	// Backwards so players are handed out in order
+	for (s64 i = AUDIO_PLAYERS_PER_BLOCK-1; i >= (s64)first_index; i--) {
+		block->players[i].next_free = audio_player_free_list;
+		audio_player_free_list = &block->players[i];
+	}
+}
+void
+audio_player_add_to_free_list(Audio_Player *p) {
+	spinlock_acquire_or_wait(&audio_player_free_list_lock);
+	p->next_free = audio_player_free_list;
+	audio_player_free_list = p;
+	spinlock_release(&audio_player_free_list_lock);
+}
+
 Audio_Player *
 audio_player_get_one() {
 
-	Audio_Player_Block *block = &audio_player_block;
-	Audio_Player_Block *last = 0;
+	spinlock_acquire_or_wait(&audio_player_free_list_lock);
 	
-	while (block) {
+	if (!audio_player_free_list_initted) {
+		audio_player_block_add_to_free_list(&audio_player_block, 0);
+		audio_player_free_list_initted = true;
+	}
+	
+	Audio_Player *p = audio_player_free_list;
+	if (p) {
+		audio_player_free_list = p->next_free;
+	} else {
+		// No free player, make another block
+		// #Volatile can't assign to last->next before this is zero initialized
+		Audio_Player_Block *new_block = alloc(get_heap_allocator(), sizeof(Audio_Player_Block));
 		
-		for (u64 i = 0; i < AUDIO_PLAYERS_PER_BLOCK; i++) {
-			if (!block->players[i].allocated) {
-			
-				memset(&block->players[i], 0, sizeof(block->players[i]));
-				block->players[i].allocated = true;
-				block->players[i].config.volume = 1.0;
-				block->players[i].config.playback_speed = 1.0;
-				
-				return &block->players[i];
-			}
-		}
+#if !DO_ZERO_INITIALIATION
+		memset(new_block, 0, sizeof(*new_block));
+#endif
 		
-		last = block;
-		block = block->next;
+		Audio_Player_Block *last = &audio_player_block;
+		while (last->next) last = last->next;
+		last->next = new_block;
+		
+		audio_player_block_add_to_free_list(new_block, 1);
+		p = &new_block->players[0];
 	}
 	
-	// No free player found, make another block
-	// #Volatile can't assign to last->next before this is zero initialized
-	Audio_Player_Block *new_block = alloc(get_heap_allocator(), sizeof(Audio_Player_Block));
+	spinlock_release(&audio_player_free_list_lock);
 	
-#if !DO_ZERO_INITIALIATION
-	memset(new_block, 0, sizeof(*new_block));
-#endif
-
-	last->next = new_block;
-
-	new_block->players[0].allocated = true;
-	new_block->players[0].config.volume = 1.0;
-	block->players[0].config.playback_speed = 1.0;
-	return &new_block->players[0];
+	assert(!p->allocated, "Internal audio error: player on the free list is still allocated");
+	memset(p, 0, sizeof(*p));
+	p->allocated = true;
+	p->config.volume = 1.0;
+	p->config.playback_speed = 1.0;
+	
+	return p;
 }
 
 void 
@@ -1242,7 +2131,7 @@ audio_player_set_state(Audio_Player *p, Audio_Player_State state) {
 
 	if (p->state == state) return;
 
-	spinlock_acquire_or_wait(&p->sample_lock);
+	spinlock_acquire_or_wait(&p->sample_lock.lock);
 	assert(p->frame_index <= p->source.number_of_frames);
 	p->state = state;
 	
@@ -1258,11 +2147,11 @@ audio_player_set_state(Audio_Player *p, Audio_Player_State state) {
 	p->fade_frames = (u64)round(fade_factor*(float64)p->source.number_of_frames);
 	p->fade_frames_total = p->fade_frames;
 	
-	spinlock_release(&p->sample_lock);
+	spinlock_release(&p->sample_lock.lock);
 }
 void
 audio_player_set_time_stamp(Audio_Player *p, float64 time_in_seconds) {
-	spinlock_acquire_or_wait(&p->sample_lock);
+	spinlock_acquire_or_wait(&p->sample_lock.lock);
 	assert(p->frame_index <= p->source.number_of_frames);
 	
 	float64 full_duration 
@@ -1272,52 +2161,52 @@ audio_player_set_time_stamp(Audio_Player *p, float64 time_in_seconds) {
 	
 	p->frame_index = (u64)round((float64)p->source.number_of_frames*progression);
 	
-	spinlock_release(&p->sample_lock);
+	spinlock_release(&p->sample_lock.lock);
 }
 
 bool 
 audio_player_at_source_end(Audio_Player *p) {
-	spinlock_acquire_or_wait(&p->sample_lock);
+	spinlock_acquire_or_wait(&p->sample_lock.lock);
 	assert(p->frame_index <= p->source.number_of_frames);
 	
     bool finished = p->frame_index == p->source.number_of_frames;
 	
-	spinlock_release(&p->sample_lock);
+	spinlock_release(&p->sample_lock.lock);
 
     return finished;
 }
 
 void // 0 - 1
 audio_player_set_progression_factor(Audio_Player *p, float64 factor) {
-	spinlock_acquire_or_wait(&p->sample_lock);
+	spinlock_acquire_or_wait(&p->sample_lock.lock);
 	assert(p->frame_index <= p->source.number_of_frames);
 	
 	p->frame_index = (u64)round((float64)p->source.number_of_frames*factor);
 	
-	spinlock_release(&p->sample_lock);
+	spinlock_release(&p->sample_lock.lock);
 }
 float64 // seconds
 audio_player_get_time_stamp(Audio_Player *p) {
-	spinlock_acquire_or_wait(&p->sample_lock);
+	spinlock_acquire_or_wait(&p->sample_lock.lock);
 	assert(p->frame_index <= p->source.number_of_frames);
 	
 	float64 full_duration 
 		= (float64)p->source.number_of_frames/(float64)p->source.format.sample_rate;
 	float64 progression = (float64)p->frame_index / (float64)p->source.number_of_frames;
 	
-	spinlock_release(&p->sample_lock);
+	spinlock_release(&p->sample_lock.lock);
 	
 	return progression*full_duration;
 }
 float64
 audio_player_get_current_progression_factor(Audio_Player *p) {
 	if (!p->has_source) return 0;
-	spinlock_acquire_or_wait(&p->sample_lock);
+	spinlock_acquire_or_wait(&p->sample_lock.lock);
 	assert(p->frame_index <= p->source.number_of_frames);
 	
 	float64 progression = (float64)p->frame_index / (float64)p->source.number_of_frames;
 	
-	spinlock_release(&p->sample_lock);
+	spinlock_release(&p->sample_lock.lock);
 	
 	return progression;
 }
@@ -1326,29 +2215,29 @@ audio_player_set_source(Audio_Player *p, Audio_Source src) {
 
 	float64 last_progression = audio_player_get_current_progression_factor(p);
 	
-	spinlock_acquire_or_wait(&p->sample_lock);
+	spinlock_acquire_or_wait(&p->sample_lock.lock);
 
 	p->source = src;
 	p->has_source = true;
 	
 	p->frame_index = 0;
 	
-	spinlock_release(&p->sample_lock);
+	spinlock_release(&p->sample_lock.lock);
 }
 void 
 audio_player_clear_source(Audio_Player *p) {
-	spinlock_acquire_or_wait(&p->sample_lock);
+	spinlock_acquire_or_wait(&p->sample_lock.lock);
 	assert(p->frame_index <= p->source.number_of_frames);
 	
 	p->has_source = false;
 	p->state = AUDIO_PLAYER_STATE_PAUSED;
 	p->source = ZERO(Audio_Source);
 	
-	spinlock_release(&p->sample_lock);
+	spinlock_release(&p->sample_lock.lock);
 }
 void
 audio_player_set_looping(Audio_Player *p, bool looping) {
-	spinlock_acquire_or_wait(&p->sample_lock);
+	spinlock_acquire_or_wait(&p->sample_lock.lock);
 	
 	if (p->has_source && looping && !p->looping && p->frame_index == p->source.number_of_frames) {
 		p->frame_index = 0;
@@ -1356,7 +2245,7 @@ audio_player_set_looping(Audio_Player *p, bool looping) {
 	
 	p->looping = looping;
 	
-	spinlock_release(&p->sample_lock);
+	spinlock_release(&p->sample_lock.lock);
 }
 
 // #Global
@@ -1631,6 +2520,15 @@ void apply_audio_volume(void* frames, Audio_Format format, u64 number_of_frames,
     u64 frame_size = comp_size * format.channels;
 	if (vol <= 0.0) {
 		memset(frames, 0, frame_size*number_of_frames);
+		return;
+	}
+	
+	if (format.bit_width == AUDIO_BITS_32) {
+		// The mixer is all f32 now so this is the one that matters
+		f32 *samples = (f32*)frames;
+		u64 sample_count = number_of_frames*format.channels;
+		for (u64 i = 0; i < sample_count; i++) samples[i] *= vol;
+		return;
 	}
 	
 	for (u64 i = 0; i < number_of_frames; ++i) {
@@ -1655,19 +2553,198 @@ void apply_audio_volume(void* frames, Audio_Format format, u64 number_of_frames,
     }
 }
 
-// This is supposed to be called by OS layer audio thread whenever it wants more audio samples
+///
+// Offline rendering
+
+// Stage timings are always collected on the mixing thread (an rdtsc per stage per voice is
+// nothing compared to the stages themselves), offline rendering just reports them.
+typedef struct Audio_Stage_Timings {
+	u64 sample_cycles;  // Reading/decoding source frames
+	u64 fade_cycles;
+	u64 convert_cycles; // Channel/bit conversion & resampling
+	u64 effect_cycles;  // Spacialization & volume
+	u64 mix_cycles;
+	u64 bus_cycles;     // Bus effects & submixing, plus the final conversion to the output format
+	u64 total_cycles;
+	u64 callbacks;
+	u64 voices;         // Sum of players mixed over all callbacks
+} Audio_Stage_Timings;
+
+typedef struct Audio_Render_Stats {
+	u64 number_of_frames;
+	f64 seconds;
+	f64 frames_per_second;
+	f64 realtime_factor; // How many seconds of audio we rendered per second
+	Audio_Stage_Timings stages;
+} Audio_Render_Stats;
+
+#define AUDIO_OFFLINE_DEFAULT_FRAMES_PER_CALLBACK 480
+
+// #Global
+ogb_instance Spinlock audio_mix_lock;
+// Set while an offline render is running, the device thread outputs silence meanwhile.
+ogb_instance volatile u64 audio_offline_render_thread_id;
+
+#if !OOGABOOGA_LINK_EXTERNAL_INSTANCE
+Spinlock audio_mix_lock = {0};
+volatile u64 audio_offline_render_thread_id = 0;
+#endif
+
+thread_local Audio_Stage_Timings audio_stage_timings = {0};
+
+inline void
+audio_stage_timings_end(u64 *stage_cycles, u64 *stage_start) {
+	u64 now = rdtsc();
+	*stage_cycles += now - *stage_start;
+	*stage_start = now;
+}
+
+void
+audio_grow_scratch_buffer(void **buffer, u64 *buffer_size, u64 required_size) {
+	if (*buffer && *buffer_size >= required_size) return;
+	
+	u64 new_size = get_next_power_of_two(required_size);
+	if (*buffer) dealloc(get_heap_allocator(), *buffer);
+	*buffer = alloc_zeroed(get_heap_allocator(), new_size);
+	*buffer_size = new_size;
+}
+
+void
+audio_bus_update_lowpass(Audio_Bus *bus, f32 cutoff_hz, f32 sample_rate) {
+	if (bus->lowpass_cutoff_hz == cutoff_hz && bus->lowpass_sample_rate == sample_rate) return;
+	
+	// RBJ cookbook 2nd order lowpass, Q of 1/sqrt(2) for a butterworth response
+	f64 w0 = TAU64*(f64)min(cutoff_hz, sample_rate*0.49f)/(f64)sample_rate;
+	f64 cos_w0 = cos(w0);
+	f64 alpha = sin(w0)/(2.0*0.70710678);
+	f64 a0 = 1.0 + alpha;
+	
+	bus->b0 = (f32)(((1.0 - cos_w0)*0.5)/a0);
+	bus->b1 = (f32)((1.0 - cos_w0)/a0);
+	bus->b2 = bus->b0;
+	bus->a1 = (f32)((-2.0*cos_w0)/a0);
+	bus->a2 = (f32)((1.0 - alpha)/a0);
+	
+	bus->lowpass_cutoff_hz = cutoff_hz;
+	bus->lowpass_sample_rate = sample_rate;
+}
+
+// Runs the bus effect chain on its own buffer: volume, low-pass, compressor, limiter
+void
+audio_bus_process(Audio_Bus *bus, Audio_Format format, u64 number_of_frames) {
+	Audio_Bus_Config config = bus->config; // Can be set from any thread, read once
+	f32 *frames = bus->buffer;
+	u64 channels = format.channels;
+	
+	// Volume, ramped over the callback from what it was last time
+	f32 from = bus->last_volume;
+	f32 to = max(config.volume, 0.0f);
+	if (from != 1.0f || to != 1.0f) {
+		f32 step = (to-from)/(f32)number_of_frames;
+		for (u64 f = 0; f < number_of_frames; f++) {
+			f32 v = from + step*(f32)(f+1);
+			for (u64 c = 0; c < channels; c++) frames[f*channels+c] *= v;
+		}
+	}
+	bus->last_volume = to;
+	
+	if (config.lowpass_cutoff_hz > 0.0) {
+		audio_bus_update_lowpass(bus, config.lowpass_cutoff_hz, (f32)format.sample_rate);
+		
+		u64 filtered_channels = min(channels, 8);
+		for (u64 c = 0; c < filtered_channels; c++) {
+			f32 *state = bus->lowpass_state[c];
+			f32 x1 = state[0], x2 = state[1], y1 = state[2], y2 = state[3];
+			for (u64 f = 0; f < number_of_frames; f++) {
+				f32 x = frames[f*channels+c];
+				f32 y = bus->b0*x + bus->b1*x1 + bus->b2*x2 - bus->a1*y1 - bus->a2*y2;
+				x2 = x1; x1 = x;
+				y2 = y1; y1 = y;
+				frames[f*channels+c] = y;
+			}
+			// Flush denormals, they make the filter crawl once the input goes silent
+			if (fabsf(y1) < 1e-15f) y1 = 0;
+			if (fabsf(y2) < 1e-15f) y2 = 0;
+			state[0] = x1; state[1] = x2; state[2] = y1; state[3] = y2;
+		}
+	} else {
+		memset(bus->lowpass_state, 0, sizeof(bus->lowpass_state));
+	}
+	
+	if (config.compressor.enabled) {
+		Audio_Compressor_Config comp = config.compressor;
+		f32 attack  = (f32)exp(-1.0/(max(comp.attack_ms, 0.01f)*0.001*(f64)format.sample_rate));
+		f32 release = (f32)exp(-1.0/(max(comp.release_ms, 0.01f)*0.001*(f64)format.sample_rate));
+		f32 slope = 1.0f - 1.0f/max(comp.ratio, 1.0f);
+		f32 env = bus->compressor_envelope_db;
+		
+		for (u64 f = 0; f < number_of_frames; f++) {
+			f32 peak = 0;
+			for (u64 c = 0; c < channels; c++) peak = max(peak, fabsf(frames[f*channels+c]));
+			
+			f32 level_db = peak > 1e-6f ? 20.0f*log10f(peak) : -120.0f;
+			f32 coeff = level_db > env ? attack : release;
+			env = level_db + (env - level_db)*coeff;
+			
+			f32 over = env - comp.threshold_db;
+			f32 gain_db = comp.makeup_db - (over > 0 ? over*slope : 0);
+			f32 gain = powf(10.0f, gain_db*0.05f);
+			
+			for (u64 c = 0; c < channels; c++) frames[f*channels+c] *= gain;
+		}
+		bus->compressor_envelope_db = env;
+	} else {
+		bus->compressor_envelope_db = -120.0f;
+	}
+	
+	if (config.enable_limiter) {
+		// Instant attack so nothing gets over the ceiling, smooth release so it doesn't pump
+		f32 ceiling = config.limiter_ceiling > 0 ? config.limiter_ceiling : 1.0f;
+		f32 release = (f32)exp(-1.0/(0.05*(f64)format.sample_rate));
+		f32 gain = bus->limiter_gain;
+		
+		for (u64 f = 0; f < number_of_frames; f++) {
+			f32 peak = 0;
+			for (u64 c = 0; c < channels; c++) peak = max(peak, fabsf(frames[f*channels+c]));
+			
+			f32 target = peak > ceiling ? ceiling/peak : 1.0f;
+			if (target < gain) gain = target;
+			else               gain = target + (gain - target)*release;
+			
+			for (u64 c = 0; c < channels; c++) frames[f*channels+c] *= gain;
+		}
+		bus->limiter_gain = gain;
+	} else {
+		bus->limiter_gain = 1.0f;
+	}
+}
+
+// Mixes all players into output. Doesn't touch temporary storage so it can run on any thread.
 void 
-do_program_audio_sample(u64 number_of_output_frames, Audio_Format out_format, 
-							 void *output) {
-							 
-	reset_temporary_storage();
-							 
+audio_mix_output(u64 number_of_output_frames, Audio_Format out_format, void *output) {
+	
+	u64 mix_start = rdtsc();
+	u64 stage_start;
+	
 	u64 out_comp_size  = get_audio_bit_width_byte_size(out_format.bit_width);
     u64 out_frame_size = out_comp_size * out_format.channels;
     u64 output_size    = number_of_output_frames * out_frame_size;
     
 	memset(output, 0, output_size);
 	
+	// Voices and buses all mix in f32, master is converted to the output format at the very end
+	Audio_Format mix_format = { AUDIO_BITS_32, out_format.channels, out_format.sample_rate };
+	u64 mix_size = number_of_output_frames*sizeof(f32)*mix_format.channels;
+	
+	audio_buses_init_if_needed();
+	u64 bus_count = audio_bus_count;
+	for (u64 b = 0; b < bus_count; b++) {
+		Audio_Bus *bus = &audio_buses[b];
+		audio_grow_scratch_buffer((void**)&bus->buffer, &bus->buffer_size, mix_size);
+		memset(bus->buffer, 0, mix_size);
+		bus->has_input = false;
+	}
+	
 	Audio_Player_Block *block = &audio_player_block;
 	
 	// #Cleanup #Memory refactor intermediate buffers
@@ -1675,27 +2752,36 @@ do_program_audio_sample(u64 number_of_output_frames, Audio_Format out_format,
 	local_persist thread_local u64 mix_buffer_size;
 	local_persist thread_local void *convert_buffer = 0;
 	local_persist thread_local u64 convert_buffer_size;
+	local_persist thread_local void *resample_buffer = 0;
+	local_persist thread_local u64 resample_buffer_size;
 	
 	memset(mix_buffer, 0, mix_buffer_size);
 	
-	u64 *started_this_frame;
-	growing_array_init((void**)&started_this_frame, sizeof(u64), get_temporary_allocator());
+	local_persist thread_local u64 *started_this_frame = 0;
+	if (!started_this_frame) {
+		growing_array_init((void**)&started_this_frame, sizeof(u64), get_heap_allocator());
+	}
+	growing_array_clear((void**)&started_this_frame);
 	
 	while (block) {
 		
 		for (u64 i = 0; i < AUDIO_PLAYERS_PER_BLOCK; i++) {
 			Audio_Player *p = &block->players[i];
-			if (p->release_when_done && (p->frame_index >= p->source.number_of_frames
+			if (p->allocated && p->release_when_done && (p->frame_index >= p->source.number_of_frames
 										  || !p->has_source)) {
+				audio_resampler_destroy(&p->resampler);
 				p->allocated = false;
+				audio_player_add_to_free_list(p);
 			}
 			if (!p->allocated) {
 				continue;
 			}
 			
 			if (p->marked_for_release) {
+				audio_resampler_destroy(&p->resampler);
 				p->marked_for_release = false;
 				p->allocated = false;
+				audio_player_add_to_free_list(p);
 				continue;
 			}
 			
@@ -1708,70 +2794,50 @@ do_program_audio_sample(u64 number_of_output_frames, Audio_Format out_format,
 			
 			if (p->frame_index >= p->source.number_of_frames && !p->looping) continue;
 			
-			spinlock_acquire_or_wait(&p->sample_lock);
+			spinlock_acquire_or_wait(&p->sample_lock.lock);
 			
 			Audio_Source src = p->source;
 			
 			mutex_acquire_or_wait(&src.mutex_for_destroy);
-
-			Audio_Format sample_format = src.format;
-			sample_format.sample_rate = sample_format.sample_rate*p->config.playback_speed;
 			
-			bool need_convert = !bytes_match(
-				&out_format, 
-				&sample_format, 
-				sizeof(Audio_Format)
-			);
+			stage_start = rdtsc();
+			audio_stage_timings.voices += 1;
 			
-			u64 in_comp_size 
-				= get_audio_bit_width_byte_size(sample_format.bit_width);
+			// Source frames consumed per output frame
+			f64 step = ((f64)src.format.sample_rate*(f64)p->config.playback_speed) 
+			           / (f64)out_format.sample_rate;
+			bool need_resample = step != 1.0;
 			
-			u64 in_frame_size = in_comp_size * sample_format.channels;
-			u64 input_size = number_of_output_frames * in_frame_size;
+			if (!need_resample || p->frame_index != p->resampler_next_frame_index) {
+				audio_resampler_reset(&p->resampler);
+			}
 			
-			// #Copypaste #Cleanup
-			u64 biggest_size = max(input_size, output_size);
-			if (!mix_buffer || mix_buffer_size < biggest_size) {
-				u64 new_size = get_next_power_of_two(biggest_size);
-				if (mix_buffer) dealloc(get_heap_allocator(), mix_buffer);
-				mix_buffer = alloc(get_heap_allocator(), new_size);
-				mix_buffer_size = new_size;
-				memset(mix_buffer, 0, new_size);
+			u64 number_of_sample_frames = number_of_output_frames;
+			if (need_resample) {
+				number_of_sample_frames = audio_resampler_get_required_input_frames(
+					&p->resampler,
+					p->config.resample_quality,
+					mix_format.channels,
+					step,
+					number_of_output_frames
+				);
 			}
 			
+			bool need_convert = need_resample
+			                 || src.format.channels  != mix_format.channels 
+			                 || src.format.bit_width != mix_format.bit_width;
+			
+			u64 in_comp_size  = get_audio_bit_width_byte_size(src.format.bit_width);
+			u64 in_frame_size = in_comp_size * src.format.channels;
+			u64 input_size    = number_of_sample_frames * in_frame_size;
+			
+			audio_grow_scratch_buffer(&mix_buffer, &mix_buffer_size, max(input_size, mix_size));
+			
 			void *target_buffer = mix_buffer;
-			u64 number_of_sample_frames = number_of_output_frames;
 			
 			if (need_convert) {
-				if (sample_format.sample_rate != out_format.sample_rate) {
-					f64 src_ratio 
-						= (f64)sample_format.sample_rate 
-						  / (f64)out_format.sample_rate;
-						
-					number_of_sample_frames = round(number_of_output_frames * src_ratio);
-					input_size = number_of_sample_frames * in_frame_size;
-
-					// #Copypaste #Cleanup  we need to potentially grow the mix buffer again after we change input_size
-					u64 biggest_size = max(input_size, output_size);
-					if (!mix_buffer || mix_buffer_size < biggest_size) {
-						u64 new_size = get_next_power_of_two(biggest_size);
-						if (mix_buffer) dealloc(get_heap_allocator(), mix_buffer);
-						mix_buffer = alloc(get_heap_allocator(), new_size);
-						mix_buffer_size = new_size;
-						memset(mix_buffer, 0, new_size);
-					}
-				}
-				
-				u64 biggest_size = max(input_size, output_size);
-				if (!convert_buffer || convert_buffer_size < biggest_size) {
-					u64 new_size = get_next_power_of_two(biggest_size);
-					if (convert_buffer) dealloc(get_heap_allocator(), convert_buffer);
-					convert_buffer = alloc(get_heap_allocator(), new_size);
-					convert_buffer_size = new_size;
-					memset(convert_buffer, 0, new_size);
-				}
+				audio_grow_scratch_buffer(&convert_buffer, &convert_buffer_size, max(input_size, mix_size));
 				target_buffer = convert_buffer;
-				
 			}
 	
 			// :PhaseCancellation
@@ -1788,6 +2854,8 @@ do_program_audio_sample(u64 number_of_output_frames, Audio_Format out_format,
 					// in looping players.
 					// #Incomplete player->is_muted_for_phase_cancellation ? 
 					p->frame_index = src.number_of_frames;
+					spinlock_release(&p->sample_lock.lock);
+					mutex_release(&src.mutex_for_destroy);
 					continue;
 				}
 				growing_array_add((void**)&started_this_frame, &src.uid);
@@ -1804,6 +2872,9 @@ do_program_audio_sample(u64 number_of_output_frames, Audio_Format out_format,
 			if (p->frame_index > last_frame_index && (p->looping || p->frame_index != src.number_of_frames)) {
 				assert(p->frame_index - last_frame_index == number_of_sample_frames);
 			}
+			p->resampler_next_frame_index = p->frame_index;
+			
+			audio_stage_timings_end(&audio_stage_timings.sample_cycles, &stage_start);
 			
 			if (p->fade_frames > 0) {
 				u64 frames_to_fade = min(p->fade_frames, number_of_sample_frames);
@@ -1844,46 +2915,274 @@ do_program_audio_sample(u64 number_of_output_frames, Audio_Format out_format,
 							fade_from,
 							fade_to
 						);
+						
+						// Whatever is left after the fade out is silence
+						if (frames_to_fade < number_of_sample_frames) {
+							memset(
+								(u8*)target_buffer+frames_to_fade*in_frame_size, 
+								0, 
+								(number_of_sample_frames-frames_to_fade)*in_frame_size
+							);
+						}
 						break;
 					}
 				}
 				
 				p->fade_frames -= frames_to_fade;
-				
-				if (frames_to_fade < number_of_sample_frames) {
-					memset(
-						(u8*)target_buffer+frames_to_fade, 
-						0, 
-						number_of_sample_frames-frames_to_fade
-					);
-				}
 			}
 			
-			spinlock_release(&p->sample_lock);
-						
-			if (need_convert) {
+			spinlock_release(&p->sample_lock.lock);
+			
+			audio_stage_timings_end(&audio_stage_timings.fade_cycles, &stage_start);
+			
+			if (need_resample) {
+				// Convert channels & bits at the source rate, then the resampler takes it
+				// to the output rate with its carried phase.
+				Audio_Format resample_format = { AUDIO_BITS_32, mix_format.channels, src.format.sample_rate };
+				u64 resample_frame_size = sizeof(f32)*mix_format.channels;
+				audio_grow_scratch_buffer(&resample_buffer, &resample_buffer_size, number_of_sample_frames*resample_frame_size);
+				
+				convert_frames(
+					resample_buffer, 
+					resample_format, 
+					convert_buffer, 
+					src.format, 
+					number_of_sample_frames
+				);
+				
+				audio_resampler_process(
+					&p->resampler, 
+					(f32*)resample_buffer, 
+					number_of_sample_frames,
+					(f32*)mix_buffer,
+					number_of_output_frames,
+					step
+				);
+			} else if (need_convert) {
+				Audio_Format sample_format = src.format;
+				sample_format.sample_rate = mix_format.sample_rate;
 				int converted = convert_frames(
 					mix_buffer, 
-					out_format, 
+					mix_format, 
 					convert_buffer, 
 					sample_format,
 					number_of_output_frames
 				);
 				assert(converted == number_of_output_frames);
 			}
+			
+			audio_stage_timings_end(&audio_stage_timings.convert_cycles, &stage_start);
 
 			if (p->config.enable_spacialization) {
-				apply_audio_spacialization(mix_buffer, out_format, number_of_output_frames, p->config.position_ndc);
+				apply_audio_spacialization(mix_buffer, mix_format, number_of_output_frames, p->config.position_ndc);
 			}
-			if (p->config.volume != 0.0) {
-				apply_audio_volume(mix_buffer, out_format, number_of_output_frames, p->config.volume);
+			if (p->config.volume != 1.0) {
+				apply_audio_volume(mix_buffer, mix_format, number_of_output_frames, p->config.volume);
 			}
 			
-			mix_frames(output, mix_buffer, number_of_output_frames, out_format);
+			audio_stage_timings_end(&audio_stage_timings.effect_cycles, &stage_start);
+			
+			Audio_Bus_Id bus_id = p->config.bus < bus_count ? p->config.bus : AUDIO_BUS_MASTER;
+			Audio_Bus *bus = &audio_buses[bus_id];
+			mix_frames(bus->buffer, mix_buffer, number_of_output_frames, mix_format);
+			bus->has_input = true;
+			
+			audio_stage_timings_end(&audio_stage_timings.mix_cycles, &stage_start);
 			
 			mutex_release(&src.mutex_for_destroy);
 		}
 		
 		block = block->next;
 	}
+	
+	stage_start = rdtsc();
+	
+	// Children always come after their parent (see audio_bus_create), so walking backwards
+	// finishes every child before its parent needs it.
+	// #Speed siblings are independent so this could fan out to worker threads level by level,
+	// but with a handful of buses it's not worth the sync yet.
+	for (s64 b = bus_count-1; b >= 0; b--) {
+		Audio_Bus *bus = &audio_buses[b];
+		
+		if (!bus->has_input) {
+			// Nothing to filter, just let the effect state settle as if it got silence
+			memset(bus->lowpass_state, 0, sizeof(bus->lowpass_state));
+			bus->compressor_envelope_db = -120.0f;
+			bus->limiter_gain = 1.0f;
+			bus->last_volume = max(bus->config.volume, 0.0f);
+			continue;
+		}
+		
+		audio_bus_process(bus, mix_format, number_of_output_frames);
+		
+		if (b != AUDIO_BUS_MASTER) {
+			Audio_Bus *parent = &audio_buses[bus->parent];
+			mix_frames(parent->buffer, bus->buffer, number_of_output_frames, mix_format);
+			parent->has_input = true;
+		}
+	}
+	
+	// Master to the output format. Clamp first, f32 -> s16 would wrap around instead of clip.
+	Audio_Bus *master = &audio_buses[AUDIO_BUS_MASTER];
+	if (master->has_input) {
+		u64 sample_count = number_of_output_frames*mix_format.channels;
+		for (u64 i = 0; i < sample_count; i++) {
+			master->buffer[i] = clamp(master->buffer[i], -1.0f, 32767.0f/32768.0f);
+		}
+		convert_frames(output, out_format, master->buffer, mix_format, number_of_output_frames);
+	}
+	
+	audio_stage_timings_end(&audio_stage_timings.bus_cycles, &stage_start);
+	
+	audio_stage_timings.callbacks += 1;
+	audio_stage_timings.total_cycles += rdtsc() - mix_start;
+}
+
+// This is supposed to be called by OS layer audio thread whenever it wants more audio samples
+void 
+do_program_audio_sample(u64 number_of_output_frames, Audio_Format out_format, 
+							 void *output) {
+							 
+	Temp_Scope scope = temp_scope_begin();
+	
+	spinlock_acquire_or_wait(&audio_mix_lock);
+	
+	if (audio_offline_render_thread_id != 0) {
+		u64 out_frame_size = get_audio_bit_width_byte_size(out_format.bit_width)*out_format.channels;
+		memset(output, 0, number_of_output_frames*out_frame_size);
+	} else {
+		audio_mix_output(number_of_output_frames, out_format, output);
+	}
+	
+	spinlock_release(&audio_mix_lock);
+	
+	temp_scope_end(scope);
+}
+
+// Headless builds don't have an audio device, so this sets up what the device would have:
+// the format audio_open_source_stream/load converts to. Don't call it with a device running.
+void
+audio_init_offline(Audio_Format format) {
+	mutex_init(&audio_init_mutex);
+	mutex_acquire_or_wait(&audio_init_mutex);
+	audio_output_format = format;
+	mutex_release(&audio_init_mutex);
+}
+
+// Pulls number_of_frames through the mixer into output as fast as we can, in chunks of
+// frames_per_callback (0 for AUDIO_OFFLINE_DEFAULT_FRAMES_PER_CALLBACK) so players see the
+// same callback sizes a device would give them.
+// Players advance just like with the device; the device outputs silence meanwhile.
+bool
+audio_render_offline(void *output, u64 number_of_frames, Audio_Format format, 
+                     u64 frames_per_callback, Audio_Render_Stats *stats) {
+	
+	if (frames_per_callback == 0) frames_per_callback = AUDIO_OFFLINE_DEFAULT_FRAMES_PER_CALLBACK;
+	
+	if (!compare_and_swap_64(&audio_offline_render_thread_id, context.thread_id, 0)) {
+		log_error("audio_render_offline(): Another offline render is already running");
+		return false;
+	}
+	
+	u64 frame_size = get_audio_bit_width_byte_size(format.bit_width)*format.channels;
+	
+	audio_stage_timings = ZERO(Audio_Stage_Timings);
+	
+	float64 start_seconds = os_get_elapsed_seconds();
+	
+	for (u64 frame = 0; frame < number_of_frames; frame += frames_per_callback) {
+		u64 n = min(frames_per_callback, number_of_frames-frame);
+		
+		spinlock_acquire_or_wait(&audio_mix_lock);
+		audio_mix_output(n, format, (u8*)output + frame*frame_size);
+		spinlock_release(&audio_mix_lock);
+	}
+	
+	float64 seconds = os_get_elapsed_seconds()-start_seconds;
+	
+	audio_offline_render_thread_id = 0;
+	
+	if (stats) {
+		stats->number_of_frames  = number_of_frames;
+		stats->seconds           = seconds;
+		stats->frames_per_second = seconds > 0 ? (f64)number_of_frames/seconds : 0;
+		stats->realtime_factor   = stats->frames_per_second/(f64)format.sample_rate;
+		stats->stages            = audio_stage_timings;
+	}
+	
+	return true;
+}
+
+bool
+wav_write_file(string path, void *frames, u64 number_of_frames, Audio_Format format) {
+	u64 comp_size  = get_audio_bit_width_byte_size(format.bit_width);
+	u64 frame_size = comp_size*format.channels;
+	u64 data_size  = number_of_frames*frame_size;
+	
+	// 16-bit is plain pcm, 32-bit is ieee float which wants the cbSize field
+	if (data_size > 0xFFFFFFFFull - 64) {
+		log_error("wav_write_file(): %llu bytes of audio doesn't fit in a wave file", data_size);
+		return false;
+	}
+	
+	bool is_float  = format.bit_width == AUDIO_BITS_32;
+	u32 fmt_size   = is_float ? 18 : 16;
+	u32 riff_size  = 4 + (8+fmt_size) + (8+(u32)data_size);
+	
+	File file = os_file_open(path, O_WRITE | O_CREATE);
+	if (file == OS_INVALID_FILE) return false;
+	
+	u8 header[64];
+	u8 *p = header;
+	memcpy(p, "RIFF", 4);                       p += 4;
+	*(u32*)p = riff_size;                       p += 4;
+	memcpy(p, "WAVE", 4);                       p += 4;
+	memcpy(p, "fmt ", 4);                       p += 4;
+	*(u32*)p = fmt_size;                        p += 4;
+	*(u16*)p = is_float ? 0x0003 : 0x0001;      p += 2;
+	*(u16*)p = (u16)format.channels;            p += 2;
+	*(u32*)p = (u32)format.sample_rate;         p += 4;
+	*(u32*)p = (u32)(format.sample_rate*frame_size); p += 4;
+	*(u16*)p = (u16)frame_size;                 p += 2;
+	*(u16*)p = (u16)(comp_size*8);              p += 2;
+	if (is_float) {
+		*(u16*)p = 0;                           p += 2;
+	}
+	memcpy(p, "data", 4);                       p += 4;
+	*(u32*)p = (u32)data_size;                  p += 4;
+	
+	bool ok = os_file_write_bytes(file, header, (u64)(p-header));
+	if (ok) ok = os_file_write_bytes(file, frames, data_size);
+	
+	os_file_close(file);
+	
+	return ok;
+}
+
+bool
+audio_render_offline_to_wav(string path, u64 number_of_frames, Audio_Format format, 
+                            u64 frames_per_callback, Audio_Render_Stats *stats) {
+	u64 frame_size = get_audio_bit_width_byte_size(format.bit_width)*format.channels;
+	
+	void *frames = alloc_uninitialized(get_heap_allocator(), number_of_frames*frame_size);
+	
+	bool ok = audio_render_offline(frames, number_of_frames, format, frames_per_callback, stats);
+	if (ok) ok = wav_write_file(path, frames, number_of_frames, format);
+	
+	dealloc(get_heap_allocator(), frames);
+	
+	return ok;
+}
+
+void
+audio_print_render_stats(Audio_Render_Stats stats) {
+	Audio_Stage_Timings t = stats.stages;
+	u64 frames = max(stats.number_of_frames, 1);
+	print("Rendered %llu frames in %.2f ms (%.0f frames/s, %.1fx realtime), %llu callbacks, %llu voices mixed\n",
+		stats.number_of_frames, stats.seconds*1000.0, stats.frames_per_second, stats.realtime_factor, 
+		t.callbacks, t.voices);
+	print("    cycles/frame: sample %.1f, fade %.1f, convert %.1f, effects %.1f, mix %.1f, buses %.1f, total %.1f\n",
+		(f64)t.sample_cycles/frames, (f64)t.fade_cycles/frames, (f64)t.convert_cycles/frames,
+		(f64)t.effect_cycles/frames, (f64)t.mix_cycles/frames, (f64)t.bus_cycles/frames, 
+		(f64)t.total_cycles/frames);
 }
@@ -62,6 +62,10 @@ typedef enum Allocator_Message {
 	ALLOCATOR_ALLOCATE,
 	ALLOCATOR_DEALLOCATE,
 	ALLOCATOR_REALLOCATE,
+	ALLOCATOR_ALLOCATE_ALIGNED, // The alignment is passed in place of the pointer
+	// Return 0 if you can't do better than a memset, alloc_zeroed() does that then. Allocators
+	// that know which of their memory is still zero from the OS only need to clear the rest.
+	ALLOCATOR_ALLOCATE_ZEROED,
 } Allocator_Message;
 typedef void*(*Allocator_Proc)(u64, void*, Allocator_Message, void*);
 
@@ -90,6 +94,8 @@ get_temporary_allocator();
 typedef struct Context {
 	void *logger; // void(*Logger_Proc)(Log_Level level, string fmt, ...)
 	
+	Allocator allocator; // For whatever the thread allocates by default. The heap unless set otherwise
+	
 	u64 thread_id;
 	
 	CONTEXT_EXTRA extra;
@@ -111,9 +117,24 @@ alloc(Allocator allocator, u64 size);
 ogb_instance void* 
 alloc_uninitialized(Allocator allocator, u64 size);
 
+// Zero initialized regardless of DO_ZERO_INITIALIZATION
+ogb_instance void* 
+alloc_zeroed(Allocator allocator, u64 size);
+
+// alignment must be a power of two. Returns 0 if the allocator can't do aligned allocations.
+ogb_instance void* 
+alloc_aligned(Allocator allocator, u64 size, u64 alignment);
+
 ogb_instance void 
 dealloc(Allocator allocator, void *p);
 
+// In place if the allocator can, otherwise it's alloc + copy + dealloc. The new part is zero
+// initialized like alloc().
+ogb_instance void* 
+reallocate(Allocator allocator, void *p, u64 old_size, u64 new_size);
+ogb_instance void* 
+reallocate_uninitialized(Allocator allocator, void *p, u64 old_size, u64 new_size);
+
 ogb_instance void 
 push_context(Context c);
 
@@ -131,12 +152,11 @@ thread_local u64 num_contexts = 0;
 
 void* 
 alloc(Allocator allocator, u64 size) {
-	assert(size > 0, "You requested an allocation of zero bytes. I'm not sure what you want with that.");
-	void *p = allocator.proc(size, 0, ALLOCATOR_ALLOCATE, allocator.data);
 #if DO_ZERO_INITIALIZATION
-	memset(p, 0, size);
+	return alloc_zeroed(allocator, size);
+#else
+	return alloc_uninitialized(allocator, size);
 #endif
-	return p;
 }
 
 void* 
@@ -145,12 +165,60 @@ alloc_uninitialized(Allocator allocator, u64 size) {
 	return allocator.proc(size, 0, ALLOCATOR_ALLOCATE, allocator.data);	
 }
 
+void* 
+alloc_zeroed(Allocator allocator, u64 size) {
+	assert(size > 0, "You requested an allocation of zero bytes. I'm not sure what you want with that.");
+	void *p = allocator.proc(size, 0, ALLOCATOR_ALLOCATE_ZEROED, allocator.data);
+	if (p) return p;
+	p = allocator.proc(size, 0, ALLOCATOR_ALLOCATE, allocator.data);
+	memset(p, 0, size);
+	return p;
+}
+
+void* 
+alloc_aligned(Allocator allocator, u64 size, u64 alignment) {
+	assert(size > 0, "You requested an allocation of zero bytes. I'm not sure what you want with that.");
+	assert(alignment > 0 && (alignment & (alignment-1)) == 0, "Alignment must be a power of two, got %llu", alignment);
+	void *p = allocator.proc(size, (void*)alignment, ALLOCATOR_ALLOCATE_ALIGNED, allocator.data);
+	if (!p) return 0;
+	assert((u64)p % alignment == 0, "Allocator returned a pointer that is not aligned to %llu", alignment);
+#if DO_ZERO_INITIALIZATION
+	memset(p, 0, size);
+#endif
+	return p;
+}
+
 void 
 dealloc(Allocator allocator, void *p) {
 	assert(p != 0, "You tried to deallocate a pointer at adress 0. That doesn't make sense!");
 	allocator.proc(0, p, ALLOCATOR_DEALLOCATE, allocator.data);
 }
 
+void* 
+reallocate_uninitialized(Allocator allocator, void *p, u64 old_size, u64 new_size) {
+	if (!p) return alloc_uninitialized(allocator, new_size);
+	assert(new_size > 0, "You requested a reallocation to zero bytes. Use dealloc for that.");
+	
+	void *new = allocator.proc(new_size, p, ALLOCATOR_REALLOCATE, allocator.data);
+	if (!new) {
+		// Not all allocators can reallocate
+		new = alloc_uninitialized(allocator, new_size);
+		memcpy(new, p, min(old_size, new_size));
+		dealloc(allocator, p);
+	}
+	return new;
+}
+
+void* 
+reallocate(Allocator allocator, void *p, u64 old_size, u64 new_size) {
+	if (!p) return alloc(allocator, new_size);
+	void *new = reallocate_uninitialized(allocator, p, old_size, new_size);
+#if DO_ZERO_INITIALIZATION
+	if (new_size > old_size) memset((u8*)new + old_size, 0, new_size - old_size);
+#endif
+	return new;
+}
+
 void 
 push_context(Context c) {
 	assert(num_contexts < CONTEXT_STACK_MAX, "Context stack overflow");
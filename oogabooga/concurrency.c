@@ -1,7 +1,19 @@
 
 typedef struct Spinlock Spinlock;
+typedef struct Padded_Spinlock Padded_Spinlock;
+typedef struct Ticket_Lock Ticket_Lock;
 typedef struct Mutex Mutex;
 typedef struct Binary_Semaphore Binary_Semaphore;
+typedef struct Fast_Mutex Fast_Mutex;
+typedef struct Condition_Variable Condition_Variable;
+typedef struct Semaphore Semaphore;
+typedef struct Event Event;
+typedef struct Rw_Lock Rw_Lock;
+typedef struct Seqlock Seqlock;
+typedef struct Spsc_Queue Spsc_Queue;
+typedef struct Mpmc_Queue Mpmc_Queue;
+typedef struct Mpsc_Node Mpsc_Node;
+typedef struct Mpsc_Queue Mpsc_Queue;
 
 // These are probably your best friend for sync-free multi-processing.
 inline bool compare_and_swap_8(volatile uint8_t *a, uint8_t b, uint8_t old);
@@ -9,15 +21,46 @@ inline bool compare_and_swap_16(volatile uint16_t *a, uint16_t b, uint16_t old);
 inline bool compare_and_swap_32(volatile uint32_t *a, uint32_t b, uint32_t old);
 inline bool compare_and_swap_64(volatile uint64_t *a, uint64_t b, uint64_t old);
 inline bool compare_and_swap_bool(volatile bool *a, bool b, bool old);
+// These return the old value
+inline uint32_t atomic_exchange_32(volatile uint32_t *a, uint32_t b);
+inline uint64_t atomic_exchange_64(volatile uint64_t *a, uint64_t b);
+inline uint32_t atomic_add_32(volatile uint32_t *a, uint32_t b);
+inline uint64_t atomic_add_64(volatile uint64_t *a, uint64_t b);
 
 ///
 // Spinlock "primitive"
 // Like a mutex but it eats up the entire core while waiting.
 // Beneficial if contention is low or sync speed is important
+// Waiters only read the lock until it looks free (test and test-and-set), pausing a little
+// longer every time (up to SPINLOCK_MAX_BACKOFF pauses), so they don't keep stealing the
+// cache line from each other and from whoever holds the lock.
+// Not fair, use a Ticket_Lock if waiters must get it in order.
+#ifndef SPINLOCK_MAX_BACKOFF
+	#define SPINLOCK_MAX_BACKOFF 64
+#endif
+
+// With ENABLE_SPINLOCK_STATS. Only written while holding the lock.
+typedef struct Spinlock_Stats {
+	u64 acquisitions;
+	u64 contended_acquisitions; // Had to wait
+	u64 wait_cycles; // rdtsc cycles spent waiting
+} Spinlock_Stats;
+
 typedef struct Spinlock {
 	volatile bool locked;
+#if ENABLE_SPINLOCK_STATS
+	Spinlock_Stats stats;
+#endif
 } Spinlock;
 
+// A spinlock with a cache line of padding on both sides, so it never shares a cache line
+// with anything else no matter how it's aligned. For hot locks next to unrelated data.
+typedef struct Padded_Spinlock {
+	u8 padding_before[CACHE_LINE_SIZE];
+	Spinlock lock;
+	u8 padding_after[CACHE_LINE_SIZE];
+} Padded_Spinlock;
+
 void ogb_instance
 spinlock_init(Spinlock *l);
 
@@ -31,6 +74,39 @@ spinlock_acquire_or_wait_timeout(Spinlock* l, f64 timeout_seconds);
 void ogb_instance
 spinlock_release(Spinlock* l);
 
+// Zeroed if ENABLE_SPINLOCK_STATS is off
+Spinlock_Stats ogb_instance
+spinlock_get_stats(Spinlock *l);
+
+///
+// Ticket lock
+// Spinlock where waiters get the lock in the order they came. Waiters back off in proportion
+// to how many are ahead of them.
+// Don't use it with more threads than cores, handing the lock to a waiter that isn't
+// running stalls everyone behind it.
+#ifndef TICKET_LOCK_ROUNDS_BEFORE_YIELD
+	#define TICKET_LOCK_ROUNDS_BEFORE_YIELD 1000
+#endif
+typedef struct Ticket_Lock {
+	volatile u32 next_ticket;
+	volatile u32 now_serving;
+#if ENABLE_SPINLOCK_STATS
+	Spinlock_Stats stats;
+#endif
+} Ticket_Lock;
+
+void ogb_instance
+ticket_lock_init(Ticket_Lock *l);
+
+void ogb_instance
+ticket_lock_acquire_or_wait(Ticket_Lock *l);
+
+void ogb_instance
+ticket_lock_release(Ticket_Lock *l);
+
+Spinlock_Stats ogb_instance
+ticket_lock_get_stats(Ticket_Lock *l);
+
 
 ///
 // High-level mutex primitive (short spinlock then OS mutex lock)
@@ -58,11 +134,188 @@ void ogb_instance
 mutex_release(Mutex *m);
 
 
+///
+// Parking primitives
+// These spin for a little while (PARK_SPIN_COUNT pauses, backing off) and then put the thread
+// to sleep with os_address_wait() until they're woken, so waiting threads don't use any cpu.
+// Spinning is skipped when other threads are already parked, because then whoever we're
+// waiting for is probably not about to be done.
+// None of them need destroying.
+#ifndef PARK_SPIN_COUNT
+	#define PARK_SPIN_COUNT 256
+#endif
+
+///
+// Fast mutex
+// 4 bytes, no OS object. Not recursive.
+typedef struct Fast_Mutex {
+	volatile u32 state; // 0 unlocked, 1 locked, 2 locked and there might be threads parked
+} Fast_Mutex;
+
+void ogb_instance
+fast_mutex_init(Fast_Mutex *m);
+
+void ogb_instance
+fast_mutex_acquire_or_wait(Fast_Mutex *m);
+
+// Returns false if it's already locked
+bool ogb_instance
+fast_mutex_try_acquire(Fast_Mutex *m);
+
+void ogb_instance
+fast_mutex_release(Fast_Mutex *m);
+
+///
+// Condition variable
+// Waits release the mutex while parked and acquire it again before returning. Waits can
+// return without a signal, so wait in a loop that checks the condition:
+//
+//     fast_mutex_acquire_or_wait(&queue_mutex);
+//     while (queue_count == 0) condition_variable_wait(&queue_not_empty, &queue_mutex);
+//     ... pop ...
+//     fast_mutex_release(&queue_mutex);
+typedef struct Condition_Variable {
+	volatile u32 sequence; // Bumped by every signal
+} Condition_Variable;
+
+void ogb_instance
+condition_variable_init(Condition_Variable *cv);
+
+void ogb_instance
+condition_variable_wait(Condition_Variable *cv, Fast_Mutex *m);
+
+// Wakes one waiting thread
+void ogb_instance
+condition_variable_signal(Condition_Variable *cv);
+
+// Wakes all waiting threads
+void ogb_instance
+condition_variable_broadcast(Condition_Variable *cv);
+
+///
+// Counting semaphore
+typedef struct Semaphore {
+	volatile u32 count;
+	volatile u32 waiters; // So signal knows if it has to wake anyone
+} Semaphore;
+
+void ogb_instance
+semaphore_init(Semaphore *sem, u32 initial_count);
+
+// Waits until count > 0 and takes one
+void ogb_instance
+semaphore_wait(Semaphore *sem);
+
+// Returns false if count is 0
+bool ogb_instance
+semaphore_try_wait(Semaphore *sem);
+
+void ogb_instance
+semaphore_signal(Semaphore *sem, u32 count);
+
+///
+// Event
+// Stays signaled and lets every waiter through until it's reset.
+// Binary_Semaphore is the one that lets one waiter through and resets itself.
+typedef struct Event {
+	volatile u32 state; // 0 not signaled, 1 signaled, 2 not signaled and there might be threads parked
+} Event;
+
+void ogb_instance
+event_init(Event *e, bool signaled);
+
+void ogb_instance
+event_wait(Event *e);
+
+void ogb_instance
+event_signal(Event *e);
+
+void ogb_instance
+event_reset(Event *e);
+
+bool ogb_instance
+event_is_signaled(Event *e);
+
+///
+// Reader-writer lock
+// Any number of readers at once, or one writer. Fair both ways (phase fair): a writer waits for
+// the readers that came before it but no new readers get in meanwhile, and readers that came
+// while a writer had it go before the next writer. Writers go in the order they came.
+// Not recursive, and a reader can't upgrade to writing.
+#define RW_LOCK_WRITER_PHASE     0x1
+#define RW_LOCK_WRITER_PRESENT   0x2
+#define RW_LOCK_WRITER_BITS      0xFF
+#define RW_LOCK_READER_INCREMENT 0x100
+typedef struct Rw_Lock {
+	volatile u32 readers_in;  // Readers that came (in steps of RW_LOCK_READER_INCREMENT) and the writer bits
+	volatile u32 readers_out; // Readers that left
+	volatile u32 writers_in;  // Next writer ticket
+	volatile u32 writers_out; // Ticket of the writer whose turn it is
+	volatile u32 parked;      // So releasing knows if it has to wake anyone
+} Rw_Lock;
+
+void ogb_instance
+rw_lock_init(Rw_Lock *l);
+
+void ogb_instance
+rw_lock_acquire_read(Rw_Lock *l);
+
+void ogb_instance
+rw_lock_release_read(Rw_Lock *l);
+
+void ogb_instance
+rw_lock_acquire_write(Rw_Lock *l);
+
+void ogb_instance
+rw_lock_release_write(Rw_Lock *l);
+
+///
+// Seqlock
+// For small things that are read a lot and written rarely, like a camera or some settings.
+// Readers never write to shared memory so they don't slow each other down, but they retry
+// if a write happened while they were reading, so they have to copy the data out:
+//
+//     Camera camera;
+//     u32 sequence;
+//     do {
+//         sequence = seqlock_read_begin(&camera_lock);
+//         camera = shared_camera;
+//     } while (seqlock_read_retry(&camera_lock, sequence));
+//
+// or seqlock_read_copy(&camera_lock, &camera, &shared_camera, sizeof(Camera));
+// Don't follow pointers in the data while reading, they might be half written.
+// Writers are serialized with each other.
+typedef struct Seqlock {
+	volatile u32 sequence; // Odd while writing
+} Seqlock;
+
+void ogb_instance
+seqlock_init(Seqlock *l);
+
+u32 ogb_instance
+seqlock_read_begin(Seqlock *l);
+
+// True if the data read since seqlock_read_begin() might be torn
+bool ogb_instance
+seqlock_read_retry(Seqlock *l, u32 sequence);
+
+void ogb_instance
+seqlock_write_begin(Seqlock *l);
+
+void ogb_instance
+seqlock_write_end(Seqlock *l);
+
+void ogb_instance
+seqlock_read_copy(Seqlock *l, void *dst, const volatile void *src, u64 size);
+
+void ogb_instance
+seqlock_write_copy(Seqlock *l, volatile void *dst, const void *src, u64 size);
+
 ///
 // Binary semaphore
+// A parking primitive like the ones above, binary_semaphore_destroy() does nothing.
 typedef struct Binary_Semaphore {
-    volatile bool signaled;
-    Mutex mutex;
+    volatile u32 state; // 0 not signaled, 1 signaled, 2 not signaled and there might be threads parked
 } Binary_Semaphore;
 
 void ogb_instance
@@ -78,35 +331,181 @@ void ogb_instance
 binary_semaphore_signal(Binary_Semaphore *sem);
 
 
+///
+// Lock-free queues
+// Elements are copied in and out, element_size bytes each. Bounded queues have a power of two
+// capacity (rounded up) and push returns false when full, pop returns false when empty.
+// What each side writes is kept on its own cache line so producers and consumers don't
+// invalidate each other's cache for every element.
+// They rely on x86 not reordering loads with loads or stores with stores. #Portability
+
+///
+// Single producer single consumer ring
+// One thread pushes and one thread pops, like a decoder feeding the audio thread.
+// Pushing and popping many at once (spsc_queue_push_many) is one copy and one index update.
+typedef struct Spsc_Queue {
+	alignat(CACHE_LINE_SIZE) volatile u64 head; // Written by the producer
+	u64 cached_tail; // The producer's last look at tail
+	
+	alignat(CACHE_LINE_SIZE) volatile u64 tail; // Written by the consumer
+	u64 cached_head; // The consumer's last look at head
+	
+	alignat(CACHE_LINE_SIZE) u8 *buffer;
+	u64 capacity;
+	u64 element_size;
+	Allocator allocator;
+} Spsc_Queue;
+
+void ogb_instance
+spsc_queue_init(Spsc_Queue *q, u64 element_size, u64 capacity, Allocator allocator);
+
+void ogb_instance
+spsc_queue_deinit(Spsc_Queue *q);
+
+bool ogb_instance
+spsc_queue_push(Spsc_Queue *q, const void *element);
+
+bool ogb_instance
+spsc_queue_pop(Spsc_Queue *q, void *element);
+
+// Returns how many were pushed, might be less than count if it fills up
+u64 ogb_instance
+spsc_queue_push_many(Spsc_Queue *q, const void *elements, u64 count);
+
+// Returns how many were popped, up to max_count
+u64 ogb_instance
+spsc_queue_pop_many(Spsc_Queue *q, void *elements, u64 max_count);
+
+// Only exact from the producer or consumer thread, and only until the other one does something
+u64 ogb_instance
+spsc_queue_count(Spsc_Queue *q);
+
+///
+// Multi producer multi consumer queue (bounded, Vyukov)
+// Each cell has a sequence number saying whose turn it is, so producers and consumers only
+// race each other with one compare_and_swap on their own index.
+typedef struct Mpmc_Queue {
+	alignat(CACHE_LINE_SIZE) volatile u64 enqueue_index;
+	alignat(CACHE_LINE_SIZE) volatile u64 dequeue_index;
+	alignat(CACHE_LINE_SIZE) u8 *cells; // u64 sequence then the element
+	u64 cell_size;
+	u64 capacity;
+	u64 element_size;
+	Allocator allocator;
+} Mpmc_Queue;
+
+void ogb_instance
+mpmc_queue_init(Mpmc_Queue *q, u64 element_size, u64 capacity, Allocator allocator);
+
+void ogb_instance
+mpmc_queue_deinit(Mpmc_Queue *q);
+
+bool ogb_instance
+mpmc_queue_push(Mpmc_Queue *q, const void *element);
+
+bool ogb_instance
+mpmc_queue_pop(Mpmc_Queue *q, void *element);
+
+///
+// Multi producer single consumer queue (unbounded, intrusive, Vyukov)
+// Nothing is allocated or copied, you put a Mpsc_Node in your struct and push that:
+//
+//     typedef struct Log_Message { Mpsc_Node node; string text; } Log_Message;
+//     mpsc_queue_push(&log_queue, &message->node);
+//     ...
+//     Mpsc_Node *node = mpsc_queue_pop(&log_queue);
+//     if (node) Log_Message *message = mpsc_queue_entry(node, Log_Message, node);
+//
+// Any thread can push, only one thread pops. Pushing never waits. Pop returns 0 when it's
+// empty, and can also return 0 for a moment while a push is halfway done.
+// Nodes belong to the queue until they're popped, and must not move.
+typedef struct Mpsc_Node {
+	Mpsc_Node *volatile next;
+} Mpsc_Node;
+
+typedef struct Mpsc_Queue {
+	alignat(CACHE_LINE_SIZE) Mpsc_Node *volatile head; // Last pushed, producers swap this
+	alignat(CACHE_LINE_SIZE) Mpsc_Node *tail; // Next to pop, only the consumer touches this
+	Mpsc_Node stub; // Keeps the queue from ever being truly empty, so push doesn't need to know
+} Mpsc_Queue;
+
+#define mpsc_queue_entry(node, type, member) ((type*)((u8*)(node) - offsetof(type, member)))
+
+void ogb_instance
+mpsc_queue_init(Mpsc_Queue *q);
+
+void ogb_instance
+mpsc_queue_push(Mpsc_Queue *q, Mpsc_Node *node);
+
+Mpsc_Node* ogb_instance
+mpsc_queue_pop(Mpsc_Queue *q);
+
+
 #if !OOGABOOGA_LINK_EXTERNAL_INSTANCE
 
 void spinlock_init(Spinlock *l) {
 	memset(l, 0, sizeof(*l));
 }
 void spinlock_acquire_or_wait(Spinlock* l) {
+	if (!l->locked && compare_and_swap_bool(&l->locked, true, false)) {
+#if ENABLE_SPINLOCK_STATS
+		l->stats.acquisitions += 1;
+#endif
+		return;
+	}
+	
+#if ENABLE_SPINLOCK_STATS
+	u64 wait_start = rdtsc();
+#endif
+	u32 backoff = 1;
 	while (true) {
-        bool expected = false;
-        if (compare_and_swap_bool(&l->locked, true, expected)) {
-            return;
-        }
         while (l->locked) {
             // spinny boi
+            for (u32 i = 0; i < backoff; i++) cpu_pause();
+            backoff = min(backoff*2, SPINLOCK_MAX_BACKOFF);
+        }
+        bool expected = false;
+        if (compare_and_swap_bool(&l->locked, true, expected)) {
+            break;
         }
     }
+#if ENABLE_SPINLOCK_STATS
+	l->stats.acquisitions += 1;
+	l->stats.contended_acquisitions += 1;
+	l->stats.wait_cycles += rdtsc()-wait_start;
+#endif
 }
 // Returns true on aquired, false if timeout seconds reached
 bool spinlock_acquire_or_wait_timeout(Spinlock* l, f64 timeout_seconds) {
+	if (!l->locked && compare_and_swap_bool(&l->locked, true, false)) {
+#if ENABLE_SPINLOCK_STATS
+		l->stats.acquisitions += 1;
+#endif
+		return true;
+	}
+	
+#if ENABLE_SPINLOCK_STATS
+	u64 wait_start = rdtsc();
+#endif
     f64 start = os_get_elapsed_seconds();
+	u32 backoff = 1;
 	while (true) {
-        bool expected = false;
-        if (compare_and_swap_bool(&l->locked, true, expected)) {
-            return true;
-        }
         while (l->locked) {
             // spinny boi
             if ((os_get_elapsed_seconds()-start) >= timeout_seconds) return false;
+            for (u32 i = 0; i < backoff; i++) cpu_pause();
+            backoff = min(backoff*2, SPINLOCK_MAX_BACKOFF);
+        }
+        bool expected = false;
+        if (compare_and_swap_bool(&l->locked, true, expected)) {
+            break;
         }
     }
+#if ENABLE_SPINLOCK_STATS
+	l->stats.acquisitions += 1;
+	l->stats.contended_acquisitions += 1;
+	l->stats.wait_cycles += rdtsc()-wait_start;
+#endif
     return true;
 }
 void spinlock_release(Spinlock* l) {
@@ -114,6 +513,66 @@ void spinlock_release(Spinlock* l) {
     bool success = compare_and_swap_bool(&l->locked, false, expected);
     assert(success, "This thread should have acquired the spinlock but compare_and_swap failed");
 }
+Spinlock_Stats spinlock_get_stats(Spinlock *l) {
+#if ENABLE_SPINLOCK_STATS
+	return l->stats;
+#else
+	return (Spinlock_Stats){0};
+#endif
+}
+
+
+///
+// Ticket lock
+
+void ticket_lock_init(Ticket_Lock *l) {
+	memset(l, 0, sizeof(*l));
+}
+void ticket_lock_acquire_or_wait(Ticket_Lock *l) {
+	u32 ticket = atomic_add_32(&l->next_ticket, 1);
+	
+	u32 ahead = ticket - l->now_serving;
+	if (ahead == 0) {
+#if ENABLE_SPINLOCK_STATS
+		l->stats.acquisitions += 1;
+#endif
+		return;
+	}
+	
+#if ENABLE_SPINLOCK_STATS
+	u64 wait_start = rdtsc();
+#endif
+	u32 rounds = 0;
+	while (ahead != 0) {
+		// Whoever is first in line checks all the time, the others less the further back they are
+		u32 pauses = min((ahead-1)*SPINLOCK_MAX_BACKOFF/4, SPINLOCK_MAX_BACKOFF*4);
+		cpu_pause();
+		for (u32 i = 0; i < pauses; i++) cpu_pause();
+		
+		// If the lock is handed to a thread that isn't running, everyone behind it waits until
+		// it gets a time slice, so give up ours when this takes long.
+		rounds += 1;
+		if (rounds > TICKET_LOCK_ROUNDS_BEFORE_YIELD) os_yield_thread();
+		
+		ahead = ticket - l->now_serving;
+	}
+#if ENABLE_SPINLOCK_STATS
+	l->stats.acquisitions += 1;
+	l->stats.contended_acquisitions += 1;
+	l->stats.wait_cycles += rdtsc()-wait_start;
+#endif
+}
+void ticket_lock_release(Ticket_Lock *l) {
+	assert(l->next_ticket != l->now_serving, "Tried to release a Ticket_Lock which is not acquired");
+	atomic_add_32(&l->now_serving, 1);
+}
+Spinlock_Stats ticket_lock_get_stats(Ticket_Lock *l) {
+#if ENABLE_SPINLOCK_STATS
+	return l->stats;
+#else
+	return (Spinlock_Stats){0};
+#endif
+}
 
 
 ///
@@ -153,30 +612,432 @@ void mutex_release(Mutex *m) {
 
 
 
+///
+// Parking primitives
+
+// Spins while *address == value for up to PARK_SPIN_COUNT pauses. Returns true if it changed.
+bool park_spin_while_equal(volatile u32 *address, u32 value) {
+	u32 pauses = 1;
+	for (u32 spun = 0; spun < PARK_SPIN_COUNT; spun += pauses) {
+		if (*address != value) return true;
+		for (u32 i = 0; i < pauses; i++) cpu_pause();
+		pauses = min(pauses*2, 16);
+	}
+	return *address != value;
+}
+
+void fast_mutex_init(Fast_Mutex *m) {
+	m->state = 0;
+}
+bool fast_mutex_try_acquire(Fast_Mutex *m) {
+	return compare_and_swap_32(&m->state, 1, 0);
+}
+void fast_mutex_acquire_or_wait(Fast_Mutex *m) {
+	if (compare_and_swap_32(&m->state, 1, 0)) return;
+	
+	// Only spin if nobody is parked
+	park_spin_while_equal(&m->state, 1);
+	if (compare_and_swap_32(&m->state, 1, 0)) return;
+	
+	// We can't know if we were the last one parked when we wake up, so we take it as 2
+	// and the release after ours wakes the next one just in case.
+	while (atomic_exchange_32(&m->state, 2) != 0) {
+		os_address_wait(&m->state, 2);
+	}
+}
+void fast_mutex_release(Fast_Mutex *m) {
+	u32 old = atomic_exchange_32(&m->state, 0);
+	assert(old != 0, "Tried to release a Fast_Mutex which is not acquired");
+	if (old == 2) os_address_wake_one(&m->state);
+}
+
+void condition_variable_init(Condition_Variable *cv) {
+	cv->sequence = 0;
+}
+void condition_variable_wait(Condition_Variable *cv, Fast_Mutex *m) {
+	// A signal between the release and os_address_wait changes the sequence so we don't
+	// sleep through it.
+	u32 sequence = cv->sequence;
+	fast_mutex_release(m);
+	if (!park_spin_while_equal(&cv->sequence, sequence)) {
+		os_address_wait(&cv->sequence, sequence);
+	}
+	fast_mutex_acquire_or_wait(m);
+}
+void condition_variable_signal(Condition_Variable *cv) {
+	atomic_add_32(&cv->sequence, 1);
+	os_address_wake_one(&cv->sequence);
+}
+void condition_variable_broadcast(Condition_Variable *cv) {
+	atomic_add_32(&cv->sequence, 1);
+	os_address_wake_all(&cv->sequence);
+}
+
+void semaphore_init(Semaphore *sem, u32 initial_count) {
+	sem->count = initial_count;
+	sem->waiters = 0;
+}
+bool semaphore_try_wait(Semaphore *sem) {
+	while (true) {
+		u32 count = sem->count;
+		if (count == 0) return false;
+		if (compare_and_swap_32(&sem->count, count-1, count)) return true;
+	}
+}
+void semaphore_wait(Semaphore *sem) {
+	if (semaphore_try_wait(sem)) return;
+	
+	if (sem->waiters == 0) park_spin_while_equal(&sem->count, 0);
+	
+	while (!semaphore_try_wait(sem)) {
+		// Counted before checking the count again in os_address_wait, so a signal either
+		// sees us waiting or we see its count.
+		atomic_add_32(&sem->waiters, 1);
+		os_address_wait(&sem->count, 0);
+		atomic_add_32(&sem->waiters, (u32)-1);
+	}
+}
+void semaphore_signal(Semaphore *sem, u32 count) {
+	if (count == 0) return;
+	atomic_add_32(&sem->count, count);
+	if (sem->waiters) {
+		if (count == 1) os_address_wake_one(&sem->count);
+		else            os_address_wake_all(&sem->count);
+	}
+}
+
+void event_init(Event *e, bool signaled) {
+	e->state = signaled ? 1 : 0;
+}
+void event_wait(Event *e) {
+	if (e->state == 1) return;
+	if (e->state == 0) park_spin_while_equal(&e->state, 0);
+	
+	while (true) {
+		u32 state = e->state;
+		if (state == 1) return;
+		if (state == 0 && !compare_and_swap_32(&e->state, 2, 0)) continue;
+		os_address_wait(&e->state, 2);
+	}
+}
+void event_signal(Event *e) {
+	if (atomic_exchange_32(&e->state, 1) == 2) os_address_wake_all(&e->state);
+}
+void event_reset(Event *e) {
+	compare_and_swap_32(&e->state, 0, 1);
+}
+bool event_is_signaled(Event *e) {
+	return e->state == 1;
+}
+
+// Waits until (*address & mask) == value, or != value if !until_equal
+void rw_lock_wait(Rw_Lock *l, volatile u32 *address, u32 mask, u32 value, bool until_equal) {
+	u32 pauses = 1;
+	for (u32 spun = 0; spun < PARK_SPIN_COUNT; spun += pauses) {
+		if (((*address & mask) == value) == until_equal) return;
+		for (u32 i = 0; i < pauses; i++) cpu_pause();
+		pauses = min(pauses*2, 16);
+	}
+	while (true) {
+		u32 current = *address;
+		if (((current & mask) == value) == until_equal) return;
+		atomic_add_32(&l->parked, 1);
+		os_address_wait(address, current);
+		atomic_add_32(&l->parked, (u32)-1);
+	}
+}
+
+void rw_lock_init(Rw_Lock *l) {
+	memset(l, 0, sizeof(*l));
+}
+void rw_lock_acquire_read(Rw_Lock *l) {
+	u32 writer = atomic_add_32(&l->readers_in, RW_LOCK_READER_INCREMENT) & RW_LOCK_WRITER_BITS;
+	if (writer == 0) return;
+	
+	// Wait for that writer to be done. The next writer has the other phase bit, so we don't
+	// wait for it too.
+	rw_lock_wait(l, &l->readers_in, RW_LOCK_WRITER_BITS, writer, false);
+}
+void rw_lock_release_read(Rw_Lock *l) {
+	atomic_add_32(&l->readers_out, RW_LOCK_READER_INCREMENT);
+	if (l->parked) os_address_wake_all(&l->readers_out);
+}
+void rw_lock_acquire_write(Rw_Lock *l) {
+	u32 ticket = atomic_add_32(&l->writers_in, 1);
+	rw_lock_wait(l, &l->writers_out, 0xFFFFFFFF, ticket, true);
+	
+	// Keeps new readers out, then wait for the ones already in
+	u32 writer = RW_LOCK_WRITER_PRESENT | (ticket & RW_LOCK_WRITER_PHASE);
+	u32 readers = atomic_add_32(&l->readers_in, writer) & ~RW_LOCK_WRITER_BITS;
+	rw_lock_wait(l, &l->readers_out, 0xFFFFFFFF, readers, true);
+}
+void rw_lock_release_write(Rw_Lock *l) {
+	u32 writer = l->readers_in & RW_LOCK_WRITER_BITS;
+	assert(writer & RW_LOCK_WRITER_PRESENT, "Tried to release a Rw_Lock which is not acquired for writing");
+	atomic_add_32(&l->readers_in, (u32)-(s32)writer);
+	atomic_add_32(&l->writers_out, 1);
+	if (l->parked) {
+		os_address_wake_all(&l->readers_in);
+		os_address_wake_all(&l->writers_out);
+	}
+}
+
+void seqlock_init(Seqlock *l) {
+	l->sequence = 0;
+}
+u32 seqlock_read_begin(Seqlock *l) {
+	while (true) {
+		u32 sequence = l->sequence;
+		if ((sequence & 1) == 0) {
+			COMPILER_BARRIER;
+			return sequence;
+		}
+		cpu_pause();
+	}
+}
+bool seqlock_read_retry(Seqlock *l, u32 sequence) {
+	COMPILER_BARRIER;
+	return l->sequence != sequence;
+}
+void seqlock_write_begin(Seqlock *l) {
+	while (true) {
+		u32 sequence = l->sequence;
+		if ((sequence & 1) == 0 && compare_and_swap_32(&l->sequence, sequence+1, sequence)) return;
+		cpu_pause();
+	}
+}
+void seqlock_write_end(Seqlock *l) {
+	COMPILER_BARRIER;
+	assert(l->sequence & 1, "Tried to end a Seqlock write that wasn't started");
+	l->sequence += 1;
+}
+void seqlock_read_copy(Seqlock *l, void *dst, const volatile void *src, u64 size) {
+	u32 sequence;
+	do {
+		sequence = seqlock_read_begin(l);
+		memcpy(dst, (const void*)src, size);
+	} while (seqlock_read_retry(l, sequence));
+}
+void seqlock_write_copy(Seqlock *l, volatile void *dst, const void *src, u64 size) {
+	seqlock_write_begin(l);
+	memcpy((void*)dst, src, size);
+	seqlock_write_end(l);
+}
+
 void binary_semaphore_init(Binary_Semaphore *sem, bool initial_state) {
-    sem->signaled = initial_state;
-    mutex_init(&sem->mutex);
+    sem->state = initial_state ? 1 : 0;
 }
 
 void binary_semaphore_destroy(Binary_Semaphore *sem) {
-    mutex_destroy(&sem->mutex);
 }
 
 void binary_semaphore_wait(Binary_Semaphore *sem) {
-    mutex_acquire_or_wait(&sem->mutex);
-    while (!sem->signaled) {
-        mutex_release(&sem->mutex);
-        os_yield_thread();
-        mutex_acquire_or_wait(&sem->mutex);
+    if (compare_and_swap_32(&sem->state, 0, 1)) return;
+    if (sem->state == 0) park_spin_while_equal(&sem->state, 0);
+    
+    // Once we've parked there might be others parked too, so we leave it as 2 when taking the
+    // signal and the next signal wakes one of them.
+    u32 taken_state = 0;
+    while (true) {
+        u32 state = sem->state;
+        if (state == 1) {
+            if (compare_and_swap_32(&sem->state, taken_state, 1)) return;
+            continue;
+        }
+        if (state == 0 && !compare_and_swap_32(&sem->state, 2, 0)) continue;
+        os_address_wait(&sem->state, 2);
+        taken_state = 2;
     }
-    sem->signaled = false;
-    mutex_release(&sem->mutex);
 }
 
 void binary_semaphore_signal(Binary_Semaphore *sem) {
-    mutex_acquire_or_wait(&sem->mutex);
-    sem->signaled = true;
-    mutex_release(&sem->mutex);
+    if (atomic_exchange_32(&sem->state, 1) == 2) os_address_wake_one(&sem->state);
+}
+
+///
+// Single producer single consumer ring
+
+void spsc_queue_init(Spsc_Queue *q, u64 element_size, u64 capacity, Allocator allocator) {
+	assert(element_size > 0 && capacity > 0, "Spsc_Queue needs an element size and capacity");
+	memset(q, 0, sizeof(*q));
+	q->capacity = get_next_power_of_two(capacity);
+	q->element_size = element_size;
+	q->allocator = allocator;
+	q->buffer = alloc_uninitialized(allocator, q->capacity*element_size);
+}
+void spsc_queue_deinit(Spsc_Queue *q) {
+	dealloc(q->allocator, q->buffer);
+	q->buffer = 0;
+}
+
+// Copies count elements into the ring starting at index, wrapping around the end
+void spsc_queue_copy_in(Spsc_Queue *q, u64 index, const void *elements, u64 count) {
+	u64 start = index & (q->capacity-1);
+	u64 first = min(count, q->capacity-start);
+	memcpy(q->buffer + start*q->element_size, elements, first*q->element_size);
+	memcpy(q->buffer, (u8*)elements + first*q->element_size, (count-first)*q->element_size);
+}
+void spsc_queue_copy_out(Spsc_Queue *q, u64 index, void *elements, u64 count) {
+	u64 start = index & (q->capacity-1);
+	u64 first = min(count, q->capacity-start);
+	memcpy(elements, q->buffer + start*q->element_size, first*q->element_size);
+	memcpy((u8*)elements + first*q->element_size, q->buffer, (count-first)*q->element_size);
+}
+
+u64 spsc_queue_push_many(Spsc_Queue *q, const void *elements, u64 count) {
+	u64 head = q->head;
+	u64 free_count = q->capacity - (head - q->cached_tail);
+	if (free_count < count) {
+		// Only look at the consumer's cache line when our copy says we're full
+		q->cached_tail = q->tail;
+		free_count = q->capacity - (head - q->cached_tail);
+	}
+	count = min(count, free_count);
+	if (count == 0) return 0;
+	
+	spsc_queue_copy_in(q, head, elements, count);
+	COMPILER_BARRIER;
+	q->head = head + count;
+	return count;
+}
+u64 spsc_queue_pop_many(Spsc_Queue *q, void *elements, u64 max_count) {
+	u64 tail = q->tail;
+	u64 available = q->cached_head - tail;
+	if (available < max_count) {
+		q->cached_head = q->head;
+		available = q->cached_head - tail;
+	}
+	u64 count = min(max_count, available);
+	if (count == 0) return 0;
+	
+	COMPILER_BARRIER;
+	spsc_queue_copy_out(q, tail, elements, count);
+	COMPILER_BARRIER;
+	q->tail = tail + count;
+	return count;
+}
+bool spsc_queue_push(Spsc_Queue *q, const void *element) {
+	return spsc_queue_push_many(q, element, 1) == 1;
+}
+bool spsc_queue_pop(Spsc_Queue *q, void *element) {
+	return spsc_queue_pop_many(q, element, 1) == 1;
+}
+u64 spsc_queue_count(Spsc_Queue *q) {
+	return q->head - q->tail;
+}
+
+///
+// Multi producer multi consumer queue
+
+void mpmc_queue_init(Mpmc_Queue *q, u64 element_size, u64 capacity, Allocator allocator) {
+	assert(element_size > 0 && capacity > 0, "Mpmc_Queue needs an element size and capacity");
+	memset(q, 0, sizeof(*q));
+	q->capacity = get_next_power_of_two(max(capacity, 2));
+	q->element_size = element_size;
+	q->cell_size = sizeof(u64) + align_next(element_size, sizeof(u64));
+	q->allocator = allocator;
+	q->cells = alloc_uninitialized(allocator, q->capacity*q->cell_size);
+	for (u64 i = 0; i < q->capacity; i++) {
+		*(volatile u64*)(q->cells + i*q->cell_size) = i;
+	}
+}
+void mpmc_queue_deinit(Mpmc_Queue *q) {
+	dealloc(q->allocator, q->cells);
+	q->cells = 0;
+}
+bool mpmc_queue_push(Mpmc_Queue *q, const void *element) {
+	u64 index = q->enqueue_index;
+	u8 *cell;
+	while (true) {
+		cell = q->cells + (index & (q->capacity-1))*q->cell_size;
+		u64 sequence = *(volatile u64*)cell;
+		s64 difference = (s64)sequence - (s64)index;
+		if (difference == 0) {
+			// Cell is free for this index, try to claim the index
+			if (compare_and_swap_64(&q->enqueue_index, index+1, index)) break;
+			index = q->enqueue_index;
+		} else if (difference < 0) {
+			// The consumer of the previous lap hasn't taken it yet
+			return false;
+		} else {
+			// Another producer got it first
+			index = q->enqueue_index;
+		}
+		cpu_pause();
+	}
+	
+	memcpy(cell + sizeof(u64), element, q->element_size);
+	COMPILER_BARRIER;
+	*(volatile u64*)cell = index + 1;
+	return true;
+}
+bool mpmc_queue_pop(Mpmc_Queue *q, void *element) {
+	u64 index = q->dequeue_index;
+	u8 *cell;
+	while (true) {
+		cell = q->cells + (index & (q->capacity-1))*q->cell_size;
+		u64 sequence = *(volatile u64*)cell;
+		s64 difference = (s64)sequence - (s64)(index+1);
+		if (difference == 0) {
+			if (compare_and_swap_64(&q->dequeue_index, index+1, index)) break;
+			index = q->dequeue_index;
+		} else if (difference < 0) {
+			// Nothing pushed here yet
+			return false;
+		} else {
+			index = q->dequeue_index;
+		}
+		cpu_pause();
+	}
+	
+	COMPILER_BARRIER;
+	memcpy(element, cell + sizeof(u64), q->element_size);
+	COMPILER_BARRIER;
+	// Free for the producer one lap ahead
+	*(volatile u64*)cell = index + q->capacity;
+	return true;
+}
+
+///
+// Multi producer single consumer queue
+
+void mpsc_queue_init(Mpsc_Queue *q) {
+	memset(q, 0, sizeof(*q));
+	q->stub.next = 0;
+	q->head = &q->stub;
+	q->tail = &q->stub;
+}
+void mpsc_queue_push(Mpsc_Queue *q, Mpsc_Node *node) {
+	node->next = 0;
+	Mpsc_Node *previous = (Mpsc_Node*)atomic_exchange_64((volatile u64*)&q->head, (u64)node);
+	// Between the exchange and this the consumer can't get past previous
+	previous->next = node;
+}
+Mpsc_Node *mpsc_queue_pop(Mpsc_Queue *q) {
+	Mpsc_Node *tail = q->tail;
+	Mpsc_Node *next = tail->next;
+	
+	if (tail == &q->stub) {
+		if (!next) return 0;
+		q->tail = next;
+		tail = next;
+		next = next->next;
+	}
+	if (next) {
+		q->tail = next;
+		return tail;
+	}
+	
+	// tail is the last node. Unless a push is halfway done, put the stub back behind it so
+	// tail can be handed out.
+	if (tail != q->head) return 0;
+	mpsc_queue_push(q, &q->stub);
+	next = tail->next;
+	if (next) {
+		q->tail = next;
+		return tail;
+	}
+	return 0;
 }
 
 #endif
\ No newline at end of file
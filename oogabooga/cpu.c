@@ -23,12 +23,16 @@ typedef struct Cpu_Capabilities {
 // I think this is the standard? (sse1)
 #define COMPILER_CAN_DO_SSE 1
 
+// #Portability
+#define CACHE_LINE_SIZE 64
+
 ///
 // Compiler specific stuff
 #if COMPILER_MVSC
 	#define inline __forceinline
 	#define alignat(x) __declspec(align(x))
 	#define noreturn __declspec(noreturn)
+	#define noinline __declspec(noinline)
     #define COMPILER_HAS_MEMCPY_INTRINSICS 1
     inline void 
     crash() noreturn {
@@ -79,6 +83,10 @@ typedef struct Cpu_Capabilities {
 	#pragma intrinsic(_InterlockedCompareExchange16)
 	#pragma intrinsic(_InterlockedCompareExchange)
 	#pragma intrinsic(_InterlockedCompareExchange64)
+	#pragma intrinsic(_InterlockedExchange)
+	#pragma intrinsic(_InterlockedExchange64)
+	#pragma intrinsic(_InterlockedExchangeAdd)
+	#pragma intrinsic(_InterlockedExchangeAdd64)
 	
 	inline bool 
 	compare_and_swap_8(volatile uint8_t *a, uint8_t b, uint8_t old) {
@@ -105,7 +113,41 @@ typedef struct Cpu_Capabilities {
 	    return compare_and_swap_8((uint8_t*)a, (uint8_t)b, (uint8_t)old);
 	}
 	
+	// Returns the old value
+	inline uint32_t 
+	atomic_exchange_32(volatile uint32_t *a, uint32_t b) {
+	    return (uint32_t)_InterlockedExchange((volatile long*)a, (long)b);
+	}
+	
+	// Returns the old value
+	inline uint64_t 
+	atomic_exchange_64(volatile uint64_t *a, uint64_t b) {
+	    return (uint64_t)_InterlockedExchange64((volatile long long*)a, (long long)b);
+	}
+	
+	// Returns the old value
+	inline uint32_t 
+	atomic_add_32(volatile uint32_t *a, uint32_t b) {
+	    return (uint32_t)_InterlockedExchangeAdd((volatile long*)a, (long)b);
+	}
+	
+	// Returns the old value
+	inline uint64_t 
+	atomic_add_64(volatile uint64_t *a, uint64_t b) {
+	    return (uint64_t)_InterlockedExchangeAdd64((volatile long long*)a, (long long)b);
+	}
+	
+	// For spin-wait loops. Tells the cpu we're spinning so it can give the other hyperthread
+	// the core and doesn't mispredict when the loop ends.
+	inline void 
+	cpu_pause() {
+		_mm_pause();
+	}
+	
 	#define MEMORY_BARRIER _ReadWriteBarrier()
+	// Only stops the compiler from moving memory accesses across it. On x86 that's enough to
+	// keep loads in order with loads and stores in order with stores. #Portability
+	#define COMPILER_BARRIER _ReadWriteBarrier()
 	
 	#define thread_local __declspec(thread)
 	
@@ -116,6 +158,7 @@ typedef struct Cpu_Capabilities {
 	#define inline __attribute__((always_inline)) inline
 	#define alignat(x) __attribute__((aligned(x)))	
     #define noreturn __attribute__((noreturn))
+    #define noinline __attribute__((noinline))
     #define COMPILER_HAS_MEMCPY_INTRINSICS 1
     
     inline void noreturn
@@ -225,7 +268,65 @@ typedef struct Cpu_Capabilities {
 	    return compare_and_swap_8((uint8_t*)a, (uint8_t)b, (uint8_t)old);
 	}
 	
+	// Returns the old value
+	inline uint32_t 
+	atomic_exchange_32(volatile uint32_t *a, uint32_t b) {
+	    __asm__ __volatile__(
+	        "xchgl %0, %1"
+	        : "+r" (b), "+m" (*a)
+	        :
+	        : "memory"
+	    );
+	    return b;
+	}
+	
+	// Returns the old value
+	inline uint64_t 
+	atomic_exchange_64(volatile uint64_t *a, uint64_t b) {
+	    __asm__ __volatile__(
+	        "xchgq %0, %1"
+	        : "+r" (b), "+m" (*a)
+	        :
+	        : "memory"
+	    );
+	    return b;
+	}
+	
+	// Returns the old value
+	inline uint32_t 
+	atomic_add_32(volatile uint32_t *a, uint32_t b) {
+	    __asm__ __volatile__(
+	        "lock; xaddl %0, %1"
+	        : "+r" (b), "+m" (*a)
+	        :
+	        : "memory"
+	    );
+	    return b;
+	}
+	
+	// Returns the old value
+	inline uint64_t 
+	atomic_add_64(volatile uint64_t *a, uint64_t b) {
+	    __asm__ __volatile__(
+	        "lock; xaddq %0, %1"
+	        : "+r" (b), "+m" (*a)
+	        :
+	        : "memory"
+	    );
+	    return b;
+	}
+	
+	// For spin-wait loops. Tells the cpu we're spinning so it can give the other hyperthread
+	// the core and doesn't mispredict when the loop ends.
+	inline void 
+	cpu_pause() {
+		__asm__ __volatile__("pause" ::: "memory");
+	}
+	
 	#define MEMORY_BARRIER {__asm__ __volatile__("" ::: "memory");__sync_synchronize();}
+	// Only stops the compiler from moving memory accesses across it. On x86 that's enough to
+	// keep loads in order with loads and stores in order with stores. #Portability
+	#define COMPILER_BARRIER __asm__ __volatile__("" ::: "memory")
 	
 	#define thread_local __thread
 	
@@ -244,6 +345,7 @@ typedef struct Cpu_Capabilities {
     inline u64 
     rdtsc() { return 0; }
     inline Cpu_Info_X86 cpuid(u32 function_id) {return (Cpu_Info_X86){0};}
+    inline void cpu_pause() {}
     #define COMPILER_CAN_DO_SSE2 0
     #define COMPILER_CAN_DO_AVX 0
     #define COMPILER_CAN_DO_AVX2 0
@@ -252,6 +354,7 @@ typedef struct Cpu_Capabilities {
     #define DEPRECATED(proc, msg) 
     
     #define MEMORY_BARRIER
+    #define COMPILER_BARRIER
     
     #warning "Compiler is not explicitly supported, some things will probably not work as expected"
 #endif
@@ -26,6 +26,11 @@
 #define Z_STACK_MAX 4096
 #define SCISSOR_STACK_MAX 4096
 
+// Address space for the quads of one frame, only what's used is committed
+#ifndef DRAW_FRAME_ARENA_RESERVE_SIZE
+	#define DRAW_FRAME_ARENA_RESERVE_SIZE GB(2)
+#endif
+
 typedef struct Draw_Quad {
 	// BEWARE !! These are in ndc
 	Vector2 bottom_left, top_left, top_right, bottom_right;
@@ -60,6 +65,8 @@ typedef struct Draw_Frame {
 	Vector4 scissor_stack[SCISSOR_STACK_MAX];
 	
 	Draw_Quad *quad_buffer;
+	Arena *arena; // quad_buffer lives here
+	u64 quads_reserved; // If quad_buffer grew past this, the arena has old copies to reclaim
 	
 	u64 z_count;
 	s32 z_stack[Z_STACK_MAX];
@@ -75,20 +82,42 @@ ogb_instance Draw_Frame draw_frame;
 Draw_Frame draw_frame;
 #endif // NOT OOGABOOGA_LINK_EXTERNAL_INSTANCE
 
-void reset_draw_frame(Draw_Frame *frame) {
+void draw_frame_init_quad_buffer(Draw_Frame *frame, u64 quads_to_reserve) {
+	if (!frame->arena) frame->arena = arena_make(DRAW_FRAME_ARENA_RESERVE_SIZE);
+	arena_reset(frame->arena);
+	growing_array_init_reserve(
+		(void**)&frame->quad_buffer, 
+		sizeof(Draw_Quad), 
+		max(quads_to_reserve, 1024), 
+		get_arena_allocator(frame->arena)
+	);
+	frame->quads_reserved = growing_array_get_allocated_count(frame->quad_buffer);
+}
 
-	// #Memory
-	// I would like to try to have the quad buffer to be allocated in a growing arena
-	// which is reset every frames, like temp allocator but large enough to fit the
-	// highest number of quads the program submits in a frame.
-	// For now, we just reset the count in the heap allocated buffer
+void reset_draw_frame(Draw_Frame *frame) {
 
+	// The quad buffer is in its own arena. When it grows, the old copies are left behind in
+	// the arena, so then we reset the arena and reserve as many quads as the busiest frame
+	// so far. After the first few frames it stops growing and we only clear the count.
+	
+	Arena *arena = frame->arena;
 	Draw_Quad *quad_buffer = frame->quad_buffer;
-	if (quad_buffer) growing_array_clear((void**)&quad_buffer);
+	u64 quads_reserved = frame->quads_reserved;
 
 	*frame = (Draw_Frame){0};
 	
+	frame->arena = arena;
 	frame->quad_buffer = quad_buffer;
+	frame->quads_reserved = quads_reserved;
+	
+	if (quad_buffer) {
+		u64 quads_allocated = growing_array_get_allocated_count(quad_buffer);
+		if (quads_allocated == quads_reserved) {
+			growing_array_clear((void**)&frame->quad_buffer);
+		} else {
+			draw_frame_init_quad_buffer(frame, quads_allocated);
+		}
+	}
 	
 	float32 aspect = (float32)window.width/(float32)window.height;
 	
@@ -96,6 +125,18 @@ void reset_draw_frame(Draw_Frame *frame) {
 	frame->camera_xform = m4_scalar(1.0);
 }
 
+// Swaps everything, including which arena each frame's quads are in
+void draw_frame_swap(Draw_Frame *a, Draw_Frame *b) {
+	// Draw_Frame is mostly the z and scissor stacks so this beats a temporary copy on the stack
+	u64 *x = (u64*)a;
+	u64 *y = (u64*)b;
+	for (u64 i = 0; i < sizeof(Draw_Frame)/sizeof(u64); i++) {
+		u64 t = x[i];
+		x[i] = y[i];
+		y[i] = t;
+	}
+}
+
 void push_z_layer(s32 z) {
 	assert(draw_frame.z_count < Z_STACK_MAX, "Too many z layers pushed. You can pop with pop_z_layer() when you are done drawing to it.");
 	
@@ -150,17 +191,13 @@ Draw_Quad *draw_quad_projected(Draw_Quad quad, Matrix4 world_to_clip) {
 	
 	memset(quad.userdata, 0, sizeof(quad.userdata));
 	
-	if (!draw_frame.quad_buffer) {
-		// #Memory
-		// Use an arena
-		growing_array_init((void**)&draw_frame.quad_buffer, sizeof(Draw_Quad), get_heap_allocator());
-	}
-	
-	Draw_Quad **target_buffer = &draw_frame.quad_buffer;
+	if (!draw_frame.quad_buffer) draw_frame_init_quad_buffer(&draw_frame, 0);
 	
-	growing_array_add((void**)target_buffer, &quad);
+	// Hot path, the quad buffer is always valid here
+	Draw_Quad *target = growing_array_add_uninitialized_unchecked((void**)&draw_frame.quad_buffer);
+	*target = quad;
 	
-	return &(*target_buffer)[growing_array_get_valid_count(*target_buffer)-1];
+	return target;
 }
 Draw_Quad *draw_quad(Draw_Quad quad) {
 	return draw_quad_projected(quad, m4_mul(draw_frame.projection, m4_inverse(draw_frame.camera_xform)));
@@ -0,0 +1,81 @@
+
+// Throughput numbers that don't belong in the tests (those only pass or fail).
+// Build with RELEASE for numbers that mean anything.
+
+void benchmark_hash() {
+	u64 big_size = MB(64);
+	u8 *big = alloc(get_heap_allocator(), big_size);
+	u64 *words = (u64*)big;
+	for (u64 i = 0; i < big_size/sizeof(u64); i++) words[i] = get_random();
+
+	const u64 rounds = 8;
+	u64 sink = 0;
+
+	float64 start_seconds = os_get_elapsed_seconds();
+	for (u64 r = 0; r < rounds; r++) sink += hash_bytes_seeded(big, big_size, r);
+	float64 long_seconds = os_get_elapsed_seconds()-start_seconds;
+
+	start_seconds = os_get_elapsed_seconds();
+	for (u64 r = 0; r < rounds; r++) sink += djb2_hash((string){big_size, big});
+	float64 djb2_seconds = os_get_elapsed_seconds()-start_seconds;
+
+	// Short keys like asset paths and names
+	start_seconds = os_get_elapsed_seconds();
+	u64 short_count = 0;
+	for (u64 i = 0; i + 24 <= big_size; i += 24) {
+		sink += hash_bytes(big + i, 8 + (i & 15));
+		short_count += 1;
+	}
+	float64 short_seconds = os_get_elapsed_seconds()-start_seconds;
+
+	float64 gigabytes = (float64)(big_size*rounds)/(1024.0*1024.0*1024.0);
+	print("hash_bytes long inputs: %.2f GB/s\n", gigabytes/long_seconds);
+	print("djb2:                   %.2f GB/s\n", gigabytes/djb2_seconds);
+	print("hash_bytes short inputs: %.1f ns per hash\n", short_seconds*1000000000.0/(float64)short_count);
+	print("(%llu)\n", sink & 1); // So the hashing isn't optimized away
+
+	dealloc(get_heap_allocator(), big);
+}
+
+// Same setup as test_rw_lock_and_seqlock in tests.c, but timed
+void benchmark_rw_lock_and_seqlock() {
+	string names[RW_TEST_MODE_COUNT] = { STR("Fast_Mutex"), STR("Rw_Lock"), STR("Seqlock") };
+	Rw_Test_Shared_Data *data = alloc(get_heap_allocator(), sizeof(Rw_Test_Shared_Data));
+	for (Rw_Test_Mode mode = 0; mode < RW_TEST_MODE_COUNT; mode++) {
+		memset(data, 0, sizeof(Rw_Test_Shared_Data));
+		data->mode = mode;
+		fast_mutex_init(&data->mutex);
+		rw_lock_init(&data->rw_lock);
+		seqlock_init(&data->seqlock);
+
+		Thread threads[RW_TEST_READER_COUNT+RW_TEST_WRITER_COUNT];
+		for (u64 i = 0; i < RW_TEST_READER_COUNT+RW_TEST_WRITER_COUNT; i++) {
+			os_thread_init(&threads[i], i < RW_TEST_READER_COUNT ? rw_test_reader_proc : rw_test_writer_proc);
+			threads[i].data = data;
+		}
+
+		float64 start_seconds = os_get_elapsed_seconds();
+		for (u64 i = 0; i < RW_TEST_READER_COUNT+RW_TEST_WRITER_COUNT; i++) os_thread_start(&threads[i]);
+		for (u64 i = 0; i < RW_TEST_READER_COUNT+RW_TEST_WRITER_COUNT; i++) {
+			os_thread_join(&threads[i]);
+			os_thread_destroy(&threads[i]);
+		}
+		float64 end_seconds = os_get_elapsed_seconds();
+
+		print("%s: %d readers, %d writers, %.2f reads per microsecond\n",
+			names[mode], RW_TEST_READER_COUNT, RW_TEST_WRITER_COUNT,
+			(float64)(RW_TEST_READER_COUNT*RW_TEST_READS)/((end_seconds-start_seconds)*1000000.0));
+	}
+	dealloc(get_heap_allocator(), data);
+}
+
+int entry(int argc, char **argv) {
+
+	print("\nHashing:\n");
+	benchmark_hash();
+
+	print("\nReaders and writers:\n");
+	benchmark_rw_lock_and_seqlock();
+
+	return 0;
+}
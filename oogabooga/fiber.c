@@ -0,0 +1,620 @@
+
+///
+///
+// Fibers
+///
+// For work that takes longer than a frame (loading, streaming, scripted sequences) without
+// writing it as a state machine or giving it a thread. A fiber is a task with its own little
+// stack that can stop in the middle and continue later, on whichever worker picks it up next:
+//
+//     void load_level(void *data) {
+//         Fiber_Counter textures = ZERO(Fiber_Counter);
+//         for (u64 i = 0; i < texture_count; i += 1) {
+//             fiber_run(&scheduler, load_texture, &textures_to_load[i], &textures);
+//         }
+//         fiber_counter_wait(&textures); // This fiber sleeps, the worker runs something else
+//
+//         while (!fade_in_done()) fiber_yield_until_next_frame();
+//     }
+//
+//     Fiber_Scheduler scheduler;
+//     fiber_scheduler_init(&scheduler, ZERO(Fiber_Policy));
+//     fiber_run(&scheduler, load_level, 0, 0);
+//     while (!window.should_close) {
+//         ...
+//         fiber_scheduler_next_frame(&scheduler);
+//     }
+//     fiber_scheduler_destroy(&scheduler);
+//
+// Tasks are cheap: they sit in a queue until a worker has a free fiber for them, so you can
+// queue thousands of them. fiber_count is how many can be started and not finished at once.
+// Stacks are allocated all at once when the scheduler is made, each with a guard page below it.
+//
+// Since a fiber can wake up on another thread:
+// - Don't keep temporary storage, or anything else thread local, across a yield or wait.
+// - Don't yield or wait while holding a lock, or inside a profiler scope.
+//
+// The context switch is hand written for x64, Win64 and System V calling conventions. MSVC
+// can't do x64 inline assembly so fibers are only there with clang and gcc (FIBERS_SUPPORTED).
+
+#if (COMPILER_GCC || COMPILER_CLANG) && (defined(__x86_64__) || defined(_M_X64))
+	#define FIBERS_SUPPORTED 1
+#else
+	#define FIBERS_SUPPORTED 0
+#endif
+
+#ifndef FIBER_DEFAULT_COUNT
+	#define FIBER_DEFAULT_COUNT 1024
+#endif
+#ifndef FIBER_DEFAULT_STACK_SIZE
+	#define FIBER_DEFAULT_STACK_SIZE KB(64)
+#endif
+#ifndef FIBER_DEFAULT_TASK_CAPACITY
+	#define FIBER_DEFAULT_TASK_CAPACITY 8192
+#endif
+// Idle workers look for work this many times before they go to sleep
+#ifndef FIBER_WORKER_SPIN_COUNT
+	#define FIBER_WORKER_SPIN_COUNT 1024
+#endif
+
+typedef struct Fiber Fiber;
+typedef struct Fiber_Scheduler Fiber_Scheduler;
+
+typedef void(*Fiber_Proc)(void *data);
+
+// Counts unfinished tasks. fiber_run adds one, and the task takes it away when it's done.
+// Zero initialize it, it can be reused once it's back to zero.
+typedef struct Fiber_Counter {
+	volatile u32 value;
+	u32 thread_waiters; // Threads (not fibers) waiting
+	Fiber *waiters; // Fibers waiting
+	Spinlock lock; // Only taken to reach zero and to wait
+} Fiber_Counter;
+
+typedef struct Fiber_Task {
+	Fiber_Proc proc;
+	void *data;
+	Fiber_Counter *counter;
+} Fiber_Task;
+
+// What the fiber wants the worker to do once it's switched away from it
+typedef enum Fiber_State {
+	FIBER_FINISHED,
+	FIBER_YIELDED,
+	FIBER_YIELDED_FRAME,
+	FIBER_WAITING,
+} Fiber_State;
+
+typedef struct Fiber {
+	void *stack_pointer; // Where the registers were saved when it was switched away from
+	Fiber_Scheduler *scheduler;
+	Fiber_Task task;
+	Fiber_State state;
+	Fiber *next; // In a Fiber_Counter's waiters or waiting for the next frame
+	u8 *stack; // Lowest address, the guard page is right below
+	u64 stack_size;
+} Fiber;
+
+// One for each worker thread
+typedef struct Fiber_Worker {
+	void *stack_pointer; // The worker's own stack while it's running a fiber
+	Fiber *current;
+	Spinlock *release_after_switch;
+} Fiber_Worker;
+
+typedef struct Fiber_Policy {
+	u64 worker_count;  // 0 for one less than the number of logical processors (at least one)
+	u64 fiber_count;   // 0 for FIBER_DEFAULT_COUNT
+	u64 stack_size;    // Per fiber, 0 for FIBER_DEFAULT_STACK_SIZE
+	u64 task_capacity; // Tasks queued and not started yet, 0 for FIBER_DEFAULT_TASK_CAPACITY
+	Allocator allocator; // Zero for context.allocator
+	Worker_Policy worker_policy;
+} Fiber_Policy;
+
+typedef struct Fiber_Scheduler {
+	Worker_Group group;
+	Fiber_Worker *workers;
+	Fiber *fibers;
+	u64 fiber_count;
+	void *stack_memory;
+	u64 stack_memory_size;
+	Mpmc_Queue tasks; // Fiber_Task
+	Mpmc_Queue ready; // Fiber*, yielded or done waiting
+	Mpmc_Queue free_fibers; // Fiber*
+	volatile u64 next_frame; // Fiber*, a stack of the ones waiting for fiber_scheduler_next_frame
+	volatile u32 wake_sequence;
+	volatile u32 sleeping_workers;
+	volatile bool running;
+	Allocator allocator;
+} Fiber_Scheduler;
+
+thread_local Fiber_Worker *current_fiber_worker = 0;
+
+// Read through a function that isn't inlined, because the compiler is allowed to assume the
+// thread doesn't change in the middle of a function and a fiber might continue on another one.
+noinline Fiber_Worker *
+get_current_fiber_worker() {
+	return current_fiber_worker;
+}
+
+// 0 if not running in a fiber
+Fiber *
+get_current_fiber() {
+	Fiber_Worker *w = get_current_fiber_worker();
+	return w ? w->current : 0;
+}
+
+#if FIBERS_SUPPORTED
+
+// Saves the callee saved registers on the current stack, stores the stack pointer in *save,
+// switches to the stack in load and pops the registers that were saved there.
+// On Win64 it also swaps the stack bounds in the TEB, which the stack probes and the
+// exception unwinder check against.
+void _fiber_switch_context(void **save, void *load);
+// Where new fibers start, the fiber is in r12
+void _fiber_trampoline();
+
+#if TARGET_OS == MACOS
+	#define FIBER_ASM_SYMBOL(name) "_" #name
+#else
+	#define FIBER_ASM_SYMBOL(name) #name
+#endif
+
+#if TARGET_OS == WINDOWS
+// Win64: rbx, rbp, rdi, rsi, r12-r15 and xmm6-xmm15 are callee saved.
+// TEB: 0x08 StackBase, 0x10 StackLimit, 0x1478 DeallocationStack.
+// Stack after the save: xmm6-xmm15, mxcsr, x87 control word, 8 bytes padding,
+// StackBase, StackLimit, DeallocationStack, r15, r14, r13, r12, rsi, rdi, rbx, rbp, return address
+#define FIBER_SAVED_SIZE (160 + 16 + 11*8)
+__asm__(
+	".text\n"
+	".globl " FIBER_ASM_SYMBOL(_fiber_switch_context) "\n"
+	FIBER_ASM_SYMBOL(_fiber_switch_context) ":\n"
+	"	pushq %rbp\n"
+	"	pushq %rbx\n"
+	"	pushq %rdi\n"
+	"	pushq %rsi\n"
+	"	pushq %r12\n"
+	"	pushq %r13\n"
+	"	pushq %r14\n"
+	"	pushq %r15\n"
+	"	pushq %gs:0x1478\n"
+	"	pushq %gs:0x10\n"
+	"	pushq %gs:0x08\n"
+	"	subq $176, %rsp\n"
+	"	movaps %xmm6, 0(%rsp)\n"
+	"	movaps %xmm7, 16(%rsp)\n"
+	"	movaps %xmm8, 32(%rsp)\n"
+	"	movaps %xmm9, 48(%rsp)\n"
+	"	movaps %xmm10, 64(%rsp)\n"
+	"	movaps %xmm11, 80(%rsp)\n"
+	"	movaps %xmm12, 96(%rsp)\n"
+	"	movaps %xmm13, 112(%rsp)\n"
+	"	movaps %xmm14, 128(%rsp)\n"
+	"	movaps %xmm15, 144(%rsp)\n"
+	"	stmxcsr 160(%rsp)\n"
+	"	fnstcw 164(%rsp)\n"
+	"	movq %rsp, (%rcx)\n"
+	"	movq %rdx, %rsp\n"
+	"	movaps 0(%rsp), %xmm6\n"
+	"	movaps 16(%rsp), %xmm7\n"
+	"	movaps 32(%rsp), %xmm8\n"
+	"	movaps 48(%rsp), %xmm9\n"
+	"	movaps 64(%rsp), %xmm10\n"
+	"	movaps 80(%rsp), %xmm11\n"
+	"	movaps 96(%rsp), %xmm12\n"
+	"	movaps 112(%rsp), %xmm13\n"
+	"	movaps 128(%rsp), %xmm14\n"
+	"	movaps 144(%rsp), %xmm15\n"
+	"	ldmxcsr 160(%rsp)\n"
+	"	fldcw 164(%rsp)\n"
+	"	addq $176, %rsp\n"
+	"	popq %gs:0x08\n"
+	"	popq %gs:0x10\n"
+	"	popq %gs:0x1478\n"
+	"	popq %r15\n"
+	"	popq %r14\n"
+	"	popq %r13\n"
+	"	popq %r12\n"
+	"	popq %rsi\n"
+	"	popq %rdi\n"
+	"	popq %rbx\n"
+	"	popq %rbp\n"
+	"	ret\n"
+
+	".globl " FIBER_ASM_SYMBOL(_fiber_trampoline) "\n"
+	FIBER_ASM_SYMBOL(_fiber_trampoline) ":\n"
+	"	subq $32, %rsp\n" // Shadow space
+	"	movq %r12, %rcx\n"
+	"	call " FIBER_ASM_SYMBOL(_fiber_entry) "\n"
+	"	ud2\n"
+);
+#else
+// System V: rbx, rbp, r12-r15 are callee saved.
+// Stack after the save: mxcsr, x87 control word, r15, r14, r13, r12, rbx, rbp, return address
+#define FIBER_SAVED_SIZE (8 + 6*8)
+__asm__(
+	".text\n"
+	".globl " FIBER_ASM_SYMBOL(_fiber_switch_context) "\n"
+	FIBER_ASM_SYMBOL(_fiber_switch_context) ":\n"
+	"	pushq %rbp\n"
+	"	pushq %rbx\n"
+	"	pushq %r12\n"
+	"	pushq %r13\n"
+	"	pushq %r14\n"
+	"	pushq %r15\n"
+	"	subq $8, %rsp\n"
+	"	stmxcsr 0(%rsp)\n"
+	"	fnstcw 4(%rsp)\n"
+	"	movq %rsp, (%rdi)\n"
+	"	movq %rsi, %rsp\n"
+	"	ldmxcsr 0(%rsp)\n"
+	"	fldcw 4(%rsp)\n"
+	"	addq $8, %rsp\n"
+	"	popq %r15\n"
+	"	popq %r14\n"
+	"	popq %r13\n"
+	"	popq %r12\n"
+	"	popq %rbx\n"
+	"	popq %rbp\n"
+	"	ret\n"
+
+	".globl " FIBER_ASM_SYMBOL(_fiber_trampoline) "\n"
+	FIBER_ASM_SYMBOL(_fiber_trampoline) ":\n"
+	"	movq %r12, %rdi\n"
+	"	call " FIBER_ASM_SYMBOL(_fiber_entry) "\n"
+	"	ud2\n"
+);
+#endif
+
+// Makes the stack look like _fiber_switch_context saved it, so switching to it the first
+// time "returns" into _fiber_trampoline.
+void
+_fiber_init_stack(Fiber *f) {
+	u8 *top = f->stack + f->stack_size;
+
+	// A zero return address above the trampoline so stack walks stop there. The saved
+	// registers end up 16 byte aligned just like a real switch leaves them.
+	u64 *slots = (u64*)(top - 16 - 8 - FIBER_SAVED_SIZE);
+	memset(slots, 0, FIBER_SAVED_SIZE + 24);
+
+#if TARGET_OS == WINDOWS
+	u32 *control = (u32*)((u8*)slots + 160);
+	control[0] = 0x1F80; // mxcsr default
+	control[1] = 0x037F; // x87 control word default
+	u64 *registers = (u64*)((u8*)slots + 176);
+	registers[0] = (u64)top;                        // StackBase
+	registers[1] = (u64)f->stack;                   // StackLimit
+	registers[2] = (u64)(f->stack - os.page_size);  // DeallocationStack, the guard page
+	registers[6] = (u64)f;                          // r12
+	registers[11] = (u64)&_fiber_trampoline;        // Return address
+#else
+	u32 *control = (u32*)slots;
+	control[0] = 0x1F80;
+	control[1] = 0x037F;
+	slots[4] = (u64)f;                   // r12
+	slots[7] = (u64)&_fiber_trampoline;  // Return address
+#endif
+
+	f->stack_pointer = slots;
+}
+
+#endif // FIBERS_SUPPORTED
+
+void
+_fiber_wake_workers(Fiber_Scheduler *s, bool all) {
+	// The push before this must be visible before we look at sleeping_workers, and a worker
+	// going to sleep counts itself before it looks at the queues one last time.
+	MEMORY_BARRIER;
+	if (s->sleeping_workers) {
+		atomic_add_32(&s->wake_sequence, 1);
+		if (all) os_address_wake_all(&s->wake_sequence);
+		else     os_address_wake_one(&s->wake_sequence);
+	}
+}
+
+// The fiber queues have room for every fiber, but a cell can't be pushed to while a pop of it
+// is halfway done on a thread that got preempted, so this might have to wait for that.
+void
+_fiber_push(Mpmc_Queue *q, Fiber *f) {
+	while (!mpmc_queue_push(q, &f)) os_yield_thread();
+}
+
+void
+_fiber_make_ready(Fiber_Scheduler *s, Fiber *f) {
+	_fiber_push(&s->ready, f);
+	_fiber_wake_workers(s, false);
+}
+
+// Switches back to the worker, which does what the state says (FIBER_WAITING releases
+// worker->release_after_switch). Returns when the fiber is picked up again.
+void
+_fiber_suspend(Fiber *f, Fiber_State state) {
+#if FIBERS_SUPPORTED
+	f->state = state;
+	Fiber_Worker *w = get_current_fiber_worker();
+	_fiber_switch_context(&f->stack_pointer, w->stack_pointer);
+#endif
+}
+
+void
+fiber_counter_decrement(Fiber_Counter *c) {
+	while (true) {
+		u32 value = c->value;
+		assert(value > 0, "Fiber_Counter decremented below zero");
+		if (value == 1) break;
+		if (compare_and_swap_32(&c->value, value-1, value)) return;
+	}
+
+	// Reaching zero, the waiters have to be taken off under the lock. Nothing in the counter
+	// is touched after the lock is released since a waiter might free it right away.
+	spinlock_acquire_or_wait(&c->lock);
+	u32 old = atomic_add_32(&c->value, (u32)-1);
+	Fiber *waiters = 0;
+	bool wake_threads = false;
+	if (old == 1) {
+		waiters = c->waiters;
+		c->waiters = 0;
+		wake_threads = c->thread_waiters > 0;
+	}
+	spinlock_release(&c->lock);
+
+	while (waiters) {
+		Fiber *next = waiters->next;
+		_fiber_make_ready(waiters->scheduler, waiters);
+		waiters = next;
+	}
+	if (wake_threads) os_address_wake_all(&c->value);
+}
+
+// Waits until the counter is zero. In a fiber the fiber sleeps, otherwise the thread does.
+void
+fiber_counter_wait(Fiber_Counter *c) {
+	if (c->value == 0) {
+		// Let a decrement that's still holding the lock finish before the counter can be freed
+		spinlock_acquire_or_wait(&c->lock);
+		spinlock_release(&c->lock);
+		return;
+	}
+
+	Fiber *f = get_current_fiber();
+	if (f) {
+		spinlock_acquire_or_wait(&c->lock);
+		if (c->value == 0) {
+			spinlock_release(&c->lock);
+			return;
+		}
+		f->next = c->waiters;
+		c->waiters = f;
+		get_current_fiber_worker()->release_after_switch = &c->lock;
+		_fiber_suspend(f, FIBER_WAITING);
+		// The decrement that woke us released the lock before making us ready
+		return;
+	}
+
+	while (true) {
+		spinlock_acquire_or_wait(&c->lock);
+		u32 value = c->value;
+		if (value == 0) {
+			spinlock_release(&c->lock);
+			return;
+		}
+		c->thread_waiters += 1;
+		spinlock_release(&c->lock);
+
+		os_address_wait(&c->value, value);
+
+		spinlock_acquire_or_wait(&c->lock);
+		c->thread_waiters -= 1;
+		spinlock_release(&c->lock);
+	}
+}
+
+// Queues a task. If counter isn't 0 it's incremented now and decremented when the task is done.
+// Waits if the task queue is full.
+void
+fiber_run(Fiber_Scheduler *s, Fiber_Proc proc, void *data, Fiber_Counter *counter) {
+	Fiber_Task task = { proc, data, counter };
+	if (counter) atomic_add_32(&counter->value, 1);
+
+	while (!mpmc_queue_push(&s->tasks, &task)) {
+		if (get_current_fiber()) _fiber_suspend(get_current_fiber(), FIBER_YIELDED);
+		else                     os_yield_thread();
+	}
+	_fiber_wake_workers(s, false);
+}
+
+// Lets other fibers run, continues when a worker gets to it again
+void
+fiber_yield() {
+	Fiber *f = get_current_fiber();
+	assert(f, "fiber_yield called outside of a fiber");
+	_fiber_suspend(f, FIBER_YIELDED);
+}
+
+// Continues after the next fiber_scheduler_next_frame
+void
+fiber_yield_until_next_frame() {
+	Fiber *f = get_current_fiber();
+	assert(f, "fiber_yield_until_next_frame called outside of a fiber");
+	_fiber_suspend(f, FIBER_YIELDED_FRAME);
+}
+
+// Call once a frame, wakes the fibers that yielded until the next frame
+void
+fiber_scheduler_next_frame(Fiber_Scheduler *s) {
+	Fiber *f = (Fiber*)atomic_exchange_64(&s->next_frame, 0);
+	if (!f) return;
+	while (f) {
+		Fiber *next = f->next;
+		_fiber_push(&s->ready, f);
+		f = next;
+	}
+	_fiber_wake_workers(s, true);
+}
+
+// Fibers that are ready to continue go first, then new tasks if there's a free fiber for them
+Fiber *
+_fiber_scheduler_get_work(Fiber_Scheduler *s) {
+	Fiber *f = 0;
+	if (mpmc_queue_pop(&s->ready, &f)) return f;
+
+	if (!mpmc_queue_pop(&s->free_fibers, &f)) return 0;
+
+	if (!mpmc_queue_pop(&s->tasks, &f->task)) {
+		_fiber_push(&s->free_fibers, f);
+		return 0;
+	}
+	return f;
+}
+
+void
+_fiber_worker_sleep(Fiber_Scheduler *s) {
+	u32 sequence = s->wake_sequence;
+	atomic_add_32(&s->sleeping_workers, 1);
+
+	// Counted, so anything pushed after this point wakes us. Tasks don't count as work if
+	// there's no free fiber to run them on.
+	bool has_ready = s->ready.enqueue_index != s->ready.dequeue_index;
+	bool has_tasks = s->tasks.enqueue_index != s->tasks.dequeue_index
+	              && s->free_fibers.enqueue_index != s->free_fibers.dequeue_index;
+	if (s->running && !has_ready && !has_tasks) {
+		os_address_wait(&s->wake_sequence, sequence);
+	}
+
+	atomic_add_32(&s->sleeping_workers, (u32)-1);
+}
+
+void
+_fiber_worker_proc(Thread *t) {
+#if FIBERS_SUPPORTED
+	Fiber_Scheduler *s = (Fiber_Scheduler*)t->data;
+	Fiber_Worker *w = &s->workers[get_worker_context()->index];
+	current_fiber_worker = w;
+
+	u64 idle = 0;
+	while (s->running) {
+		Fiber *f = _fiber_scheduler_get_work(s);
+		if (!f) {
+			idle += 1;
+			if (idle < FIBER_WORKER_SPIN_COUNT) cpu_pause();
+			else { _fiber_worker_sleep(s); idle = 0; }
+			continue;
+		}
+		idle = 0;
+
+		w->current = f;
+		_fiber_switch_context(&w->stack_pointer, f->stack_pointer);
+		w->current = 0;
+
+		switch (f->state) {
+			case FIBER_FINISHED: {
+				_fiber_push(&s->free_fibers, f);
+				// Someone might be sleeping on tasks that had no fiber to run on
+				_fiber_wake_workers(s, false);
+				break;
+			}
+			case FIBER_YIELDED: {
+				_fiber_push(&s->ready, f);
+				break;
+			}
+			case FIBER_YIELDED_FRAME: {
+				while (true) {
+					u64 head = s->next_frame;
+					f->next = (Fiber*)head;
+					if (compare_and_swap_64(&s->next_frame, (u64)f, head)) break;
+				}
+				break;
+			}
+			case FIBER_WAITING: {
+				spinlock_release(w->release_after_switch);
+				w->release_after_switch = 0;
+				break;
+			}
+		}
+	}
+
+	current_fiber_worker = 0;
+#endif
+}
+
+// Where every fiber starts. Fibers are reused so this never returns, it waits for the next task.
+// Not marked noreturn, that macro is #undef'd before windows.h and the loop says it anyway.
+void
+_fiber_entry(Fiber *f) {
+	while (true) {
+		f->task.proc(f->task.data);
+		if (f->task.counter) fiber_counter_decrement(f->task.counter);
+		_fiber_suspend(f, FIBER_FINISHED);
+	}
+}
+
+void
+fiber_scheduler_init(Fiber_Scheduler *s, Fiber_Policy policy) {
+	assert(FIBERS_SUPPORTED, "Fibers need clang or gcc on x64");
+
+	if (policy.worker_count == 0) {
+		u64 processors = os_get_number_of_logical_processors();
+		policy.worker_count = processors > 1 ? processors-1 : 1;
+	}
+	if (policy.fiber_count == 0)   policy.fiber_count = FIBER_DEFAULT_COUNT;
+	if (policy.stack_size == 0)    policy.stack_size = FIBER_DEFAULT_STACK_SIZE;
+	if (policy.task_capacity == 0) policy.task_capacity = FIBER_DEFAULT_TASK_CAPACITY;
+	if (!policy.allocator.proc)    policy.allocator = context.allocator;
+	if (!policy.allocator.proc)    policy.allocator = get_heap_allocator();
+
+	memset(s, 0, sizeof(*s));
+	s->allocator = policy.allocator;
+	s->fiber_count = policy.fiber_count;
+	s->running = true;
+
+	mpmc_queue_init(&s->tasks, sizeof(Fiber_Task), policy.task_capacity, policy.allocator);
+	mpmc_queue_init(&s->ready, sizeof(Fiber*), policy.fiber_count, policy.allocator);
+	mpmc_queue_init(&s->free_fibers, sizeof(Fiber*), policy.fiber_count, policy.allocator);
+
+	// Every stack has an uncommitted guard page under it, so an overflow crashes right away
+	// instead of writing over the next fiber's stack.
+	u64 stack_size = align_next(policy.stack_size, os.page_size);
+	u64 slot_size = stack_size + os.page_size;
+	s->stack_memory_size = slot_size*policy.fiber_count;
+	s->stack_memory = os_reserve_memory(s->stack_memory_size);
+	assert(s->stack_memory, "Could not reserve memory for fiber stacks");
+
+	s->fibers = (Fiber*)alloc(policy.allocator, sizeof(Fiber)*policy.fiber_count);
+	for (u64 i = 0; i < policy.fiber_count; i += 1) {
+		Fiber *f = &s->fibers[i];
+		f->scheduler = s;
+		f->stack = (u8*)s->stack_memory + i*slot_size + os.page_size;
+		f->stack_size = stack_size;
+		bool ok = os_commit_memory(f->stack, stack_size);
+		assert(ok, "Could not commit fiber stack");
+#if FIBERS_SUPPORTED
+		_fiber_init_stack(f);
+#endif
+		_fiber_push(&s->free_fibers, f);
+	}
+
+	s->workers = (Fiber_Worker*)alloc(policy.allocator, sizeof(Fiber_Worker)*policy.worker_count);
+	worker_group_init(&s->group, policy.worker_count, _fiber_worker_proc, s, policy.worker_policy);
+	worker_group_start(&s->group);
+}
+
+// Stops the workers once they're done with the fiber they're running. Tasks that didn't start
+// are dropped and fibers that are waiting never continue, so wait for your counters first.
+void
+fiber_scheduler_destroy(Fiber_Scheduler *s) {
+	s->running = false;
+	MEMORY_BARRIER;
+	atomic_add_32(&s->wake_sequence, 1);
+	os_address_wake_all(&s->wake_sequence);
+
+	worker_group_destroy(&s->group);
+
+	mpmc_queue_deinit(&s->tasks);
+	mpmc_queue_deinit(&s->ready);
+	mpmc_queue_deinit(&s->free_fibers);
+	os_release_memory(s->stack_memory, s->stack_memory_size);
+	dealloc(s->allocator, s->fibers);
+	dealloc(s->allocator, s->workers);
+	memset(s, 0, sizeof(*s));
+}
@@ -113,12 +113,15 @@ Gfx_Font *load_font_from_disk(string path, Allocator allocator) {
 	
 	if (!read_ok) return 0;
 	
-	third_party_allocator = allocator;
-	
 	stbtt_fontinfo stbtt_handle;
+	Third_Party_Scope scope = third_party_scope_begin(allocator);
 	int result = stbtt_InitFont(&stbtt_handle, font_data.data, stbtt_GetFontOffsetForIndex(font_data.data, 0));
+	third_party_scope_end(scope);
 	
-	if (result == 0) return 0;
+	if (result == 0) {
+		dealloc_string(allocator, font_data);
+		return 0;
+	}
 	
 	Gfx_Font *font = alloc(allocator, sizeof(Gfx_Font));
 	memset(font, 0, sizeof(Gfx_Font));
@@ -126,13 +129,11 @@ Gfx_Font *load_font_from_disk(string path, Allocator allocator) {
 	font->raw_font_data = font_data;
 	font->allocator = allocator;
 	
-	third_party_allocator = ZERO(Allocator);
-	
 	return font;
 }
 void destroy_font(Gfx_Font *font) {
 
-	third_party_allocator = font->allocator;
+	Third_Party_Scope scope = third_party_scope_begin(font->allocator);
 
 	for (u64 i = 0; i < MAX_FONT_HEIGHT; i++) {
 		Gfx_Font_Variation *variation = &font->variations[i];
@@ -151,7 +152,7 @@ void destroy_font(Gfx_Font *font) {
 	dealloc_string(font->allocator, font->raw_font_data);
 	dealloc(font->allocator, font);
 	
-	third_party_allocator = ZERO(Allocator);
+	third_party_scope_end(scope);
 }
 
 void font_variation_init(Gfx_Font_Variation *variation, Gfx_Font *font, u32 font_height) {
@@ -214,7 +215,8 @@ void font_atlas_init(Gfx_Font_Atlas *atlas, Gfx_Font_Variation *variation, u32 f
 	u32 cursor_x = 0;
 	u32 cursor_y = 0;
 	
-	third_party_allocator = variation->font->allocator;
+	// This can happen lazily in the middle of walk_glyphs, so keep out of the caller's temp memory
+	Temp_Scope scope = temp_scope_begin();
 	// Used for flipping bitmaps
 	u8 *temp_row = (u8 *)talloc(variation->height);
 	for (u32 c = first_codepoint; c < first_codepoint + variation->codepoint_range_per_atlas; c++) {
@@ -222,6 +224,9 @@ void font_atlas_init(Gfx_Font_Atlas *atlas, Gfx_Font_Variation *variation, u32 f
 		Gfx_Glyph *glyph = &atlas->glyphs[i];
 		glyph->codepoint = c;
 		
+		// Glyph bitmaps and rasterizer temporaries are gone after the glyph is copied to the atlas
+		Third_Party_Scope glyph_scope = third_party_scope_begin(get_third_party_scratch_allocator());
+		
 		int w, h, x, y;
 		void *bitmap = stbtt_GetCodepointBitmap(&stbtt_handle, variation->scale, variation->scale, (int)c, &w, &h, &x, &y);
 		
@@ -235,9 +240,10 @@ void font_atlas_init(Gfx_Font_Atlas *atlas, Gfx_Font_Variation *variation, u32 f
 			for (int row = 0; row < h; ++row) {
                 gfx_set_image_data(atlas->image, cursor_x, cursor_y + (h - 1 - row), w, 1, bitmap + (row * w));
             }
-			stbtt_FreeBitmap(bitmap, 0);
 		}
 		
+		third_party_scope_end(glyph_scope);
+		
 		glyph->xoffset = (float)x;
 		glyph->yoffset = variation->height - (float)y - (float)h - variation->metrics.max_ascent+variation->metrics.max_descent;  // Adjusted yoffset for bottom-up rendering
 		glyph->width   = (float)w;
@@ -257,7 +263,7 @@ void font_atlas_init(Gfx_Font_Atlas *atlas, Gfx_Font_Variation *variation, u32 f
 		cursor_x += w;
 	}
 	
-	third_party_allocator = ZERO(Allocator);
+	temp_scope_end(scope);
 }
 
 void render_atlas_if_not_yet_rendered(Gfx_Font *font, u32 font_height, u32 codepoint) {
@@ -63,6 +63,21 @@ u64 d3d11_cbuffer_size = 0;
 Draw_Quad *sort_quad_buffer = 0;
 u64 sort_quad_buffer_size = 0;
 
+#if ENABLE_RENDER_THREAD
+// The render thread draws and presents d3d11_render_frame while the game fills draw_frame.
+// gfx_update waits for the previous frame to be done, then swaps the two and lets it go.
+Thread d3d11_render_thread;
+Draw_Frame d3d11_render_frame;
+Binary_Semaphore d3d11_render_frame_ready; // Signaled by gfx_update
+Binary_Semaphore d3d11_render_frame_done;  // Signaled by the render thread
+// The immediate context isn't thread safe. The render thread holds this while it draws and
+// presents, anything else that touches d3d11_context while it might be running takes it too.
+Fast_Mutex d3d11_context_lock;
+// draw_frame.cbuffer points at the game's memory, which it might change during the next frame
+void *d3d11_render_cbuffer = 0;
+u64 d3d11_render_cbuffer_size = 0;
+#endif
+
 const char* d3d11_stringify_category(D3D11_MESSAGE_CATEGORY category) {
     switch (category) {
     case D3D11_MESSAGE_CATEGORY_APPLICATION_DEFINED: return "Application Defined";
@@ -555,11 +570,15 @@ void gfx_init() {
 	
 	assert(ok, "Failed compiling default shader");
 
+#if ENABLE_RENDER_THREAD
+	d3d11_render_thread_init();
+#endif
+
 	log_info("D3D11 init done");
 	
 }
 
-void d3d11_draw_call(int number_of_rendered_quads, ID3D11ShaderResourceView **textures, u64 num_textures) {
+void d3d11_draw_call(Draw_Frame *frame, int number_of_rendered_quads, ID3D11ShaderResourceView **textures, u64 num_textures) {
 	ID3D11DeviceContext_OMSetBlendState(d3d11_context, d3d11_blend_state, 0, 0xffffffff);
 	ID3D11DeviceContext_OMSetRenderTargets(d3d11_context, 1, &d3d11_window_render_target_view, 0); 
 	ID3D11DeviceContext_RSSetState(d3d11_context, d3d11_rasterizer);
@@ -579,7 +598,7 @@ void d3d11_draw_call(int number_of_rendered_quads, ID3D11ShaderResourceView **te
     ID3D11DeviceContext_VSSetShader(d3d11_context, d3d11_vertex_shader_for_2d, NULL, 0);
     ID3D11DeviceContext_PSSetShader(d3d11_context, d3d11_fragment_shader_for_2d, NULL, 0);
     
-	if (draw_frame.cbuffer && d3d11_cbuffer && d3d11_cbuffer_size) {
+	if (frame->cbuffer && d3d11_cbuffer && d3d11_cbuffer_size) {
 		D3D11_MAPPED_SUBRESOURCE cbuffer_mapping;
 		ID3D11DeviceContext_Map(
 			d3d11_context, 
@@ -589,7 +608,7 @@ void d3d11_draw_call(int number_of_rendered_quads, ID3D11ShaderResourceView **te
 			0, 
 			&cbuffer_mapping
 		);
-		memcpy(cbuffer_mapping.pData, draw_frame.cbuffer, d3d11_cbuffer_size);
+		memcpy(cbuffer_mapping.pData, frame->cbuffer, d3d11_cbuffer_size);
 		ID3D11DeviceContext_Unmap(d3d11_context, (ID3D11Resource*)d3d11_cbuffer, 0);
 		
 		ID3D11DeviceContext_PSSetConstantBuffers(d3d11_context, 0, 1, &d3d11_cbuffer);
@@ -604,15 +623,19 @@ void d3d11_draw_call(int number_of_rendered_quads, ID3D11ShaderResourceView **te
     ID3D11DeviceContext_Draw(d3d11_context, number_of_rendered_quads * 6, 0);
 }
 
-void d3d11_process_draw_frame() {
+void d3d11_process_draw_frame(Draw_Frame *frame) {
 
 	HRESULT hr;
 	
 	ID3D11DeviceContext_ClearRenderTargetView(d3d11_context, d3d11_window_render_target_view, (float*)&window.clear_color);
 	
-	if (!draw_frame.quad_buffer) return;
+	if (!frame->quad_buffer) {
+		// Still reset, with the render thread this frame goes back to the game
+		reset_draw_frame(frame);
+		return;
+	}
 
-	u64 number_of_quads = growing_array_get_valid_count(draw_frame.quad_buffer);
+	u64 number_of_quads = growing_array_get_valid_count(frame->quad_buffer);
 	
 	///
 	// Maybe grow quad vbo
@@ -633,7 +656,7 @@ void d3d11_process_draw_frame() {
 		assert(SUCCEEDED(hr), "CreateBuffer failed");
 		d3d11_quad_vbo_size = new_size;
 		
-		d3d11_staging_quad_buffer = alloc(get_heap_allocator(), d3d11_quad_vbo_size);
+		d3d11_staging_quad_buffer = alloc_uninitialized(get_heap_allocator(), d3d11_quad_vbo_size);
 		assert((u64)d3d11_staging_quad_buffer%16 == 0);
 		
 		log_verbose("Grew quad vbo to %d bytes.", d3d11_quad_vbo_size);
@@ -656,19 +679,19 @@ void d3d11_process_draw_frame() {
 		
 		
 		tm_scope("Quad processing") {
-			if (draw_frame.enable_z_sorting) tm_scope("Z sorting") {
+			if (frame->enable_z_sorting) tm_scope("Z sorting") {
 				if (!sort_quad_buffer || (sort_quad_buffer_size < number_of_quads*sizeof(Draw_Quad))) {
 					// #Memory #Heapalloc
 					if (sort_quad_buffer) dealloc(get_heap_allocator(), sort_quad_buffer);
-					sort_quad_buffer = alloc(get_heap_allocator(), number_of_quads*sizeof(Draw_Quad));
+					sort_quad_buffer = alloc_uninitialized(get_heap_allocator(), number_of_quads*sizeof(Draw_Quad));
 					sort_quad_buffer_size = number_of_quads*sizeof(Draw_Quad);
 				}
-				radix_sort(draw_frame.quad_buffer, sort_quad_buffer, number_of_quads, sizeof(Draw_Quad), offsetof(Draw_Quad, z), MAX_Z_BITS);
+				radix_sort(frame->quad_buffer, sort_quad_buffer, number_of_quads, sizeof(Draw_Quad), offsetof(Draw_Quad, z), MAX_Z_BITS);
 			}
 		
 			for (u64 i = 0; i < number_of_quads; i++)  {
 				
-				Draw_Quad *q = &draw_frame.quad_buffer[i];
+				Draw_Quad *q = &frame->quad_buffer[i];
 				
 				assert(q->z <= MAX_Z, "Z is too high. Z is %d, Max is %d.", q->z, MAX_Z);
 				assert(q->z >= (-MAX_Z+1), "Z is too low. Z is %d, Min is %d.", q->z, -MAX_Z+1);
@@ -695,7 +718,7 @@ void d3d11_process_draw_frame() {
 								ID3D11DeviceContext_Map(d3d11_context, (ID3D11Resource*)d3d11_quad_vbo, 0, D3D11_MAP_WRITE_DISCARD, 0, &buffer_mapping);
 								memcpy(buffer_mapping.pData, d3d11_staging_quad_buffer, number_of_rendered_quads*sizeof(D3D11_Vertex)*6);
 								ID3D11DeviceContext_Unmap(d3d11_context, (ID3D11Resource*)d3d11_quad_vbo, 0);
-								d3d11_draw_call(number_of_rendered_quads, textures, num_textures);
+								d3d11_draw_call(frame, number_of_rendered_quads, textures, num_textures);
 								head = (D3D11_Vertex*)d3d11_staging_quad_buffer;
 								num_textures = 0;
 								texture_index = 0;
@@ -844,20 +867,19 @@ void d3d11_process_draw_frame() {
 		
 		///
 		// Draw call
-		tm_scope("Draw call") d3d11_draw_call(number_of_rendered_quads, textures, num_textures);
+		tm_scope("Draw call") d3d11_draw_call(frame, number_of_rendered_quads, textures, num_textures);
     }
     
-    reset_draw_frame(&draw_frame);
+    reset_draw_frame(frame);
 }
 
-void gfx_update() {
-	if (window.should_close) return;
-	
-	
+void d3d11_present() {
+	tm_scope("Present") {
+		IDXGISwapChain1_Present(d3d11_swap_chain, window.enable_vsync, window.enable_vsync ? 0 : DXGI_PRESENT_ALLOW_TEARING);
+	}
+}
 
-	HRESULT hr;
-	///
-	// Maybe resize swap chain
+void d3d11_maybe_resize_swapchain() {
 	RECT client_rect;
 	bool ok = GetClientRect(window._os_handle, &client_rect);
 	assert(ok, "GetClientRect failed with error code %lu", GetLastError());
@@ -866,18 +888,91 @@ void gfx_update() {
 	if (window_width != d3d11_swap_chain_width || window_height != d3d11_swap_chain_height) {
 		d3d11_update_swapchain();
 	}
+}
 
-	d3d11_process_draw_frame();
+#if ENABLE_RENDER_THREAD
 
-	tm_scope("Present") {
-		IDXGISwapChain1_Present(d3d11_swap_chain, window.enable_vsync, window.enable_vsync ? 0 : DXGI_PRESENT_ALLOW_TEARING);
+void d3d11_render_thread_proc(Thread *t) {
+	while (true) {
+		binary_semaphore_wait(&d3d11_render_frame_ready);
+		
+		fast_mutex_acquire_or_wait(&d3d11_context_lock);
+		d3d11_process_draw_frame(&d3d11_render_frame);
+		d3d11_present();
+		fast_mutex_release(&d3d11_context_lock);
+		
+		binary_semaphore_signal(&d3d11_render_frame_done);
 	}
+}
+
+void d3d11_render_thread_init() {
+	fast_mutex_init(&d3d11_context_lock);
+	binary_semaphore_init(&d3d11_render_frame_ready, false);
+	binary_semaphore_init(&d3d11_render_frame_done, true); // No frame in flight yet
+	reset_draw_frame(&d3d11_render_frame);
 	
+	os_thread_init(&d3d11_render_thread, d3d11_render_thread_proc);
+	os_thread_start(&d3d11_render_thread);
+}
+
+// Returns when the render thread isn't working on a frame. It can't start another one until
+// the next gfx_update.
+void d3d11_wait_for_render_thread() {
+	binary_semaphore_wait(&d3d11_render_frame_done);
+	binary_semaphore_signal(&d3d11_render_frame_done);
+}
+
+#endif // ENABLE_RENDER_THREAD
+
+void gfx_update() {
+	if (window.should_close) return;
+
+#if ENABLE_RENDER_THREAD
+
+	// Never more than one frame ahead of the render thread
+	tm_scope("Wait for render thread") {
+		binary_semaphore_wait(&d3d11_render_frame_done);
+	}
+	
+	// The render thread is idle until we signal it so we can use the context. Resizing happens
+	// here and not on the render thread since DXGI might need this thread to pump messages.
+	d3d11_maybe_resize_swapchain();
 	
 #if CONFIGURATION == DEBUG
 	d3d11_output_debug_messages();
 #endif
+
+	// The frame that was just rendered was reset by d3d11_process_draw_frame, so the game
+	// gets a fresh one with its arena intact.
+	draw_frame_swap(&draw_frame, &d3d11_render_frame);
+	
+	// Frames are always reset before they go back to the game, so the cbuffer should be the
+	// game's. Don't copy our own copy onto itself (or from it after reallocating it) if not.
+	if (d3d11_render_frame.cbuffer && d3d11_render_frame.cbuffer != d3d11_render_cbuffer && d3d11_cbuffer_size) {
+		if (d3d11_render_cbuffer_size < d3d11_cbuffer_size) {
+			if (d3d11_render_cbuffer) dealloc(get_heap_allocator(), d3d11_render_cbuffer);
+			d3d11_render_cbuffer = alloc(get_heap_allocator(), d3d11_cbuffer_size);
+			d3d11_render_cbuffer_size = d3d11_cbuffer_size;
+		}
+		memcpy(d3d11_render_cbuffer, d3d11_render_frame.cbuffer, d3d11_cbuffer_size);
+		d3d11_render_frame.cbuffer = d3d11_render_cbuffer;
+	}
+	
+	binary_semaphore_signal(&d3d11_render_frame_ready);
 	
+#else
+
+	d3d11_maybe_resize_swapchain();
+
+	d3d11_process_draw_frame(&draw_frame);
+
+	d3d11_present();
+	
+#if CONFIGURATION == DEBUG
+	d3d11_output_debug_messages();
+#endif
+
+#endif // ENABLE_RENDER_THREAD
 }
 
 
@@ -886,8 +981,7 @@ void gfx_init_image(Gfx_Image *image, void *initial_data) {
 	void *data = initial_data;
     if (!initial_data){
     	// #Incomplete 8 bit width assumed
-    	data = alloc(image->allocator, image->width*image->height*image->channels);
-    	memset(data, 0, image->width*image->height*image->channels);
+    	data = alloc_zeroed(image->allocator, image->width*image->height*image->channels);
     }
     
 	assert(image->channels > 0 && image->channels <= 4 && image->channels != 3, "Only 1, 2 or 4 channels allowed on images. Got %d", image->channels);
@@ -951,9 +1045,19 @@ void gfx_set_image_data(Gfx_Image *image, u32 x, u32 y, u32 w, u32 h, void *data
     destBox.back = 1;
 
 	// #Incomplete bit-width 8 assumed
+#if ENABLE_RENDER_THREAD
+	fast_mutex_acquire_or_wait(&d3d11_context_lock);
+#endif
     ID3D11DeviceContext_UpdateSubresource(d3d11_context, (ID3D11Resource*)texture, 0, &destBox, data, w * image->channels, 0);
+#if ENABLE_RENDER_THREAD
+	fast_mutex_release(&d3d11_context_lock);
+#endif
 }
 void gfx_deinit_image(Gfx_Image *image) {
+#if ENABLE_RENDER_THREAD
+	// The frame in flight might still draw it
+	d3d11_wait_for_render_thread();
+#endif
 	ID3D11ShaderResourceView *view = image->gfx_handle;
 	ID3D11Resource *resource = 0;
 	ID3D11ShaderResourceView_GetResource(view, &resource);
@@ -976,6 +1080,11 @@ shader_recompile_with_extension(string ext_source, u64 cbuffer_size) {
 	string source = string_replace_all(STR(d3d11_image_shader_source), STR("$INJECT_PIXEL_POST_PROCESS"), ext_source, get_temporary_allocator());
 	
 	
+#if ENABLE_RENDER_THREAD
+	// The shaders and cbuffer are swapped out under the render thread otherwise
+	d3d11_wait_for_render_thread();
+#endif
+	
 	if (!d3d11_compile_shader(source)) return false;
 	
 	u64 aligned_cbuffer_size = (max(cbuffer_size, 16) + 16) & ~(15);
@@ -63,10 +63,12 @@ shader_recompile_with_extension(string ext_source, u64 cbuffer_size);
 // initial_data can be null to leave image data uninitialized
 Gfx_Image *
 make_image(u32 width, u32 height, u32 channels, void *initial_data, Allocator allocator) {
-	Gfx_Image *image = alloc(allocator, sizeof(Gfx_Image) + width*height*channels);
-	
 	assert(channels > 0 && channels <= 4, "Only 1, 2, 3 or 4 channels allowed on images. Got %d", channels);
 	
+	// Only the header needs clearing, pixels are uninitialized unless initial_data is given
+	Gfx_Image *image = alloc_uninitialized(allocator, sizeof(Gfx_Image) + width*height*channels);
+	*image = ZERO(Gfx_Image);
+	
     image->width = width;
     image->height = height;
     image->gfx_handle = GFX_INVALID_HANDLE;  // This is handled in gfx
@@ -87,12 +89,15 @@ load_image_from_disk(string path, Allocator allocator) {
     Gfx_Image *image = alloc(allocator, sizeof(Gfx_Image));
     
     int width, height, channels;
-    stbi_set_flip_vertically_on_load(1);
-    third_party_allocator = allocator;
+    stbi_set_flip_vertically_on_load_thread(1);
+    // The decoded pixels are only needed until they're uploaded, so everything stb_image
+    // allocates goes in the scratch arena.
+    Third_Party_Scope scope = third_party_scope_begin(get_third_party_scratch_allocator());
     unsigned char* stb_data = stbi_load_from_memory(png.data, png.count, &width, &height, &channels, STBI_rgb_alpha);
     
     
     if (!stb_data) {
+        third_party_scope_end(scope);
         dealloc(allocator, image);
         dealloc_string(allocator, png);
         return 0;
@@ -108,9 +113,7 @@ load_image_from_disk(string path, Allocator allocator) {
     
     gfx_init_image(image, stb_data);
     
-    stbi_image_free(stb_data);
-    
-    third_party_allocator = ZERO(Allocator);
+    third_party_scope_end(scope);
 
     return image;
 }
@@ -7,8 +7,21 @@
 		void growing_array_init(void **array, u64 block_size_in_bytes, Allocator allocator);
 		void growing_array_deinit(void **array);
 		
-		void *growing_array_add_empty(void **array);
+		// How much the capacity is multiplied by when the array grows. Must be more than 1.
+		void growing_array_set_growth_factor(void **array, float32 growth_factor);
+		
+		void *growing_array_add_empty(void **array); // Zeroed with DO_ZERO_INITIALIZATION
+		void *growing_array_add_uninitialized(void **array);
 		void growing_array_add(void **array, void *item);
+		void growing_array_add_many(void **array, void *items, u64 count);
+		
+		// No signature check, and only calls out to grow when the array is full.
+		// For hot loops where the array is known to be valid.
+		void *growing_array_add_uninitialized_unchecked(void **array);
+		void growing_array_add_unchecked(void **array, void *item);
+		
+		void growing_array_insert_range(void **array, u64 index, void *items, u64 count);
+		void growing_array_remove_range(void **array, u64 index, u64 count);
 		
 		void growing_array_reserve(void **array, u64 count_to_reserve);
 		void growing_array_resize(void **array, u64 new_count);
@@ -16,18 +29,18 @@
 		void growing_array_clear(void **array);
 		
 		// Returns -1 if not found
-		s32  growing_array_find_index_from_left_by_pointer(void **array, void *p);
-		s32  growing_array_find_index_from_left_by_value(void **array, void *p);
+		s64  growing_array_find_index_from_left_by_pointer(void **array, void *p);
+		s64  growing_array_find_index_from_left_by_value(void **array, void *p);
 		
-		void growing_array_ordered_remove_by_index(void **array, u32 index);
-		void growing_array_unordered_remove_by_index(void **array, u32 index);
+		void growing_array_ordered_remove_by_index(void **array, u64 index);
+		void growing_array_unordered_remove_by_index(void **array, u64 index);
 		bool growing_array_ordered_remove_by_pointer(void **array, void *p);
 		bool growing_array_unordered_remove_by_pointer(void **array, void *p);
 		bool growing_array_ordered_remove_one_by_value(void **array, void *p);
 		bool growing_array_unordered_remove_one_by_value(void **array, void *p);
 		
-		u32  growing_array_get_valid_count(void *array);
-		u32  growing_array_get_allocated_count(void *array);
+		u64  growing_array_get_valid_count(void *array);
+		u64  growing_array_get_allocated_count(void *array);
 
 	Usage:
 	
@@ -44,6 +57,11 @@
 	    growing_array_reserve_count(&things, 690);
 	    growing_array_resize_count(&things, 69);
 	    
+	    // One reserve and one copy for the whole range
+	    growing_array_add_many(&things, more_things, more_things_count);
+	    growing_array_insert_range(&things, i, more_things, more_things_count);
+	    growing_array_remove_range(&things, i, count);
+	    
 	    // "Slow", but stuff in the array keeps the same order
 	    growing_array_ordered_remove_by_index(&things, i);
 	    
@@ -66,11 +84,16 @@
 
 #define GROWING_ARRAY_SIGNATURE 2224364215
 
+#ifndef GROWING_ARRAY_DEFAULT_GROWTH_FACTOR
+	#define GROWING_ARRAY_DEFAULT_GROWTH_FACTOR 2.0
+#endif
+
 typedef struct Growing_Array_Header {
 	u32 signature;
-    u32 valid_count;
-    u32 allocated_count;
-    u32 block_size_in_bytes;
+	float32 growth_factor;
+    u64 valid_count;
+    u64 allocated_count;
+    u64 block_size_in_bytes;
     Allocator allocator;
 } Growing_Array_Header;
 
@@ -87,12 +110,14 @@ growing_array_init_reserve(void **array, u64 block_size_in_bytes, u64 count_to_r
     count_to_reserve = get_next_power_of_two(count_to_reserve);
     u64 bytes_to_allocate = count_to_reserve*block_size_in_bytes + sizeof(Growing_Array_Header);
     
-    Growing_Array_Header *header = (Growing_Array_Header*)alloc(allocator, bytes_to_allocate);
+    // Items are initialized as they're added
+    Growing_Array_Header *header = (Growing_Array_Header*)alloc_uninitialized(allocator, bytes_to_allocate);
     
     header->allocator = allocator;
     header->block_size_in_bytes = block_size_in_bytes;
     header->valid_count = 0;
     header->allocated_count = count_to_reserve;
+    header->growth_factor = GROWING_ARRAY_DEFAULT_GROWTH_FACTOR;
     header->signature = GROWING_ARRAY_SIGNATURE;
     
     *array = header+1;
@@ -108,6 +133,14 @@ growing_array_deinit(void **array) {
     dealloc(header->allocator, header);
 }
 
+void
+growing_array_set_growth_factor(void **array, float32 growth_factor) {
+	assert(check_growing_array_signature(array), "Not a valid growing array");
+	assert(growth_factor > 1.0, "Growing array growth factor must be more than 1");
+    Growing_Array_Header *header = ((Growing_Array_Header*)*array) - 1;
+    header->growth_factor = growth_factor;
+}
+
 void
 growing_array_reserve(void **array, u64 count_to_reserve) {
 	assert(check_growing_array_signature(array), "Not a valid growing array");
@@ -116,22 +149,22 @@ growing_array_reserve(void **array, u64 count_to_reserve) {
     if (header->allocated_count >= count_to_reserve) return;
     
     u64 old_allocated_bytes = header->allocated_count*header->block_size_in_bytes+sizeof(Growing_Array_Header);
-    count_to_reserve = get_next_power_of_two(count_to_reserve);
-    u64 bytes_to_allocate = count_to_reserve*header->block_size_in_bytes+sizeof(Growing_Array_Header);
-    Growing_Array_Header *new_header = (Growing_Array_Header*)alloc(header->allocator, bytes_to_allocate);
     
-    memcpy(new_header, header, old_allocated_bytes);
+    // Grow by at least the growth factor so adding one at a time stays amortized O(1)
+    u64 grown_count = (u64)((float64)header->allocated_count*header->growth_factor);
+    count_to_reserve = max(count_to_reserve, grown_count);
     
+    u64 bytes_to_allocate = count_to_reserve*header->block_size_in_bytes+sizeof(Growing_Array_Header);
+    // Grows in place when the allocator can
+    Growing_Array_Header *new_header = (Growing_Array_Header*)reallocate_uninitialized(header->allocator, header, old_allocated_bytes, bytes_to_allocate);
     
     *array = new_header+1;
     
     new_header->allocated_count = count_to_reserve;
-    
-    dealloc(header->allocator, header);
 }
 
 void*
-growing_array_add_empty(void **array) {
+growing_array_add_uninitialized(void **array) {
 	assert(check_growing_array_signature(array), "Not a valid growing array");
     Growing_Array_Header *header = ((Growing_Array_Header*)*array) - 1;
     growing_array_reserve(array, header->valid_count+1);
@@ -145,19 +178,98 @@ growing_array_add_empty(void **array) {
     
     return item;
 }
+void*
+growing_array_add_empty(void **array) {
+    void *item = growing_array_add_uninitialized(array);
+#if DO_ZERO_INITIALIZATION
+    Growing_Array_Header *header = ((Growing_Array_Header*)*array) - 1;
+    memset(item, 0, header->block_size_in_bytes);
+#endif
+    return item;
+}
 void
 growing_array_add(void **array, void *item) {
 
-    void *new = growing_array_add_empty(array);
+    void *new = growing_array_add_uninitialized(array);
 
     Growing_Array_Header *header = ((Growing_Array_Header*)*array) - 1;
     
     memcpy(new, item, header->block_size_in_bytes);
 }
+void
+growing_array_add_many(void **array, void *items, u64 count) {
+	assert(check_growing_array_signature(array), "Not a valid growing array");
+    Growing_Array_Header *header = ((Growing_Array_Header*)*array) - 1;
+    growing_array_reserve(array, header->valid_count+count);
+    
+    header = ((Growing_Array_Header*)*array) - 1; 
+    
+    memcpy((u8*)*array + header->valid_count*header->block_size_in_bytes, items, count*header->block_size_in_bytes);
+    
+    header->valid_count += count;
+}
+
+inline void*
+growing_array_add_uninitialized_unchecked(void **array) {
+    Growing_Array_Header *header = ((Growing_Array_Header*)*array) - 1;
+    
+    if (header->valid_count == header->allocated_count) {
+    	growing_array_reserve(array, header->valid_count+1);
+    	header = ((Growing_Array_Header*)*array) - 1; 
+    }
+    
+    void *item = (u8*)*array + header->valid_count*header->block_size_in_bytes;
+    header->valid_count += 1;
+    
+    return item;
+}
+inline void
+growing_array_add_unchecked(void **array, void *item) {
+    void *new = growing_array_add_uninitialized_unchecked(array);
+    Growing_Array_Header *header = ((Growing_Array_Header*)*array) - 1;
+    memcpy(new, item, header->block_size_in_bytes);
+}
+
+void
+growing_array_insert_range(void **array, u64 index, void *items, u64 count) {
+	assert(check_growing_array_signature(array), "Not a valid growing array");
+    Growing_Array_Header *header = ((Growing_Array_Header*)*array) - 1;
+    assert(index <= header->valid_count, "Growing array index out of range");
+    growing_array_reserve(array, header->valid_count+count);
+    
+    header = ((Growing_Array_Header*)*array) - 1; 
+    
+    u64 block_size = header->block_size_in_bytes;
+    u8 *first = (u8*)*array + index*block_size;
+    
+    memmove(first + count*block_size, first, (header->valid_count-index)*block_size);
+    memcpy(first, items, count*block_size);
+    
+    header->valid_count += count;
+}
+void
+growing_array_remove_range(void **array, u64 index, u64 count) {
+	assert(check_growing_array_signature(array), "Not a valid growing array");
+    Growing_Array_Header *header = ((Growing_Array_Header*)*array) - 1;
+    assert(index <= header->valid_count && count <= header->valid_count-index, "Growing array range out of range");
+    
+    u64 block_size = header->block_size_in_bytes;
+    u8 *first = (u8*)*array + index*block_size;
+    
+    memmove(first, first + count*block_size, (header->valid_count-index-count)*block_size);
+    
+    header->valid_count -= count;
+}
 
 void growing_array_resize(void **array, u64 new_count) {
     growing_array_reserve(array, new_count);
     Growing_Array_Header *header = ((Growing_Array_Header*)*array) - 1;
+#if DO_ZERO_INITIALIZATION
+    if (new_count > header->valid_count) {
+        u8 *first_new = (u8*)*array + header->valid_count*header->block_size_in_bytes;
+        memset(first_new, 0, (new_count-header->valid_count)*header->block_size_in_bytes);
+    }
+#endif
     header->valid_count = new_count;
 }
 
@@ -175,7 +287,7 @@ void growing_array_clear(void **array) {
 }
 
 void 
-growing_array_ordered_remove_by_index(void **array, u32 index) {
+growing_array_ordered_remove_by_index(void **array, u64 index) {
 	assert(check_growing_array_signature(array), "Not a valid growing array");
     Growing_Array_Header *header = ((Growing_Array_Header*)*array) - 1;
     assert(index < header->valid_count, "Growing array index out of range");
@@ -187,7 +299,8 @@ growing_array_ordered_remove_by_index(void **array, u32 index) {
     
     u64 byte_index = header->block_size_in_bytes*index;
     
-    memcpy(
+    // The ranges overlap
+    memmove(
         (u8*)*array + byte_index, 
         (u8*)*array + byte_index + header->block_size_in_bytes,
         (header->valid_count-index-1)*header->block_size_in_bytes
@@ -195,7 +308,7 @@ growing_array_ordered_remove_by_index(void **array, u32 index) {
     header->valid_count -= 1;
 }
 void 
-growing_array_unordered_remove_by_index(void **array, u32 index) {
+growing_array_unordered_remove_by_index(void **array, u64 index) {
 	assert(check_growing_array_signature(array), "Not a valid growing array");
     Growing_Array_Header *header = ((Growing_Array_Header*)*array) - 1;
     assert(index < header->valid_count, "Growing array index out of range");
@@ -216,30 +329,66 @@ growing_array_unordered_remove_by_index(void **array, u32 index) {
     header->valid_count -= 1;
 }
 
-s32
+s64
 growing_array_find_index_from_left_by_pointer(void **array, void *p) {
 	assert(check_growing_array_signature(array), "Not a valid growing array");
     Growing_Array_Header *header = ((Growing_Array_Header*)*array) - 1;
     
-    for (u32 i = 0; i < header->valid_count; i++) {
-        void *next = (u8*)*array + i*header->block_size_in_bytes;
-        
-        if (next == p) {
-            return i;
-        }
-    }
-    return -1;
+    // Items are contiguous, so this is just arithmetic
+    u64 block_size = header->block_size_in_bytes;
+    u8 *first = (u8*)*array;
+    u8 *end = first + header->valid_count*block_size;
+    if ((u8*)p < first || (u8*)p >= end) return -1;
+    
+    u64 offset = (u64)((u8*)p - first);
+    if (offset % block_size != 0) return -1;
+    
+    return (s64)(offset/block_size);
 }
-s32
+s64
 growing_array_find_index_from_left_by_value(void **array, void *p) {
 	assert(check_growing_array_signature(array), "Not a valid growing array");
     Growing_Array_Header *header = ((Growing_Array_Header*)*array) - 1;
     
-    for (u32 i = 0; i < header->valid_count; i++) {
-        void *next = (u8*)*array + i*header->block_size_in_bytes;
+    u64 count = header->valid_count;
+    u64 block_size = header->block_size_in_bytes;
+    
+    // Compare the common sizes as integers rather than calling into bytes_match per item
+    switch (block_size) {
+    	case 1: {
+    		u8 v = *(u8*)p;
+    		u8 *items = (u8*)*array;
+    		for (u64 i = 0; i < count; i++) if (items[i] == v) return (s64)i;
+    		return -1;
+    	}
+    	case 2: {
+    		u16 v; memcpy(&v, p, 2);
+    		u16 *items = (u16*)*array;
+    		for (u64 i = 0; i < count; i++) if (items[i] == v) return (s64)i;
+    		return -1;
+    	}
+    	case 4: {
+    		u32 v; memcpy(&v, p, 4);
+    		u32 *items = (u32*)*array;
+    		for (u64 i = 0; i < count; i++) if (items[i] == v) return (s64)i;
+    		return -1;
+    	}
+    	case 8: {
+    		u64 v; memcpy(&v, p, 8);
+    		u64 *items = (u64*)*array;
+    		for (u64 i = 0; i < count; i++) if (items[i] == v) return (s64)i;
+    		return -1;
+    	}
+    	default: break;
+    }
+    
+    // Reject on the first byte before comparing the whole item
+    u8 first_byte = *(u8*)p;
+    for (u64 i = 0; i < count; i++) {
+        u8 *next = (u8*)*array + i*block_size;
         
-        if (bytes_match(next, p, header->block_size_in_bytes)) {
-            return i;
+        if (*next == first_byte && bytes_match(next, p, block_size)) {
+            return (s64)i;
         }
     }
     return -1;
@@ -247,49 +396,41 @@ growing_array_find_index_from_left_by_value(void **array, void *p) {
 
 bool
 growing_array_ordered_remove_by_pointer(void **array, void *p) {
-    Growing_Array_Header *header = ((Growing_Array_Header*)*array) - 1;
-    
-    s32 i = growing_array_find_index_from_left_by_pointer(array, p);
+    s64 i = growing_array_find_index_from_left_by_pointer(array, p);
     
     if (i < 0) return false;
     
-    growing_array_ordered_remove_by_index(array, i);
+    growing_array_ordered_remove_by_index(array, (u64)i);
     
     return true;
 }
 bool 
 growing_array_unordered_remove_by_pointer(void **array, void *p) {
-    Growing_Array_Header *header = ((Growing_Array_Header*)*array) - 1;
-    
-    s32 i = growing_array_find_index_from_left_by_pointer(array, p);
+    s64 i = growing_array_find_index_from_left_by_pointer(array, p);
     
     if (i < 0) return false;
     
-    growing_array_unordered_remove_by_index(array, i);
+    growing_array_unordered_remove_by_index(array, (u64)i);
     
     return true;
 }
 bool 
 growing_array_ordered_remove_one_by_value(void **array, void *p) {
-    Growing_Array_Header *header = ((Growing_Array_Header*)*array) - 1;
-    
-    s32 i = growing_array_find_index_from_left_by_value(array, p);
+    s64 i = growing_array_find_index_from_left_by_value(array, p);
     
     if (i < 0) return false;
     
-    growing_array_ordered_remove_by_index(array, i);
+    growing_array_ordered_remove_by_index(array, (u64)i);
     
     return true;
 }
 bool 
 growing_array_unordered_remove_one_by_value(void **array, void *p) {
-    Growing_Array_Header *header = ((Growing_Array_Header*)*array) - 1;
-    
-    s32 i = growing_array_find_index_from_left_by_value(array, p);
+    s64 i = growing_array_find_index_from_left_by_value(array, p);
     
     if (i < 0) return false;
     
-    growing_array_unordered_remove_by_index(array, i);
+    growing_array_unordered_remove_by_index(array, (u64)i);
     
     return true;
 }
@@ -298,15 +439,15 @@ growing_array_unordered_remove_one_by_value(void **array, void *p) {
 // s32 growing_array_ordered_remove_one_by_value(void **array, void *p)
 // s32 growing_array_unordered_remove_one_by_value(void **array, void *p)
 
-u32
+u64
 growing_array_get_valid_count(void *array) {
 	assert(check_growing_array_signature(&array), "Not a valid growing array");
     Growing_Array_Header *header = ((Growing_Array_Header*)array) - 1;
     return header->valid_count;
 }
-u32
+u64
 growing_array_get_allocated_count(void *array) {
 	assert(check_growing_array_signature(&array), "Not a valid growing array");
     Growing_Array_Header *header = ((Growing_Array_Header*)array) - 1;
     return header->allocated_count;
-}
\ No newline at end of file
+}
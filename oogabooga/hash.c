@@ -6,6 +6,10 @@
 #define PRIME64_4 9650029242287828579ULL
 #define PRIME64_5 2870177450012600261ULL
 
+#define PRIME32_1 0x9E3779B1U
+#define PRIME32_2 0x85EBCA77U
+#define PRIME32_3 0xC2B2AE3DU
+
 static inline u64 xx_hash(u64 x) {
     u64 h64 = PRIME64_5 + 8;
     h64 += x * PRIME64_3;
@@ -18,32 +22,197 @@ static inline u64 xx_hash(u64 x) {
     return h64;
 }
 
-static inline u64 city_hash(string s) {
-    const u64 k = 0x9ddfea08eb382d69ULL;
-    u64 a = s.count;
-    u64 b = s.count * 5;
-    u64 c = 9;
-    u64 d = b;
-
-    if (s.count <= 16) {
-        memcpy(&a, s.data, sizeof(u64));
-        memcpy(&b, s.data + s.count - 8, sizeof(u64));
-    } else {
-        memcpy(&a, s.data, sizeof(u64));
-        memcpy(&b, s.data + 8, sizeof(u64));
-        memcpy(&c, s.data + s.count - 8, sizeof(u64));
-        memcpy(&d, s.data + s.count - 16, sizeof(u64));
-    }
+///
+// Byte hashing
+//
+// Inputs under HASH_LONG_INPUT_SIZE go through wyhash (final version 4, public domain, by
+// Wang Yi). It reads short inputs with overlapping 4 byte loads and never reads past the end.
+// Longer inputs are consumed in 64 byte stripes by an xxh3 style accumulator, which is 8
+// independent lanes of 32x32->64 multiplies, so it maps straight onto AVX2. The scalar and AVX2
+// accumulators produce the same hash.
+
+#ifndef HASH_LONG_INPUT_SIZE
+	#define HASH_LONG_INPUT_SIZE 1024
+#endif
+
+#define HASH_STRIPE_SIZE 64
+// Accumulators are scrambled once per block so the lanes don't just sum up over long inputs
+#define HASH_STRIPES_PER_BLOCK 16
+
+static const u64 _wyp[4] = {
+	0x2d358dccaa6c78a5ULL, 0x8bb84b93962eacc9ULL, 0x4b33a62ed433d4a3ULL, 0x4d5a2da51de1aa47ULL
+};
+static const u64 _hash_secret[8] = {
+	0xbe4ba423396cfeb8ULL, 0x1cad21f72c81017cULL, 0xdb979083e96dd4deULL, 0x1f67b3b7a4a44072ULL,
+	0x78e5c0cc4ee679cbULL, 0x2172ffcc7dd05a82ULL, 0x8e2443f7744608b8ULL, 0x4c263a81e69035e0ULL,
+};
+
+static inline void _wymum(u64 *a, u64 *b) {
+#if COMPILER_MSVC
+	u64 hi;
+	u64 lo = _umul128(*a, *b, &hi);
+	*a = lo;
+	*b = hi;
+#else
+	__uint128_t r = (__uint128_t)*a * *b;
+	*a = (u64)r;
+	*b = (u64)(r >> 64);
+#endif
+}
+static inline u64 _wymix(u64 a, u64 b) {
+	_wymum(&a, &b);
+	return a^b;
+}
+static inline u64 _hash_read_64(const u8 *p) { u64 v; memcpy(&v, p, 8); return v; }
+static inline u64 _hash_read_32(const u8 *p) { u32 v; memcpy(&v, p, 4); return v; }
+// 1 to 3 bytes, reads the first, middle and last byte
+static inline u64 _hash_read_small(const u8 *p, u64 k) {
+	return (((u64)p[0]) << 16) | (((u64)p[k >> 1]) << 8) | p[k - 1];
+}
+
+static inline u64 wy_hash(const void *data, u64 size, u64 seed) {
+	const u8 *p = (const u8*)data;
+	seed ^= _wymix(seed ^ _wyp[0], _wyp[1]);
+	u64 a, b;
+	
+	if (size <= 16) {
+		if (size >= 4) {
+			a = (_hash_read_32(p) << 32) | _hash_read_32(p + ((size >> 3) << 2));
+			b = (_hash_read_32(p + size - 4) << 32) | _hash_read_32(p + size - 4 - ((size >> 3) << 2));
+		} else if (size > 0) {
+			a = _hash_read_small(p, size);
+			b = 0;
+		} else {
+			a = b = 0;
+		}
+	} else {
+		u64 i = size;
+		if (i > 48) {
+			u64 see1 = seed, see2 = seed;
+			do {
+				seed = _wymix(_hash_read_64(p)      ^ _wyp[1], _hash_read_64(p + 8)  ^ seed);
+				see1 = _wymix(_hash_read_64(p + 16) ^ _wyp[2], _hash_read_64(p + 24) ^ see1);
+				see2 = _wymix(_hash_read_64(p + 32) ^ _wyp[3], _hash_read_64(p + 40) ^ see2);
+				p += 48; i -= 48;
+			} while (i > 48);
+			seed ^= see1 ^ see2;
+		}
+		while (i > 16) {
+			seed = _wymix(_hash_read_64(p) ^ _wyp[1], _hash_read_64(p + 8) ^ seed);
+			i -= 16; p += 16;
+		}
+		a = _hash_read_64(p + i - 16);
+		b = _hash_read_64(p + i - 8);
+	}
+	
+	a ^= _wyp[1];
+	b ^= seed;
+	_wymum(&a, &b);
+	return _wymix(a ^ _wyp[0] ^ size, b ^ _wyp[1]);
+}
+
+void _hash_accumulate_stripes_scalar(u64 *acc, const u8 *p, u64 stripe_count, const u64 *key) {
+	for (u64 s = 0; s < stripe_count; s++) {
+		const u8 *stripe = p + s*HASH_STRIPE_SIZE;
+		for (u64 i = 0; i < 8; i++) {
+			u64 d  = _hash_read_64(stripe + i*8);
+			u64 dk = d ^ key[i];
+			acc[i ^ 1] += d;
+			acc[i]     += (dk & 0xFFFFFFFF) * (dk >> 32);
+		}
+	}
+}
+void _hash_scramble_scalar(u64 *acc, const u64 *key) {
+	for (u64 i = 0; i < 8; i++) {
+		u64 a = acc[i];
+		a ^= a >> 47;
+		a ^= key[i];
+		acc[i] = a * PRIME32_1;
+	}
+}
+
+#if ENABLE_SIMD && SIMD_ENABLE_AVX2
+void _hash_accumulate_stripes_avx2(u64 *acc, const u8 *p, u64 stripe_count, const u64 *key) {
+	__m256i acc0 = _mm256_loadu_si256((const __m256i*)acc);
+	__m256i acc1 = _mm256_loadu_si256((const __m256i*)(acc + 4));
+	__m256i key0 = _mm256_loadu_si256((const __m256i*)key);
+	__m256i key1 = _mm256_loadu_si256((const __m256i*)(key + 4));
+	
+	for (u64 s = 0; s < stripe_count; s++) {
+		const u8 *stripe = p + s*HASH_STRIPE_SIZE;
+		__m256i d0 = _mm256_loadu_si256((const __m256i*)stripe);
+		__m256i d1 = _mm256_loadu_si256((const __m256i*)(stripe + 32));
+		__m256i dk0 = _mm256_xor_si256(d0, key0);
+		__m256i dk1 = _mm256_xor_si256(d1, key1);
+		// low 32 bits times high 32 bits of each 64 bit lane
+		__m256i product0 = _mm256_mul_epu32(dk0, _mm256_srli_epi64(dk0, 32));
+		__m256i product1 = _mm256_mul_epu32(dk1, _mm256_srli_epi64(dk1, 32));
+		// Swap neighbouring 64 bit lanes, same as acc[i^1] += d in the scalar version
+		__m256i swapped0 = _mm256_shuffle_epi32(d0, _MM_SHUFFLE(1, 0, 3, 2));
+		__m256i swapped1 = _mm256_shuffle_epi32(d1, _MM_SHUFFLE(1, 0, 3, 2));
+		acc0 = _mm256_add_epi64(acc0, _mm256_add_epi64(product0, swapped0));
+		acc1 = _mm256_add_epi64(acc1, _mm256_add_epi64(product1, swapped1));
+	}
+	
+	_mm256_storeu_si256((__m256i*)acc, acc0);
+	_mm256_storeu_si256((__m256i*)(acc + 4), acc1);
+}
+void _hash_scramble_avx2(u64 *acc, const u64 *key) {
+	__m256i prime = _mm256_set1_epi32((int)PRIME32_1);
+	for (u64 i = 0; i < 8; i += 4) {
+		__m256i a = _mm256_loadu_si256((const __m256i*)(acc + i));
+		__m256i k = _mm256_loadu_si256((const __m256i*)(key + i));
+		a = _mm256_xor_si256(a, _mm256_srli_epi64(a, 47));
+		a = _mm256_xor_si256(a, k);
+		// 64 bit times 32 bit, there is no 64 bit multiply in AVX2
+		__m256i lo = _mm256_mul_epu32(a, prime);
+		__m256i hi = _mm256_mul_epu32(_mm256_srli_epi64(a, 32), prime);
+		a = _mm256_add_epi64(lo, _mm256_slli_epi64(hi, 32));
+		_mm256_storeu_si256((__m256i*)(acc + i), a);
+	}
+}
+	#define _hash_accumulate_stripes _hash_accumulate_stripes_avx2
+	#define _hash_scramble _hash_scramble_avx2
+#else
+	#define _hash_accumulate_stripes _hash_accumulate_stripes_scalar
+	#define _hash_scramble _hash_scramble_scalar
+#endif
 
-    a += b;
-    a = (a << 43) | (a >> (64 - 43));
-    a += c;
-    a = a * 5 + 0x52dce729;
-    d ^= a;
-    d = (d << 44) | (d >> (64 - 44));
-    d += b;
+u64 _hash_long(const void *data, u64 size, u64 seed) {
+	const u8 *p = (const u8*)data;
+	
+	u64 key[8];
+	for (u64 i = 0; i < 8; i++) key[i] = (i & 1) ? _hash_secret[i] - seed : _hash_secret[i] + seed;
+	
+	u64 acc[8] = {
+		PRIME32_3, PRIME64_1, PRIME64_2, PRIME64_3, PRIME64_4, PRIME32_2, PRIME64_5, PRIME32_1
+	};
+	
+	// Always leave 1 to 64 bytes for the tail
+	u64 stripe_count = (size - 1) / HASH_STRIPE_SIZE;
+	u64 block_count  = stripe_count / HASH_STRIPES_PER_BLOCK;
+	for (u64 b = 0; b < block_count; b++) {
+		_hash_accumulate_stripes(acc, p, HASH_STRIPES_PER_BLOCK, key);
+		_hash_scramble(acc, key);
+		p += HASH_STRIPES_PER_BLOCK*HASH_STRIPE_SIZE;
+	}
+	u64 remaining_stripes = stripe_count - block_count*HASH_STRIPES_PER_BLOCK;
+	_hash_accumulate_stripes(acc, p, remaining_stripes, key);
+	p += remaining_stripes*HASH_STRIPE_SIZE;
+	
+	u64 h = size * PRIME64_1;
+	for (u64 i = 0; i < 8; i += 2) h += _wymix(acc[i] ^ key[i], acc[i+1] ^ key[i+1]);
+	
+	u64 tail_size = size - (u64)(p - (const u8*)data);
+	return wy_hash(p, tail_size, h);
+}
 
-    return d * k;
+u64 hash_bytes_seeded(const void *data, u64 size, u64 seed) {
+	if (size >= HASH_LONG_INPUT_SIZE) return _hash_long(data, size, seed);
+	return wy_hash(data, size, seed);
+}
+u64 hash_bytes(const void *data, u64 size) {
+	return hash_bytes_seeded(data, size, 0);
 }
 
 u64 djb2_hash(string s) {
@@ -55,8 +224,10 @@ u64 djb2_hash(string s) {
 }
 
 u64 string_get_hash(string s) {
-    if (s.count > 32) return djb2_hash(s);
-    return city_hash(s);
+    return hash_bytes_seeded(s.data, s.count, 0);
+}
+u64 string_get_hash_seeded(string s, u64 seed) {
+    return hash_bytes_seeded(s.data, s.count, seed);
 }
 u64 pointer_get_hash(void *p) {
 	return xx_hash((u64)p);
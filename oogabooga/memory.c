@@ -25,6 +25,14 @@ void* initialization_allocator_proc(u64 size, void *p, Allocator_Message message
 			return p;
 			break;
 		}
+		case ALLOCATOR_ALLOCATE_ALIGNED: {
+			init_memory_head = (u8*)align_next((u64)init_memory_head, (u64)p);
+			return initialization_allocator_proc(size, 0, ALLOCATOR_ALLOCATE, data);
+		}
+		case ALLOCATOR_ALLOCATE_ZEROED: {
+			// Nothing is ever given back, so it's all still zero
+			return initialization_allocator_proc(size, 0, ALLOCATOR_ALLOCATE, data);
+		}
 		case ALLOCATOR_DEALLOCATE: {
 			return 0;
 		}
@@ -46,15 +54,54 @@ Allocator get_initialization_allocator() {
 // Basic general heap allocator, free list
 ///
 // Technically thread safe but synchronization is horrible.
-// Fragmentation is catastrophic.
-// We could fix it by merging free nodes every now and then
-// BUT: We aren't really supposed to allocate/deallocate directly on the heap too much anyways...
+// Free nodes are kept sorted by address and merged with their neighbours when freeing, so
+// reallocate can usually grow in place. Finding the spot is a walk through the free list though.
+// We aren't really supposed to allocate/deallocate directly on the heap too much anyways...
+//
+// Allocations of HEAP_LARGE_ALLOCATION_THRESHOLD or more don't go in the heap blocks, they get
+// their own run of pages straight from the OS. When freed, they are kept around for reuse as
+// long as we stay under HEAP_RETAIN_BUDGET, otherwise given back.
+// Big free spans in the heap blocks are decommitted (pages given back to the OS, address
+// space kept) once the heap holds more than HEAP_RETAIN_BUDGET of free committed memory.
+// heap_release_unused_memory() gives back everything it can right away.
 
 #define MAX_HEAP_BLOCK_SIZE align_next(MB(500), os.page_size)
 #define DEFAULT_HEAP_BLOCK_SIZE (min(MAX_HEAP_BLOCK_SIZE, program_memory_capacity))
 #define HEAP_ALIGNMENT (sizeof(Heap_Free_Node))
+
+#ifndef HEAP_LARGE_ALLOCATION_THRESHOLD
+	#define HEAP_LARGE_ALLOCATION_THRESHOLD MB(1)
+#endif
+#ifndef HEAP_RETAIN_BUDGET
+	#define HEAP_RETAIN_BUDGET MB(64)
+#endif
+// Free spans smaller than this are never decommitted, it's not worth the syscalls
+#ifndef HEAP_DECOMMIT_MIN_SIZE
+	#define HEAP_DECOMMIT_MIN_SIZE KB(256)
+#endif
+#define HEAP_RECOMMIT_SIZE KB(64)
+
+// Allocations can be tagged to see which part of the program uses how much memory,
+// see heap_tag_scope(). Tag 0 is everything untagged.
+#ifndef HEAP_MAX_TAGS
+	#define HEAP_MAX_TAGS 256
+#endif
+#define HEAP_TAG_NONE 0
+// Size class n is allocations of more than 2^(n-1) and at most 2^n bytes (including metadata)
+#define HEAP_SIZE_CLASS_COUNT 48
+typedef u16 Heap_Tag;
+
+typedef struct Heap_Tag_Stats {
+	string name;
+	u64 live_bytes;
+	u64 live_allocations;
+	u64 peak_bytes;
+	u64 total_allocations;
+} Heap_Tag_Stats;
+
 typedef struct Heap_Free_Node Heap_Free_Node;
 typedef struct Heap_Block Heap_Block;
+typedef struct Heap_Large_Allocation Heap_Large_Allocation;
 
 typedef struct Heap_Free_Node {
 	u64 size;
@@ -66,16 +113,23 @@ typedef struct Heap_Block {
 	Heap_Free_Node *free_head;
 	void* start;
 	Heap_Block *next;
-	// 32 bytes !!
+	u64 *decommitted_pages; // One bit per page. Made on first decommit.
+	u64 decommitted_bytes;
+	// Nothing from here to the end of the block has been handed out yet, so it's still zero
+	// from the OS. heap_alloc_zeroed() doesn't need to clear that part.
+	u8 *untouched;
+	u64 padding;
+	// 64 bytes !!
 #if CONFIGURATION == DEBUG
 	u64 total_allocated;
-	u64 padding;
+	u64 debug_padding; // Keeps it a multiple of 16 bytes
 #endif
 } Heap_Block;
 
 #define HEAP_META_SIGNATURE 6969694206942069ull
 typedef alignat(16) struct Heap_Allocation_Metadata {
-	u64 size;
+	u64 size : 48;
+	u64 tag  : 16; // Heap_Tag
 	Heap_Block *block;
 #if CONFIGURATION == DEBUG
 	u64 signature;
@@ -83,16 +137,61 @@ typedef alignat(16) struct Heap_Allocation_Metadata {
 #endif
 } Heap_Allocation_Metadata;
 
+// Lives right before the allocation in its own page run. That's at the start of the run
+// unless the allocation asked for more alignment.
+typedef alignat(16) struct Heap_Large_Allocation {
+	u64 size; // Including this header
+	u64 run_size;
+	Heap_Large_Allocation *next;
+	Heap_Large_Allocation *previous;
+	u8 *run_start;
+	u64 tag; // Heap_Tag
+} Heap_Large_Allocation;
+
 // #Global
 ogb_instance Heap_Block *heap_head;
 ogb_instance bool heap_initted;
-ogb_instance Spinlock heap_lock;
+ogb_instance Padded_Spinlock heap_lock; // Hot, so it gets its own cache line
+// Live large allocations, and freed ones we kept for reuse
+ogb_instance Heap_Large_Allocation *heap_large_allocations;
+ogb_instance Heap_Large_Allocation *heap_large_cache;
+ogb_instance u64 heap_block_bytes;
+ogb_instance u64 heap_allocated_bytes;
+ogb_instance u64 heap_decommitted_bytes;
+ogb_instance u64 heap_large_bytes;
+ogb_instance u64 heap_large_cached_bytes;
+ogb_instance u64 heap_decommit_threshold;
+ogb_instance u64 heap_large_allocated_bytes;
+ogb_instance u64 heap_live_allocations;
+ogb_instance u64 heap_total_allocations;
+ogb_instance u64 heap_size_classes[HEAP_SIZE_CLASS_COUNT]; // Live allocations per size class
+ogb_instance Heap_Tag_Stats heap_tags[HEAP_MAX_TAGS];
+ogb_instance u64 heap_tag_count;
+ogb_instance Spinlock heap_tags_lock;
 
 #if !OOGABOOGA_LINK_EXTERNAL_INSTANCE
 Heap_Block *heap_head;
 bool heap_initted = false;
-Spinlock heap_lock;
+Padded_Spinlock heap_lock;
+Heap_Large_Allocation *heap_large_allocations = 0;
+Heap_Large_Allocation *heap_large_cache = 0;
+u64 heap_block_bytes = 0;
+u64 heap_allocated_bytes = 0;
+u64 heap_decommitted_bytes = 0;
+u64 heap_large_bytes = 0;
+u64 heap_large_cached_bytes = 0;
+u64 heap_decommit_threshold = HEAP_RETAIN_BUDGET;
+u64 heap_large_allocated_bytes = 0;
+u64 heap_live_allocations = 0;
+u64 heap_total_allocations = 0;
+u64 heap_size_classes[HEAP_SIZE_CLASS_COUNT] = {0};
+Heap_Tag_Stats heap_tags[HEAP_MAX_TAGS] = {0};
+u64 heap_tag_count = 1;
+Spinlock heap_tags_lock;
 #endif // NOT OOGABOOGA_LINK_EXTERNAL_INSTANCE
+
+// Not shared with an external instance, so a tag set in one module only applies there
+thread_local Heap_Tag heap_current_tag = HEAP_TAG_NONE;
 	
 
 u64 get_heap_block_size_excluding_metadata(Heap_Block *block) {
@@ -113,8 +212,54 @@ bool is_pointer_in_stack(void* p) {
 bool is_pointer_in_static_memory(void* p) {
     return (uintptr_t)p >= (uintptr_t)os.static_memory_start && (uintptr_t)p < (uintptr_t)os.static_memory_end;
 }
+// Assumes heap_lock is held
+Heap_Large_Allocation *find_heap_large_allocation(void *p) {
+	Heap_Large_Allocation *large = heap_large_allocations;
+	while (large) {
+		if ((u8*)p >= (u8*)large && (u8*)p < (u8*)large + large->size) return large;
+		large = large->next;
+	}
+	return 0;
+}
+bool is_pointer_in_large_allocation(void *p) {
+	if (!heap_initted) return false;
+	spinlock_acquire_or_wait(&heap_lock.lock);
+	bool result = find_heap_large_allocation(p) != 0;
+	spinlock_release(&heap_lock.lock);
+	return result;
+}
+bool is_pointer_in_arena(void *p);
 bool is_pointer_valid(void *p) {
-	return is_pointer_in_program_memory(p) || is_pointer_in_stack(p) || is_pointer_in_static_memory(p);
+	return is_pointer_in_program_memory(p) || is_pointer_in_stack(p) || is_pointer_in_static_memory(p) || is_pointer_in_large_allocation(p) || is_pointer_in_arena(p);
+}
+
+// Every large heap allocation and arena reservation is somewhere in between these. They only
+// ever grow, so checking against them takes no lock.
+ogb_instance volatile u64 reserved_memory_low;
+ogb_instance volatile u64 reserved_memory_high;
+
+#if !OOGABOOGA_LINK_EXTERNAL_INSTANCE
+volatile u64 reserved_memory_low  = 0xFFFFFFFFFFFFFFFFull;
+volatile u64 reserved_memory_high = 0;
+#endif // NOT OOGABOOGA_LINK_EXTERNAL_INSTANCE
+
+void note_reserved_memory(void *p, u64 size) {
+	u64 low = (u64)p;
+	u64 high = (u64)p + size;
+	u64 old;
+	while ((old = reserved_memory_low) > low) {
+		if (compare_and_swap_64(&reserved_memory_low, low, old)) break;
+	}
+	while ((old = reserved_memory_high) < high) {
+		if (compare_and_swap_64(&reserved_memory_high, high, old)) break;
+	}
+}
+// Like is_pointer_valid, but without any locks or list walks. Large allocations and arenas
+// are only checked against the range they all fall in, so it can say yes for memory in
+// between them. For guesses on hot paths, like telling a string from a char* in print.
+bool is_pointer_probably_valid(void *p) {
+	if (is_pointer_in_program_memory(p) || is_pointer_in_stack(p) || is_pointer_in_static_memory(p)) return true;
+	return (u64)p >= reserved_memory_low && (u64)p < reserved_memory_high;
 }
 
 // Meant for debug
@@ -233,29 +378,270 @@ Heap_Block *make_heap_block(Heap_Block *parent, u64 size) {
 	block->start = ((u8*)block)+sizeof(Heap_Block);
 	block->size = size;
 	block->next = 0;
+	block->decommitted_pages = 0;
+	block->decommitted_bytes = 0;
 	block->free_head = (Heap_Free_Node*)block->start;
 	block->free_head->size = get_heap_block_size_excluding_metadata(block);
 	block->free_head->next = 0;
+#if CONFIGURATION == DEBUG
+	// Program memory is filled with garbage in debug
+	block->untouched = (u8*)block + block->size;
+#else
+	block->untouched = (u8*)(block->free_head+1);
+#endif
+	
+	heap_block_bytes += get_heap_block_size_excluding_metadata(block);
 	
 	return block;
 }
 
+// Call before writing anything at or past block->untouched.
+// Assumes heap_lock is held
+void heap_block_touch(Heap_Block *block, void *end) {
+	if ((u8*)end > block->untouched) block->untouched = (u8*)end;
+}
+
+///
+// Decommitting free pages in heap blocks
+// Which pages are decommitted is tracked per block so we know what to recommit when the
+// memory is handed out again. Free node headers are never decommitted, so we can walk and
+// merge free nodes without caring.
+
+u64 get_heap_free_committed_bytes() {
+	return heap_block_bytes - heap_allocated_bytes - heap_decommitted_bytes;
+}
+
+// start and end must be page aligned. Assumes heap_lock is held.
+void heap_block_decommit_pages(Heap_Block *block, void *start, void *end) {
+	if ((u8*)end <= (u8*)start) return;
+	
+	if (!block->decommitted_pages) {
+		// Outside of the heap since we're in the middle of the heap
+		u64 page_count = block->size/os.page_size;
+		u64 bitmap_size = align_next(((page_count+63)/64)*sizeof(u64), os.page_size);
+		block->decommitted_pages = (u64*)os_reserve_memory(bitmap_size);
+		assert(block->decommitted_pages, "Failed reserving memory for heap decommit bitmap");
+		bool ok = os_commit_memory(block->decommitted_pages, bitmap_size);
+		assert(ok, "Failed committing memory for heap decommit bitmap");
+		// Fresh pages from the OS are zeroed
+	}
+	
+	u64 first_page = ((u64)start - (u64)block)/os.page_size;
+	u64 end_page   = ((u64)end   - (u64)block)/os.page_size;
+	u64 newly_decommitted = 0;
+	for (u64 i = first_page; i < end_page; i++) {
+		u64 bit = 1ull << (i%64);
+		if (!(block->decommitted_pages[i/64] & bit)) {
+			block->decommitted_pages[i/64] |= bit;
+			newly_decommitted += 1;
+		}
+	}
+	if (newly_decommitted == 0) return;
+	
+	os_decommit_memory(start, (u64)end-(u64)start);
+	block->decommitted_bytes += newly_decommitted*os.page_size;
+	heap_decommitted_bytes   += newly_decommitted*os.page_size;
+}
+// Makes sure all pages overlapping [start, end) are committed. Assumes heap_lock is held.
+void heap_block_recommit_pages(Heap_Block *block, void *start, void *end) {
+	if (block->decommitted_bytes == 0) return;
+	
+	u64 first_page = (align_previous(start, os.page_size) - (u64)block)/os.page_size;
+	u64 end_page   = (align_next((u64)end, os.page_size) - (u64)block)/os.page_size;
+	end_page = min(end_page, block->size/os.page_size);
+	
+	u64 recommitted = 0;
+	u64 first_set = end_page;
+	u64 last_set = 0;
+	for (u64 i = first_page; i < end_page; i++) {
+		u64 bit = 1ull << (i%64);
+		if (block->decommitted_pages[i/64] & bit) {
+			block->decommitted_pages[i/64] &= ~bit;
+			recommitted += 1;
+			first_set = min(first_set, i);
+			last_set = i;
+		}
+	}
+	if (recommitted == 0) return;
+	
+	// Recommitting pages that are already committed is fine
+	void *commit_start = (u8*)block + first_set*os.page_size;
+	u64 commit_size = (last_set-first_set+1)*os.page_size;
+	bool ok = os_commit_memory(commit_start, commit_size);
+	assert(ok, "Failed recommitting heap memory. Out of memory?");
+	
+	block->decommitted_bytes -= recommitted*os.page_size;
+	heap_decommitted_bytes   -= recommitted*os.page_size;
+}
+
+// Decommits free spans until we're down to target_free_committed bytes of free committed memory
+// or we run out of spans big enough. Assumes heap_lock is held.
+void heap_decommit_free_spans(u64 target_free_committed) {
+	// Large pages can't be decommitted one small page at a time
+	if (program_memory_has_large_pages) return;
+	
+	Heap_Block *block = heap_head;
+	while (block && get_heap_free_committed_bytes() > target_free_committed) {
+		Heap_Free_Node *node = block->free_head;
+		while (node && get_heap_free_committed_bytes() > target_free_committed) {
+			if (node->size >= HEAP_DECOMMIT_MIN_SIZE) {
+				// Keep the page with the node header
+				void *first_page = (void*)align_next((u64)node + sizeof(Heap_Free_Node), os.page_size);
+				void *last_page_end = (void*)align_previous((u64)node + node->size, os.page_size);
+				heap_block_decommit_pages(block, first_page, last_page_end);
+			}
+			node = node->next;
+		}
+		block = block->next;
+	}
+}
+
 void heap_init() {
 	if (heap_initted) return;
 	assert(HEAP_ALIGNMENT == 16);
 	assert(sizeof(Heap_Allocation_Metadata) % HEAP_ALIGNMENT == 0);
+	assert(sizeof(Heap_Block) % HEAP_ALIGNMENT == 0);
+	assert(sizeof(Heap_Large_Allocation) % HEAP_ALIGNMENT == 0);
 	heap_initted = true;
+	heap_tags[HEAP_TAG_NONE].name = STR("untagged");
 	heap_head = make_heap_block(0, DEFAULT_HEAP_BLOCK_SIZE);
-	spinlock_init(&heap_lock);
+	spinlock_init(&heap_lock.lock);
 }
 
-void *heap_alloc(u64 size) {
+///
+// Tracking
+
+u64 get_heap_size_class(u64 size) {
+	u64 size_class = 0;
+	u64 x = size-1;
+	while (x) {
+		x >>= 1;
+		size_class += 1;
+	}
+	return min(size_class, HEAP_SIZE_CLASS_COUNT-1);
+}
+// Assumes heap_lock is held
+void heap_track_add(Heap_Tag tag, u64 size) {
+	heap_size_classes[get_heap_size_class(size)] += 1;
+	heap_live_allocations += 1;
+	Heap_Tag_Stats *stats = &heap_tags[tag];
+	stats->live_bytes += size;
+	stats->live_allocations += 1;
+	stats->peak_bytes = max(stats->peak_bytes, stats->live_bytes);
+}
+// Assumes heap_lock is held
+void heap_track_remove(Heap_Tag tag, u64 size) {
+	heap_size_classes[get_heap_size_class(size)] -= 1;
+	heap_live_allocations -= 1;
+	Heap_Tag_Stats *stats = &heap_tags[tag];
+	stats->live_bytes -= size;
+	stats->live_allocations -= 1;
+}
+// Assumes heap_lock is held
+void heap_track_new_allocation(Heap_Tag tag, u64 size) {
+	heap_track_add(tag, size);
+	heap_total_allocations += 1;
+	heap_tags[tag].total_allocations += 1;
+}
+
+///
+// Large allocations
+
+// Assumes heap_lock is held
+void *heap_alloc_large(u64 size, u64 alignment, bool zero_initialize) {
+	// Offset from the start of the run to the allocation
+	u64 offset = align_next(sizeof(Heap_Large_Allocation), max(alignment, HEAP_ALIGNMENT));
+	u64 needed = align_next(offset + size, HEAP_ALIGNMENT);
+	
+	// Reuse a run we kept around if it's not too wasteful
+	u8 *run = 0;
+	u64 run_size = 0;
+	Heap_Large_Allocation *cached = heap_large_cache;
+	while (cached) {
+		if (cached->run_size >= needed && cached->run_size <= needed*2) {
+			if (cached->previous) cached->previous->next = cached->next;
+			else heap_large_cache = cached->next;
+			if (cached->next) cached->next->previous = cached->previous;
+			heap_large_cached_bytes -= cached->run_size;
+			run = cached->run_start;
+			run_size = cached->run_size;
+			break;
+		}
+		cached = cached->next;
+	}
+	
+	// Fresh pages are already zero
+	bool needs_zeroing = zero_initialize && run;
+	
+	if (!run) {
+		run_size = align_next(needed, os.page_size);
+		run = (u8*)os_reserve_memory(run_size);
+		assert(run, "Failed reserving %llu bytes for a large heap allocation. Out of address space?", run_size);
+		bool ok = os_commit_memory(run, run_size);
+		assert(ok, "Failed committing %llu bytes for a large heap allocation. Out of memory?", run_size);
+		note_reserved_memory(run, run_size);
+	}
+	
+	Heap_Large_Allocation *large = ((Heap_Large_Allocation*)(run + offset))-1;
+	large->run_start = run;
+	large->run_size = run_size;
+	large->size = needed - (offset - sizeof(Heap_Large_Allocation));
+	large->tag = heap_current_tag;
+	large->previous = 0;
+	large->next = heap_large_allocations;
+	if (heap_large_allocations) heap_large_allocations->previous = large;
+	heap_large_allocations = large;
+	heap_large_bytes += large->run_size;
+	heap_large_allocated_bytes += large->size;
+	heap_track_new_allocation((Heap_Tag)large->tag, large->size);
+	
+	void *p = large+1;
+	assert((u64)p % max(alignment, HEAP_ALIGNMENT) == 0, "Internal heap error. Large allocation is not aligned");
+	if (needs_zeroing) memset(p, 0, size);
+	return p;
+}
+// Assumes heap_lock is held
+void heap_dealloc_large(Heap_Large_Allocation *large) {
+	if (large->previous) large->previous->next = large->next;
+	else heap_large_allocations = large->next;
+	if (large->next) large->next->previous = large->previous;
+	heap_large_bytes -= large->run_size;
+	heap_large_allocated_bytes -= large->size;
+	heap_track_remove((Heap_Tag)large->tag, large->size);
+	
+	if (heap_large_cached_bytes + large->run_size <= HEAP_RETAIN_BUDGET) {
+#if CONFIGURATION == DEBUG
+		memset(large+1, 0x69696969, large->size-sizeof(Heap_Large_Allocation));
+#endif
+		large->previous = 0;
+		large->next = heap_large_cache;
+		if (heap_large_cache) heap_large_cache->previous = large;
+		heap_large_cache = large;
+		heap_large_cached_bytes += large->run_size;
+	} else {
+		os_release_memory(large->run_start, large->run_size);
+	}
+}
+Heap_Large_Allocation *get_heap_large_allocation(void *p) {
+	Heap_Large_Allocation *large = ((Heap_Large_Allocation*)p)-1;
+#if CONFIGURATION == DEBUG
+	assert(find_heap_large_allocation(p) == large, "A bad pointer was passed to the heap: it is not in program memory and it's not a large allocation");
+#endif
+	return large;
+}
+
+void *heap_alloc_internal(u64 size, bool zero_initialize) {
 
 	if (!heap_initted) heap_init();
 
 	// #Sync #Speed oof
-	spinlock_acquire_or_wait(&heap_lock);
+	spinlock_acquire_or_wait(&heap_lock.lock);
 	
+	if (size >= HEAP_LARGE_ALLOCATION_THRESHOLD) {
+		void *p = heap_alloc_large(size, HEAP_ALIGNMENT, zero_initialize);
+		spinlock_release(&heap_lock.lock);
+		return p;
+	}
 
 
 
@@ -264,8 +650,6 @@ void *heap_alloc(u64 size) {
 	
 	size = (size+HEAP_ALIGNMENT) & ~(HEAP_ALIGNMENT-1);
 	
-	assert(size < MAX_HEAP_BLOCK_SIZE, "Past Charlie has been lazy and did not handle large allocations like this. I apologize on behalf of past Charlie. A quick fix could be to increase the heap block size for now. #Incomplete #Limitation");
-	
 	
 #if VERY_DEBUG
 	{
@@ -329,6 +713,11 @@ void *heap_alloc(u64 size) {
 	
 	assert(best_fit != 0, "Internal heap error");
 	
+	// Recommit anything we decommitted, including where the remaining free node header goes.
+	// Recommit a bit extra so allocating off the end of a decommitted span isn't a syscall every time.
+	u64 recommit_size = min(best_fit->size, max(size + sizeof(Heap_Free_Node), HEAP_RECOMMIT_SIZE));
+	heap_block_recommit_pages(best_fit_block, best_fit, (u8*)best_fit + recommit_size);
+	
 	// Unlock best fit
 	
 	// #Copypaste
@@ -339,8 +728,12 @@ void *heap_alloc(u64 size) {
 		os_unlock_program_memory_pages(first_page, (u64)last_page_end-(u64)first_page);
 	}
 	
+	// Anything before this may have been used already
+	u8 *untouched = best_fit_block->untouched;
+	
 	Heap_Free_Node *new_free_node = 0;
 	if (size != best_fit->size) {
+		heap_block_touch(best_fit_block, (u8*)best_fit + size + sizeof(Heap_Free_Node));
 		u64 remainder = best_fit->size - size;
 		new_free_node = (Heap_Free_Node*)(((u8*)best_fit)+size);
 		new_free_node->size = remainder;
@@ -374,13 +767,19 @@ void *heap_alloc(u64 size) {
 		} else best_fit_block->free_head = best_fit_block->free_head->next;
 	}
 	
+	heap_block_touch(best_fit_block, (u8*)best_fit + size);
+	
 	Heap_Allocation_Metadata *meta = (Heap_Allocation_Metadata*)best_fit;
 	meta->size = size;
+	meta->tag = heap_current_tag;
 	meta->block = best_fit_block;
 #if CONFIGURATION == DEBUG
 	meta->signature = HEAP_META_SIGNATURE;
 	meta->block->total_allocated += size;
 #endif
+	heap_allocated_bytes += size;
+	heap_track_new_allocation((Heap_Tag)meta->tag, size);
+	if (get_heap_free_committed_bytes() < HEAP_RETAIN_BUDGET) heap_decommit_threshold = HEAP_RETAIN_BUDGET;
 
 	check_meta(meta);
 
@@ -389,21 +788,85 @@ void *heap_alloc(u64 size) {
 #endif
 	
 	// #Sync #Speed oof
-	spinlock_release(&heap_lock);
+	spinlock_release(&heap_lock.lock);
 	
 	
 	void *p = ((u8*)meta)+sizeof(Heap_Allocation_Metadata);
 	assert((u64)p % HEAP_ALIGNMENT == 0, "Internal heap error. Result pointer is not aligned to HEAP_ALIGNMENT");
+	
+	if (zero_initialize) {
+		u8 *dirty_end = min((u8*)meta + size, untouched);
+		if (dirty_end > (u8*)p) memset(p, 0, (u64)(dirty_end - (u8*)p));
+	}
+	
 	return p;
 }
+void *heap_alloc(u64 size) {
+	return heap_alloc_internal(size, false);
+}
+// Only clears memory that has been used before, fresh memory from the OS is already zero.
+void *heap_alloc_zeroed(u64 size) {
+	return heap_alloc_internal(size, true);
+}
+// Puts a range back in the block's free list. The free list is kept sorted by address so
+// that neighbours can be merged, which is what lets allocations grow in place.
+// Assumes heap_lock is held.
+void heap_insert_free_node(Heap_Block *block, Heap_Free_Node *new_node, u64 size) {
+	new_node->size = size;
+	
+	Heap_Free_Node *previous = 0;
+	Heap_Free_Node *next = block->free_head;
+	// #Speed
+	while (next && next < new_node) {
+		previous = next;
+		next = next->next;
+	}
+	assert(next != new_node, "Pointer was freed twice. Either that or the heap is corrupt.");
+	assert(!previous || (u8*)previous + previous->size <= (u8*)new_node, "Freed memory overlaps with a free node. Double free? If not, this is heap corruption.");
+	
+	bool merged_next = next && (u8*)new_node + size == (u8*)next;
+	if (merged_next) {
+		new_node->size += next->size;
+		new_node->next = next->next;
+	} else {
+		new_node->next = next;
+	}
+	
+	Heap_Free_Node *node = new_node;
+	if (previous && (u8*)previous + previous->size == (u8*)new_node) {
+		previous->size += new_node->size;
+		previous->next = new_node->next;
+		node = previous;
+	} else if (previous) {
+		previous->next = new_node;
+	} else {
+		block->free_head = new_node;
+	}
+	
+	// Lock the pages that were just freed, but never the page with the node header.
+	// The rest of a merged node was locked already.
+	void *lock_start = node == new_node ? (u8*)new_node + sizeof(Heap_Free_Node) : (u8*)new_node;
+	void *lock_end = (u8*)new_node + size + (merged_next ? sizeof(Heap_Free_Node) : 0);
+	void *first_page = (void*)align_next((u64)lock_start, os.page_size);
+	void *last_page_end = (void*)align_previous((u64)lock_end, os.page_size);
+	if ((u8*)last_page_end > (u8*)first_page) {
+		os_lock_program_memory_pages(first_page, (u64)last_page_end-(u64)first_page);
+	}
+}
+
 void heap_dealloc(void *p) {
 	// #Sync #Speed oof
 	
 	if (!heap_initted) heap_init();
 
-	spinlock_acquire_or_wait(&heap_lock);
+	spinlock_acquire_or_wait(&heap_lock.lock);
+	
+	if (!is_pointer_in_program_memory(p)) {
+		heap_dealloc_large(get_heap_large_allocation(p));
+		spinlock_release(&heap_lock.lock);
+		return;
+	}
 	
-	assert(is_pointer_in_program_memory(p), "A bad pointer was passed tp heap_dealloc: it is out of program memory bounds!"); 
 	p = (u8*)p-sizeof(Heap_Allocation_Metadata);
 	Heap_Allocation_Metadata *meta = (Heap_Allocation_Metadata*)(p);
 	check_meta(meta);
@@ -411,6 +874,7 @@ void heap_dealloc(void *p) {
 	// Yoink meta data before we start overwriting it
 	Heap_Block *block = meta->block;
 	u64 size = meta->size;
+	heap_track_remove((Heap_Tag)meta->tag, size);
 	
 #if CONFIGURATION == DEBUG
 	memset(p, 0x69696969, size);
@@ -420,115 +884,214 @@ void heap_dealloc(void *p) {
 		sanity_check_block(block);
 	#endif
 	
-	Heap_Free_Node *new_node = cast(Heap_Free_Node*)p;
-	new_node->size = size;
+	heap_insert_free_node(block, (Heap_Free_Node*)p, size);
+
+#if CONFIGURATION == DEBUG
+	block->total_allocated -= size;
+#endif
+	heap_allocated_bytes -= size;
 	
-	if (new_node < block->free_head) {
-		// #Copypaste
-		void *free_tail = (u8*)new_node + new_node->size;
-		void *next_page = (void*)align_next(new_node, os.page_size);
-		void *last_page_end = (void*)align_previous(free_tail, os.page_size);
-		if ((u8*)last_page_end > (u8*)next_page) {
-			os_lock_program_memory_pages(next_page, (u64)last_page_end-(u64)next_page);
+	if (get_heap_free_committed_bytes() > heap_decommit_threshold) {
+		heap_decommit_free_spans(HEAP_RETAIN_BUDGET/2);
+		// If what's left is in spans too small to decommit, don't walk all of them again
+		// on every single dealloc.
+		heap_decommit_threshold = max(HEAP_RETAIN_BUDGET, get_heap_free_committed_bytes() + HEAP_RETAIN_BUDGET/4);
+	}
+
+#if VERY_DEBUG
+	sanity_check_block(block);
+#endif
+	// #Sync #Speed oof
+	spinlock_release(&heap_lock.lock);
+}
+
+// Grows into the free node right after the allocation, or gives back the tail when shrinking.
+// Large allocations can grow up to the end of their page run.
+// Returns false if it doesn't fit, then the allocation is untouched.
+bool heap_resize_in_place(void *p, u64 size) {
+	
+	if (!is_pointer_in_program_memory(p)) {
+		// Shrinking a large allocation down to a small one moves it back to the heap blocks
+		if (size < HEAP_LARGE_ALLOCATION_THRESHOLD) return false;
+		
+		spinlock_acquire_or_wait(&heap_lock.lock);
+		Heap_Large_Allocation *large = get_heap_large_allocation(p);
+		u64 new_size = align_next(size + sizeof(Heap_Large_Allocation), HEAP_ALIGNMENT);
+		bool fits = (u64)((u8*)large - large->run_start) + new_size <= large->run_size;
+		if (fits) {
+			heap_track_remove((Heap_Tag)large->tag, large->size);
+			heap_track_add((Heap_Tag)large->tag, new_size);
+			heap_large_allocated_bytes = heap_large_allocated_bytes - large->size + new_size;
+			large->size = new_size;
 		}
+		spinlock_release(&heap_lock.lock);
+		return fits;
+	}
+	
+	if (size >= HEAP_LARGE_ALLOCATION_THRESHOLD) return false;
+	
+	spinlock_acquire_or_wait(&heap_lock.lock);
+	
+	Heap_Allocation_Metadata *meta = (Heap_Allocation_Metadata*)((u8*)p-sizeof(Heap_Allocation_Metadata));
+	check_meta(meta);
+	Heap_Block *block = meta->block;
+	
+	// Same as in heap_alloc
+	u64 new_size = size + sizeof(Heap_Allocation_Metadata);
+	new_size = (new_size+HEAP_ALIGNMENT) & ~(HEAP_ALIGNMENT-1);
+	u64 old_size = meta->size;
+	
+	bool ok = true;
+	if (new_size < old_size) {
+		u64 freed = old_size - new_size;
+		heap_track_remove((Heap_Tag)meta->tag, old_size);
+		heap_track_add((Heap_Tag)meta->tag, new_size);
+		meta->size = new_size;
+#if CONFIGURATION == DEBUG
+		memset((u8*)meta + new_size, 0x69696969, freed);
+		block->total_allocated -= freed;
+#endif
+		heap_allocated_bytes -= freed;
+		heap_insert_free_node(block, (Heap_Free_Node*)((u8*)meta + new_size), freed);
+	} else if (new_size > old_size) {
+		Heap_Free_Node *tail = (Heap_Free_Node*)((u8*)meta + old_size);
 		
-		if ((u8*)new_node+size == (u8*)block->free_head) {
-			new_node->size = size + block->free_head->size;
-			new_node->next = block->free_head->next;
-			block->free_head = new_node;
-		} else {
-			new_node->next = block->free_head;
-			block->free_head = new_node;
+		Heap_Free_Node *previous = 0;
+		Heap_Free_Node *node = block->free_head;
+		// #Speed
+		while (node && node < tail) {
+			previous = node;
+			node = node->next;
 		}
 		
-	} else {
-	
-		if (!block->free_head) {
-			block->free_head = new_node;
-			new_node->next = 0;
+		u64 take = new_size - old_size;
+		if (node == tail && node->size >= take) {
+			u64 remainder = node->size - take;
+			Heap_Free_Node *next = node->next;
 			
-			// #Copypaste
-			void *free_tail = (u8*)new_node + new_node->size;
-			void *next_page = (void*)align_next(new_node, os.page_size);
-			void *last_page_end = (void*)align_previous(free_tail, os.page_size);
-			if ((u8*)last_page_end > (u8*)next_page) {
-				os_lock_program_memory_pages(next_page, (u64)last_page_end-(u64)next_page);
-			}
+			u64 touched = min(node->size, take + sizeof(Heap_Free_Node));
+			heap_block_recommit_pages(block, tail, (u8*)tail + min(node->size, max(touched, HEAP_RECOMMIT_SIZE)));
+			void *first_page = (void*)align_previous((u64)tail, os.page_size);
+			void *last_page_end = (void*)align_next((u64)tail + touched, os.page_size);
+			os_unlock_program_memory_pages(first_page, (u64)last_page_end-(u64)first_page);
 			
-		} else {
-			Heap_Free_Node *node = block->free_head;
-		
-			while (true) {
+			heap_block_touch(block, (u8*)tail + take + (remainder ? sizeof(Heap_Free_Node) : 0));
 			
-				assert(node != 0, "We didn't find where the free node should be! This is likely heap corruption (or, hopefully not, an internal error)");
-				
-				// In retrospect, I don't remember a good reason to care about where the
-				// free nodes are... maybe I'm just dumb right now? #Speed #Memory
-				// ... ACtually, it's probably to easily know when to merge free nodes.
-				// BUT. Maybe it's not worth the performance hit? Then again, if the heap
-				// allocator slows down your program you should rethink your memory management
-				// anyways...
-				
-				if (new_node >= node) {
-					u8* node_tail = (u8*)node + node->size;
-					if (cast(u8*)new_node == node_tail) {
-						
-						// We need to account for the cases where we coalesce free blocks with start/end in the middle
-						// of a page.
-						
-						u64 new_node_size = new_node->size;
-						
-						// #Copypaste
-						void *free_tail = (u8*)new_node + new_node->size;
-						void *next_page = (void*)align_previous(node_tail, os.page_size);
-						void *last_page_end = (void*)align_previous(free_tail, os.page_size);
-
-						if ((u8*)next_page < (u8*)node) next_page = (u8*)next_page + os.page_size;
-						
-						if ((u8*)last_page_end > (u8*)next_page) {
-							os_lock_program_memory_pages(next_page, (u64)last_page_end-(u64)next_page);
-						}
-						
-						node->size += new_node_size;
-						
-						break;
-					} else {
-						new_node->next = node->next;
-						node->next = new_node;
-						
-						u8* new_node_tail = (u8*)new_node + new_node->size;
-						if (new_node->next && (u8*)new_node->next == new_node_tail) {
-							new_node->size += new_node->next->size;
-							new_node->next = new_node->next->next;
-						}
-						
-						// #Copypaste
-						void *free_tail = (u8*)new_node + new_node->size;
-						void *next_page = (void*)align_next(new_node, os.page_size);
-						void *last_page_end = (void*)align_previous(free_tail, os.page_size);
-						if ((u8*)last_page_end > (u8*)next_page) {
-							os_lock_program_memory_pages(next_page, (u64)last_page_end-(u64)next_page);
-						}
-						
-						break;
-					}
-				}
-				
-				node = node->next;
+			Heap_Free_Node *replacement = next;
+			if (remainder) {
+				replacement = (Heap_Free_Node*)((u8*)tail + take);
+				replacement->size = remainder;
+				replacement->next = next;
 			}
+			if (previous) previous->next = replacement;
+			else block->free_head = replacement;
+			
+			heap_track_remove((Heap_Tag)meta->tag, old_size);
+			heap_track_add((Heap_Tag)meta->tag, new_size);
+			meta->size = new_size;
+#if CONFIGURATION == DEBUG
+			block->total_allocated += take;
+#endif
+			heap_allocated_bytes += take;
+		} else {
+			ok = false;
 		}
 	}
 	
+#if VERY_DEBUG
+	sanity_check_block(block);
+#endif
+	
+	spinlock_release(&heap_lock.lock);
+	return ok;
+}
 
+// For alignment above HEAP_ALIGNMENT. Freed with heap_dealloc like anything else.
+void *heap_alloc_aligned(u64 size, u64 alignment) {
+	assert(alignment > 0 && (alignment & (alignment-1)) == 0, "Heap alignment must be a power of two, got %llu", alignment);
+	if (alignment <= HEAP_ALIGNMENT) return heap_alloc(size);
+	
+	if (!heap_initted) heap_init();
+	
+	if (size + alignment >= HEAP_LARGE_ALLOCATION_THRESHOLD) {
+		spinlock_acquire_or_wait(&heap_lock.lock);
+		void *p = heap_alloc_large(size, alignment, false);
+		spinlock_release(&heap_lock.lock);
+		return p;
+	}
+	
+	// Allocate enough to fit the alignment, then give back what's in front and behind
+	u8 *p = (u8*)heap_alloc(size + alignment);
+	u8 *aligned = (u8*)align_next((u64)p, alignment);
+	
+	if (aligned != p) {
+		spinlock_acquire_or_wait(&heap_lock.lock);
+		
+		Heap_Allocation_Metadata meta = *(Heap_Allocation_Metadata*)(p - sizeof(Heap_Allocation_Metadata));
+		u64 gap = (u64)(aligned - p);
+		
+		Heap_Allocation_Metadata *aligned_meta = (Heap_Allocation_Metadata*)(aligned - sizeof(Heap_Allocation_Metadata));
+		*aligned_meta = meta;
+		aligned_meta->size = meta.size - gap;
+		heap_track_remove((Heap_Tag)meta.tag, meta.size);
+		heap_track_add((Heap_Tag)meta.tag, meta.size - gap);
 #if CONFIGURATION == DEBUG
-	block->total_allocated -= size;
+		meta.block->total_allocated -= gap;
 #endif
+		heap_allocated_bytes -= gap;
+		heap_insert_free_node(meta.block, (Heap_Free_Node*)(p - sizeof(Heap_Allocation_Metadata)), gap);
+		
+		spinlock_release(&heap_lock.lock);
+	}
+	
+	heap_resize_in_place(aligned, size);
+	
+	return aligned;
+}
 
-#if VERY_DEBUG
-	sanity_check_block(block);
-#endif
-	// #Sync #Speed oof
-	spinlock_release(&heap_lock);
+// Decommits all free heap memory that can be decommitted and gives back the large
+// allocations we kept around for reuse.
+void heap_release_unused_memory() {
+	if (!heap_initted) return;
+	
+	spinlock_acquire_or_wait(&heap_lock.lock);
+	
+	heap_decommit_free_spans(0);
+	heap_decommit_threshold = HEAP_RETAIN_BUDGET;
+	
+	while (heap_large_cache) {
+		Heap_Large_Allocation *next = heap_large_cache->next;
+		os_release_memory(heap_large_cache->run_start, heap_large_cache->run_size);
+		heap_large_cache = next;
+	}
+	heap_large_cached_bytes = 0;
+	
+	spinlock_release(&heap_lock.lock);
+}
+
+// Usable size, might be a bit more than what was asked for
+u64 heap_get_allocation_size(void *p) {
+	if (is_pointer_in_program_memory(p)) {
+		Heap_Allocation_Metadata *meta = (Heap_Allocation_Metadata*)(((u64)p)-sizeof(Heap_Allocation_Metadata));
+		check_meta(meta);
+		return meta->size - sizeof(Heap_Allocation_Metadata);
+	}
+	spinlock_acquire_or_wait(&heap_lock.lock);
+	Heap_Large_Allocation *large = get_heap_large_allocation(p);
+	spinlock_release(&heap_lock.lock);
+	return large->size - sizeof(Heap_Large_Allocation);
+}
+
+Heap_Tag heap_get_allocation_tag(void *p) {
+	if (is_pointer_in_program_memory(p)) {
+		Heap_Allocation_Metadata *meta = (Heap_Allocation_Metadata*)(((u64)p)-sizeof(Heap_Allocation_Metadata));
+		check_meta(meta);
+		return (Heap_Tag)meta->tag;
+	}
+	spinlock_acquire_or_wait(&heap_lock.lock);
+	Heap_Large_Allocation *large = get_heap_large_allocation(p);
+	spinlock_release(&heap_lock.lock);
+	return (Heap_Tag)large->tag;
 }
 
 void* heap_allocator_proc(u64 size, void *p, Allocator_Message message, void* data) {
@@ -537,6 +1100,12 @@ void* heap_allocator_proc(u64 size, void *p, Allocator_Message message, void* da
 			return heap_alloc(size);
 			break;
 		}
+		case ALLOCATOR_ALLOCATE_ZEROED: {
+			return heap_alloc_zeroed(size);
+		}
+		case ALLOCATOR_ALLOCATE_ALIGNED: {
+			return heap_alloc_aligned(size, (u64)p);
+		}
 		case ALLOCATOR_DEALLOCATE: {
 			heap_dealloc(p);
 			return 0;
@@ -546,10 +1115,18 @@ void* heap_allocator_proc(u64 size, void *p, Allocator_Message message, void* da
 				return heap_alloc(size);
 			}
 			assert(is_pointer_valid(p), "Invalid pointer passed to heap allocator reallocate");
-			Heap_Allocation_Metadata *meta = (Heap_Allocation_Metadata*)(((u64)p)-sizeof(Heap_Allocation_Metadata));
-			check_meta(meta);
+			
+			if (heap_resize_in_place(p, size)) return p;
+			
+			u64 old_size = heap_get_allocation_size(p);
+			
+			// Moved allocation keeps its tag
+			Heap_Tag previous_tag = heap_current_tag;
+			heap_current_tag = heap_get_allocation_tag(p);
 			void *new = heap_alloc(size);
-			memcpy(new, p, min(size, meta->size));
+			heap_current_tag = previous_tag;
+			
+			memcpy(new, p, min(size, old_size));
 			heap_dealloc(p);
 			return new;
 		}
@@ -568,53 +1145,880 @@ Allocator get_heap_allocator() {
 
 ///
 ///
-// Temporary storage
+// Heap telemetry
 ///
+// get_heap_stats() for the totals, heap_stats_to_json() for everything including tags.
+// Tagging is cheap enough to leave on in release, it's just some counters in the allocation
+// metadata and a table lookup per allocation:
+//
+//     Heap_Tag world_tag = heap_tag_make(STR("World"));
+//     heap_tag_scope(world_tag) {
+//         // Heap allocations in here count towards "World"
+//     }
+//     heap_tag_scope_here() {
+//         // Tagged with this file and line
+//     }
 
-#ifndef TEMPORARY_STORAGE_SIZE
-	#define TEMPORARY_STORAGE_SIZE (1024ULL*1024ULL*2ULL) // 2mb
-#endif
+typedef struct Heap_Stats {
+	u64 bytes_in_use;       // Live allocations, including their metadata
+	u64 bytes_committed;    // What the heap holds from the OS right now
+	u64 block_bytes;        // Heap blocks, committed or not
+	u64 decommitted_bytes;  // Free pages in heap blocks that were given back to the OS
+	u64 large_bytes;        // Page runs of live large allocations
+	u64 large_cached_bytes; // Page runs of freed large allocations kept for reuse
+	u64 free_bytes;         // Free memory in heap blocks
+	u64 largest_free;
+	u64 free_node_count;
+	u64 block_count;
+	u64 live_allocations;
+	u64 total_allocations;
+	// 0 when the free memory is all in one span, close to 1 when it's in many small ones
+	float64 fragmentation;
+	u64 allocations_per_size_class[HEAP_SIZE_CLASS_COUNT];
+} Heap_Stats;
 
-ogb_instance void* talloc(u64);
-ogb_instance void* temp_allocator_proc(u64 size, void *p, Allocator_Message message, void*);
+// Max blocks heap_stats_to_json() lists one by one
+#define HEAP_STATS_MAX_LISTED_BLOCKS 64
 
-// #Global
-ogb_instance Allocator 
-get_temporary_allocator();
+typedef struct Heap_Block_Stats {
+	u64 size;
+	u64 free_bytes;
+	u64 free_node_count;
+	u64 largest_free;
+	u64 decommitted_bytes;
+} Heap_Block_Stats;
 
-#if !OOGABOOGA_LINK_EXTERNAL_INSTANCE
-thread_local void * temporary_storage = 0;
-thread_local void * temporary_storage_pointer = 0;
-thread_local bool   has_warned_temporary_storage_overflow = false;
-thread_local Allocator temp_allocator;
+// Returns the existing tag if one with that name was already made.
+// Returns HEAP_TAG_NONE if we're out of tags (HEAP_MAX_TAGS).
+Heap_Tag
+heap_tag_make(string name) {
+	if (!heap_initted) heap_init();
+	
+	spinlock_acquire_or_wait(&heap_tags_lock);
+	
+	Heap_Tag tag = HEAP_TAG_NONE;
+	for (u64 i = 1; i < heap_tag_count; i++) {
+		if (strings_match(heap_tags[i].name, name)) {
+			tag = (Heap_Tag)i;
+			break;
+		}
+	}
+	
+	if (tag == HEAP_TAG_NONE && heap_tag_count < HEAP_MAX_TAGS) {
+		string copy;
+		copy.count = name.count;
+		copy.data = heap_alloc(max(name.count, 1));
+		memcpy(copy.data, name.data, name.count);
+		
+		tag = (Heap_Tag)heap_tag_count;
+		heap_tags[tag].name = copy;
+		// After the name is set, stats are read up to heap_tag_count without this lock
+		heap_tag_count += 1;
+	}
+	
+	spinlock_release(&heap_tags_lock);
+	
+	return tag;
+}
 
-ogb_instance Allocator 
-get_temporary_allocator() {
-	if (!temporary_storage) return get_initialization_allocator();
-	return temp_allocator;
+// Allocations on this thread get this tag from now on. Returns the previous tag.
+Heap_Tag
+heap_set_tag(Heap_Tag tag) {
+	assert(tag < HEAP_MAX_TAGS, "Invalid heap tag %d", (s32)tag);
+	Heap_Tag previous = heap_current_tag;
+	heap_current_tag = tag;
+	return previous;
+}
+Heap_Tag
+heap_get_tag() {
+	return heap_current_tag;
 }
-#endif
 
-ogb_instance void* 
-temp_allocator_proc(u64 size, void *p, Allocator_Message message, void* data);
+// Like other scopes, returning or breaking out of it skips resetting the tag.
+#define heap_tag_scope(tag) \
+	for (Heap_Tag _heap_tag_previous_ = heap_set_tag(tag), _heap_tag_once_ = 1; \
+	     _heap_tag_once_; \
+	     _heap_tag_once_ = 0, heap_set_tag(_heap_tag_previous_))
 
-ogb_instance void 
-temporary_storage_init(u64 arena_size);
+#define _HEAP_STRINGIFY(x) #x
+#define HEAP_STRINGIFY(x) _HEAP_STRINGIFY(x)
+#define heap_tag_scope_here() heap_tag_scope(heap_tag_make(STR(__FILE__ ":" HEAP_STRINGIFY(__LINE__))))
 
-ogb_instance void* 
-talloc(u64 size);
+Heap_Tag_Stats
+get_heap_tag_stats(Heap_Tag tag) {
+	assert(tag < HEAP_MAX_TAGS, "Invalid heap tag %d", (s32)tag);
+	spinlock_acquire_or_wait(&heap_lock.lock);
+	Heap_Tag_Stats stats = heap_tags[tag];
+	spinlock_release(&heap_lock.lock);
+	return stats;
+}
 
-ogb_instance void 
-reset_temporary_storage();
+// Assumes heap_lock is held
+Heap_Block_Stats
+get_heap_block_stats(Heap_Block *block) {
+	Heap_Block_Stats stats = ZERO(Heap_Block_Stats);
+	stats.size = get_heap_block_size_excluding_metadata(block);
+	stats.decommitted_bytes = block->decommitted_bytes;
+	for (Heap_Free_Node *node = block->free_head; node; node = node->next) {
+		stats.free_bytes += node->size;
+		stats.free_node_count += 1;
+		stats.largest_free = max(stats.largest_free, node->size);
+	}
+	return stats;
+}
 
+Heap_Stats
+get_heap_stats() {
+	if (!heap_initted) heap_init();
+	
+	Heap_Stats stats = ZERO(Heap_Stats);
+	
+	spinlock_acquire_or_wait(&heap_lock.lock);
+	
+	stats.bytes_in_use       = heap_allocated_bytes + heap_large_allocated_bytes;
+	stats.block_bytes        = heap_block_bytes;
+	stats.decommitted_bytes  = heap_decommitted_bytes;
+	stats.large_bytes        = heap_large_bytes;
+	stats.large_cached_bytes = heap_large_cached_bytes;
+	stats.bytes_committed    = heap_block_bytes - heap_decommitted_bytes + heap_large_bytes + heap_large_cached_bytes;
+	stats.live_allocations   = heap_live_allocations;
+	stats.total_allocations  = heap_total_allocations;
+	memcpy(stats.allocations_per_size_class, heap_size_classes, sizeof(heap_size_classes));
+	
+	for (Heap_Block *block = heap_head; block; block = block->next) {
+		Heap_Block_Stats block_stats = get_heap_block_stats(block);
+		stats.free_bytes      += block_stats.free_bytes;
+		stats.free_node_count += block_stats.free_node_count;
+		stats.largest_free     = max(stats.largest_free, block_stats.largest_free);
+		stats.block_count     += 1;
+	}
+	
+	spinlock_release(&heap_lock.lock);
+	
+	if (stats.free_bytes) {
+		stats.fragmentation = 1.0 - (float64)stats.largest_free/(float64)stats.free_bytes;
+	}
+	
+	return stats;
+}
 
-#if !OOGABOOGA_LINK_EXTERNAL_INSTANCE
+void
+string_builder_append_json_string(String_Builder *b, string s) {
+	string_builder_append(b, STR("\""));
+	for (u64 i = 0; i < s.count; i++) {
+		u8 c = s.data[i];
+		if (c == '"' || c == '\\') {
+			u8 escaped[2] = { '\\', c };
+			string_builder_append(b, (string){ 2, escaped });
+		} else if (c < 0x20) {
+			string_builder_print(b, STR("\\u%04x"), (u32)c);
+		} else {
+			string_builder_append(b, (string){ 1, &s.data[i] });
+		}
+	}
+	string_builder_append(b, STR("\""));
+}
+
+// Everything we know about the heap, for dumping to a file or sending somewhere.
+// Only tags with live allocations or allocations in the past are listed.
+string
+heap_stats_to_json(Allocator allocator) {
+	Heap_Stats stats = get_heap_stats();
+	
+	// Copy what we need while locked, we might be allocating on the heap while printing
+	Heap_Tag_Stats tags[HEAP_MAX_TAGS];
+	Heap_Block_Stats blocks[HEAP_STATS_MAX_LISTED_BLOCKS];
+	u64 tag_count = 0;
+	u64 block_count = 0;
+	spinlock_acquire_or_wait(&heap_lock.lock);
+	tag_count = heap_tag_count;
+	memcpy(tags, heap_tags, tag_count*sizeof(Heap_Tag_Stats));
+	for (Heap_Block *block = heap_head; block && block_count < HEAP_STATS_MAX_LISTED_BLOCKS; block = block->next) {
+		blocks[block_count] = get_heap_block_stats(block);
+		block_count += 1;
+	}
+	spinlock_release(&heap_lock.lock);
+	
+	String_Builder b;
+	string_builder_init_reserve(&b, KB(4), allocator);
+	
+	string_builder_print(&b, STR("{\n"));
+	string_builder_print(&b, STR("\t\"bytes_in_use\": %llu,\n"),       stats.bytes_in_use);
+	string_builder_print(&b, STR("\t\"bytes_committed\": %llu,\n"),    stats.bytes_committed);
+	string_builder_print(&b, STR("\t\"block_bytes\": %llu,\n"),        stats.block_bytes);
+	string_builder_print(&b, STR("\t\"decommitted_bytes\": %llu,\n"),  stats.decommitted_bytes);
+	string_builder_print(&b, STR("\t\"large_bytes\": %llu,\n"),        stats.large_bytes);
+	string_builder_print(&b, STR("\t\"large_cached_bytes\": %llu,\n"), stats.large_cached_bytes);
+	string_builder_print(&b, STR("\t\"free_bytes\": %llu,\n"),         stats.free_bytes);
+	string_builder_print(&b, STR("\t\"largest_free\": %llu,\n"),       stats.largest_free);
+	string_builder_print(&b, STR("\t\"free_node_count\": %llu,\n"),    stats.free_node_count);
+	string_builder_print(&b, STR("\t\"block_count\": %llu,\n"),        stats.block_count);
+	string_builder_print(&b, STR("\t\"live_allocations\": %llu,\n"),   stats.live_allocations);
+	string_builder_print(&b, STR("\t\"total_allocations\": %llu,\n"),  stats.total_allocations);
+	string_builder_print(&b, STR("\t\"fragmentation\": %.4f,\n"),      stats.fragmentation);
+	
+	string_builder_print(&b, STR("\t\"size_classes\": ["));
+	bool first = true;
+	for (u64 i = 0; i < HEAP_SIZE_CLASS_COUNT; i++) {
+		if (!stats.allocations_per_size_class[i]) continue;
+		string_builder_print(&b, STR("%s\n\t\t{ \"max_size\": %llu, \"live_allocations\": %llu }"), first ? STR("") : STR(","), 1ull << i, stats.allocations_per_size_class[i]);
+		first = false;
+	}
+	string_builder_print(&b, STR("\n\t],\n"));
+	
+	string_builder_print(&b, STR("\t\"blocks\": ["));
+	for (u64 i = 0; i < block_count; i++) {
+		string_builder_print(&b, STR("%s\n\t\t{ \"size\": %llu, \"free_bytes\": %llu, \"free_node_count\": %llu, \"largest_free\": %llu, \"decommitted_bytes\": %llu }"), i ? STR(",") : STR(""), blocks[i].size, blocks[i].free_bytes, blocks[i].free_node_count, blocks[i].largest_free, blocks[i].decommitted_bytes);
+	}
+	string_builder_print(&b, STR("\n\t],\n"));
+	
+	string_builder_print(&b, STR("\t\"tags\": ["));
+	first = true;
+	for (u64 i = 0; i < tag_count; i++) {
+		if (!tags[i].total_allocations) continue;
+		string_builder_print(&b, STR("%s\n\t\t{ \"name\": "), first ? STR("") : STR(","));
+		string_builder_append_json_string(&b, tags[i].name);
+		string_builder_print(&b, STR(", \"live_bytes\": %llu, \"live_allocations\": %llu, \"peak_bytes\": %llu, \"total_allocations\": %llu }"), tags[i].live_bytes, tags[i].live_allocations, tags[i].peak_bytes, tags[i].total_allocations);
+		first = false;
+	}
+	string_builder_print(&b, STR("\n\t]\n}\n"));
+	
+	return string_builder_get_string(b);
+}
+
+///
+///
+// Arena
+///
+// Linear allocator in its own reserved range of virtual memory. Memory is only committed as
+// it's used, so reserving a lot is cheap. Nothing is freed individually, instead you reset
+// the whole arena or go back to a mark:
+//
+//     Arena *level_arena = arena_make(GB(4));
+//     Allocator level_allocator = get_arena_allocator(level_arena);
+//     ...
+//     arena_reset(level_arena); // New level
+//
+//     arena_scope(frame_arena) {
+//         // Everything allocated in here is freed at the end of the scope
+//     }
+//
+// arena_push is uninitialized, like talloc. alloc() on an arena allocator zeroes as usual.
+
+#ifndef ARENA_DEFAULT_RESERVE_SIZE
+	#define ARENA_DEFAULT_RESERVE_SIZE GB(1)
+#endif
+// Commit this much at a time, so we don't go to the OS for every page
+#ifndef ARENA_COMMIT_SIZE
+	#define ARENA_COMMIT_SIZE KB(64)
+#endif
+// With ENABLE_LARGE_PAGES, arenas made with a reserve size in this range get large pages.
+// Large pages have to be committed up front so it's not for the default reserve size, or
+// for arenas that reserve a lot "just in case".
+#ifndef ARENA_LARGE_PAGES_MIN_SIZE
+	#define ARENA_LARGE_PAGES_MIN_SIZE MB(16)
+#endif
+#ifndef ARENA_LARGE_PAGES_MAX_SIZE
+	#define ARENA_LARGE_PAGES_MAX_SIZE MB(512)
+#endif
+#define ARENA_DEFAULT_ALIGNMENT 16
+
+typedef struct Arena Arena;
+typedef struct Arena {
+	u8 *base; // The Arena itself lives at the start of its reservation
+	u64 reserved;
+	u64 committed;
+	u64 pos;
+	u64 last_allocation; // So the last allocation can grow in place on reallocate
+	u64 high_water;
+	Arena *next; // All live arenas are linked so is_pointer_valid() can know about them
+	Arena *previous;
+} Arena;
+
+typedef struct Arena_Mark {
+	Arena *arena;
+	u64 pos;
+} Arena_Mark;
+
+#define ARENA_HEADER_SIZE align_next(sizeof(Arena), 64)
+#define ARENA_NO_LAST_ALLOCATION 0xFFFFFFFFFFFFFFFFull
+
+// #Global
+ogb_instance Arena *arena_list;
+ogb_instance Spinlock arena_list_lock;
+
+#if !OOGABOOGA_LINK_EXTERNAL_INSTANCE
+Arena *arena_list = 0;
+Spinlock arena_list_lock;
+#endif // NOT OOGABOOGA_LINK_EXTERNAL_INSTANCE
+
+bool
+is_pointer_in_arena(void *p) {
+	bool result = false;
+	spinlock_acquire_or_wait(&arena_list_lock);
+	for (Arena *arena = arena_list; arena; arena = arena->next) {
+		if ((u8*)p >= arena->base && (u8*)p < arena->base + arena->reserved) {
+			result = true;
+			break;
+		}
+	}
+	spinlock_release(&arena_list_lock);
+	return result;
+}
+
+bool
+arena_commit_to(Arena *arena, u64 end) {
+	if (end <= arena->committed) return true;
+	u64 new_committed = min(align_next(end, ARENA_COMMIT_SIZE), arena->reserved);
+	if (!os_commit_memory(arena->base + arena->committed, new_committed - arena->committed)) return false;
+	arena->committed = new_committed;
+	return true;
+}
+
+// reserve_size 0 for ARENA_DEFAULT_RESERVE_SIZE.
+// allow_large_pages false for arenas that should commit as they go no matter their size, like
+// per-thread scratch that's mostly unused.
+Arena *
+arena_make_with_large_pages(u64 reserve_size, bool allow_large_pages) {
+	if (reserve_size == 0) reserve_size = ARENA_DEFAULT_RESERVE_SIZE;
+	reserve_size = align_next(reserve_size + ARENA_HEADER_SIZE, max(ARENA_COMMIT_SIZE, os.page_size));
+	
+	u8 *base = 0;
+	u64 committed = 0;
+#if ENABLE_LARGE_PAGES
+	if (allow_large_pages && os.large_page_size && reserve_size >= ARENA_LARGE_PAGES_MIN_SIZE && reserve_size <= ARENA_LARGE_PAGES_MAX_SIZE) {
+		u64 large_size = align_next(reserve_size, os.large_page_size);
+		base = (u8*)os_reserve_and_commit_large_pages(large_size);
+		if (base) {
+			reserve_size = large_size;
+			committed = large_size;
+		}
+	}
+#endif
+	if (!base) base = (u8*)os_reserve_memory(reserve_size);
+	assert(base, "Failed reserving %llu bytes for arena. Out of address space?", reserve_size);
+	note_reserved_memory(base, reserve_size);
+	
+	Arena header = ZERO(Arena);
+	header.base = base;
+	header.reserved = reserve_size;
+	header.committed = committed;
+	bool ok = arena_commit_to(&header, ARENA_HEADER_SIZE);
+	assert(ok, "Failed committing memory for arena. Out of memory?");
+	
+	Arena *arena = (Arena*)base;
+	*arena = header;
+	arena->pos = ARENA_HEADER_SIZE;
+	arena->high_water = arena->pos;
+	arena->last_allocation = ARENA_NO_LAST_ALLOCATION;
+	
+	spinlock_acquire_or_wait(&arena_list_lock);
+	arena->next = arena_list;
+	if (arena_list) arena_list->previous = arena;
+	arena_list = arena;
+	spinlock_release(&arena_list_lock);
+	
+	return arena;
+}
+Arena *
+arena_make(u64 reserve_size) {
+	return arena_make_with_large_pages(reserve_size, true);
+}
+void
+arena_destroy(Arena *arena) {
+	spinlock_acquire_or_wait(&arena_list_lock);
+	if (arena->previous) arena->previous->next = arena->next;
+	else arena_list = arena->next;
+	if (arena->next) arena->next->previous = arena->previous;
+	spinlock_release(&arena_list_lock);
+	
+	os_release_memory(arena->base, arena->reserved);
+}
+
+void *
+arena_push_aligned(Arena *arena, u64 size, u64 alignment) {
+	assert(alignment > 0 && (alignment & (alignment-1)) == 0, "Arena alignment must be a power of two, got %llu", alignment);
+	
+	u64 start = align_next(arena->pos, alignment);
+	u64 end = start + size;
+	assert(end <= arena->reserved, "Arena ran out of its %llu reserved bytes. Make it with a larger reserve size.", arena->reserved);
+	
+	bool ok = arena_commit_to(arena, end);
+	assert(ok, "Failed committing memory for arena. Out of memory?");
+	
+	arena->pos = end;
+	arena->last_allocation = start;
+	arena->high_water = max(arena->high_water, end);
+	
+	return arena->base + start;
+}
+void *
+arena_push(Arena *arena, u64 size) {
+	return arena_push_aligned(arena, size, ARENA_DEFAULT_ALIGNMENT);
+}
+
+void
+arena_reset(Arena *arena) {
+	arena->pos = ARENA_HEADER_SIZE;
+	arena->last_allocation = ARENA_NO_LAST_ALLOCATION;
+}
+
+// Bytes in use, not counting the arena header
+u64
+arena_get_used(Arena *arena) {
+	return arena->pos - ARENA_HEADER_SIZE;
+}
+
+Arena_Mark
+arena_get_mark(Arena *arena) {
+	return (Arena_Mark){ arena, arena->pos };
+}
+void
+arena_pop_to_mark(Arena_Mark mark) {
+	assert(mark.pos >= ARENA_HEADER_SIZE && mark.pos <= mark.arena->pos, "Arena mark is newer than the arena position. Did you pop marks out of order?");
+	mark.arena->pos = mark.pos;
+	mark.arena->last_allocation = ARENA_NO_LAST_ALLOCATION;
+}
+
+// Frees everything allocated in the scope when it ends. Returning or breaking out of the
+// scope skips that, so don't.
+#define arena_scope(arena) \
+	for (Arena_Mark _arena_mark_ = arena_get_mark(arena), *_arena_once_ = &_arena_mark_; \
+	     _arena_once_; \
+	     _arena_once_ = 0, arena_pop_to_mark(_arena_mark_))
+
+void* arena_allocator_proc(u64 size, void *p, Allocator_Message message, void *data) {
+	Arena *arena = (Arena*)data;
+	switch (message) {
+		case ALLOCATOR_ALLOCATE: {
+			return arena_push(arena, size);
+		}
+		case ALLOCATOR_ALLOCATE_ZEROED: {
+			// Past the high water mark it's never been handed out, so still zero from the OS
+			u64 untouched = arena->high_water;
+			u8 *result = (u8*)arena_push(arena, size);
+			u64 start = (u64)(result - arena->base);
+			if (start < untouched) memset(result, 0, min(size, untouched - start));
+			return result;
+		}
+		case ALLOCATOR_ALLOCATE_ALIGNED: {
+			return arena_push_aligned(arena, size, max((u64)p, ARENA_DEFAULT_ALIGNMENT));
+		}
+		case ALLOCATOR_DEALLOCATE: {
+			// We can only give back the last allocation
+			if ((u8*)p - arena->base == arena->last_allocation) {
+				arena->pos = arena->last_allocation;
+				arena->last_allocation = ARENA_NO_LAST_ALLOCATION;
+			}
+			return 0;
+		}
+		case ALLOCATOR_REALLOCATE: {
+			if (!p) return arena_push(arena, size);
+			
+			u64 offset = (u64)((u8*)p - arena->base);
+			assert(offset >= ARENA_HEADER_SIZE && offset < arena->pos, "Pointer passed to arena reallocate is not in the arena");
+			
+			if (offset == arena->last_allocation) {
+				// Grow or shrink in place
+				arena->pos = offset;
+				return arena_push_aligned(arena, size, 1);
+			}
+			
+			// We don't know the old size, but it can't go past the end of the arena
+			u64 old_size_at_most = arena->pos - offset;
+			void *new = arena_push(arena, size);
+			memcpy(new, p, min(size, old_size_at_most));
+			return new;
+		}
+	}
+	return 0;
+}
+
+Allocator
+get_arena_allocator(Arena *arena) {
+	Allocator a;
+	a.proc = arena_allocator_proc;
+	a.data = arena;
+	return a;
+}
+
+///
+///
+// Pool
+///
+// For lots of things of the same size. Elements are allocated in chunks from a backing
+// allocator, and freed elements go on a free list that lives in the elements themselves, so
+// alloc and free are a pop and a push. Chunks are only given back in pool_deinit().
+//
+//     Pool bullet_pool;
+//     pool_init(&bullet_pool, sizeof(Bullet), 256, get_heap_allocator());
+//     Bullet *bullet = pool_alloc(&bullet_pool);
+//     ...
+//     pool_free(&bullet_pool, bullet);
+//
+// Pools are thread safe. If use_thread_caches is set, each thread keeps a few free elements
+// for itself so most allocs and frees don't touch the pool lock. Only do that for pools that
+// outlive the threads using them, or cached elements will point into a deinitialized pool.
+// pool_alloc is uninitialized, like arena_push. alloc() on a pool allocator zeroes as usual.
+
+#define POOL_DEFAULT_ALIGNMENT 16
+// Elements moved between a thread cache and the pool at a time
+#define POOL_THREAD_CACHE_BATCH 32
+// How many pools one thread can have caches for. Pools past that just use the lock.
+#define POOL_MAX_THREAD_CACHES 16
+
+typedef struct Pool_Free_Element Pool_Free_Element;
+typedef struct Pool_Chunk Pool_Chunk;
+
+typedef struct Pool_Free_Element {
+	Pool_Free_Element *next;
+} Pool_Free_Element;
+
+typedef struct Pool_Chunk {
+	Pool_Chunk *next;
+} Pool_Chunk;
+
+typedef struct Pool {
+	u64 element_size; // Including padding for alignment
+	u64 alignment;
+	u64 elements_per_chunk;
+	Allocator backing;
+	bool use_thread_caches; // Set this after pool_init() and before using the pool
+	
+	Spinlock lock;
+	Pool_Free_Element *free_head;
+	Pool_Chunk *chunks;
+	u64 chunk_count;
+} Pool;
+
+typedef struct Pool_Thread_Cache {
+	Pool *pool;
+	Pool_Free_Element *head;
+	u64 count;
+} Pool_Thread_Cache;
+
+// #Global
+// Not shared with an external instance on purpose, each module just keeps its own caches.
+thread_local Pool_Thread_Cache pool_thread_caches[POOL_MAX_THREAD_CACHES];
+
+#define POOL_CHUNK_HEADER_SIZE(pool) align_next(sizeof(Pool_Chunk), (pool)->alignment)
+
+void
+pool_init_aligned(Pool *pool, u64 element_size, u64 alignment, u64 elements_per_chunk, Allocator backing) {
+	assert(element_size > 0, "Pool element size can't be zero");
+	assert(alignment > 0 && (alignment & (alignment-1)) == 0, "Pool alignment must be a power of two, got %llu", alignment);
+	assert(elements_per_chunk > 0, "Pool needs at least one element per chunk");
+	
+	*pool = ZERO(Pool);
+	pool->alignment = max(alignment, sizeof(Pool_Free_Element));
+	pool->element_size = align_next(max(element_size, sizeof(Pool_Free_Element)), pool->alignment);
+	pool->elements_per_chunk = elements_per_chunk;
+	pool->backing = backing;
+	spinlock_init(&pool->lock);
+}
+void
+pool_init(Pool *pool, u64 element_size, u64 elements_per_chunk, Allocator backing) {
+	pool_init_aligned(pool, element_size, POOL_DEFAULT_ALIGNMENT, elements_per_chunk, backing);
+}
+
+void
+pool_deinit(Pool *pool) {
+	Pool_Chunk *chunk = pool->chunks;
+	while (chunk) {
+		Pool_Chunk *next = chunk->next;
+		dealloc(pool->backing, chunk);
+		chunk = next;
+	}
+	*pool = ZERO(Pool);
+}
+
+// Assumes pool->lock is held
+void
+pool_grow(Pool *pool) {
+	u64 chunk_size = POOL_CHUNK_HEADER_SIZE(pool) + pool->element_size*pool->elements_per_chunk;
+	Pool_Chunk *chunk;
+	if (pool->alignment <= 16) chunk = alloc_uninitialized(pool->backing, chunk_size);
+	else                       chunk = alloc_aligned(pool->backing, chunk_size, pool->alignment);
+	assert(chunk, "Pool failed allocating a chunk from its backing allocator");
+	
+	chunk->next = pool->chunks;
+	pool->chunks = chunk;
+	pool->chunk_count += 1;
+	
+	// Backwards so the elements are handed out in address order
+	u8 *first = (u8*)chunk + POOL_CHUNK_HEADER_SIZE(pool);
+	for (s64 i = (s64)pool->elements_per_chunk-1; i >= 0; i--) {
+		Pool_Free_Element *element = (Pool_Free_Element*)(first + (u64)i*pool->element_size);
+		element->next = pool->free_head;
+		pool->free_head = element;
+	}
+}
+
+bool
+pool_owns(Pool *pool, void *p) {
+	bool result = false;
+	spinlock_acquire_or_wait(&pool->lock);
+	u64 elements_size = pool->element_size*pool->elements_per_chunk;
+	for (Pool_Chunk *chunk = pool->chunks; chunk; chunk = chunk->next) {
+		u8 *first = (u8*)chunk + POOL_CHUNK_HEADER_SIZE(pool);
+		if ((u8*)p >= first && (u8*)p < first + elements_size) {
+			result = ((u64)((u8*)p - first) % pool->element_size) == 0;
+			break;
+		}
+	}
+	spinlock_release(&pool->lock);
+	return result;
+}
+
+Pool_Thread_Cache *
+pool_get_thread_cache(Pool *pool) {
+	Pool_Thread_Cache *unused = 0;
+	for (u64 i = 0; i < POOL_MAX_THREAD_CACHES; i++) {
+		if (pool_thread_caches[i].pool == pool) return &pool_thread_caches[i];
+		if (!unused && !pool_thread_caches[i].pool) unused = &pool_thread_caches[i];
+	}
+	if (unused) unused->pool = pool;
+	return unused;
+}
+
+void *
+pool_alloc(Pool *pool) {
+	Pool_Thread_Cache *cache = pool->use_thread_caches ? pool_get_thread_cache(pool) : 0;
+	
+	if (cache) {
+		if (!cache->head) {
+			spinlock_acquire_or_wait(&pool->lock);
+			for (u64 i = 0; i < POOL_THREAD_CACHE_BATCH; i++) {
+				if (!pool->free_head) pool_grow(pool);
+				Pool_Free_Element *element = pool->free_head;
+				pool->free_head = element->next;
+				element->next = cache->head;
+				cache->head = element;
+				cache->count += 1;
+			}
+			spinlock_release(&pool->lock);
+		}
+		Pool_Free_Element *element = cache->head;
+		cache->head = element->next;
+		cache->count -= 1;
+		return element;
+	}
+	
+	spinlock_acquire_or_wait(&pool->lock);
+	if (!pool->free_head) pool_grow(pool);
+	Pool_Free_Element *element = pool->free_head;
+	pool->free_head = element->next;
+	spinlock_release(&pool->lock);
+	
+	return element;
+}
+
+void
+pool_free(Pool *pool, void *p) {
+#if CONFIGURATION == DEBUG
+	assert(pool_owns(pool, p), "Pointer passed to pool_free is not an element in this pool");
+	memset(p, 0x69, pool->element_size);
+#endif
+	Pool_Free_Element *element = (Pool_Free_Element*)p;
+	
+	Pool_Thread_Cache *cache = pool->use_thread_caches ? pool_get_thread_cache(pool) : 0;
+	if (cache) {
+		element->next = cache->head;
+		cache->head = element;
+		cache->count += 1;
+		
+		if (cache->count >= POOL_THREAD_CACHE_BATCH*2) {
+			// Give some back so other threads can have them
+			spinlock_acquire_or_wait(&pool->lock);
+			for (u64 i = 0; i < POOL_THREAD_CACHE_BATCH; i++) {
+				Pool_Free_Element *give = cache->head;
+				cache->head = give->next;
+				give->next = pool->free_head;
+				pool->free_head = give;
+			}
+			cache->count -= POOL_THREAD_CACHE_BATCH;
+			spinlock_release(&pool->lock);
+		}
+		return;
+	}
+	
+	spinlock_acquire_or_wait(&pool->lock);
+	element->next = pool->free_head;
+	pool->free_head = element;
+	spinlock_release(&pool->lock);
+}
+
+// Gives everything in this thread's caches back to their pools. Threads made with
+// os_thread_start() do this when they exit.
+void
+pool_flush_thread_caches() {
+	for (u64 i = 0; i < POOL_MAX_THREAD_CACHES; i++) {
+		Pool_Thread_Cache *cache = &pool_thread_caches[i];
+		if (!cache->pool) continue;
+		
+		spinlock_acquire_or_wait(&cache->pool->lock);
+		while (cache->head) {
+			Pool_Free_Element *element = cache->head;
+			cache->head = element->next;
+			element->next = cache->pool->free_head;
+			cache->pool->free_head = element;
+		}
+		spinlock_release(&cache->pool->lock);
+		
+		*cache = ZERO(Pool_Thread_Cache);
+	}
+}
+
+void* pool_allocator_proc(u64 size, void *p, Allocator_Message message, void *data) {
+	Pool *pool = (Pool*)data;
+	switch (message) {
+		case ALLOCATOR_ALLOCATE: {
+			assert(size <= pool->element_size, "Allocation of %llu bytes is too big for a pool of %llu byte elements", size, pool->element_size);
+			return pool_alloc(pool);
+		}
+		case ALLOCATOR_ALLOCATE_ALIGNED: {
+			assert(size <= pool->element_size, "Allocation of %llu bytes is too big for a pool of %llu byte elements", size, pool->element_size);
+			if ((u64)p > pool->alignment) return 0;
+			return pool_alloc(pool);
+		}
+		case ALLOCATOR_ALLOCATE_ZEROED: {
+			return 0; // Elements are reused, alloc_zeroed() clears them
+		}
+		case ALLOCATOR_DEALLOCATE: {
+			pool_free(pool, p);
+			return 0;
+		}
+		case ALLOCATOR_REALLOCATE: {
+			if (!p) return pool_alloc(pool);
+			assert(size <= pool->element_size, "Can't reallocate to %llu bytes in a pool of %llu byte elements", size, pool->element_size);
+			return p;
+		}
+	}
+	return 0;
+}
+
+Allocator
+get_pool_allocator(Pool *pool) {
+	Allocator a;
+	a.proc = pool_allocator_proc;
+	a.data = pool;
+	return a;
+}
+
+///
+///
+// Temporary storage
+///
+// Per-thread bump allocator, reset with reset_temporary_storage() (usually once per frame).
+// When a block runs out we chain a new, bigger one instead of wrapping around over memory
+// that might still be in use. On reset, if we had to chain, the first block is replaced by
+// one big enough for the high water mark so the next frame fits in one block again.
+//
+// Library code that wants temp memory without resetting the caller's can use a scope:
+//
+//     temp_scope() {
+//         void *scratch = talloc(1024);
+//     } // scratch is freed here, everything the caller talloc'd before is untouched
+//
+// or Temp_Scope scope = temp_scope_begin(); ... temp_scope_end(scope);
+//
+// The first block can also be memory we don't own (temporary_storage_init_with_memory), that's
+// how worker threads get theirs. It's never freed, and only replaced if it turned out too small.
+
+#ifndef TEMPORARY_STORAGE_SIZE
+	#define TEMPORARY_STORAGE_SIZE (1024ULL*1024ULL*2ULL) // 2mb
+#endif
+#define TEMPORARY_STORAGE_ALIGNMENT 16
+
+typedef struct Temporary_Storage_Block Temporary_Storage_Block;
+typedef struct Temporary_Storage_Block {
+	Temporary_Storage_Block *previous;
+	u64 size; // Including this header
+	u64 padding[2];
+} Temporary_Storage_Block;
+
+typedef struct Temp_Scope {
+	Temporary_Storage_Block *block;
+	void *pointer;
+	u64 used;
+} Temp_Scope;
+
+ogb_instance void* talloc(u64);
+ogb_instance void* temp_allocator_proc(u64 size, void *p, Allocator_Message message, void*);
+
+// #Global
+ogb_instance Allocator 
+get_temporary_allocator();
+
+#if !OOGABOOGA_LINK_EXTERNAL_INSTANCE
+thread_local void * temporary_storage = 0; // First block
+thread_local void * temporary_storage_pointer = 0;
+thread_local Temporary_Storage_Block *temporary_storage_block = 0; // Current block
+thread_local u64 temporary_storage_used = 0;
+thread_local u64 temporary_storage_high_water = 0;
+thread_local u64 temporary_storage_last_high_water = 0;
+thread_local bool temporary_storage_first_block_borrowed = false;
+thread_local Allocator temp_allocator;
+
+ogb_instance Allocator 
+get_temporary_allocator() {
+	if (!temporary_storage) return get_initialization_allocator();
+	return temp_allocator;
+}
+#endif
+
+ogb_instance void* 
+temp_allocator_proc(u64 size, void *p, Allocator_Message message, void* data);
+
+ogb_instance void 
+temporary_storage_init(u64 arena_size);
+
+// memory must be TEMPORARY_STORAGE_ALIGNMENT aligned and stay valid until temporary_storage_deinit()
+ogb_instance void 
+temporary_storage_init_with_memory(void *memory, u64 size);
+
+ogb_instance void 
+temporary_storage_deinit();
+
+ogb_instance void* 
+talloc(u64 size);
+
+ogb_instance void 
+reset_temporary_storage();
+
+ogb_instance Temp_Scope 
+temp_scope_begin();
+
+ogb_instance void 
+temp_scope_end(Temp_Scope scope);
+
+// Most temp memory in use since the last reset, and between the two resets before that
+ogb_instance u64 
+get_temporary_storage_high_water();
+ogb_instance u64 
+get_temporary_storage_last_high_water();
+
+#define temp_scope() \
+	for (Temp_Scope _temp_scope_ = temp_scope_begin(), *_temp_scope_once_ = &_temp_scope_; \
+	     _temp_scope_once_; \
+	     _temp_scope_once_ = 0, temp_scope_end(_temp_scope_))
+
+
+#if !OOGABOOGA_LINK_EXTERNAL_INSTANCE
 void* temp_allocator_proc(u64 size, void *p, Allocator_Message message, void* data) {
 	switch (message) {
 		case ALLOCATOR_ALLOCATE: {
 			return talloc(size);
 			break;
 		}
+		case ALLOCATOR_ALLOCATE_ZEROED: {
+			return 0; // Reused every frame, alloc_zeroed() clears it
+		}
+		case ALLOCATOR_ALLOCATE_ALIGNED: {
+			u64 alignment = (u64)p;
+			if (alignment <= TEMPORARY_STORAGE_ALIGNMENT) return talloc(size);
+			return (void*)align_next((u64)talloc(size + alignment), alignment);
+		}
 		case ALLOCATOR_DEALLOCATE: {
 			return 0;
 		}
@@ -625,41 +2029,366 @@ void* temp_allocator_proc(u64 size, void *p, Allocator_Message message, void* da
 	return 0;
 }
 
-void temporary_storage_init(u64 arena_size) {
-	
-	temporary_storage = heap_alloc(arena_size);
-	assert(temporary_storage, "Failed allocating temporary storage");
-	temporary_storage_pointer = temporary_storage;
+Temporary_Storage_Block *
+temporary_storage_make_block(u64 size, Temporary_Storage_Block *previous) {
+	size = align_next(size, TEMPORARY_STORAGE_ALIGNMENT);
+	Temporary_Storage_Block *block = heap_alloc(size);
+	assert(block, "Failed allocating temporary storage");
+	block->previous = previous;
+	block->size = size;
+	return block;
+}
+
+void temporary_storage_set_block(Temporary_Storage_Block *block) {
+	temporary_storage_block = block;
+	temporary_storage_pointer = block+1;
+}
+
+void temporary_storage_init_first_block(Temporary_Storage_Block *block, bool borrowed) {
+	temporary_storage = block;
+	temporary_storage_first_block_borrowed = borrowed;
+	temporary_storage_set_block(block);
+	temporary_storage_used = 0;
+	temporary_storage_high_water = 0;
+	temporary_storage_last_high_water = 0;
 
 	temp_allocator.proc = temp_allocator_proc;
 	temp_allocator.data = 0;
+}
+
+void temporary_storage_init(u64 arena_size) {
 	
-	temp_allocator.proc = temp_allocator_proc;
+	Temporary_Storage_Block *block = temporary_storage_make_block(arena_size + sizeof(Temporary_Storage_Block), 0);
+	temporary_storage_init_first_block(block, false);
+}
+
+void temporary_storage_init_with_memory(void *memory, u64 size) {
+	assert((u64)memory % TEMPORARY_STORAGE_ALIGNMENT == 0, "Temporary storage memory must be %d aligned", TEMPORARY_STORAGE_ALIGNMENT);
+	assert(size > sizeof(Temporary_Storage_Block), "Too little memory for temporary storage (%llu bytes)", size);
+	
+	Temporary_Storage_Block *block = (Temporary_Storage_Block*)memory;
+	block->previous = 0;
+	block->size = size - size % TEMPORARY_STORAGE_ALIGNMENT;
+	temporary_storage_init_first_block(block, true);
+}
+
+// Frees every block after (not including) the given one
+void temporary_storage_free_blocks_after(Temporary_Storage_Block *last_to_keep) {
+	Temporary_Storage_Block *block = temporary_storage_block;
+	while (block != last_to_keep) {
+		assert(block, "Temp_Scope block is not in this thread's temporary storage. Did you end a scope on another thread?");
+		Temporary_Storage_Block *previous = block->previous;
+		if (block != temporary_storage || !temporary_storage_first_block_borrowed) heap_dealloc(block);
+		block = previous;
+	}
+}
+
+void temporary_storage_deinit() {
+	if (!temporary_storage) return;
+	temporary_storage_free_blocks_after(0);
+	temporary_storage = 0;
+	temporary_storage_block = 0;
+	temporary_storage_pointer = 0;
+	temporary_storage_first_block_borrowed = false;
 }
 
 void* talloc(u64 size) {
 	
-	assert(size < TEMPORARY_STORAGE_SIZE, "Bruddah this is too large for temp allocator");
+	if (!temporary_storage) return alloc(get_initialization_allocator(), size);
+	
+	size = align_next(size, TEMPORARY_STORAGE_ALIGNMENT);
+	
+	u8 *block_end = (u8*)temporary_storage_block + temporary_storage_block->size;
+	if ((u8*)temporary_storage_pointer + size > block_end) {
+		// Chain a new block. What's left at the end of this one is counted as used, so the
+		// high water mark is enough to fit everything in one block next time.
+		temporary_storage_used += (u64)(block_end - (u8*)temporary_storage_pointer);
+		
+		u64 new_size = max(temporary_storage_block->size*2, size + sizeof(Temporary_Storage_Block));
+		temporary_storage_set_block(temporary_storage_make_block(new_size, temporary_storage_block));
+	}
 	
 	void* p = temporary_storage_pointer;
 	
 	temporary_storage_pointer = (u8*)temporary_storage_pointer + size;
-	
-	if ((u8*)temporary_storage_pointer >= (u8*)temporary_storage+TEMPORARY_STORAGE_SIZE) {
-		if (!has_warned_temporary_storage_overflow) {
-			os_write_string_to_stdout(STR("WARNING: temporary storage was overflown, we wrap around at the start.\n"));
-			has_warned_temporary_storage_overflow = true;
-		}
-		temporary_storage_pointer = temporary_storage;
-		return talloc(size);;
-	}
+	temporary_storage_used += size;
+	temporary_storage_high_water = max(temporary_storage_high_water, temporary_storage_used);
 	
 	return p;
 }
 
 void reset_temporary_storage() {
-	temporary_storage_pointer = temporary_storage;	
-	has_warned_temporary_storage_overflow = false;
+	if (!temporary_storage) return;
+	
+	Temporary_Storage_Block *first = (Temporary_Storage_Block*)temporary_storage;
+	
+	if (temporary_storage_block != first) {
+		// We overflowed, so make the first block large enough for that from now on
+		temporary_storage_free_blocks_after(0);
+		u64 new_size = get_next_power_of_two(temporary_storage_high_water + sizeof(Temporary_Storage_Block));
+		first = temporary_storage_make_block(new_size, 0);
+		temporary_storage = first;
+		temporary_storage_first_block_borrowed = false;
+	}
+	
+	temporary_storage_set_block(first);
+	temporary_storage_used = 0;
+	temporary_storage_last_high_water = temporary_storage_high_water;
+	temporary_storage_high_water = 0;
+}
+
+Temp_Scope temp_scope_begin() {
+	Temp_Scope scope;
+	scope.block   = temporary_storage_block;
+	scope.pointer = temporary_storage_pointer;
+	scope.used    = temporary_storage_used;
+	return scope;
+}
+
+void temp_scope_end(Temp_Scope scope) {
+	if (!temporary_storage) return;
+	temporary_storage_free_blocks_after(scope.block);
+	temporary_storage_block   = scope.block;
+	temporary_storage_pointer = scope.pointer;
+	temporary_storage_used    = scope.used;
 }
 
-#endif // NOT OOGABOOGA_LINK_EXTERNAL_INSTANCE
\ No newline at end of file
+u64 get_temporary_storage_high_water() {
+	return temporary_storage_high_water;
+}
+u64 get_temporary_storage_last_high_water() {
+	return temporary_storage_last_high_water;
+}
+
+#endif // NOT OOGABOOGA_LINK_EXTERNAL_INSTANCE
+
+///
+///
+// Third party allocations
+///
+// stb_image, stb_truetype and stb_vorbis allocate through the per-thread third_party_allocator,
+// so images, fonts and audio can be decoded on several threads at once. Set it with a scope,
+// scopes nest:
+//
+//     Third_Party_Scope scope = third_party_scope_begin(allocator);
+//     u8 *pixels = stbi_load_from_memory(...);
+//     third_party_scope_end(scope);
+//
+// Decoder temporaries go in a per-thread scratch arena (third_party_scratch_alloc), which is
+// popped back when the scope ends. To put everything stb allocates in the scratch arena, make
+// a scope with get_third_party_scratch_allocator().
+
+#ifndef THIRD_PARTY_SCRATCH_RESERVE_SIZE
+	#define THIRD_PARTY_SCRATCH_RESERVE_SIZE MB(256)
+#endif
+
+typedef struct Third_Party_Scope {
+	Allocator previous_allocator;
+	Arena_Mark scratch_mark;
+} Third_Party_Scope;
+
+thread_local Arena *third_party_scratch = 0;
+
+Arena *
+get_third_party_scratch() {
+	// Never large pages, those would commit and lock the whole reserve up front on every thread
+	// that decodes anything, including the audio thread in the middle of mixing.
+	if (!third_party_scratch) third_party_scratch = arena_make_with_large_pages(THIRD_PARTY_SCRATCH_RESERVE_SIZE, false);
+	return third_party_scratch;
+}
+Allocator
+get_third_party_scratch_allocator() {
+	return get_arena_allocator(get_third_party_scratch());
+}
+
+void *
+third_party_scratch_alloc(size_t size) {
+	assert(third_party_allocator.proc, "Third party scratch memory used outside of a third party scope");
+	return arena_push(get_third_party_scratch(), size);
+}
+
+Third_Party_Scope
+third_party_scope_begin(Allocator allocator) {
+	Third_Party_Scope scope;
+	scope.previous_allocator = third_party_allocator;
+	scope.scratch_mark = arena_get_mark(get_third_party_scratch());
+	third_party_allocator = allocator;
+	return scope;
+}
+void
+third_party_scope_end(Third_Party_Scope scope) {
+	arena_pop_to_mark(scope.scratch_mark);
+	third_party_allocator = scope.previous_allocator;
+}
+
+// Called when a thread exits
+void
+third_party_scratch_deinit() {
+	if (!third_party_scratch) return;
+	arena_destroy(third_party_scratch);
+	third_party_scratch = 0;
+}
+
+///
+///
+// Worker contexts
+///
+// Making a bunch of threads the usual way means each one heap allocates its temporary storage
+// under the heap lock, and then page faults its way through it on first use. A Worker_Group
+// instead makes all its threads' memory up front in one reservation (an arena, so it gets large
+// pages with ENABLE_LARGE_PAGES when the size is right). Each worker gets its own slice with its
+// temporary storage and profiler buffer, and starts with a context carrying the allocator and
+// logger from the policy:
+//
+//     Worker_Group group;
+//     Worker_Policy policy = ZERO(Worker_Policy);
+//     policy.temporary_storage_size = MB(4);
+//     worker_group_init(&group, os_get_number_of_logical_processors(), job_thread_proc, &job_queue, policy);
+//     worker_group_start(&group);
+//     ...
+//     worker_group_destroy(&group); // Joins
+//
+// In the thread proc, get_worker_context() (or t->worker_context) has the worker's index.
+// Slices are page aligned so workers never share a page.
+
+#ifndef WORKER_DEFAULT_TEMPORARY_STORAGE_SIZE
+	#define WORKER_DEFAULT_TEMPORARY_STORAGE_SIZE MB(1)
+#endif
+#ifndef WORKER_DEFAULT_PROFILER_BUFFER_SIZE
+	#if ENABLE_PROFILING
+		#define WORKER_DEFAULT_PROFILER_BUFFER_SIZE KB(64)
+	#else
+		#define WORKER_DEFAULT_PROFILER_BUFFER_SIZE 0
+	#endif
+#endif
+
+typedef struct Worker_Policy {
+	u64 temporary_storage_size; // Per worker, 0 for WORKER_DEFAULT_TEMPORARY_STORAGE_SIZE
+	u64 profiler_buffer_size;   // Per worker, 0 for WORKER_DEFAULT_PROFILER_BUFFER_SIZE
+	u64 stack_size;             // 0 for the OS default
+	Allocator allocator;        // context.allocator on the workers. Zero to use the one making the group
+	void *logger;               // context.logger on the workers. 0 to use the one making the group
+	bool prefault;              // Workers touch all their memory before running their proc
+} Worker_Policy;
+
+typedef struct Worker_Group Worker_Group;
+
+typedef struct Worker_Context {
+	Thread thread;
+	Worker_Group *group;
+	u64 index;
+	Context context; // What the worker starts with
+	void *temporary_storage;
+	u64 temporary_storage_size;
+	u8 *profiler_buffer;
+	u64 profiler_buffer_size;
+	u64 slice_size; // Everything above, from the start of this struct
+	bool prefault;
+} Worker_Context;
+
+typedef struct Worker_Group {
+	Arena *arena; // All the workers' memory
+	Worker_Context **workers;
+	u64 worker_count;
+} Worker_Group;
+
+thread_local Worker_Context *current_worker_context = 0;
+
+// 0 if this thread isn't in a Worker_Group
+Worker_Context *
+get_worker_context() {
+	return current_worker_context;
+}
+
+void
+worker_group_init(Worker_Group *group, u64 worker_count, Thread_Proc proc, void *data, Worker_Policy policy) {
+	assert(worker_count > 0, "Worker group needs at least one worker");
+	
+	if (policy.temporary_storage_size == 0) policy.temporary_storage_size = WORKER_DEFAULT_TEMPORARY_STORAGE_SIZE;
+	if (policy.profiler_buffer_size == 0)   policy.profiler_buffer_size   = WORKER_DEFAULT_PROFILER_BUFFER_SIZE;
+	if (!policy.allocator.proc) policy.allocator = context.allocator;
+	if (!policy.allocator.proc) policy.allocator = get_heap_allocator();
+	if (!policy.logger) policy.logger = context.logger;
+	
+	u64 header_size = align_next(sizeof(Worker_Context), 64);
+	u64 temporary_storage_size = align_next(policy.temporary_storage_size + sizeof(Temporary_Storage_Block), 64);
+	u64 slice_size = align_next(header_size + temporary_storage_size + policy.profiler_buffer_size, os.page_size);
+	
+	u64 list_size = align_next(worker_count*sizeof(Worker_Context*), os.page_size);
+	group->arena = arena_make(list_size + slice_size*worker_count + os.page_size);
+	group->workers = (Worker_Context**)arena_push_aligned(group->arena, list_size, os.page_size);
+	group->worker_count = worker_count;
+	
+	for (u64 i = 0; i < worker_count; i += 1) {
+		u8 *slice = (u8*)arena_push_aligned(group->arena, slice_size, os.page_size);
+		
+		Worker_Context *w = (Worker_Context*)slice;
+		os_thread_init(&w->thread, proc);
+		w->thread.data = data;
+		w->thread.stack_size = policy.stack_size;
+		w->thread.worker_context = w;
+		
+		w->group = group;
+		w->index = i;
+		w->context = context;
+		w->context.allocator = policy.allocator;
+		w->context.logger = policy.logger;
+		w->thread.initial_context = w->context;
+		
+		w->temporary_storage = slice + header_size;
+		w->temporary_storage_size = temporary_storage_size;
+		w->profiler_buffer = policy.profiler_buffer_size ? slice + header_size + temporary_storage_size : 0;
+		w->profiler_buffer_size = policy.profiler_buffer_size;
+		w->slice_size = slice_size;
+		w->prefault = policy.prefault;
+		
+		group->workers[i] = w;
+	}
+}
+
+void
+worker_group_start(Worker_Group *group) {
+	for (u64 i = 0; i < group->worker_count; i += 1) {
+		os_thread_start(&group->workers[i]->thread);
+	}
+}
+
+void
+worker_group_join(Worker_Group *group) {
+	for (u64 i = 0; i < group->worker_count; i += 1) {
+		os_thread_join(&group->workers[i]->thread);
+	}
+}
+
+// Joins the workers first
+void
+worker_group_destroy(Worker_Group *group) {
+	for (u64 i = 0; i < group->worker_count; i += 1) {
+		os_thread_destroy(&group->workers[i]->thread);
+	}
+	arena_destroy(group->arena);
+	*group = ZERO(Worker_Group);
+}
+
+// Called on the worker thread before its proc runs
+void
+worker_context_enter(Worker_Context *w) {
+	if (w->prefault) {
+		// The first page has the Worker_Context itself, which is already touched
+		for (u64 offset = os.page_size; offset < w->slice_size; offset += os.page_size) {
+			((volatile u8*)w)[offset] = 0;
+		}
+	}
+	
+	current_worker_context = w;
+	context = w->context;
+	temporary_storage_init_with_memory(w->temporary_storage, w->temporary_storage_size);
+	profiler_set_thread_buffer(w->profiler_buffer, w->profiler_buffer_size);
+}
+
+// Called on the worker thread after its proc returns, before temporary_storage_deinit()
+void
+worker_context_exit(Worker_Context *w) {
+	profiler_set_thread_buffer(0, 0);
+	current_worker_context = 0;
+}
@@ -103,8 +103,10 @@
 					tm_scope_accum
 					
 		- OOGABOOGA_HEADLESS
-            Run oogabooga in headless mode, i.e. no window, no graphics, no audio.
+            Run oogabooga in headless mode, i.e. no window, no graphics, no audio device.
             Useful if you only need the oogabooga standard library for something like a game server.
+            Audio can still be mixed with audio_render_offline() (see audio.c), which is how
+            we test & benchmark the mixer on machines without a sound card.
             
             0: Disable
             1: Enable
@@ -201,6 +203,26 @@ typedef u8 bool;
     #define INITIAL_PROGRAM_MEMORY_SIZE MB(5)
 #endif
 
+// Back program memory (heap) and big arenas with large pages (2mb on x64) for fewer TLB misses.
+// On windows the user needs the "Lock pages in memory" privilege, if we can't get large pages
+// we just use normal pages. Large pages are never paged out and can't be partially decommitted.
+// Program memory stays in normal pages in DEBUG, since we protect it page by page there.
+#ifndef ENABLE_LARGE_PAGES
+	#define ENABLE_LARGE_PAGES 0
+#endif
+
+// Count acquisitions, contended acquisitions and cycles spent waiting in every Spinlock and
+// Ticket_Lock (see concurrency.c), to find the locks worth fixing.
+#ifndef ENABLE_SPINLOCK_STATS
+	#define ENABLE_SPINLOCK_STATS 0
+#endif
+
+// Draw and present the last frame on a render thread while the game makes the next one, so a
+// frame costs the slower of the two instead of both added together. Adds a frame of latency.
+#ifndef ENABLE_RENDER_THREAD
+	#define ENABLE_RENDER_THREAD 0
+#endif
+
 #if ENABLE_SIMD && !defined(SIMD_ENABLE_SSE2)
 	#if COMPILER_CAN_DO_SSE2
 		#define SIMD_ENABLE_SSE2 1
@@ -290,6 +312,7 @@ typedef u8 bool;
 
 #include "hash_table.c"
 #include "growing_array.c"
+#include "slot_map.c"
 
 #include "os_interface.c"
 
@@ -310,6 +333,8 @@ typedef u8 bool;
 #include "random.c"
 #include "color.c"
 #include "memory.c"
+#include "string_interner.c"
+#include "fiber.c"
 #include "input.c"
 
 #ifndef OOGABOOGA_HEADLESS
@@ -319,10 +344,11 @@ typedef u8 bool;
     #include "font.c"
 
     #include "drawing.c"
-
-    #include "audio.c"
 #endif
 
+// Audio is compiled in headless mode too, there's just no device driving it
+#include "audio.c"
+
 #if !OOGABOOGA_LINK_EXTERNAL_INSTANCE
 
     #if TARGET_OS == WINDOWS
@@ -384,12 +410,15 @@ void oogabooga_init(u64 program_memory_size) {
 	Cpu_Capabilities features = query_cpu_capabilities();
 	os_init(program_memory_size);
 	heap_init();
+	context.allocator = get_heap_allocator();
 	temporary_storage_init(TEMPORARY_STORAGE_SIZE);
+	string_interner_init(&string_interner, STRING_INTERNER_ARENA_RESERVE_SIZE);
 	log_info("Ooga booga version is %d.%02d.%03d", OGB_VERSION_MAJOR, OGB_VERSION_MINOR, OGB_VERSION_PATCH);
 #ifndef OOGABOOGA_HEADLESS
 	gfx_init();
 #else
     log_info("Headless mode on");
+    audio_init_offline((Audio_Format){AUDIO_BITS_32, 2, 48000});
 #endif
 	log_verbose("CPU has sse1:   %cs", features.sse1 ? "true" : "false");
 	log_verbose("CPU has sse2:   %cs", features.sse2 ? "true" : "false");
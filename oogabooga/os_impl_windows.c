@@ -339,6 +339,73 @@ win32_audio_poll_default_device_thread(Thread *t);
 volatile bool win32_has_audio_thread_started = false;
 #endif /* OOGABOOGA_HEADLESS */
 
+#if ENABLE_LARGE_PAGES
+// Large pages need SeLockMemoryPrivilege enabled in the process token. advapi32 is loaded here
+// so we don't need to link it for this one thing.
+typedef BOOL (WINAPI *Win32_Open_Process_Token_Proc)(HANDLE, DWORD, PHANDLE);
+typedef BOOL (WINAPI *Win32_Lookup_Privilege_Value_Proc)(LPCWSTR, LPCWSTR, PLUID);
+typedef BOOL (WINAPI *Win32_Adjust_Token_Privileges_Proc)(HANDLE, BOOL, PTOKEN_PRIVILEGES, DWORD, PTOKEN_PRIVILEGES, PDWORD);
+bool win32_enable_lock_memory_privilege() {
+	Dynamic_Library_Handle advapi = os_load_dynamic_library(STR("advapi32.dll"));
+	if (!advapi) return false;
+	
+	Win32_Open_Process_Token_Proc open_process_token = (Win32_Open_Process_Token_Proc)os_dynamic_library_load_symbol(advapi, STR("OpenProcessToken"));
+	Win32_Lookup_Privilege_Value_Proc lookup_privilege_value = (Win32_Lookup_Privilege_Value_Proc)os_dynamic_library_load_symbol(advapi, STR("LookupPrivilegeValueW"));
+	Win32_Adjust_Token_Privileges_Proc adjust_token_privileges = (Win32_Adjust_Token_Privileges_Proc)os_dynamic_library_load_symbol(advapi, STR("AdjustTokenPrivileges"));
+	if (!open_process_token || !lookup_privilege_value || !adjust_token_privileges) return false;
+	
+	HANDLE token;
+	if (!open_process_token(GetCurrentProcess(), TOKEN_ADJUST_PRIVILEGES | TOKEN_QUERY, &token)) return false;
+	
+	TOKEN_PRIVILEGES privileges = ZERO(TOKEN_PRIVILEGES);
+	privileges.PrivilegeCount = 1;
+	privileges.Privileges[0].Attributes = SE_PRIVILEGE_ENABLED;
+	bool ok = lookup_privilege_value(0, L"SeLockMemoryPrivilege", &privileges.Privileges[0].Luid);
+	// AdjustTokenPrivileges succeeds with ERROR_NOT_ALL_ASSIGNED if the user doesn't have the privilege
+	ok = ok && adjust_token_privileges(token, FALSE, &privileges, 0, 0, 0) && GetLastError() == ERROR_SUCCESS;
+	
+	CloseHandle(token);
+	return ok;
+}
+#endif // ENABLE_LARGE_PAGES
+
+///
+// Waiting on an address
+// WaitOnAddress is windows 8+ and lives in its own api set, so it's loaded at init instead of
+// linking synchronization.lib. Without it os_address_wait just yields, which is allowed since
+// callers have to check again anyways.
+
+typedef BOOL (WINAPI *Win32_Wait_On_Address_Proc)(volatile VOID*, PVOID, SIZE_T, DWORD);
+typedef VOID (WINAPI *Win32_Wake_By_Address_Proc)(PVOID);
+Win32_Wait_On_Address_Proc win32_wait_on_address = 0;
+Win32_Wake_By_Address_Proc win32_wake_by_address_single = 0;
+Win32_Wake_By_Address_Proc win32_wake_by_address_all = 0;
+
+void win32_load_wait_on_address() {
+	Dynamic_Library_Handle synch = os_load_dynamic_library(STR("api-ms-win-core-synch-l1-2-0.dll"));
+	if (!synch) return;
+	win32_wait_on_address = (Win32_Wait_On_Address_Proc)os_dynamic_library_load_symbol(synch, STR("WaitOnAddress"));
+	win32_wake_by_address_single = (Win32_Wake_By_Address_Proc)os_dynamic_library_load_symbol(synch, STR("WakeByAddressSingle"));
+	win32_wake_by_address_all = (Win32_Wake_By_Address_Proc)os_dynamic_library_load_symbol(synch, STR("WakeByAddressAll"));
+	if (!win32_wait_on_address || !win32_wake_by_address_single || !win32_wake_by_address_all) {
+		win32_wait_on_address = 0;
+	}
+}
+
+void os_address_wait(volatile u32 *address, u32 expected) {
+	if (!win32_wait_on_address) {
+		os_yield_thread();
+		return;
+	}
+	win32_wait_on_address(address, &expected, sizeof(u32), INFINITE);
+}
+void os_address_wake_one(volatile u32 *address) {
+	if (win32_wait_on_address) win32_wake_by_address_single((PVOID)address);
+}
+void os_address_wake_all(volatile u32 *address) {
+	if (win32_wait_on_address) win32_wake_by_address_all((PVOID)address);
+}
+
 void os_init(u64 program_memory_capacity) {
 	
     // #Volatile
@@ -394,6 +461,18 @@ void os_init(u64 program_memory_capacity) {
     }
 
 
+	os.large_page_size = 0;
+#if ENABLE_LARGE_PAGES
+	if (win32_enable_lock_memory_privilege()) {
+		os.large_page_size = (u64)GetLargePageMinimum();
+	}
+	if (!os.large_page_size) {
+		os_write_string_to_stdout(STR("Large pages are not available, falling back to normal pages. Needs the \"Lock pages in memory\" privilege.\n"));
+	}
+#endif
+
+	win32_load_wait_on_address();
+
 	program_memory_mutex = os_make_mutex();
 	os_grow_program_memory(program_memory_capacity);
 	
@@ -501,14 +580,21 @@ DWORD WINAPI win32_thread_invoker(LPVOID param) {
 	timeBeginPeriod(1);
 #endif
 	
-	temporary_storage_init(t->temporary_storage_size);
+	if (t->worker_context) {
+		worker_context_enter(t->worker_context);
+	} else {
+		temporary_storage_init(t->temporary_storage_size);
+		context = t->initial_context;
+	}
 	
-	context = t->initial_context;
 	context.thread_id = GetCurrentThreadId();
 	
 	t->proc(t);
 	
-	heap_dealloc(temporary_storage);
+	pool_flush_thread_caches();
+	third_party_scratch_deinit();
+	if (t->worker_context) worker_context_exit(t->worker_context);
+	temporary_storage_deinit();
 	
 	return 0;
 }
@@ -558,12 +644,13 @@ void os_thread_destroy(Thread *t) {
 	CloseHandle(t->os_handle);
 }
 void os_thread_start(Thread *t) {
+	// stack_size only reserves, the stack is committed as it grows like the default one
 	t->os_handle = CreateThread(
         0,
-        0,
+        t->stack_size,
         win32_thread_invoker,
         t,
-        0,
+        t->stack_size ? STACK_SIZE_PARAM_IS_A_RESERVATION : 0,
         (DWORD*)&t->id
     );
     
@@ -809,6 +896,47 @@ bool os_delete_directory_s(string path, bool recursive) {
     return true;
 }
 
+bool os_file_map_s(string path, Os_File_Mapping *result) {
+	*result = ZERO(Os_File_Mapping);
+	
+	u16 *path_wide = temp_win32_fixed_utf8_to_null_terminated_wide(path);
+	File file = CreateFileW(path_wide, GENERIC_READ, FILE_SHARE_READ, 0, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, 0);
+	if (file == INVALID_HANDLE_VALUE) return false;
+	
+	LARGE_INTEGER file_size;
+	if (!GetFileSizeEx(file, &file_size) || file_size.QuadPart == 0) {
+		CloseHandle(file);
+		return false;
+	}
+	
+	HANDLE mapping_handle = CreateFileMappingW(file, 0, PAGE_READONLY, 0, 0, 0);
+	if (!mapping_handle) {
+		CloseHandle(file);
+		return false;
+	}
+	
+	void *data = MapViewOfFile(mapping_handle, FILE_MAP_READ, 0, 0, 0);
+	if (!data) {
+		CloseHandle(mapping_handle);
+		CloseHandle(file);
+		return false;
+	}
+	
+	result->data = data;
+	result->size = (u64)file_size.QuadPart;
+	result->file = file;
+	result->mapping_handle = mapping_handle;
+	
+	return true;
+}
+
+void os_file_unmap(Os_File_Mapping *mapping) {
+	if (mapping->data)           UnmapViewOfFile(mapping->data);
+	if (mapping->mapping_handle) CloseHandle(mapping->mapping_handle);
+	if (mapping->file && mapping->file != OS_INVALID_FILE) CloseHandle(mapping->file);
+	*mapping = ZERO(Os_File_Mapping);
+}
+
 bool os_file_write_string(File f, string s) {
     DWORD written;
     BOOL result = WriteFile(f, s.data, s.count, &written, 0);
@@ -1185,6 +1313,29 @@ os_get_stack_trace(u64 *trace_count, Allocator allocator) {
 #endif // NOT DEBUG
 }
 
+// Regions are aligned to the large page size when we might use large pages, so a region that
+// fell back to normal pages doesn't leave the tail unaligned for the next one.
+u64 win32_get_program_memory_alignment() {
+#if ENABLE_LARGE_PAGES && CONFIGURATION != DEBUG
+	if (os.large_page_size) return max(os.large_page_size, os.granularity);
+#endif
+	return os.granularity;
+}
+void *win32_alloc_program_memory_region(void *base, u64 size) {
+#if ENABLE_LARGE_PAGES && CONFIGURATION != DEBUG
+	if (os.large_page_size) {
+		void *result = VirtualAlloc(base, size, MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE);
+		if (result) {
+			program_memory_has_large_pages = true;
+			return result;
+		}
+		// Large pages need physically contiguous memory which can be hard to find once the
+		// system has been running for a while, so this can fail at any point.
+	}
+#endif
+	return VirtualAlloc(base, size, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+}
+
 bool os_grow_program_memory(u64 new_size) {
 	os_lock_mutex(program_memory_mutex); // #Sync
 	if (program_memory_capacity >= new_size) {
@@ -1201,10 +1352,10 @@ bool os_grow_program_memory(u64 new_size) {
 		// since we allocate each region with the base address at the tail of the
 		// previous region, then that tail needs to be aligned to granularity, which
 		// will be true if the size is also always aligned to granularity.
-		u64 aligned_size = align_next(new_size, os.granularity);
-		void *aligned_base = (void*)align_next(VIRTUAL_MEMORY_BASE, os.granularity);
+		u64 aligned_size = align_next(new_size, win32_get_program_memory_alignment());
+		void *aligned_base = (void*)align_next(VIRTUAL_MEMORY_BASE, win32_get_program_memory_alignment());
 
-		program_memory = VirtualAlloc(aligned_base, aligned_size, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+		program_memory = win32_alloc_program_memory_region(aligned_base, aligned_size);
 		if (program_memory == 0) { 
 			os_unlock_mutex(program_memory_mutex); // #Sync
 			return false;
@@ -1222,10 +1373,10 @@ bool os_grow_program_memory(u64 new_size) {
 		assert((u64)program_memory_capacity % os.granularity == 0, "program_memory_capacity is not aligned to granularity!");
 		assert((u64)tail % os.granularity == 0, "Tail is not aligned to granularity!");
 		
-		u64 amount_to_allocate = align_next(new_size-program_memory_capacity, os.granularity);
+		u64 amount_to_allocate = align_next(new_size-program_memory_capacity, win32_get_program_memory_alignment());
 		
 		// Just keep allocating at the tail of the current chunk
-		void* result = VirtualAlloc(tail, amount_to_allocate, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+		void* result = win32_alloc_program_memory_region(tail, amount_to_allocate);
 #if CONFIGURATION == DEBUG
 		memset(result, 0xBA, amount_to_allocate);
 		DWORD _ = PAGE_READWRITE;
@@ -1287,6 +1438,10 @@ os_unlock_program_memory_pages(void *start, u64 size) {
 	// Probably super slow but this shouldn't happen often at all + it's only in debug.
 	// - Charlie M 28th July 2024
 	for (u8 *p = (u8*)start; p < (u8*)start+size; p += os.page_size) {
+		// The heap decommits big free spans, those pages can't be protected
+		MEMORY_BASIC_INFORMATION info;
+		if (VirtualQuery(p, &info, sizeof(info)) && info.State != MEM_COMMIT) continue;
+		
 		DWORD old_protect = PAGE_NOACCESS;
 		BOOL ok = VirtualProtect(p, os.page_size, PAGE_READWRITE, &old_protect);
 		assert(ok, "VirtualProtect Failed with error %d", GetLastError());
@@ -1303,6 +1458,10 @@ os_lock_program_memory_pages(void *start, u64 size) {
 	// Probably super slow but this shouldn't happen often at all + it's only in debug.
 	// - Charlie M 28th July 2024
 	for (u8 *p = (u8*)start; p < (u8*)start+size; p += os.page_size) {
+		// The heap decommits big free spans, those pages can't be protected
+		MEMORY_BASIC_INFORMATION info;
+		if (VirtualQuery(p, &info, sizeof(info)) && info.State != MEM_COMMIT) continue;
+		
 		DWORD old_protect = PAGE_READWRITE;
 		BOOL ok = VirtualProtect(p, os.page_size, PAGE_NOACCESS, &old_protect);
 		assert(ok, "VirtualProtect Failed with error %d", GetLastError());
@@ -1310,6 +1469,56 @@ os_lock_program_memory_pages(void *start, u64 size) {
 #endif
 }
 
+void*
+os_reserve_memory(u64 size) {
+	assert(size % os.page_size == 0, "size was not aligned to page size in os_reserve_memory");
+	return VirtualAlloc(0, size, MEM_RESERVE, PAGE_READWRITE);
+}
+void*
+os_reserve_and_commit_large_pages(u64 size) {
+	if (!os.large_page_size) return 0;
+	assert(size % os.large_page_size == 0, "size was not aligned to large page size in os_reserve_and_commit_large_pages");
+	return VirtualAlloc(0, size, MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE);
+}
+bool
+os_commit_memory(void *start, u64 size) {
+	assert((u64)start % os.page_size == 0, "When committing memory, the start address must be the start of a page");
+	assert(size       % os.page_size == 0, "When committing memory, the size must be aligned to page_size");
+	// The range may cross several VirtualAlloc regions (heap blocks in program memory), which
+	// VirtualAlloc/VirtualFree won't do in one call.
+	u8 *p = (u8*)start;
+	u8 *end = (u8*)start+size;
+	while (p < end) {
+		MEMORY_BASIC_INFORMATION info;
+		if (!VirtualQuery(p, &info, sizeof(info))) return false;
+		u8 *region_end = min((u8*)info.BaseAddress+info.RegionSize, end);
+		if (!VirtualAlloc(p, (SIZE_T)(region_end-p), MEM_COMMIT, PAGE_READWRITE)) return false;
+		p = region_end;
+	}
+	return true;
+}
+void
+os_decommit_memory(void *start, u64 size) {
+	assert((u64)start % os.page_size == 0, "When decommitting memory, the start address must be the start of a page");
+	assert(size       % os.page_size == 0, "When decommitting memory, the size must be aligned to page_size");
+	u8 *p = (u8*)start;
+	u8 *end = (u8*)start+size;
+	while (p < end) {
+		MEMORY_BASIC_INFORMATION info;
+		SIZE_T query_ok = VirtualQuery(p, &info, sizeof(info));
+		assert(query_ok, "VirtualQuery Failed with error %d", GetLastError());
+		u8 *region_end = min((u8*)info.BaseAddress+info.RegionSize, end);
+		BOOL ok = VirtualFree(p, (SIZE_T)(region_end-p), MEM_DECOMMIT);
+		assert(ok, "VirtualFree Failed with error %d", GetLastError());
+		p = region_end;
+	}
+}
+void
+os_release_memory(void *start, u64 size) {
+	BOOL ok = VirtualFree(start, 0, MEM_RELEASE);
+	assert(ok, "VirtualFree Failed with error %d", GetLastError());
+}
+
 ///
 ///
 // Mouse pointer
@@ -1407,14 +1616,15 @@ os_make_custom_mouse_pointer(void *image, int width, int height, int hotspot_x,
 Custom_Mouse_Pointer ogb_instance
 os_make_custom_mouse_pointer_from_file(string path, int hotspot_x, int hotspot_y, Allocator allocator) {
     int width, height, channels;
-    stbi_set_flip_vertically_on_load(1);
-    third_party_allocator = allocator;
+    stbi_set_flip_vertically_on_load_thread(1);
     
     string png;
     bool ok = os_read_entire_file(path, &png, allocator);
     
     if (!ok) return 0;
     
+    // The pixels are only needed until the cursor is made
+    Third_Party_Scope scope = third_party_scope_begin(get_third_party_scratch_allocator());
     unsigned char* stb_data = stbi_load_from_memory(
         png.data, 
         png.count,
@@ -1425,6 +1635,7 @@ os_make_custom_mouse_pointer_from_file(string path, int hotspot_x, int hotspot_y
     );
     
     if (!stb_data) {
+        third_party_scope_end(scope);
         dealloc_string(allocator, png);
         return 0;
     }
@@ -1432,8 +1643,7 @@ os_make_custom_mouse_pointer_from_file(string path, int hotspot_x, int hotspot_y
     Custom_Mouse_Pointer p = os_make_custom_mouse_pointer(stb_data, width, height, hotspot_x, hotspot_y);
     
     dealloc_string(allocator, png);
-    stbi_image_free(stb_data);
-    third_party_allocator = ZERO(Allocator);
+    third_party_scope_end(scope);
     
     return p;
     
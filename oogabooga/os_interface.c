@@ -40,6 +40,7 @@ typedef int   (__cdecl *Crt_Vsnprintf_Proc) (char*, size_t, const char*, va_list
 typedef struct Os_Info {
 	u64 page_size;
 	u64 granularity;
+	u64 large_page_size; // 0 if large pages are disabled (ENABLE_LARGE_PAGES) or not available
 	
 	Dynamic_Library_Handle crt;
 	
@@ -95,6 +96,7 @@ inline int vsnprintf(char* buffer, size_t n, const char* fmt, va_list args) {
 ///
 
 typedef struct Thread Thread;
+typedef struct Worker_Context Worker_Context;
 
 typedef void(*Thread_Proc)(Thread*);
 
@@ -102,9 +104,11 @@ typedef struct Thread {
 	u64 id; // This is valid after os_thread_start
 	Context initial_context;
 	void* data;
-	u64 temporary_storage_size; // Defaults to KB(10)
+	u64 temporary_storage_size; // Defaults to KB(10), grows when needed
+	u64 stack_size; // 0 for the OS default
 	Thread_Proc proc;
 	Thread_Handle os_handle;
+	Worker_Context *worker_context; // Set for threads in a Worker_Group, see worker_group_init()
 	
 	
 	Allocator allocator;  // Deprecated !! #Cleanup
@@ -145,6 +149,21 @@ os_lock_mutex(Mutex_Handle m);
 void ogb_instance
 os_unlock_mutex(Mutex_Handle m);
 
+///
+// Waiting on an address (WaitOnAddress on windows, futex on linux)
+// os_address_wait() sleeps as long as *address == expected, until another thread wakes the
+// address. It can return without being woken, so always check again.
+// The parking primitives in concurrency.c are built on this, use those instead.
+
+void ogb_instance
+os_address_wait(volatile u32 *address, u32 expected);
+
+void ogb_instance
+os_address_wake_one(volatile u32 *address);
+
+void ogb_instance
+os_address_wake_all(volatile u32 *address);
+
 ///
 // Threading utilities
 
@@ -225,6 +244,25 @@ bool ogb_instance
 os_delete_directory_s(string path, bool recursive);
 
 
+// Read-only view of a whole file. Pages are loaded lazily on first access and shared with
+// the OS file cache, so nothing gets copied into our memory.
+// The file can't be deleted or written to while it's mapped.
+typedef struct Os_File_Mapping {
+	void *data;
+	u64 size;
+	
+	File file;
+	void *mapping_handle;
+} Os_File_Mapping;
+
+// Fails on empty files, there's nothing to map
+bool ogb_instance
+os_file_map_s(string path, Os_File_Mapping *result);
+
+void ogb_instance
+os_file_unmap(Os_File_Mapping *mapping);
+
+
 bool ogb_instance
 os_file_write_string(File f, string s);
 
@@ -299,6 +337,12 @@ inline bool os_file_delete_f(const char *path) {return os_file_delete_s(STR(path
                            default: os_file_delete_f \
                           )(__VA_ARGS__)
                           
+inline bool os_file_map_f(const char *path, Os_File_Mapping *result) {return os_file_map_s(STR(path), result);}
+#define os_file_map(...) _Generic((FIRST_ARG(__VA_ARGS__)), \
+                           string:  os_file_map_s, \
+                           default: os_file_map_f \
+                          )(__VA_ARGS__)
+                          
 inline bool os_file_copy_f(const char *from, const char *to, bool replace_if_exists) {return os_file_copy_s(STR(from), STR(to), replace_if_exists);}
 #define os_file_copy(...) _Generic((FIRST_ARG(__VA_ARGS__)), \
                            string:  os_file_copy_s, \
@@ -421,12 +465,14 @@ ogb_instance void *program_memory;
 ogb_instance void *program_memory_next;
 ogb_instance u64 program_memory_capacity;
 ogb_instance Mutex_Handle program_memory_mutex;
+ogb_instance bool program_memory_has_large_pages;
 
 #if !OOGABOOGA_LINK_EXTERNAL_INSTANCE
 void *program_memory = 0;
 void *program_memory_next = 0;
 u64 program_memory_capacity = 0;
 Mutex_Handle program_memory_mutex = 0;
+bool program_memory_has_large_pages = false;
 #endif // NOT OOGABOOGA_LINK_EXTERNAL_INSTANCE
 
 bool ogb_instance
@@ -444,6 +490,25 @@ os_unlock_program_memory_pages(void *start, u64 size);
 void ogb_instance
 os_lock_program_memory_pages(void *start, u64 size);
 
+// Virtual memory outside of program memory, for things that want their own range of
+// address space (arenas, large heap allocations). Reserving only claims the addresses, memory
+// needs to be committed before it's touched. Everything must be aligned to os.page_size.
+// Commit/decommit also work on program memory, that's how the heap gives back free pages.
+// Returns 0 on fail
+ogb_instance void*
+os_reserve_memory(u64 size);
+bool ogb_instance
+os_commit_memory(void *start, u64 size);
+void ogb_instance
+os_decommit_memory(void *start, u64 size);
+// Must be the exact pointer returned by os_reserve_memory
+void ogb_instance
+os_release_memory(void *start, u64 size);
+// Reserved and committed in one go, can't be decommitted. Release with os_release_memory.
+// size must be aligned to os.large_page_size. Returns 0 if there are no large pages to be had.
+ogb_instance void*
+os_reserve_and_commit_large_pages(u64 size);
+
 ///
 ///
 // Mouse pointer
@@ -22,7 +22,7 @@ void dump_profile_result() {
 	
 	log_verbose("Wrote profiling result to google_trace.json");
 }
-void _profiler_report_time_cycles(string name, u64 count, u64 start) {
+void _profiler_init_if_needed() {
 	if (!profiler_initted) {
 		spinlock_init(&_profiler_lock);
 		profiler_initted = true;
@@ -30,11 +30,57 @@ void _profiler_report_time_cycles(string name, u64 count, u64 start) {
 		string_builder_init_reserve(&_profile_output, 1024*1000, get_heap_allocator());	
 		
 	}
+}
+
+// Worker threads (see worker_group_init) report into their own buffer so they don't fight
+// over _profiler_lock. It goes to _profile_output when it's full and when the thread exits.
+thread_local u8 *_profiler_thread_buffer = 0;
+thread_local u64 _profiler_thread_buffer_size = 0;
+thread_local u64 _profiler_thread_buffer_used = 0;
+
+void _profiler_flush_thread_buffer() {
+	if (_profiler_thread_buffer_used == 0) return;
+	
+	_profiler_init_if_needed();
+	
+	spinlock_acquire_or_wait(&_profiler_lock);
+	string_builder_append(&_profile_output, (string){_profiler_thread_buffer_used, _profiler_thread_buffer});
+	spinlock_release(&_profiler_lock);
+	
+	_profiler_thread_buffer_used = 0;
+}
+
+// Flushes whatever was in the previous buffer. Pass 0 to report straight to _profile_output.
+void profiler_set_thread_buffer(u8 *buffer, u64 size) {
+	_profiler_flush_thread_buffer();
+	_profiler_thread_buffer = buffer;
+	_profiler_thread_buffer_size = buffer ? size : 0;
+	_profiler_thread_buffer_used = 0;
+}
+
+void _profiler_report_time_cycles(string name, u64 count, u64 start) {
+	_profiler_init_if_needed();
+	
+	const char *fmt = "{\"cat\":\"function\",\"dur\":%.3f,\"name\":\"%s\",\"ph\":\"X\",\"pid\":0,\"tid\":%zu,\"ts\":%lld},";
+	
+	if (_profiler_thread_buffer) {
+		for (int attempt = 0; attempt < 2; attempt += 1) {
+			char *p = (char*)_profiler_thread_buffer + _profiler_thread_buffer_used;
+			u64 left = _profiler_thread_buffer_size - _profiler_thread_buffer_used;
+			u64 n = format_string_to_buffer_va(p, left, fmt, (float64)count*1000, name, get_context().thread_id, start*1000);
+			// Filling it up to the null terminator means it might have been cut off
+			if (n+1 < left) {
+				_profiler_thread_buffer_used += n;
+				return;
+			}
+			_profiler_flush_thread_buffer();
+		}
+		// Doesn't even fit in an empty buffer, so it goes straight to the output below
+	}
 	
 	spinlock_acquire_or_wait(&_profiler_lock);
 	
-	string fmt = STR("{\"cat\":\"function\",\"dur\":%.3f,\"name\":\"%s\",\"ph\":\"X\",\"pid\":0,\"tid\":%zu,\"ts\":%lld},");
-	string_builder_print(&_profile_output, fmt, (float64)count*1000, name, get_context().thread_id, start*1000);
+	string_builder_print(&_profile_output, STR(fmt), (float64)count*1000, name, get_context().thread_id, start*1000);
 	
 	spinlock_release(&_profiler_lock);
 }
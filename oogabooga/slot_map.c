@@ -0,0 +1,384 @@
+
+/*
+
+	Slot map:
+
+	Items are packed together in one array so iterating them is as fast as it gets, but you
+	keep a handle to them instead of a pointer or an index. Removing an item moves the last
+	one into its place, so pointers and indices change, handles don't. A handle to a removed
+	item stops working, even if its slot is reused by a new item.
+	Add, remove and get are O(1).
+
+	// Make a slot map of 'Entity', allocated on the heap
+	Slot_Map entities = make_slot_map(Entity, get_heap_allocator());
+
+	// The entity is copied in. Needs to be an lvalue like with hash_table_set.
+	Entity e = ...;
+	Slot_Handle handle = slot_map_add(&entities, e);
+
+	// Or get a zeroed one (with DO_ZERO_INITIALIZATION) to fill in
+	Entity *new_entity = slot_map_add_empty(&entities, &handle);
+
+	// 0 if the entity was removed
+	Entity *entity = slot_map_get(&entities, handle);
+
+	// Items are in map.items, map.count of them
+	Entity *all = (Entity*)entities.items;
+	for (u64 i = 0; i < entities.count; i++) {
+		Entity *e = &all[i];
+		Slot_Handle h = slot_map_get_nth_handle(&entities, i);
+	}
+
+	// Returns false if it was already removed. Don't remove while iterating forwards,
+	// the last item moves into the removed one's place. Iterate backwards instead.
+	slot_map_remove(&entities, handle);
+
+	// Remove everything, all handles stop working
+	slot_map_reset(&entities);
+
+	slot_map_destroy(&entities);
+
+	A zeroed Slot_Handle is never valid, so ZERO(Slot_Handle) can be used as "no handle".
+
+
+	Sparse set:
+
+	Like a slot map, but you choose the ids (u32), for example entity indices. Each id can have
+	a value. Ids and values are packed together for iterating, and the sparse array going from
+	id to index is as big as the biggest id added. Add, remove and find are O(1).
+
+	// Ids with a 'Vector2' each
+	Sparse_Set velocities = make_sparse_set(Vector2, get_heap_allocator());
+
+	// Returns true if the id was newly added, otherwise the value is replaced
+	Vector2 v = v2(1, 0);
+	sparse_set_set(&velocities, entity_id, v);
+
+	// 0 if the id isn't in the set
+	Vector2 *velocity = sparse_set_find(&velocities, entity_id);
+
+	for (u64 i = 0; i < velocities.count; i++) {
+		u32 id = velocities.ids[i];
+		Vector2 *velocity = &((Vector2*)velocities.values)[i];
+	}
+
+	sparse_set_remove(&velocities, entity_id);
+
+	// Just ids, no values
+	Sparse_Set selected = make_sparse_set_raw(0, get_heap_allocator());
+	sparse_set_add(&selected, entity_id);
+	if (sparse_set_contains(&selected, entity_id)) { ... }
+
+*/
+
+typedef struct Slot_Handle {
+	u32 index;      // Slot in the sparse array
+	u32 generation; // Bumped every time the slot is freed, so old handles stop matching
+} Slot_Handle;
+
+typedef struct Slot_Map_Slot {
+	u32 dense_index; // If the slot is free, this is the next free slot instead
+	u32 generation;  // Odd when the slot is in use, so a zeroed handle is never valid
+} Slot_Map_Slot;
+
+#define SLOT_MAP_NO_SLOT 0xFFFFFFFF
+
+typedef struct Slot_Map {
+	void *items; // Dense, count of them
+	u64 count;
+	u64 capacity;
+
+	u32 *item_slots; // The slot of each item, to fix it up when the item moves
+	Slot_Map_Slot *slots;
+	u64 slot_count;
+	u32 first_free_slot;
+
+	u64 item_size;
+	Allocator allocator;
+} Slot_Map;
+
+typedef struct Sparse_Set {
+	u32 *ids;     // Dense, count of them
+	void *values; // Dense, next to ids. 0 if value_size is 0
+	u64 count;
+	u64 capacity;
+
+	u32 *sparse;  // Id to index in ids, only means something if ids[sparse[id]] == id
+	u64 sparse_count;
+
+	u64 value_size;
+	Allocator allocator;
+} Sparse_Set;
+
+// API:
+#define make_slot_map_reserve(Item_Type, capacity_count, allocator) \
+	make_slot_map_reserve_raw(sizeof(Item_Type), capacity_count, allocator)
+
+#define make_slot_map(Item_Type, allocator) \
+	make_slot_map_raw(sizeof(Item_Type), allocator)
+
+#define slot_map_add(map_ptr, item) \
+	slot_map_add_raw((map_ptr), &(item), sizeof(item))
+
+#define make_sparse_set_reserve(Value_Type, capacity_count, allocator) \
+	make_sparse_set_reserve_raw(sizeof(Value_Type), capacity_count, allocator)
+
+#define make_sparse_set(Value_Type, allocator) \
+	make_sparse_set_raw(sizeof(Value_Type), allocator)
+
+#define sparse_set_set(set_ptr, id, value) \
+	sparse_set_set_raw((set_ptr), (id), &(value), sizeof(value))
+
+///
+// Slot map
+
+void slot_map_reserve(Slot_Map *m, u64 required_count) {
+	if (m->capacity >= required_count) return;
+
+	u64 new_capacity = get_next_power_of_two(required_count);
+
+	// Slots are never given back, there's at most as many of them as there were items at once
+	m->items      = reallocate_uninitialized(m->allocator, m->items, m->capacity*m->item_size, new_capacity*m->item_size);
+	m->item_slots = reallocate_uninitialized(m->allocator, m->item_slots, m->capacity*sizeof(u32), new_capacity*sizeof(u32));
+	m->slots      = reallocate_uninitialized(m->allocator, m->slots, m->capacity*sizeof(Slot_Map_Slot), new_capacity*sizeof(Slot_Map_Slot));
+	m->capacity = new_capacity;
+}
+
+Slot_Map make_slot_map_reserve_raw(u64 item_size, u64 capacity_count, Allocator allocator) {
+	assert(item_size > 0, "Slot map item size must be more than 0");
+
+	Slot_Map m = ZERO(Slot_Map);
+	m.item_size = item_size;
+	m.allocator = allocator;
+	m.first_free_slot = SLOT_MAP_NO_SLOT;
+
+	slot_map_reserve(&m, max(capacity_count, 8));
+
+	return m;
+}
+inline Slot_Map make_slot_map_raw(u64 item_size, Allocator allocator) {
+	return make_slot_map_reserve_raw(item_size, 64, allocator);
+}
+
+void slot_map_destroy(Slot_Map *m) {
+	dealloc(m->allocator, m->items);
+	dealloc(m->allocator, m->item_slots);
+	dealloc(m->allocator, m->slots);
+
+	*m = ZERO(Slot_Map);
+}
+
+// Removes everything and invalidates all handles, keeps the memory
+void slot_map_reset(Slot_Map *m) {
+	for (u64 i = 0; i < m->count; i++) {
+		Slot_Map_Slot *slot = &m->slots[m->item_slots[i]];
+		slot->generation += 1;
+		slot->dense_index = m->first_free_slot;
+		m->first_free_slot = m->item_slots[i];
+	}
+	m->count = 0;
+}
+
+void *slot_map_add_uninitialized(Slot_Map *m, Slot_Handle *handle) {
+	slot_map_reserve(m, m->count+1);
+
+	u32 slot_index;
+	if (m->first_free_slot != SLOT_MAP_NO_SLOT) {
+		slot_index = m->first_free_slot;
+		m->first_free_slot = m->slots[slot_index].dense_index;
+	} else {
+		assert(m->slot_count < SLOT_MAP_NO_SLOT, "Slot map is full");
+		slot_index = (u32)m->slot_count;
+		m->slots[slot_index].generation = 0;
+		m->slot_count += 1;
+	}
+
+	Slot_Map_Slot *slot = &m->slots[slot_index];
+	slot->generation += 1; // Now odd, in use
+	slot->dense_index = (u32)m->count;
+
+	m->item_slots[m->count] = slot_index;
+	void *item = (u8*)m->items + m->count*m->item_size;
+	m->count += 1;
+
+	if (handle) {
+		handle->index = slot_index;
+		handle->generation = slot->generation;
+	}
+
+	return item;
+}
+void *slot_map_add_empty(Slot_Map *m, Slot_Handle *handle) {
+	void *item = slot_map_add_uninitialized(m, handle);
+#if DO_ZERO_INITIALIZATION
+	memset(item, 0, m->item_size);
+#endif
+	return item;
+}
+Slot_Handle slot_map_add_raw(Slot_Map *m, void *item, u64 item_size) {
+	assert(m->item_size == item_size, "Item type size does not match slot map initted item type size");
+
+	Slot_Handle handle;
+	void *new_item = slot_map_add_uninitialized(m, &handle);
+	memcpy(new_item, item, item_size);
+	return handle;
+}
+
+// Returns 0 if the item was removed (or the handle is zero)
+void *slot_map_get(Slot_Map *m, Slot_Handle handle) {
+	if (handle.index >= m->slot_count) return 0;
+
+	Slot_Map_Slot slot = m->slots[handle.index];
+	if (slot.generation != handle.generation || (slot.generation & 1) == 0) return 0;
+
+	return (u8*)m->items + slot.dense_index*m->item_size;
+}
+
+bool slot_map_contains(Slot_Map *m, Slot_Handle handle) {
+	return slot_map_get(m, handle) != 0;
+}
+
+// Returns false if the item was already removed
+bool slot_map_remove(Slot_Map *m, Slot_Handle handle) {
+	if (!slot_map_get(m, handle)) return false;
+
+	Slot_Map_Slot *slot = &m->slots[handle.index];
+	u32 dense_index = slot->dense_index;
+	u32 last_index = (u32)m->count-1;
+
+	// Move the last item into the hole
+	if (dense_index != last_index) {
+		memcpy((u8*)m->items + dense_index*m->item_size, (u8*)m->items + last_index*m->item_size, m->item_size);
+		u32 moved_slot = m->item_slots[last_index];
+		m->item_slots[dense_index] = moved_slot;
+		m->slots[moved_slot].dense_index = dense_index;
+	}
+	m->count -= 1;
+
+	slot->generation += 1; // Now even, free
+	slot->dense_index = m->first_free_slot;
+	m->first_free_slot = handle.index;
+
+	return true;
+}
+
+// The handle of the nth item in map.items
+Slot_Handle slot_map_get_nth_handle(Slot_Map *m, u64 n) {
+	assert(n < m->count, "Slot map n is out of range");
+
+	u32 slot_index = m->item_slots[n];
+	Slot_Handle handle;
+	handle.index = slot_index;
+	handle.generation = m->slots[slot_index].generation;
+	return handle;
+}
+
+///
+// Sparse set
+
+void sparse_set_reserve(Sparse_Set *s, u64 required_count) {
+	if (s->capacity >= required_count) return;
+
+	u64 new_capacity = get_next_power_of_two(required_count);
+
+	s->ids = reallocate_uninitialized(s->allocator, s->ids, s->capacity*sizeof(u32), new_capacity*sizeof(u32));
+	if (s->value_size) {
+		s->values = reallocate_uninitialized(s->allocator, s->values, s->capacity*s->value_size, new_capacity*s->value_size);
+	}
+	s->capacity = new_capacity;
+}
+
+// Makes room for ids up to max_id
+void sparse_set_reserve_ids(Sparse_Set *s, u32 max_id) {
+	if (s->sparse_count > max_id) return;
+
+	u64 new_count = get_next_power_of_two((u64)max_id+1);
+	s->sparse = reallocate(s->allocator, s->sparse, s->sparse_count*sizeof(u32), new_count*sizeof(u32));
+	s->sparse_count = new_count;
+}
+
+Sparse_Set make_sparse_set_reserve_raw(u64 value_size, u64 capacity_count, Allocator allocator) {
+	Sparse_Set s = ZERO(Sparse_Set);
+	s.value_size = value_size;
+	s.allocator = allocator;
+
+	sparse_set_reserve(&s, max(capacity_count, 8));
+
+	return s;
+}
+inline Sparse_Set make_sparse_set_raw(u64 value_size, Allocator allocator) {
+	return make_sparse_set_reserve_raw(value_size, 64, allocator);
+}
+
+void sparse_set_destroy(Sparse_Set *s) {
+	dealloc(s->allocator, s->ids);
+	if (s->values) dealloc(s->allocator, s->values);
+	if (s->sparse) dealloc(s->allocator, s->sparse);
+
+	*s = ZERO(Sparse_Set);
+}
+
+// The sparse array doesn't need clearing, nothing in it matches the ids anymore
+void sparse_set_reset(Sparse_Set *s) {
+	s->count = 0;
+}
+
+inline bool sparse_set_contains(Sparse_Set *s, u32 id) {
+	if (id >= s->sparse_count) return false;
+	u32 index = s->sparse[id];
+	return index < s->count && s->ids[index] == id;
+}
+
+// Returns 0 if the id isn't in the set, or if the set has no values
+void *sparse_set_find(Sparse_Set *s, u32 id) {
+	if (!s->value_size || !sparse_set_contains(s, id)) return 0;
+	return (u8*)s->values + s->sparse[id]*s->value_size;
+}
+
+// Returns true if the id was newly added. Its value is zeroed with DO_ZERO_INITIALIZATION.
+bool sparse_set_add(Sparse_Set *s, u32 id) {
+	if (sparse_set_contains(s, id)) return false;
+
+	sparse_set_reserve(s, s->count+1);
+	sparse_set_reserve_ids(s, id);
+
+	s->sparse[id] = (u32)s->count;
+	s->ids[s->count] = id;
+#if DO_ZERO_INITIALIZATION
+	if (s->value_size) memset((u8*)s->values + s->count*s->value_size, 0, s->value_size);
+#endif
+	s->count += 1;
+
+	return true;
+}
+
+// Returns true if the id was newly added, otherwise its value is replaced
+bool sparse_set_set_raw(Sparse_Set *s, u32 id, void *value, u64 value_size) {
+	assert(s->value_size == value_size, "Value type size does not match sparse set initted value type size");
+
+	bool newly_added = sparse_set_add(s, id);
+	memcpy((u8*)s->values + s->sparse[id]*s->value_size, value, value_size);
+
+	return newly_added;
+}
+
+// Returns false if the id wasn't in the set
+bool sparse_set_remove(Sparse_Set *s, u32 id) {
+	if (!sparse_set_contains(s, id)) return false;
+
+	u32 index = s->sparse[id];
+	u32 last_index = (u32)s->count-1;
+
+	// Move the last id (and value) into the hole
+	if (index != last_index) {
+		u32 last_id = s->ids[last_index];
+		s->ids[index] = last_id;
+		s->sparse[last_id] = index;
+		if (s->value_size) {
+			memcpy((u8*)s->values + index*s->value_size, (u8*)s->values + last_index*s->value_size, s->value_size);
+		}
+	}
+	s->count -= 1;
+
+	return true;
+}
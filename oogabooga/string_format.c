@@ -2,7 +2,7 @@
 ogb_instance void os_write_string_to_stdout(string s);
 inline int crt_sprintf(char *str, const char *format, ...);
 int vsnprintf(char* buffer, size_t n, const char* fmt, va_list args);
-bool is_pointer_valid(void *p);
+bool is_pointer_probably_valid(void *p);
 
 u64 format_string_to_buffer(char* buffer, u64 count, const char* fmt, va_list args);
 u64 format_string_to_buffer_vararg(char* buffer, u64 count, const char* fmt, ...) {
@@ -30,7 +30,7 @@ u64 format_string_to_buffer(char* buffer, u64 count, const char* fmt, va_list ar
                 string s = va_arg(args2, string);
                 va_end(args2);
             	// Ooga booga moment
-            	bool is_valid_fixed_length_string = s.count < 1024ULL*1024ULL*1024ULL*256ULL && is_pointer_valid(s.data);
+            	bool is_valid_fixed_length_string = s.count < 1024ULL*1024ULL*1024ULL*256ULL && is_pointer_probably_valid(s.data);
             	if (is_valid_fixed_length_string) {
             		va_arg(args, string);
 	                for (u64 i = 0; i < s.count && (bufp - buffer) < count - 1; i++) {
@@ -0,0 +1,209 @@
+
+/*
+
+	String interner:
+
+	Gives each distinct string a small u32 id and a copy that never moves, so strings that are
+	passed around a lot (asset paths, log categories, scope names) can be compared with == on
+	the id and hashed once instead of on every lookup.
+	Looking up a string that's already interned takes no lock. Interning a new one takes the
+	interner's lock.
+
+	// There's a global one, made in oogabooga_init
+	u32 id = intern_string(STR("sprites/player.png"));
+
+	// Stable for as long as the interner lives, and null terminated for C APIs
+	string path = get_interned_string(id);
+
+	// 0 if the string was never interned. Never interns anything.
+	u32 found = find_interned_string(STR("sprites/enemy.png"));
+
+	// Or keep your own
+	String_Interner interner;
+	string_interner_init(&interner, MB(64));
+	u32 category = string_interner_intern(&interner, STR("audio"));
+	string_interner_destroy(&interner);
+
+	Id 0 is never given out, so it can be used as "no string". The same string gets the same
+	id from the same interner, ids are not the same between interners or between runs.
+	Interned strings are never removed, only the whole interner can be destroyed.
+
+*/
+
+#ifndef STRING_INTERNER_ARENA_RESERVE_SIZE
+	#define STRING_INTERNER_ARENA_RESERVE_SIZE GB(1)
+#endif
+
+// Records are allocated in chunks and never move, so the id -> string lookup stays lock free
+#define STRING_INTERNER_CHUNK_SIZE 1024
+#define STRING_INTERNER_MAX_CHUNKS 4096 // ~4 million strings
+
+typedef struct Interned_String {
+	string s;
+	u64 hash;
+} Interned_String;
+
+// Open addressing. Each slot is (high 32 bits of hash) << 32 | id, 0 means empty. A slot is
+// written once with a single aligned 64 bit store, so readers see it whole or not at all.
+typedef struct _String_Interner_Table {
+	u64 capacity; // Power of two
+	volatile u64 slots[];
+} _String_Interner_Table;
+
+typedef struct String_Interner {
+	Arena *arena;
+	_String_Interner_Table *volatile table;
+	Interned_String *volatile *chunks;
+	volatile u32 count;
+	Spinlock lock;
+} String_Interner;
+
+void
+string_interner_init(String_Interner *interner, u64 arena_reserve_size) {
+	*interner = ZERO(String_Interner);
+	spinlock_init(&interner->lock);
+	interner->arena = arena_make(arena_reserve_size);
+
+	interner->chunks = (Interned_String *volatile*)arena_push(interner->arena, STRING_INTERNER_MAX_CHUNKS*sizeof(Interned_String*));
+	memset((void*)interner->chunks, 0, STRING_INTERNER_MAX_CHUNKS*sizeof(Interned_String*));
+
+	u64 capacity = 1024;
+	_String_Interner_Table *table = arena_push(interner->arena, sizeof(_String_Interner_Table) + capacity*sizeof(u64));
+	memset(table, 0, sizeof(_String_Interner_Table) + capacity*sizeof(u64));
+	table->capacity = capacity;
+	interner->table = table;
+}
+void
+string_interner_destroy(String_Interner *interner) {
+	arena_destroy(interner->arena);
+	*interner = ZERO(String_Interner);
+}
+
+inline Interned_String *
+_string_interner_get_record(String_Interner *interner, u32 id) {
+	u32 index = id-1;
+	return &interner->chunks[index/STRING_INTERNER_CHUNK_SIZE][index%STRING_INTERNER_CHUNK_SIZE];
+}
+
+u32
+_string_interner_find_in_table(String_Interner *interner, _String_Interner_Table *table, string s, u64 hash) {
+	u64 mask = table->capacity-1;
+	u64 hash_bits = hash >> 32;
+
+	for (u64 i = hash & mask; ; i = (i+1) & mask) {
+		u64 slot = table->slots[i];
+		if (slot == 0) return 0;
+
+		if ((slot >> 32) == hash_bits) {
+			u32 id = (u32)slot;
+			Interned_String *record = _string_interner_get_record(interner, id);
+			if (record->hash == hash && strings_match(record->s, s)) return id;
+		}
+	}
+}
+void
+_string_interner_put_in_table(_String_Interner_Table *table, u64 hash, u32 id) {
+	u64 mask = table->capacity-1;
+	u64 i = hash & mask;
+	while (table->slots[i] != 0) i = (i+1) & mask;
+	table->slots[i] = ((hash >> 32) << 32) | id;
+}
+
+// Lock free. Returns 0 if the string isn't interned.
+u32
+string_interner_find(String_Interner *interner, string s) {
+	u64 hash = string_get_hash(s);
+	return _string_interner_find_in_table(interner, interner->table, s, hash);
+}
+
+u32
+string_interner_intern(String_Interner *interner, string s) {
+	u64 hash = string_get_hash(s);
+
+	// Most strings are interned already, so try without the lock first
+	u32 id = _string_interner_find_in_table(interner, interner->table, s, hash);
+	if (id) return id;
+
+	spinlock_acquire_or_wait(&interner->lock);
+
+	// Someone might have interned it, or grown the table, while we were waiting
+	_String_Interner_Table *table = interner->table;
+	id = _string_interner_find_in_table(interner, table, s, hash);
+	if (id) {
+		spinlock_release(&interner->lock);
+		return id;
+	}
+
+	u32 index = interner->count;
+	assert(index < STRING_INTERNER_MAX_CHUNKS*STRING_INTERNER_CHUNK_SIZE, "String interner is full");
+
+	u32 chunk_index = index/STRING_INTERNER_CHUNK_SIZE;
+	if (!interner->chunks[chunk_index]) {
+		Interned_String *chunk = arena_push(interner->arena, STRING_INTERNER_CHUNK_SIZE*sizeof(Interned_String));
+		interner->chunks[chunk_index] = chunk;
+	}
+
+	u8 *data = arena_push_aligned(interner->arena, s.count+1, 1);
+	memcpy(data, s.data, s.count);
+	data[s.count] = 0;
+
+	Interned_String *record = &interner->chunks[chunk_index][index%STRING_INTERNER_CHUNK_SIZE];
+	record->s = (string){s.count, data};
+	record->hash = hash;
+
+	id = index+1;
+	interner->count = id;
+
+	// Keep the load under a half. The new table is filled in completely before it's published,
+	// and the old one is left in the arena since readers might still be probing it.
+	if ((u64)(index+1)*2 > table->capacity) {
+		u64 capacity = table->capacity*2;
+		_String_Interner_Table *new_table = arena_push(interner->arena, sizeof(_String_Interner_Table) + capacity*sizeof(u64));
+		memset(new_table, 0, sizeof(_String_Interner_Table) + capacity*sizeof(u64));
+		new_table->capacity = capacity;
+		for (u32 i = 1; i < id; i++) {
+			_string_interner_put_in_table(new_table, _string_interner_get_record(interner, i)->hash, i);
+		}
+		_string_interner_put_in_table(new_table, hash, id);
+
+		MEMORY_BARRIER;
+		interner->table = new_table;
+	} else {
+		// The record has to be visible before the slot pointing at it
+		MEMORY_BARRIER;
+		_string_interner_put_in_table(table, hash, id);
+	}
+
+	spinlock_release(&interner->lock);
+
+	return id;
+}
+
+// The string data stays where it is until the interner is destroyed
+string
+string_interner_get(String_Interner *interner, u32 id) {
+	assert(id != 0 && id <= interner->count, "Invalid interned string id %u", id);
+	return _string_interner_get_record(interner, id)->s;
+}
+u64
+string_interner_get_hash(String_Interner *interner, u32 id) {
+	assert(id != 0 && id <= interner->count, "Invalid interned string id %u", id);
+	return _string_interner_get_record(interner, id)->hash;
+}
+
+// #Global
+ogb_instance String_Interner string_interner;
+
+#if !OOGABOOGA_LINK_EXTERNAL_INSTANCE
+String_Interner string_interner;
+#endif // NOT OOGABOOGA_LINK_EXTERNAL_INSTANCE
+
+u32 intern_string(string s) {
+	return string_interner_intern(&string_interner, s);
+}
+u32 find_interned_string(string s) {
+	return string_interner_find(&string_interner, s);
+}
+string get_interned_string(u32 id) {
+	return string_interner_get(&string_interner, id);
+}
@@ -5,7 +5,7 @@
 ///
 
 void log_heap() {
-	spinlock_acquire_or_wait(&heap_lock);
+	spinlock_acquire_or_wait(&heap_lock.lock);
 	print("\nHEAP:\n");
 	
 	Heap_Block *block = heap_head;
@@ -31,7 +31,7 @@ void log_heap() {
 		
 		block = block->next;
 	}
-	spinlock_release(&heap_lock);
+	spinlock_release(&heap_lock.lock);
 }
 
 void test_allocator(bool do_log_heap) {
@@ -197,6 +197,555 @@ void test_allocator(bool do_log_heap) {
     if (do_log_heap) log_heap();
 }
 
+void test_heap_large_allocations() {
+	Allocator heap = get_heap_allocator();
+	
+	// Large allocations get their own pages and are still valid pointers
+	u8 *big = alloc(heap, MB(4));
+	assert(!is_pointer_in_program_memory(big), "Failed: large allocation should not be in the heap blocks");
+	assert(is_pointer_valid(big) && is_pointer_valid(big+MB(4)-1), "Failed: large allocation should be a valid pointer");
+	assert(is_pointer_probably_valid(big), "Failed: large allocation should count for is_pointer_probably_valid");
+	assert((u64)big % 16 == 0, "Failed: large allocation alignment");
+	for (u64 i = 0; i < MB(4); i += 4096) big[i] = (u8)(i/4096);
+	
+	// Grows in place while it fits in its page run
+	u8 *grown = heap.proc(MB(4)+1000, big, ALLOCATOR_REALLOCATE, heap.data);
+	assert(grown == big, "Failed: large allocation should grow in place");
+	u8 *moved = heap.proc(MB(16), grown, ALLOCATOR_REALLOCATE, heap.data);
+	for (u64 i = 0; i < MB(4); i += 4096) assert(moved[i] == (u8)(i/4096), "Failed: large reallocate lost data");
+	
+	// Small -> large -> small
+	u8 *small = alloc(heap, 100);
+	memset(small, 0x11, 100);
+	small = heap.proc(MB(2), small, ALLOCATOR_REALLOCATE, heap.data);
+	assert(small[99] == 0x11 && !is_pointer_in_program_memory(small), "Failed: small to large reallocate");
+	small = heap.proc(64, small, ALLOCATOR_REALLOCATE, heap.data);
+	assert(small[63] == 0x11 && is_pointer_in_program_memory(small), "Failed: large to small reallocate");
+	dealloc(heap, small);
+	
+	// Freed runs are kept for reuse, within the budget
+	dealloc(heap, moved);
+	assert(heap_large_cached_bytes > 0 && heap_large_cached_bytes <= HEAP_RETAIN_BUDGET, "Failed: freed large allocation should be cached");
+	u8 *reused = alloc(heap, MB(12));
+	assert(reused == moved, "Failed: cached large allocation should be reused");
+#if DO_ZERO_INITIALIZATION
+	assert(reused[MB(12)-1] == 0, "Failed: reused large allocation should be zeroed by alloc");
+#endif
+	dealloc(heap, reused);
+	
+	// Free spans get decommitted, and come back when allocated again
+	heap_release_unused_memory();
+	assert(heap_large_cached_bytes == 0, "Failed: heap_release_unused_memory should release cached large allocations");
+	assert(heap_decommitted_bytes > 0, "Failed: heap_release_unused_memory should decommit free spans");
+	
+	u8 *chunks[64];
+	for (u64 i = 0; i < 64; i++) {
+		chunks[i] = alloc(heap, KB(200));
+		memset(chunks[i], (int)i, KB(200));
+	}
+	for (s64 i = 63; i >= 0; i--) {
+		for (u64 j = 0; j < KB(200); j += 1000) assert(chunks[i][j] == (u8)i, "Failed: heap memory corrupted around decommitted pages");
+		dealloc(heap, chunks[i]);
+	}
+	heap_release_unused_memory();
+	for (u64 i = 0; i < 64; i++) {
+		chunks[i] = alloc(heap, KB(200));
+		memset(chunks[i], (int)i, KB(200));
+	}
+	for (u64 i = 0; i < 64; i++) {
+		assert(chunks[i][KB(200)-1] == (u8)i, "Failed: recommitted heap memory");
+		dealloc(heap, chunks[i]);
+	}
+}
+
+void test_heap_resize_and_alignment() {
+	Allocator heap = get_heap_allocator();
+	
+	// Grows into the free space right after it, and shrinks in place
+	u8 *a = alloc(heap, 1000);
+	u8 *b = alloc(heap, 1000);
+	memset(a, 0x22, 1000);
+	bool b_is_neighbour = b == a + heap_get_allocation_size(a) + sizeof(Heap_Allocation_Metadata);
+	dealloc(heap, b);
+	u8 *grown = heap.proc(1900, a, ALLOCATOR_REALLOCATE, heap.data);
+	if (b_is_neighbour) assert(grown == a, "Failed: heap reallocate should grow into the free neighbour");
+	for (int i = 0; i < 1000; i++) assert(grown[i] == 0x22, "Failed: heap reallocate lost data");
+	u8 *shrunk = heap.proc(100, grown, ALLOCATOR_REALLOCATE, heap.data);
+	assert(shrunk == grown, "Failed: heap reallocate should shrink in place");
+	assert(heap_get_allocation_size(shrunk) < 200, "Failed: shrinking should give back the tail");
+	dealloc(heap, shrunk);
+	
+	// reallocate() zeroes the new part, and works with allocators that can't reallocate
+	int *numbers = alloc(heap, 10*sizeof(int));
+	for (int i = 0; i < 10; i++) numbers[i] = i+1;
+	numbers = reallocate(heap, numbers, 10*sizeof(int), 100*sizeof(int));
+	for (int i = 0; i < 10; i++) assert(numbers[i] == i+1, "Failed: reallocate lost data");
+#if DO_ZERO_INITIALIZATION
+	for (int i = 10; i < 100; i++) assert(numbers[i] == 0, "Failed: reallocate should zero the new part");
+#endif
+	dealloc(heap, numbers);
+	
+	int *temp_numbers = alloc(get_temporary_allocator(), 10*sizeof(int));
+	for (int i = 0; i < 10; i++) temp_numbers[i] = i+1;
+	temp_numbers = reallocate(get_temporary_allocator(), temp_numbers, 10*sizeof(int), 100*sizeof(int));
+	for (int i = 0; i < 10; i++) assert(temp_numbers[i] == i+1, "Failed: reallocate with temporary allocator lost data");
+	
+	// Aligned allocations, small and large, from the heap and the other allocators
+	Allocator allocators[] = { heap, get_temporary_allocator() };
+	for (u64 i = 0; i < sizeof(allocators)/sizeof(Allocator); i++) {
+		for (u64 alignment = 32; alignment <= os.page_size; alignment *= 2) {
+			u8 *small = alloc_aligned(allocators[i], 100, alignment);
+			u8 *filler = alloc(allocators[i], 16);
+			assert((u64)small % alignment == 0, "Failed: alloc_aligned small (%llu)", alignment);
+			memset(small, 0x33, 100);
+			dealloc(allocators[i], filler);
+			dealloc(allocators[i], small);
+		}
+	}
+	u8 *big = alloc_aligned(heap, MB(2), 4096);
+	assert((u64)big % 4096 == 0, "Failed: alloc_aligned large");
+	assert(is_pointer_valid(big) && is_pointer_valid(big+MB(2)-1), "Failed: aligned large allocation should be a valid pointer");
+	memset(big, 0x44, MB(2));
+	dealloc(heap, big);
+	
+	// Freeing everything merges the free nodes again
+	u8 *ptrs[100];
+	for (int i = 0; i < 100; i++) ptrs[i] = alloc(heap, 64 + i*16);
+	for (int i = 0; i < 100; i += 2) dealloc(heap, ptrs[i]);
+	for (int i = 1; i < 100; i += 2) dealloc(heap, ptrs[i]);
+	
+	spinlock_acquire_or_wait(&heap_lock.lock);
+	for (Heap_Block *block = heap_head; block; block = block->next) {
+		for (Heap_Free_Node *node = block->free_head; node && node->next; node = node->next) {
+			assert((u8*)node + node->size < (u8*)node->next, "Failed: heap free list should be sorted and merged");
+		}
+	}
+	spinlock_release(&heap_lock.lock);
+}
+
+void test_heap_stats() {
+	Allocator heap = get_heap_allocator();
+	
+	Heap_Tag tag = heap_tag_make(STR("Test \"heap\" stats"));
+	assert(tag != HEAP_TAG_NONE, "Failed: heap_tag_make");
+	assert(heap_tag_make(STR("Test \"heap\" stats")) == tag, "Failed: heap_tag_make should find the existing tag");
+	
+	Heap_Tag_Stats before = get_heap_tag_stats(tag);
+	
+	u8 *small = 0;
+	u8 *medium = 0;
+	u8 *large = 0;
+	heap_tag_scope(tag) {
+		small  = alloc(heap, 100);
+		medium = alloc(heap, 5000);
+		large  = alloc(heap, MB(2));
+	}
+	assert(heap_get_tag() == HEAP_TAG_NONE, "Failed: heap_tag_scope should reset the tag");
+	u8 *untagged = alloc(heap, 100);
+	
+	Heap_Tag_Stats during = get_heap_tag_stats(tag);
+	assert(during.live_allocations == before.live_allocations + 3, "Failed: tag live allocations");
+	assert(during.live_bytes >= before.live_bytes + 5100 + MB(2), "Failed: tag live bytes");
+	assert(during.peak_bytes >= during.live_bytes, "Failed: tag peak bytes");
+	
+	Heap_Stats stats = get_heap_stats();
+	assert(stats.bytes_in_use >= during.live_bytes, "Failed: heap bytes in use");
+	assert(stats.bytes_committed >= stats.bytes_in_use, "Failed: heap bytes committed");
+	assert(stats.large_bytes >= MB(2), "Failed: heap large bytes");
+	assert(stats.block_count >= 1 && stats.free_node_count >= 1, "Failed: heap free lists");
+	assert(stats.largest_free <= stats.free_bytes, "Failed: heap largest free node");
+	assert(stats.fragmentation >= 0.0 && stats.fragmentation < 1.0, "Failed: heap fragmentation");
+	assert(stats.allocations_per_size_class[get_heap_size_class(heap_get_allocation_size(large))] >= 1, "Failed: heap size classes");
+	
+	string json = heap_stats_to_json(get_temporary_allocator());
+	assert(string_find_from_left(json, STR("\"bytes_in_use\": ")) != -1, "Failed: heap json");
+	assert(string_find_from_left(json, STR("\"size_classes\": [")) != -1, "Failed: heap json");
+	assert(string_find_from_left(json, STR("\"name\": \"Test \\\"heap\\\" stats\"")) != -1, "Failed: heap json should list escaped tag names");
+	
+	// Moving and resizing keeps the tag
+	medium = heap.proc(20000, medium, ALLOCATOR_REALLOCATE, heap.data);
+	small = heap.proc(50, small, ALLOCATOR_REALLOCATE, heap.data);
+	during = get_heap_tag_stats(tag);
+	assert(during.live_allocations == before.live_allocations + 3, "Failed: tag should survive reallocate");
+	
+	dealloc(heap, small);
+	dealloc(heap, medium);
+	dealloc(heap, large);
+	dealloc(heap, untagged);
+	
+	Heap_Tag_Stats after = get_heap_tag_stats(tag);
+	assert(after.live_allocations == before.live_allocations, "Failed: tag live allocations after free");
+	assert(after.live_bytes == before.live_bytes, "Failed: tag live bytes after free");
+	assert(after.total_allocations >= before.total_allocations + 3, "Failed: tag total allocations");
+}
+
+void test_alloc_zeroed() {
+	// Memory that was used before has to be cleared, fresh memory is zero already.
+	// Dirty some memory first so there's something to get wrong.
+	Arena *arena = arena_make(MB(8));
+	Pool pool;
+	pool_init(&pool, 256, 16, get_heap_allocator());
+	Allocator allocators[] = {
+		get_heap_allocator(),
+		get_temporary_allocator(),
+		get_arena_allocator(arena),
+		get_pool_allocator(&pool),
+	};
+	u64 sizes[] = { 16, 200, 5000, 100000, MB(2) };
+	for (u64 a = 0; a < sizeof(allocators)/sizeof(Allocator); a++) {
+		bool is_pool = a == 3;
+		for (u64 s = 0; s < sizeof(sizes)/sizeof(u64); s++) {
+			u64 size = sizes[s];
+			if (is_pool && size > 256) continue;
+			if (a == 1 && size > KB(64)) continue;
+			
+			Arena_Mark mark = arena_get_mark(arena);
+			u8 *dirty = alloc_uninitialized(allocators[a], size);
+			memset(dirty, 0xCD, size);
+			dealloc(allocators[a], dirty);
+			arena_pop_to_mark(mark);
+			
+			u8 *p = alloc_zeroed(allocators[a], size);
+			for (u64 i = 0; i < size; i++) assert(p[i] == 0, "Failed: alloc_zeroed (allocator %llu, size %llu, byte %llu)", a, size, i);
+			u8 *q = alloc_zeroed(allocators[a], size);
+			for (u64 i = 0; i < size; i++) assert(q[i] == 0, "Failed: alloc_zeroed fresh (allocator %llu, size %llu, byte %llu)", a, size, i);
+			dealloc(allocators[a], q);
+			dealloc(allocators[a], p);
+		}
+	}
+	pool_deinit(&pool);
+	arena_destroy(arena);
+	
+	// Growing arrays only clear what's added empty or resized into
+	int *ints;
+	growing_array_init_reserve((void**)&ints, sizeof(int), 4, get_heap_allocator());
+	for (int i = 0; i < 4; i++) growing_array_add((void**)&ints, &i);
+	growing_array_clear((void**)&ints);
+	int *empty = growing_array_add_empty((void**)&ints);
+#if DO_ZERO_INITIALIZATION
+	assert(*empty == 0, "Failed: growing_array_add_empty should be zeroed");
+	growing_array_resize((void**)&ints, 100);
+	for (int i = 0; i < 100; i++) assert(ints[i] == 0, "Failed: growing_array_resize should zero new items");
+#endif
+	growing_array_deinit((void**)&ints);
+}
+
+void test_arena() {
+	Arena *arena = arena_make(MB(64));
+	assert(arena && arena_get_used(arena) == 0, "Failed: arena_make");
+	
+	// Pushes are aligned and don't overlap
+	u8 *a = arena_push(arena, 3);
+	u8 *b = arena_push(arena, 100);
+	u8 *c = arena_push_aligned(arena, 10, 64);
+	assert((u64)a % 16 == 0 && (u64)b % 16 == 0, "Failed: arena default alignment");
+	assert((u64)c % 64 == 0, "Failed: arena explicit alignment");
+	assert(b >= a+3 && c >= b+100, "Failed: arena allocations overlap");
+	assert(is_pointer_valid(a), "Failed: arena memory should count as a valid pointer");
+	assert(is_pointer_probably_valid(a), "Failed: arena memory should count for is_pointer_probably_valid");
+	
+	// Commits on demand past the first chunk
+	u8 *big = arena_push(arena, MB(3));
+	memset(big, 0xAB, MB(3));
+	assert(big[MB(3)-1] == 0xAB, "Failed: arena commit on demand");
+	assert(arena->committed >= arena->pos, "Failed: arena committed less than used");
+	
+	// Marks
+	Arena_Mark mark = arena_get_mark(arena);
+	u64 used_before = arena_get_used(arena);
+	u8 *temp = arena_push(arena, 1000);
+	arena_pop_to_mark(mark);
+	assert(arena_get_used(arena) == used_before, "Failed: arena_pop_to_mark");
+	assert(arena_push(arena, 1000) == temp, "Failed: memory after a mark should be reused");
+	arena_pop_to_mark(mark);
+	
+	// Scopes, including nested ones
+	arena_scope(arena) {
+		arena_push(arena, 500);
+		arena_scope(arena) {
+			arena_push(arena, 500);
+		}
+		assert(arena_get_used(arena) > used_before, "Failed: inner arena scope popped too much");
+	}
+	assert(arena_get_used(arena) == used_before, "Failed: arena_scope didn't pop");
+	
+	// Through the allocator interface, realloc of the last allocation stays in place
+	Allocator allocator = get_arena_allocator(arena);
+	int *numbers = alloc(allocator, 10*sizeof(int));
+	for (int i = 0; i < 10; i++) numbers[i] = i;
+	int *grown = allocator.proc(1000*sizeof(int), numbers, ALLOCATOR_REALLOCATE, allocator.data);
+	assert(grown == numbers, "Failed: arena should grow the last allocation in place");
+	int *other = alloc(allocator, 16);
+	(void)other;
+	int *moved = allocator.proc(2000*sizeof(int), grown, ALLOCATOR_REALLOCATE, allocator.data);
+	assert(moved != grown, "Failed: arena reallocate of a non-last allocation should move");
+	for (int i = 0; i < 10; i++) assert(moved[i] == i, "Failed: arena reallocate lost data");
+	
+	// Growing arrays in arenas just leave the old copies behind
+	int *ints;
+	growing_array_init((void**)&ints, sizeof(int), allocator);
+	for (int i = 0; i < 10000; i++) growing_array_add((void**)&ints, &i);
+	for (int i = 0; i < 10000; i++) assert(ints[i] == i, "Failed: growing array in arena");
+	
+	u64 high_water = arena->high_water;
+	arena_reset(arena);
+	assert(arena_get_used(arena) == 0, "Failed: arena_reset");
+	assert(arena->high_water == high_water, "Failed: arena_reset shouldn't forget the high water mark");
+	assert(arena_push(arena, 3) == a, "Failed: arena_reset should start over from the beginning");
+	
+	arena_destroy(arena);
+}
+
+void test_pool_thread_proc(Thread *t) {
+	Pool *pool = (Pool*)t->data;
+	u64 *mine[200];
+	for (u64 round = 0; round < 50; round++) {
+		for (u64 i = 0; i < 200; i++) {
+			mine[i] = pool_alloc(pool);
+			mine[i][0] = (u64)t;
+			mine[i][1] = i;
+		}
+		for (u64 i = 0; i < 200; i++) {
+			assert(mine[i][0] == (u64)t && mine[i][1] == i, "Failed: pool element shared between threads");
+			pool_free(pool, mine[i]);
+		}
+	}
+}
+
+void test_pool() {
+	Pool pool;
+	pool_init(&pool, 24, 8, get_heap_allocator());
+	assert(pool.element_size == 32, "Failed: pool element size should be padded to the alignment");
+	
+	// Handed out in order, grows in chunks
+	u8 *elements[20];
+	for (u64 i = 0; i < 20; i++) {
+		elements[i] = pool_alloc(&pool);
+		assert((u64)elements[i] % 16 == 0, "Failed: pool alignment");
+		memset(elements[i], (int)i, 24);
+	}
+	assert(elements[1] == elements[0]+32, "Failed: pool should hand out elements in order");
+	assert(pool.chunk_count == 3, "Failed: pool should grow by one chunk at a time");
+	for (u64 i = 0; i < 20; i++) {
+		for (u64 j = 0; j < 24; j++) assert(elements[i][j] == (u8)i, "Failed: pool elements overlap");
+		assert(pool_owns(&pool, elements[i]), "Failed: pool_owns");
+	}
+	assert(!pool_owns(&pool, elements[0]+1), "Failed: pool_owns should only accept element pointers");
+	
+	// Last freed is the first reused
+	pool_free(&pool, elements[5]);
+	pool_free(&pool, elements[7]);
+	assert(pool_alloc(&pool) == elements[7] && pool_alloc(&pool) == elements[5], "Failed: pool free list");
+	
+	// Allocator interface
+	Allocator allocator = get_pool_allocator(&pool);
+	u8 *p = alloc(allocator, 20);
+	assert(pool_owns(&pool, p), "Failed: pool allocator");
+	for (u64 i = 0; i < 20; i++) assert(p[i] == 0 || !DO_ZERO_INITIALIZATION, "Failed: alloc on a pool allocator should zero");
+	dealloc(allocator, p);
+	assert(alloc_aligned(allocator, 16, 64) == 0, "Failed: pool should refuse alignment it can't do");
+	pool_deinit(&pool);
+	
+	pool_init_aligned(&pool, 100, 64, 4, get_heap_allocator());
+	for (u64 i = 0; i < 10; i++) assert((u64)pool_alloc(&pool) % 64 == 0, "Failed: aligned pool");
+	pool_deinit(&pool);
+	
+	// Thread caches
+	pool_init(&pool, 2*sizeof(u64), 64, get_heap_allocator());
+	pool.use_thread_caches = true;
+	
+	Thread threads[4];
+	for (u64 i = 0; i < 4; i++) {
+		os_thread_init(&threads[i], test_pool_thread_proc);
+		threads[i].data = &pool;
+		os_thread_start(&threads[i]);
+	}
+	Thread self = ZERO(Thread);
+	self.data = &pool;
+	test_pool_thread_proc(&self);
+	for (u64 i = 0; i < 4; i++) {
+		os_thread_join(&threads[i]);
+		os_thread_destroy(&threads[i]);
+	}
+	
+	// Everything went back, so allocating the whole capacity doesn't grow the pool
+	pool_flush_thread_caches();
+	pool.use_thread_caches = false;
+	u64 capacity = pool.chunk_count*pool.elements_per_chunk;
+	u64 chunks = pool.chunk_count;
+	for (u64 i = 0; i < capacity; i++) pool_alloc(&pool);
+	assert(pool.chunk_count == chunks, "Failed: pool thread caches lost elements");
+	pool_deinit(&pool);
+}
+
+// Worker threads start with a tiny temporary storage, this used to run past the end of it
+void test_temporary_storage_thread_proc(Thread *t) {
+	u64 *chunks[100];
+	for (u64 i = 0; i < 100; i++) {
+		chunks[i] = talloc(KB(1));
+		for (u64 j = 0; j < KB(1)/sizeof(u64); j++) chunks[i][j] = i;
+	}
+	for (u64 i = 0; i < 100; i++) {
+		for (u64 j = 0; j < KB(1)/sizeof(u64); j++) assert(chunks[i][j] == i, "Failed: worker temporary storage overlapped");
+	}
+	reset_temporary_storage();
+	assert(get_temporary_storage_last_high_water() >= KB(100), "Failed: worker temporary storage high water");
+}
+
+void test_temporary_storage() {
+	reset_temporary_storage();
+	
+	// Scopes give back only what was allocated inside them
+	u8 *a = talloc(100);
+	u8 *b = 0;
+	temp_scope() {
+		b = talloc(100);
+		temp_scope() {
+			talloc(100);
+		}
+		assert(talloc(1) != b, "Failed: inner temp scope freed the outer scope's memory");
+	}
+	u8 *c = talloc(100);
+	assert(c == b, "Failed: temp_scope didn't give memory back");
+	assert(a != c, "Failed: temp_scope freed memory from before the scope");
+	assert((u64)a % 16 == 0 && (u64)c % 16 == 0, "Failed: talloc alignment");
+	
+	// Overflowing chains a new block instead of wrapping over live memory
+	memset(a, 0x42, 100);
+	u64 big_size = TEMPORARY_STORAGE_SIZE + MB(1);
+	u8 *big = talloc(big_size);
+	memset(big, 0x13, big_size);
+	for (u64 i = 0; i < 100; i++) assert(a[i] == 0x42, "Failed: temporary storage overflow corrupted earlier allocation");
+	assert(get_temporary_storage_high_water() >= big_size, "Failed: temporary storage high water");
+	
+	// Scope ending across a chained block
+	Temp_Scope scope = temp_scope_begin();
+	talloc(big_size*2);
+	temp_scope_end(scope);
+	assert(talloc(16) == big+big_size, "Failed: temp_scope_end across blocks");
+	
+	// After reset it's made room so the same frame doesn't need to chain
+	reset_temporary_storage();
+	assert(get_temporary_storage_last_high_water() >= big_size, "Failed: temporary storage last high water");
+	talloc(100);
+	talloc(big_size);
+	assert(temporary_storage_block == temporary_storage, "Failed: temporary storage should have grown on reset");
+	reset_temporary_storage();
+	
+	Thread t;
+	os_thread_init(&t, test_temporary_storage_thread_proc);
+	assert(t.temporary_storage_size < KB(100), "Test assumes a small worker temporary storage");
+	os_thread_start(&t);
+	os_thread_join(&t);
+	os_thread_destroy(&t);
+}
+
+void test_third_party_allocator_thread_proc(Thread *t) {
+	Arena *arena = (Arena*)t->data;
+	Third_Party_Scope scope = third_party_scope_begin(get_arena_allocator(arena));
+	for (u64 i = 0; i < 1000; i++) {
+		u8 *p = third_party_malloc(64);
+		assert(p >= arena->base && p < arena->base + arena->reserved, "Failed: third party allocator shared between threads");
+		u8 *scratch = third_party_scratch_alloc(128);
+		assert(!(scratch >= arena->base && scratch < arena->base + arena->reserved), "Failed: third party scratch should be its own memory");
+	}
+	third_party_scope_end(scope);
+}
+
+void test_third_party_allocator() {
+	Allocator heap = get_heap_allocator();
+	
+	// Scopes nest, and scratch memory is given back when the scope ends
+	Third_Party_Scope outer = third_party_scope_begin(heap);
+	u64 scratch_used = arena_get_used(get_third_party_scratch());
+	
+	Third_Party_Scope inner = third_party_scope_begin(get_temporary_allocator());
+	third_party_scratch_alloc(KB(10));
+	assert(third_party_allocator.proc == get_temporary_allocator().proc, "Failed: third_party_scope_begin");
+	
+	// Can grow with allocators that can't reallocate, when the old size is known
+	u8 *grown = third_party_malloc(16);
+	memset(grown, 0x11, 16);
+	grown = third_party_realloc_sized(grown, 16, 1000);
+	for (u64 i = 0; i < 16; i++) assert(grown[i] == 0x11, "Failed: third_party_realloc_sized lost data");
+	
+	third_party_scope_end(inner);
+	assert(third_party_allocator.proc == heap.proc, "Failed: third_party_scope_end should restore the outer allocator");
+	assert(arena_get_used(get_third_party_scratch()) == scratch_used, "Failed: third party scratch should be reset at scope end");
+	third_party_scope_end(outer);
+	
+	// Each thread has its own
+	Thread threads[4];
+	Arena *arenas[4];
+	for (u64 i = 0; i < 4; i++) {
+		arenas[i] = arena_make(MB(1));
+		os_thread_init(&threads[i], test_third_party_allocator_thread_proc);
+		threads[i].data = arenas[i];
+		os_thread_start(&threads[i]);
+	}
+	for (u64 i = 0; i < 4; i++) {
+		os_thread_join(&threads[i]);
+		os_thread_destroy(&threads[i]);
+		arena_destroy(arenas[i]);
+	}
+}
+
+void *test_worker_group_allocator_proc(u64 size, void *p, Allocator_Message message, void *data) {
+	return heap_allocator_proc(size, p, message, data);
+}
+void test_worker_group_thread_proc(Thread *t) {
+	Worker_Context *w = get_worker_context();
+	assert(w && w == t->worker_context, "Failed: get_worker_context");
+	assert(context.allocator.proc == test_worker_group_allocator_proc, "Failed: worker context allocator");
+	assert(context.thread_id != 0, "Failed: worker thread id");
+	
+	// Temporary storage is the worker's slice, no heap involved
+	u8 *slice = (u8*)w;
+	u8 *p = talloc(KB(4));
+	assert(p >= slice && p < slice + w->slice_size, "Failed: worker temporary storage should be in its slice");
+	
+	// Overflowing still works, and the slice is never given to heap_dealloc
+	talloc(w->temporary_storage_size*2);
+	reset_temporary_storage();
+	u8 *q = talloc(w->temporary_storage_size);
+	assert(!(q >= slice && q < slice + w->slice_size), "Failed: worker temporary storage should grow after overflowing");
+	
+	u64 *hits = (u64*)t->data;
+	hits[w->index] += 1;
+}
+
+void test_worker_group() {
+	u64 hits[8] = {0};
+	
+	Worker_Policy policy = ZERO(Worker_Policy);
+	policy.temporary_storage_size = KB(64);
+	policy.profiler_buffer_size = KB(4);
+	policy.stack_size = MB(1);
+	policy.allocator = (Allocator){ test_worker_group_allocator_proc, 0 };
+	policy.prefault = true;
+	
+	Worker_Group group;
+	worker_group_init(&group, 8, test_worker_group_thread_proc, hits, policy);
+	assert(group.worker_count == 8, "Failed: worker_group_init");
+	for (u64 i = 0; i < group.worker_count; i++) {
+		Worker_Context *w = group.workers[i];
+		assert((u64)w % os.page_size == 0, "Failed: worker slices should be page aligned");
+		assert(is_pointer_valid(w->temporary_storage), "Failed: worker memory should be valid for is_pointer_valid");
+		assert(w->profiler_buffer >= (u8*)w->temporary_storage + w->temporary_storage_size, "Failed: profiler buffer overlaps temporary storage");
+		assert(w->profiler_buffer + w->profiler_buffer_size <= (u8*)w + w->slice_size, "Failed: profiler buffer outside of the worker slice");
+		if (i > 0) assert((u8*)w >= (u8*)group.workers[i-1] + group.workers[i-1]->slice_size, "Failed: worker slices overlap");
+	}
+	
+	worker_group_start(&group);
+	worker_group_destroy(&group);
+	
+	for (u64 i = 0; i < 8; i++) assert(hits[i] == 1, "Failed: worker %llu ran %llu times", i, hits[i]);
+	assert(group.arena == 0 && group.worker_count == 0, "Failed: worker_group_destroy");
+	
+	// Standalone threads are unaffected
+	assert(get_worker_context() == 0, "Failed: main thread is not a worker");
+}
+
 void test_thread_proc1(Thread* t) {
 	os_sleep(5);
 	print("Hello from thread %llu\n", t->id);
@@ -1103,6 +1652,103 @@ void test_intmath() {
     assert(v4i_result.x == 1 && v4i_result.y == 2 && v4i_result.z == 3 && v4i_result.w == 4, "v4i_divi incorrect");
 }
 
+void test_hash() {
+	
+	// Hashes of short inputs must only depend on the bytes in the input, no peeking past the end
+	u8 padded_a[128];
+	u8 padded_b[128];
+	for (u64 i = 0; i < 128; i++) {
+		padded_a[i] = (u8)(i*7);
+		padded_b[i] = (u8)(i*7);
+	}
+	for (u64 size = 0; size <= 64; size++) {
+		// Different garbage right after the input
+		for (u64 i = size; i < 128; i++) padded_b[i] = ~padded_a[i];
+		assert(hash_bytes(padded_a, size) == hash_bytes(padded_b, size), "Failed: hash of %llu bytes read past the end", size);
+		if (size > 0) {
+			assert(hash_bytes(padded_a, size) != hash_bytes(padded_a, size-1), "Failed: hash of %llu bytes ignored the last byte", size);
+		}
+		for (u64 i = size; i < 128; i++) padded_b[i] = padded_a[i];
+	}
+	
+	string s = STR("assets/sprites/player.png");
+	assert(string_get_hash(s) == string_get_hash(STR("assets/sprites/player.png")), "Failed: string_get_hash not deterministic");
+	assert(string_get_hash(s) == string_get_hash_seeded(s, 0), "Failed: string_get_hash should be seed 0");
+	assert(string_get_hash_seeded(s, 1) != string_get_hash_seeded(s, 2), "Failed: string_get_hash_seeded ignores the seed");
+	
+	// Throughput is measured in examples/benchmarks.c, this only needs to be long enough
+	u64 big_size = KB(8);
+	u8 *big = alloc(get_heap_allocator(), big_size);
+	for (u64 i = 0; i < big_size; i++) big[i] = (u8)get_random();
+	
+#if ENABLE_SIMD && SIMD_ENABLE_AVX2
+	// The AVX2 accumulator must match the scalar one, hashes shouldn't depend on the build
+	u64 acc_scalar[8] = {1, 2, 3, 4, 5, 6, 7, 8};
+	u64 acc_simd[8]   = {1, 2, 3, 4, 5, 6, 7, 8};
+	_hash_accumulate_stripes_scalar(acc_scalar, big, 100, _hash_secret);
+	_hash_accumulate_stripes_avx2(acc_simd, big, 100, _hash_secret);
+	_hash_scramble_scalar(acc_scalar, _hash_secret);
+	_hash_scramble_avx2(acc_simd, _hash_secret);
+	for (u64 i = 0; i < 8; i++) assert(acc_scalar[i] == acc_simd[i], "Failed: AVX2 hash accumulator differs from scalar");
+#endif
+	
+	// Long inputs: every byte matters, including the ones in the tail
+	for (u64 size = HASH_LONG_INPUT_SIZE-1; size < HASH_LONG_INPUT_SIZE+200; size += 13) {
+		u64 before = hash_bytes(big, size);
+		big[size/2] ^= 1;
+		assert(hash_bytes(big, size) != before, "Failed: long hash ignored a byte in the middle");
+		big[size/2] ^= 1;
+		big[size-1] ^= 1;
+		assert(hash_bytes(big, size) != before, "Failed: long hash ignored the last byte");
+		big[size-1] ^= 1;
+	}
+	
+	// Avalanche: flipping one input bit should flip about half of the output bits
+	u64 flipped_bits = 0;
+	u64 flips = 0;
+	u64 sizes[] = {3, 8, 13, 32, 100, 3000};
+	for (u64 s = 0; s < sizeof(sizes)/sizeof(sizes[0]); s++) {
+		u64 size = sizes[s];
+		for (u64 bit = 0; bit < size*8; bit += (size > 100 ? 97 : 1)) {
+			u64 before = hash_bytes(big, size);
+			big[bit/8] ^= (u8)(1 << (bit%8));
+			u64 diff = before ^ hash_bytes(big, size);
+			big[bit/8] ^= (u8)(1 << (bit%8));
+			for (; diff; diff &= diff-1) flipped_bits += 1;
+			flips += 1;
+		}
+	}
+	float64 average_flipped = (float64)flipped_bits/(float64)flips;
+	assert(average_flipped > 30.0 && average_flipped < 34.0, "Failed: bad hash avalanche, %.2f bits flipped on average", average_flipped);
+	
+	// Distribution: similar looking asset paths into a power of two table should fill it about as
+	// well as random numbers would, which is 1-1/e of the slots when keys == slots.
+	const u64 bucket_count = 1 << 16;
+	u8 *buckets = alloc(get_heap_allocator(), bucket_count);
+	memset(buckets, 0, bucket_count);
+	u64 used_buckets = 0;
+	u8 path[64];
+	string prefix = STR("assets/sprites/enemy_");
+	memcpy(path, prefix.data, prefix.count);
+	for (u64 i = 0; i < bucket_count; i++) {
+		u64 n = prefix.count;
+		for (u64 x = i; ; x /= 10) {
+			path[n++] = (u8)('0' + x%10);
+			if (x < 10) break;
+		}
+		memcpy(path + n, ".png", 4);
+		n += 4;
+		u64 b = hash_bytes(path, n) & (bucket_count-1);
+		if (!buckets[b]) used_buckets += 1;
+		buckets[b] = 1;
+	}
+	float64 fill = (float64)used_buckets/(float64)bucket_count;
+	assert(fill > 0.62 && fill < 0.645, "Failed: bad hash distribution, %.3f of buckets used", fill);
+	dealloc(get_heap_allocator(), buckets);
+	
+	dealloc(get_heap_allocator(), big);
+}
+
 void test_hash_table() {
     Hash_Table table = make_hash_table(string, int, get_heap_allocator());
     
@@ -1140,6 +1786,197 @@ void test_hash_table() {
     assert(table.capacity_count == 0, "Failed: Hash table capacity count should be 0 after destroy");
 }
 
+typedef struct Slot_Map_Test_Item {
+    u64 id;
+    float32 value;
+} Slot_Map_Test_Item;
+void test_slot_map_and_sparse_set() {
+    Allocator heap = get_heap_allocator();
+    
+    Slot_Map map = make_slot_map(Slot_Map_Test_Item, heap);
+    
+    Slot_Handle none = ZERO(Slot_Handle);
+    assert(slot_map_get(&map, none) == 0, "Failed: A zeroed handle should never be valid");
+    
+    // Add a bunch, remove every third, the rest must still be found through their handles
+    const u64 count = 1000;
+    Slot_Handle *handles = alloc(heap, count*sizeof(Slot_Handle));
+    for (u64 i = 0; i < count; i++) {
+        Slot_Map_Test_Item item = {i, (float32)i*0.5f};
+        handles[i] = slot_map_add(&map, item);
+    }
+    assert(map.count == count, "Failed: Slot map count should be %llu, got %llu", count, map.count);
+    
+    for (u64 i = 0; i < count; i += 3) {
+        assert(slot_map_remove(&map, handles[i]), "Failed: slot_map_remove");
+        assert(!slot_map_remove(&map, handles[i]), "Failed: Removing twice should fail");
+    }
+    for (u64 i = 0; i < count; i++) {
+        Slot_Map_Test_Item *item = slot_map_get(&map, handles[i]);
+        if (i % 3 == 0) {
+            assert(item == 0, "Failed: Removed item should not be found");
+        } else {
+            assert(item && item->id == i && item->value == (float32)i*0.5f, "Failed: Slot map item moved or changed");
+        }
+    }
+    
+    // Reused slots don't bring old handles back
+    u64 slots_before = map.slot_count;
+    Slot_Handle reused;
+    Slot_Map_Test_Item *empty = slot_map_add_empty(&map, &reused);
+    assert(empty->id == 0 && empty->value == 0, "Failed: slot_map_add_empty should be zeroed");
+    assert(map.slot_count == slots_before, "Failed: Slot map should reuse a free slot");
+    assert(slot_map_get(&map, handles[0]) == 0 && slot_map_get(&map, handles[count-2]) != 0, "Failed: Stale handle matched a reused slot");
+    assert(slot_map_remove(&map, reused), "Failed: slot_map_remove of reused slot");
+    
+    // Dense iteration sees every remaining item exactly once, and nth handles point back to them
+    u64 expected_count = count - (count+2)/3;
+    assert(map.count == expected_count, "Failed: Slot map count should be %llu, got %llu", expected_count, map.count);
+    Slot_Map_Test_Item *items = (Slot_Map_Test_Item*)map.items;
+    u64 id_sum = 0;
+    for (u64 i = 0; i < map.count; i++) {
+        id_sum += items[i].id;
+        assert(slot_map_get(&map, slot_map_get_nth_handle(&map, i)) == &items[i], "Failed: slot_map_get_nth_handle");
+    }
+    u64 expected_sum = 0;
+    for (u64 i = 0; i < count; i++) if (i % 3 != 0) expected_sum += i;
+    assert(id_sum == expected_sum, "Failed: Slot map iteration missed or repeated items");
+    
+    slot_map_reset(&map);
+    assert(map.count == 0, "Failed: Slot map should be empty after reset");
+    assert(slot_map_get(&map, handles[1]) == 0, "Failed: Handles should not work after reset");
+    
+    slot_map_destroy(&map);
+    assert(map.items == 0 && map.count == 0, "Failed: Slot map should be zeroed after destroy");
+    dealloc(heap, handles);
+    
+    // Sparse set with values
+    Sparse_Set set = make_sparse_set(Vector2, heap);
+    for (u32 id = 0; id < 500; id++) {
+        Vector2 v = v2((float32)id, 1);
+        assert(sparse_set_set(&set, id*7, v), "Failed: Id should be newly added to sparse set");
+    }
+    Vector2 replaced = v2(-1, -1);
+    assert(!sparse_set_set(&set, 21, replaced), "Failed: Setting an existing id should not add it");
+    assert(sparse_set_find(&set, 21) && ((Vector2*)sparse_set_find(&set, 21))->x == -1, "Failed: sparse_set_set should replace the value");
+    assert(!sparse_set_contains(&set, 15) && sparse_set_find(&set, 15) == 0, "Failed: Sparse set contains an id that was never added");
+    assert(!sparse_set_contains(&set, 1000000), "Failed: Sparse set contains an id past its sparse array");
+    
+    for (u32 id = 0; id < 500; id += 2) assert(sparse_set_remove(&set, id*7), "Failed: sparse_set_remove");
+    assert(!sparse_set_remove(&set, 0), "Failed: Removing twice should fail");
+    assert(set.count == 250, "Failed: Sparse set count should be 250, got %llu", set.count);
+    for (u64 i = 0; i < set.count; i++) {
+        u32 id = set.ids[i];
+        Vector2 *v = &((Vector2*)set.values)[i];
+        assert((id/7) % 2 == 1, "Failed: Removed id still in sparse set");
+        assert(sparse_set_find(&set, id) == v, "Failed: Sparse set ids and values out of sync");
+        assert(id == 21 ? v->x == -1 : v->x == (float32)(id/7), "Failed: Sparse set value moved to the wrong id");
+    }
+    // 21 survives the removals, its replaced value has to survive them too
+    assert(sparse_set_contains(&set, 21) && ((Vector2*)sparse_set_find(&set, 21))->y == -1, "Failed: Replaced sparse set value lost by removals");
+    
+    sparse_set_reset(&set);
+    assert(!sparse_set_contains(&set, 7), "Failed: Sparse set should be empty after reset");
+    sparse_set_destroy(&set);
+    
+    // Sparse set without values
+    Sparse_Set ids = make_sparse_set_raw(0, heap);
+    assert(sparse_set_add(&ids, 42), "Failed: sparse_set_add");
+    assert(!sparse_set_add(&ids, 42), "Failed: Adding an id twice should fail");
+    assert(sparse_set_contains(&ids, 42) && sparse_set_find(&ids, 42) == 0, "Failed: Sparse set without values");
+    sparse_set_destroy(&ids);
+}
+
+#define STRING_INTERNER_TEST_COUNT 5000
+typedef struct String_Interner_Test_Data {
+	String_Interner *interner;
+	u64 offset;
+	u32 ids[STRING_INTERNER_TEST_COUNT];
+} String_Interner_Test_Data;
+
+string test_string_interner_make_name(u8 *buffer, u64 n) {
+	string prefix = STR("scope_");
+	memcpy(buffer, prefix.data, prefix.count);
+	u64 count = prefix.count;
+	for (u64 x = n; ; x /= 10) {
+		buffer[count++] = (u8)('0' + x%10);
+		if (x < 10) break;
+	}
+	return (string){count, buffer};
+}
+void test_string_interner_thread_proc(Thread *t) {
+	String_Interner_Test_Data *data = (String_Interner_Test_Data*)t->data;
+	u8 buffer[32];
+	// Every thread starts somewhere else so they race on interning the same strings
+	for (u64 i = 0; i < STRING_INTERNER_TEST_COUNT; i++) {
+		u64 n = (i + data->offset) % STRING_INTERNER_TEST_COUNT;
+		data->ids[n] = string_interner_intern(data->interner, test_string_interner_make_name(buffer, n));
+	}
+}
+
+void test_string_interner() {
+	String_Interner interner;
+	string_interner_init(&interner, MB(64));
+	
+	u32 a = string_interner_intern(&interner, STR("sprites/player.png"));
+	u32 b = string_interner_intern(&interner, STR("sprites/enemy.png"));
+	assert(a != 0 && b != 0 && a != b, "Failed: string_interner_intern");
+	
+	// Different memory, same string
+	u8 copy[] = "sprites/player.png";
+	assert(string_interner_intern(&interner, (string){sizeof(copy)-1, copy}) == a, "Failed: Same string should get the same id");
+	copy[0] = 'S';
+	assert(string_interner_find(&interner, (string){sizeof(copy)-1, copy}) == 0, "Failed: string_interner_find should not find what was never interned");
+	assert(string_interner_find(&interner, STR("sprites/enemy.png")) == b, "Failed: string_interner_find");
+	
+	string s = string_interner_get(&interner, a);
+	assert(strings_match(s, STR("sprites/player.png")) && s.data[s.count] == 0, "Failed: string_interner_get");
+	assert(string_interner_get_hash(&interner, a) == string_get_hash(s), "Failed: string_interner_get_hash");
+	
+	u32 empty = string_interner_intern(&interner, STR(""));
+	assert(empty != 0 && string_interner_get(&interner, empty).count == 0, "Failed: Interning an empty string");
+	
+	// Interned data doesn't move when the table grows
+	u8 *player_data = s.data;
+	
+	String_Interner_Test_Data *datas = alloc(get_heap_allocator(), 4*sizeof(String_Interner_Test_Data));
+	Thread threads[3];
+	for (u64 i = 0; i < 3; i++) {
+		datas[i].interner = &interner;
+		datas[i].offset = i*(STRING_INTERNER_TEST_COUNT/4);
+		os_thread_init(&threads[i], test_string_interner_thread_proc);
+		threads[i].data = &datas[i];
+		os_thread_start(&threads[i]);
+	}
+	Thread self = ZERO(Thread);
+	datas[3].interner = &interner;
+	datas[3].offset = 3*(STRING_INTERNER_TEST_COUNT/4);
+	self.data = &datas[3];
+	test_string_interner_thread_proc(&self);
+	for (u64 i = 0; i < 3; i++) {
+		os_thread_join(&threads[i]);
+		os_thread_destroy(&threads[i]);
+	}
+	
+	u8 buffer[32];
+	for (u64 n = 0; n < STRING_INTERNER_TEST_COUNT; n++) {
+		u32 id = datas[0].ids[n];
+		for (u64 i = 1; i < 4; i++) assert(datas[i].ids[n] == id, "Failed: Threads got different ids for the same string");
+		assert(strings_match(string_interner_get(&interner, id), test_string_interner_make_name(buffer, n)), "Failed: Interned string doesn't match");
+		assert(string_interner_find(&interner, test_string_interner_make_name(buffer, n)) == id, "Failed: string_interner_find after growing");
+	}
+	assert(interner.count == STRING_INTERNER_TEST_COUNT+3, "Failed: A string was interned twice");
+	assert(string_interner_get(&interner, a).data == player_data, "Failed: Interned string moved");
+	
+	dealloc(get_heap_allocator(), datas);
+	string_interner_destroy(&interner);
+	
+	// The global one
+	u32 id = intern_string(STR("Some log category"));
+	assert(find_interned_string(STR("Some log category")) == id, "Failed: intern_string");
+	assert(strings_match(get_interned_string(id), STR("Some log category")), "Failed: get_interned_string");
+}
+
 #define NUM_BINS 100
 #define NUM_SAMPLES 100000000
 
@@ -1225,6 +2062,624 @@ void test_mutex() {
     mutex_destroy(&data.mutex);
 }
 
+typedef struct Spinlock_Test_Shared_Data {
+    Padded_Spinlock spinlock;
+    Ticket_Lock ticket_lock;
+    int counter;
+    bool any_active_thread;
+} Spinlock_Test_Shared_Data;
+void spinlock_test_increment_counter(Thread* t) {
+    Spinlock_Test_Shared_Data* data = (Spinlock_Test_Shared_Data*)t->data;
+    for (int i = 0; i < MUTEX_TEST_TASK_COUNT; i++) {
+        spinlock_acquire_or_wait(&data->spinlock.lock);
+        assert(!data->any_active_thread, "Failed: More than one thread is in critical section!");
+        data->any_active_thread = true;
+        data->counter++;
+        data->any_active_thread = false;
+        spinlock_release(&data->spinlock.lock);
+        
+        ticket_lock_acquire_or_wait(&data->ticket_lock);
+        assert(!data->any_active_thread, "Failed: More than one thread is in critical section!");
+        data->any_active_thread = true;
+        data->counter++;
+        data->any_active_thread = false;
+        ticket_lock_release(&data->ticket_lock);
+    }
+}
+void test_spinlocks() {
+    assert(offsetof(Padded_Spinlock, lock) >= CACHE_LINE_SIZE, "Failed: Padded_Spinlock padding");
+    assert(sizeof(Padded_Spinlock) - offsetof(Padded_Spinlock, lock) - sizeof(Spinlock) >= CACHE_LINE_SIZE, "Failed: Padded_Spinlock padding");
+    
+    Spinlock l;
+    spinlock_init(&l);
+    assert(spinlock_acquire_or_wait_timeout(&l, 0.1), "Failed: spinlock_acquire_or_wait_timeout on a free spinlock");
+    assert(!spinlock_acquire_or_wait_timeout(&l, 0.001), "Failed: spinlock_acquire_or_wait_timeout should time out");
+    spinlock_release(&l);
+    
+    Spinlock_Test_Shared_Data *data = alloc(get_heap_allocator(), sizeof(Spinlock_Test_Shared_Data));
+    spinlock_init(&data->spinlock.lock);
+    ticket_lock_init(&data->ticket_lock);
+    
+    // Not more threads than cores, see Ticket_Lock
+    const u64 num_threads = clamp(os_get_number_of_logical_processors(), 2, 8);
+    Thread threads[8];
+    for (u64 i = 0; i < num_threads; i++) {
+        os_thread_init(&threads[i], spinlock_test_increment_counter);
+        threads[i].data = data;
+        os_thread_start(&threads[i]);
+    }
+    for (u64 i = 0; i < num_threads; i++) {
+        os_thread_join(&threads[i]);
+        os_thread_destroy(&threads[i]);
+    }
+    assert(data->counter == num_threads*MUTEX_TEST_TASK_COUNT*2, "Failed: Counter does not match expected value after threading tasks");
+    assert(data->ticket_lock.next_ticket == data->ticket_lock.now_serving, "Failed: Ticket_Lock tickets out of balance");
+    
+#if ENABLE_SPINLOCK_STATS
+    Spinlock_Stats spinlock_stats = spinlock_get_stats(&data->spinlock.lock);
+    Spinlock_Stats ticket_stats = ticket_lock_get_stats(&data->ticket_lock);
+    assert(spinlock_stats.acquisitions == num_threads*MUTEX_TEST_TASK_COUNT, "Failed: Spinlock acquisitions count");
+    assert(ticket_stats.acquisitions == num_threads*MUTEX_TEST_TASK_COUNT, "Failed: Ticket_Lock acquisitions count");
+    print("Spinlock: %llu of %llu acquisitions contended, %llu cycles waiting\n", spinlock_stats.contended_acquisitions, spinlock_stats.acquisitions, spinlock_stats.wait_cycles);
+    print("Ticket_Lock: %llu of %llu acquisitions contended, %llu cycles waiting\n", ticket_stats.contended_acquisitions, ticket_stats.acquisitions, ticket_stats.wait_cycles);
+#endif
+    
+    dealloc(get_heap_allocator(), data);
+}
+
+#define PARKING_TEST_THREAD_COUNT 8
+#define PARKING_TEST_ITEM_COUNT 1000
+typedef struct Parking_Test_Shared_Data {
+    Fast_Mutex mutex;
+    Condition_Variable not_empty;
+    Semaphore semaphore;
+    Event go;
+    Binary_Semaphore ping;
+    Binary_Semaphore pong;
+    int counter;
+    bool any_active_thread;
+    int queue[PARKING_TEST_ITEM_COUNT];
+    int queue_count;
+    int popped;
+    int popped_sum;
+    volatile uint32_t semaphore_taken;
+} Parking_Test_Shared_Data;
+void parking_test_thread_proc(Thread* t) {
+    Parking_Test_Shared_Data* data = (Parking_Test_Shared_Data*)t->data;
+    
+    event_wait(&data->go);
+    
+    for (int i = 0; i < MUTEX_TEST_TASK_COUNT; i++) {
+        fast_mutex_acquire_or_wait(&data->mutex);
+        assert(!data->any_active_thread, "Failed: More than one thread is in critical section!");
+        data->any_active_thread = true;
+        data->counter++;
+        data->any_active_thread = false;
+        fast_mutex_release(&data->mutex);
+    }
+    
+    // Consumers
+    while (true) {
+        fast_mutex_acquire_or_wait(&data->mutex);
+        while (data->queue_count == 0 && data->popped < PARKING_TEST_ITEM_COUNT) {
+            condition_variable_wait(&data->not_empty, &data->mutex);
+        }
+        if (data->popped == PARKING_TEST_ITEM_COUNT) {
+            fast_mutex_release(&data->mutex);
+            break;
+        }
+        data->queue_count -= 1;
+        data->popped_sum += data->queue[data->queue_count];
+        data->popped += 1;
+        if (data->popped == PARKING_TEST_ITEM_COUNT) condition_variable_broadcast(&data->not_empty);
+        fast_mutex_release(&data->mutex);
+    }
+    
+    semaphore_wait(&data->semaphore);
+    atomic_add_32(&data->semaphore_taken, 1);
+}
+void parking_test_pong_proc(Thread* t) {
+    Parking_Test_Shared_Data* data = (Parking_Test_Shared_Data*)t->data;
+    for (int i = 0; i < PARKING_TEST_ITEM_COUNT; i++) {
+        binary_semaphore_wait(&data->ping);
+        data->counter += 1;
+        binary_semaphore_signal(&data->pong);
+    }
+}
+void test_parking_primitives() {
+    assert(sizeof(Fast_Mutex) == 4, "Failed: Fast_Mutex should be 4 bytes");
+    
+    Fast_Mutex m;
+    fast_mutex_init(&m);
+    assert(fast_mutex_try_acquire(&m), "Failed: fast_mutex_try_acquire on unlocked mutex");
+    assert(!fast_mutex_try_acquire(&m), "Failed: fast_mutex_try_acquire on locked mutex");
+    fast_mutex_release(&m);
+    fast_mutex_acquire_or_wait(&m);
+    fast_mutex_release(&m);
+    
+    Semaphore sem;
+    semaphore_init(&sem, 2);
+    assert(semaphore_try_wait(&sem) && semaphore_try_wait(&sem), "Failed: semaphore_try_wait with count");
+    assert(!semaphore_try_wait(&sem), "Failed: semaphore_try_wait with 0 count");
+    
+    Event e;
+    event_init(&e, false);
+    assert(!event_is_signaled(&e), "Failed: event_init");
+    event_signal(&e);
+    event_wait(&e);
+    event_wait(&e);
+    assert(event_is_signaled(&e), "Failed: Event should stay signaled until reset");
+    event_reset(&e);
+    assert(!event_is_signaled(&e), "Failed: event_reset");
+    
+    Parking_Test_Shared_Data *data = alloc(get_heap_allocator(), sizeof(Parking_Test_Shared_Data));
+    fast_mutex_init(&data->mutex);
+    condition_variable_init(&data->not_empty);
+    semaphore_init(&data->semaphore, 0);
+    event_init(&data->go, false);
+    binary_semaphore_init(&data->ping, false);
+    binary_semaphore_init(&data->pong, false);
+    
+    Thread threads[PARKING_TEST_THREAD_COUNT];
+    for (u64 i = 0; i < PARKING_TEST_THREAD_COUNT; i++) {
+        os_thread_init(&threads[i], parking_test_thread_proc);
+        threads[i].data = data;
+        os_thread_start(&threads[i]);
+    }
+    
+    // Everyone is parked on the event until now
+    os_sleep(5);
+    assert(data->counter == 0, "Failed: Threads got past an event that wasn't signaled");
+    event_signal(&data->go);
+    
+    // Producer
+    for (int i = 0; i < PARKING_TEST_ITEM_COUNT; i++) {
+        fast_mutex_acquire_or_wait(&data->mutex);
+        data->queue[data->queue_count] = i;
+        data->queue_count += 1;
+        condition_variable_signal(&data->not_empty);
+        fast_mutex_release(&data->mutex);
+    }
+    
+    // Threads are parked on the semaphore after consuming everything
+    os_sleep(5);
+    semaphore_signal(&data->semaphore, PARKING_TEST_THREAD_COUNT/2);
+    semaphore_signal(&data->semaphore, PARKING_TEST_THREAD_COUNT - PARKING_TEST_THREAD_COUNT/2);
+    
+    for (u64 i = 0; i < PARKING_TEST_THREAD_COUNT; i++) {
+        os_thread_join(&threads[i]);
+        os_thread_destroy(&threads[i]);
+    }
+    
+    assert(data->counter == PARKING_TEST_THREAD_COUNT * MUTEX_TEST_TASK_COUNT, "Failed: Counter does not match expected value after threading tasks");
+    assert(data->popped == PARKING_TEST_ITEM_COUNT, "Failed: Condition variable consumers popped %d items", data->popped);
+    assert(data->popped_sum == (PARKING_TEST_ITEM_COUNT-1)*PARKING_TEST_ITEM_COUNT/2, "Failed: Condition variable consumers lost items");
+    assert(data->semaphore_taken == PARKING_TEST_THREAD_COUNT, "Failed: Semaphore let %u threads through", data->semaphore_taken);
+    assert(!semaphore_try_wait(&data->semaphore), "Failed: Semaphore count should be back at 0");
+    
+    // Binary semaphores ping pong
+    data->counter = 0;
+    Thread pong;
+    os_thread_init(&pong, parking_test_pong_proc);
+    pong.data = data;
+    os_thread_start(&pong);
+    for (int i = 0; i < PARKING_TEST_ITEM_COUNT; i++) {
+        binary_semaphore_signal(&data->ping);
+        binary_semaphore_wait(&data->pong);
+        assert(data->counter == i+1, "Failed: Binary semaphore ping pong out of sync");
+    }
+    os_thread_join(&pong);
+    os_thread_destroy(&pong);
+    binary_semaphore_destroy(&data->ping);
+    binary_semaphore_destroy(&data->pong);
+    
+    dealloc(get_heap_allocator(), data);
+}
+
+#define RW_TEST_READER_COUNT 6
+#define RW_TEST_WRITER_COUNT 2
+#define RW_TEST_READS 100000
+#define RW_TEST_WRITES 5000
+typedef enum Rw_Test_Mode {
+    RW_TEST_FAST_MUTEX,
+    RW_TEST_RW_LOCK,
+    RW_TEST_SEQLOCK,
+    RW_TEST_MODE_COUNT,
+} Rw_Test_Mode;
+typedef struct Rw_Test_Snapshot {
+    u64 values[8];
+} Rw_Test_Snapshot;
+typedef struct Rw_Test_Shared_Data {
+    Rw_Test_Mode mode;
+    Fast_Mutex mutex;
+    Rw_Lock rw_lock;
+    Seqlock seqlock;
+    Rw_Test_Snapshot snapshot;
+    volatile uint32_t readers_inside;
+    volatile bool writer_inside;
+} Rw_Test_Shared_Data;
+void rw_test_read(Rw_Test_Shared_Data *data, Rw_Test_Snapshot *out) {
+    switch (data->mode) {
+        case RW_TEST_FAST_MUTEX: {
+            fast_mutex_acquire_or_wait(&data->mutex);
+            *out = data->snapshot;
+            fast_mutex_release(&data->mutex);
+            break;
+        }
+        case RW_TEST_RW_LOCK: {
+            rw_lock_acquire_read(&data->rw_lock);
+            atomic_add_32(&data->readers_inside, 1);
+            assert(!data->writer_inside, "Failed: Rw_Lock let a reader in with a writer");
+            *out = data->snapshot;
+            atomic_add_32(&data->readers_inside, (uint32_t)-1);
+            rw_lock_release_read(&data->rw_lock);
+            break;
+        }
+        case RW_TEST_SEQLOCK: {
+            seqlock_read_copy(&data->seqlock, out, &data->snapshot, sizeof(Rw_Test_Snapshot));
+            break;
+        }
+        default: break;
+    }
+}
+void rw_test_write(Rw_Test_Shared_Data *data) {
+    switch (data->mode) {
+        case RW_TEST_FAST_MUTEX: fast_mutex_acquire_or_wait(&data->mutex); break;
+        case RW_TEST_RW_LOCK: {
+            rw_lock_acquire_write(&data->rw_lock);
+            assert(!data->writer_inside && data->readers_inside == 0, "Failed: Rw_Lock writer is not alone");
+            data->writer_inside = true;
+            break;
+        }
+        case RW_TEST_SEQLOCK: seqlock_write_begin(&data->seqlock); break;
+        default: break;
+    }
+    for (u64 i = 0; i < 8; i++) data->snapshot.values[i] += 1;
+    switch (data->mode) {
+        case RW_TEST_FAST_MUTEX: fast_mutex_release(&data->mutex); break;
+        case RW_TEST_RW_LOCK: {
+            data->writer_inside = false;
+            rw_lock_release_write(&data->rw_lock);
+            break;
+        }
+        case RW_TEST_SEQLOCK: seqlock_write_end(&data->seqlock); break;
+        default: break;
+    }
+}
+void rw_test_reader_proc(Thread *t) {
+    Rw_Test_Shared_Data *data = (Rw_Test_Shared_Data*)t->data;
+    u64 last = 0;
+    for (u64 i = 0; i < RW_TEST_READS; i++) {
+        Rw_Test_Snapshot snapshot;
+        rw_test_read(data, &snapshot);
+        for (u64 j = 1; j < 8; j++) assert(snapshot.values[j] == snapshot.values[0], "Failed: Read a torn snapshot");
+        assert(snapshot.values[0] >= last, "Failed: Read an older snapshot after a newer one");
+        last = snapshot.values[0];
+    }
+}
+void rw_test_writer_proc(Thread *t) {
+    Rw_Test_Shared_Data *data = (Rw_Test_Shared_Data*)t->data;
+    for (u64 i = 0; i < RW_TEST_WRITES; i++) {
+        rw_test_write(data);
+    }
+}
+void test_rw_lock_and_seqlock() {
+    Rw_Lock l;
+    rw_lock_init(&l);
+    rw_lock_acquire_read(&l);
+    rw_lock_acquire_read(&l);
+    rw_lock_release_read(&l);
+    rw_lock_release_read(&l);
+    rw_lock_acquire_write(&l);
+    rw_lock_release_write(&l);
+    rw_lock_acquire_read(&l);
+    rw_lock_release_read(&l);
+    assert(l.readers_in == l.readers_out && l.writers_in == l.writers_out, "Failed: Rw_Lock counters out of balance");
+    
+    Seqlock sl;
+    seqlock_init(&sl);
+    u32 sequence = seqlock_read_begin(&sl);
+    assert(!seqlock_read_retry(&sl, sequence), "Failed: Seqlock retry without a write");
+    seqlock_write_begin(&sl);
+    seqlock_write_end(&sl);
+    assert(seqlock_read_retry(&sl, sequence), "Failed: Seqlock should retry after a write");
+    
+    // Contention: readers reading a 64 byte snapshot while writers update it.
+    // How fast each one is, is measured in examples/benchmarks.c.
+    string names[RW_TEST_MODE_COUNT] = { STR("Fast_Mutex"), STR("Rw_Lock"), STR("Seqlock") };
+    Rw_Test_Shared_Data *data = alloc(get_heap_allocator(), sizeof(Rw_Test_Shared_Data));
+    for (Rw_Test_Mode mode = 0; mode < RW_TEST_MODE_COUNT; mode++) {
+        memset(data, 0, sizeof(Rw_Test_Shared_Data));
+        data->mode = mode;
+        fast_mutex_init(&data->mutex);
+        rw_lock_init(&data->rw_lock);
+        seqlock_init(&data->seqlock);
+        
+        Thread threads[RW_TEST_READER_COUNT+RW_TEST_WRITER_COUNT];
+        for (u64 i = 0; i < RW_TEST_READER_COUNT+RW_TEST_WRITER_COUNT; i++) {
+            os_thread_init(&threads[i], i < RW_TEST_READER_COUNT ? rw_test_reader_proc : rw_test_writer_proc);
+            threads[i].data = data;
+        }
+        
+        for (u64 i = 0; i < RW_TEST_READER_COUNT+RW_TEST_WRITER_COUNT; i++) os_thread_start(&threads[i]);
+        for (u64 i = 0; i < RW_TEST_READER_COUNT+RW_TEST_WRITER_COUNT; i++) {
+            os_thread_join(&threads[i]);
+            os_thread_destroy(&threads[i]);
+        }
+        
+        assert(data->snapshot.values[0] == RW_TEST_WRITER_COUNT*RW_TEST_WRITES, "Failed: %s lost writes", names[mode]);
+    }
+    dealloc(get_heap_allocator(), data);
+}
+
+#define QUEUE_TEST_COUNT 200000
+#define QUEUE_TEST_PRODUCERS 4
+#define QUEUE_TEST_CONSUMERS 4
+typedef struct Queue_Test_Item {
+    Mpsc_Node node;
+    u64 producer;
+    u64 sequence;
+} Queue_Test_Item;
+typedef struct Queue_Test_Shared_Data {
+    Spsc_Queue spsc;
+    Mpmc_Queue mpmc;
+    Mpsc_Queue mpsc;
+    Queue_Test_Item *items;
+    volatile u8 *seen;
+    volatile uint64_t popped;
+    volatile uint64_t popped_sum;
+} Queue_Test_Shared_Data;
+void queue_test_spsc_producer(Thread *t) {
+    Queue_Test_Shared_Data *data = (Queue_Test_Shared_Data*)t->data;
+    u64 batch[7];
+    u64 next = 0;
+    while (next < QUEUE_TEST_COUNT) {
+        // Mix single and batched pushes so the ring wraps at odd places
+        u64 count = min(next % 3 == 0 ? 1 : 7, QUEUE_TEST_COUNT-next);
+        for (u64 i = 0; i < count; i++) batch[i] = next + i;
+        u64 pushed = spsc_queue_push_many(&data->spsc, batch, count);
+        if (pushed == 0) os_yield_thread();
+        next += pushed;
+    }
+}
+typedef struct Queue_Test_Producer {
+    Queue_Test_Shared_Data *data;
+    u64 index;
+} Queue_Test_Producer;
+void queue_test_mpmc_producer(Thread *t) {
+    Queue_Test_Producer *producer = (Queue_Test_Producer*)t->data;
+    for (u64 i = 0; i < QUEUE_TEST_COUNT; i++) {
+        u64 value = producer->index*QUEUE_TEST_COUNT + i;
+        while (!mpmc_queue_push(&producer->data->mpmc, &value)) os_yield_thread();
+    }
+}
+void queue_test_mpmc_consumer(Thread *t) {
+    Queue_Test_Shared_Data *data = (Queue_Test_Shared_Data*)t->data;
+    while (data->popped < QUEUE_TEST_PRODUCERS*QUEUE_TEST_COUNT) {
+        u64 value;
+        if (!mpmc_queue_pop(&data->mpmc, &value)) {
+            os_yield_thread();
+            continue;
+        }
+        assert(value < QUEUE_TEST_PRODUCERS*QUEUE_TEST_COUNT, "Failed: Mpmc_Queue popped garbage");
+        assert(!data->seen[value], "Failed: Mpmc_Queue popped %llu twice", value);
+        data->seen[value] = 1;
+        atomic_add_64(&data->popped_sum, value);
+        atomic_add_64(&data->popped, 1);
+    }
+}
+void queue_test_mpsc_producer(Thread *t) {
+    Queue_Test_Producer *producer = (Queue_Test_Producer*)t->data;
+    for (u64 i = 0; i < QUEUE_TEST_COUNT; i++) {
+        Queue_Test_Item *item = &producer->data->items[producer->index*QUEUE_TEST_COUNT + i];
+        item->producer = producer->index;
+        item->sequence = i;
+        mpsc_queue_push(&producer->data->mpsc, &item->node);
+    }
+}
+void test_queues() {
+    Allocator heap = get_heap_allocator();
+    
+    // Single threaded basics
+    Spsc_Queue spsc;
+    spsc_queue_init(&spsc, sizeof(u32), 5, heap);
+    assert(spsc.capacity == 8, "Failed: Spsc_Queue capacity should round up to a power of two");
+    for (u32 i = 0; i < 8; i++) assert(spsc_queue_push(&spsc, &i), "Failed: spsc_queue_push");
+    u32 value = 0;
+    assert(!spsc_queue_push(&spsc, &value), "Failed: Spsc_Queue should be full");
+    assert(spsc_queue_count(&spsc) == 8, "Failed: spsc_queue_count");
+    for (u32 i = 0; i < 8; i++) assert(spsc_queue_pop(&spsc, &value) && value == i, "Failed: spsc_queue_pop");
+    assert(!spsc_queue_pop(&spsc, &value), "Failed: Spsc_Queue should be empty");
+    spsc_queue_deinit(&spsc);
+    
+    Mpmc_Queue mpmc;
+    mpmc_queue_init(&mpmc, 3, 4, heap);
+    u8 bytes[3] = {1, 2, 3};
+    for (u64 i = 0; i < 4; i++) assert(mpmc_queue_push(&mpmc, bytes), "Failed: mpmc_queue_push");
+    assert(!mpmc_queue_push(&mpmc, bytes), "Failed: Mpmc_Queue should be full");
+    for (u64 i = 0; i < 4; i++) {
+        u8 out[3] = {0};
+        assert(mpmc_queue_pop(&mpmc, out) && out[0] == 1 && out[1] == 2 && out[2] == 3, "Failed: mpmc_queue_pop");
+    }
+    assert(!mpmc_queue_pop(&mpmc, bytes), "Failed: Mpmc_Queue should be empty");
+    mpmc_queue_deinit(&mpmc);
+    
+    Queue_Test_Shared_Data *data = alloc(heap, sizeof(Queue_Test_Shared_Data));
+    
+    // Spsc stress, popping in batches of a different size than pushing
+    spsc_queue_init(&data->spsc, sizeof(u64), 64, heap);
+    Thread producer;
+    os_thread_init(&producer, queue_test_spsc_producer);
+    producer.data = data;
+    os_thread_start(&producer);
+    u64 expected = 0;
+    while (expected < QUEUE_TEST_COUNT) {
+        u64 batch[5];
+        u64 count = spsc_queue_pop_many(&data->spsc, batch, 5);
+        if (count == 0) os_yield_thread();
+        for (u64 i = 0; i < count; i++) {
+            assert(batch[i] == expected, "Failed: Spsc_Queue popped %llu, expected %llu", batch[i], expected);
+            expected += 1;
+        }
+    }
+    os_thread_join(&producer);
+    os_thread_destroy(&producer);
+    spsc_queue_deinit(&data->spsc);
+    
+    // Mpmc stress, every value comes out exactly once
+    u64 total = QUEUE_TEST_PRODUCERS*QUEUE_TEST_COUNT;
+    mpmc_queue_init(&data->mpmc, sizeof(u64), 1024, heap);
+    data->seen = alloc(heap, total);
+    Thread threads[QUEUE_TEST_PRODUCERS+QUEUE_TEST_CONSUMERS];
+    Queue_Test_Producer producers[QUEUE_TEST_PRODUCERS];
+    for (u64 i = 0; i < QUEUE_TEST_PRODUCERS; i++) {
+        producers[i].data = data;
+        producers[i].index = i;
+        os_thread_init(&threads[i], queue_test_mpmc_producer);
+        threads[i].data = &producers[i];
+    }
+    for (u64 i = QUEUE_TEST_PRODUCERS; i < QUEUE_TEST_PRODUCERS+QUEUE_TEST_CONSUMERS; i++) {
+        os_thread_init(&threads[i], queue_test_mpmc_consumer);
+        threads[i].data = data;
+    }
+    for (u64 i = 0; i < QUEUE_TEST_PRODUCERS+QUEUE_TEST_CONSUMERS; i++) os_thread_start(&threads[i]);
+    for (u64 i = 0; i < QUEUE_TEST_PRODUCERS+QUEUE_TEST_CONSUMERS; i++) {
+        os_thread_join(&threads[i]);
+        os_thread_destroy(&threads[i]);
+    }
+    assert(data->popped == total, "Failed: Mpmc_Queue popped %llu of %llu", data->popped, total);
+    assert(data->popped_sum == total*(total-1)/2, "Failed: Mpmc_Queue lost or changed values");
+    assert(!mpmc_queue_pop(&data->mpmc, &value), "Failed: Mpmc_Queue should be empty");
+    mpmc_queue_deinit(&data->mpmc);
+    dealloc(heap, (void*)data->seen);
+    
+    // Mpsc stress, each producer's items come out in the order they were pushed
+    mpsc_queue_init(&data->mpsc);
+    data->items = alloc(heap, total*sizeof(Queue_Test_Item));
+    for (u64 i = 0; i < QUEUE_TEST_PRODUCERS; i++) {
+        os_thread_init(&threads[i], queue_test_mpsc_producer);
+        threads[i].data = &producers[i];
+        os_thread_start(&threads[i]);
+    }
+    u64 next_sequence[QUEUE_TEST_PRODUCERS] = {0};
+    u64 popped = 0;
+    while (popped < total) {
+        Mpsc_Node *node = mpsc_queue_pop(&data->mpsc);
+        if (!node) {
+            os_yield_thread();
+            continue;
+        }
+        Queue_Test_Item *item = mpsc_queue_entry(node, Queue_Test_Item, node);
+        assert(item->sequence == next_sequence[item->producer], "Failed: Mpsc_Queue reordered a producer's items");
+        next_sequence[item->producer] += 1;
+        popped += 1;
+    }
+    for (u64 i = 0; i < QUEUE_TEST_PRODUCERS; i++) {
+        os_thread_join(&threads[i]);
+        os_thread_destroy(&threads[i]);
+    }
+    assert(mpsc_queue_pop(&data->mpsc) == 0, "Failed: Mpsc_Queue should be empty");
+    Queue_Test_Item single;
+    mpsc_queue_push(&data->mpsc, &single.node);
+    assert(mpsc_queue_pop(&data->mpsc) == &single.node, "Failed: Mpsc_Queue push after empty");
+    
+    dealloc(heap, data->items);
+    dealloc(heap, data);
+}
+
+#if FIBERS_SUPPORTED
+#define FIBER_TEST_PARENTS 64
+#define FIBER_TEST_CHILDREN 16
+#define FIBER_TEST_FRAMES 3
+typedef struct Fiber_Test_Shared_Data {
+    Fiber_Scheduler scheduler;
+    volatile u32 children_done;
+    volatile u32 frame_resumes;
+} Fiber_Test_Shared_Data;
+typedef struct Fiber_Test_Child {
+    Fiber_Test_Shared_Data *data;
+    u64 runs;
+    f64 result;
+} Fiber_Test_Child;
+void fiber_test_child(void *p) {
+    Fiber_Test_Child *child = (Fiber_Test_Child*)p;
+    // Floats live in registers across the yields, which might continue on another thread
+    f64 x = 1.5;
+    for (u64 i = 0; i < 4; i++) {
+        x *= 2.0;
+        fiber_yield();
+    }
+    child->result = x;
+    child->runs += 1;
+    atomic_add_32(&child->data->children_done, 1);
+}
+void fiber_test_parent(void *p) {
+    Fiber_Test_Shared_Data *data = (Fiber_Test_Shared_Data*)p;
+    
+    Fiber_Counter counter = ZERO(Fiber_Counter);
+    Fiber_Test_Child children[FIBER_TEST_CHILDREN];
+    for (u64 i = 0; i < FIBER_TEST_CHILDREN; i++) {
+        children[i] = ZERO(Fiber_Test_Child);
+        children[i].data = data;
+        fiber_run(&data->scheduler, fiber_test_child, &children[i], &counter);
+    }
+    fiber_counter_wait(&counter);
+    assert(counter.value == 0, "Failed: fiber_counter_wait returned before the counter was zero");
+    for (u64 i = 0; i < FIBER_TEST_CHILDREN; i++) {
+        assert(children[i].runs == 1, "Failed: Fiber task ran %llu times", children[i].runs);
+        assert(children[i].result == 24.0, "Failed: Fiber lost a float register across a yield");
+    }
+    
+    for (u64 i = 0; i < FIBER_TEST_FRAMES; i++) {
+        fiber_yield_until_next_frame();
+        atomic_add_32(&data->frame_resumes, 1);
+    }
+}
+#endif
+void test_fibers() {
+#if FIBERS_SUPPORTED
+    Allocator heap = get_heap_allocator();
+    Fiber_Test_Shared_Data *data = alloc(heap, sizeof(Fiber_Test_Shared_Data));
+    
+    Fiber_Policy policy = ZERO(Fiber_Policy);
+    policy.worker_count = 3;
+    policy.fiber_count = 256; // Fewer than the parents and children together, tasks have to wait for fibers
+    fiber_scheduler_init(&data->scheduler, policy);
+    
+    assert(get_current_fiber() == 0, "Failed: get_current_fiber should be 0 outside of fibers");
+    
+    Fiber_Counter parents = ZERO(Fiber_Counter);
+    for (u64 i = 0; i < FIBER_TEST_PARENTS; i++) {
+        fiber_run(&data->scheduler, fiber_test_parent, data, &parents);
+    }
+    
+    // The main thread drives the frames until everyone is done
+    u64 frames = 0;
+    while (parents.value != 0) {
+        fiber_scheduler_next_frame(&data->scheduler);
+        os_sleep(1);
+        frames += 1;
+        assert(frames < 100000, "Failed: Fibers didn't finish");
+    }
+    fiber_counter_wait(&parents);
+    
+    assert(data->children_done == FIBER_TEST_PARENTS*FIBER_TEST_CHILDREN, "Failed: %u fiber children finished", data->children_done);
+    assert(data->frame_resumes == FIBER_TEST_PARENTS*FIBER_TEST_FRAMES, "Failed: %u fibers resumed on next frame", data->frame_resumes);
+    assert(frames >= FIBER_TEST_FRAMES, "Failed: Fibers yielding until the next frame didn't wait for the frames");
+    
+    // The main thread sleeps on a counter too
+    Fiber_Counter counter = ZERO(Fiber_Counter);
+    Fiber_Test_Child child = ZERO(Fiber_Test_Child);
+    child.data = data;
+    fiber_run(&data->scheduler, fiber_test_child, &child, &counter);
+    fiber_counter_wait(&counter);
+    assert(child.runs == 1 && child.result == 24.0, "Failed: fiber_counter_wait on a thread");
+    
+    fiber_scheduler_destroy(&data->scheduler);
+    dealloc(heap, data);
+#endif
+}
+
 #ifndef OOGABOOGA_HEADLESS
 int compare_draw_quads(const void *a, const void *b) {
     return ((Draw_Quad*)a)->z-((Draw_Quad*)b)->z;
@@ -1297,6 +2752,401 @@ void test_sort() {
 }
 #endif /* OOGABOOGA_HEADLESS */
 
+// Feeds a sine through the resampler in odd sized chunks and returns the peak of the output
+// after the filter has settled, plus the worst error against the ideal continuous signal.
+f64 resample_test_sine(Audio_Resample_Quality quality, f64 cycles_per_frame, f64 step, u64 chunk, f64 *max_error) {
+	Audio_Resampler r = ZERO(Audio_Resampler);
+	
+	u64 output_frame_count = 20000;
+	u64 settle_frames = 1000;
+	f32 *output = alloc(get_heap_allocator(), output_frame_count*sizeof(f32));
+	f32 *input  = alloc(get_heap_allocator(), (u64)(chunk*step+64)*sizeof(f32));
+	
+	u64 input_index = 0;
+	u64 produced = 0;
+	while (produced < output_frame_count) {
+		u64 n = min(chunk, output_frame_count-produced);
+		u64 required = audio_resampler_get_required_input_frames(&r, quality, 1, step, n);
+		for (u64 i = 0; i < required; i++) {
+			input[i] = (f32)sin(TAU64*cycles_per_frame*(f64)(input_index+i));
+		}
+		input_index += required;
+		audio_resampler_process(&r, input, required, output+produced, n, step);
+		produced += n;
+	}
+	
+	// Output frame k is reconstructed at input time k*step minus the filter delay
+	f64 delay = (f64)(r.taps/2+1);
+	f64 peak = 0;
+	*max_error = 0;
+	for (u64 i = settle_frames; i < output_frame_count; i++) {
+		peak = max(peak, fabs(output[i]));
+		f64 ideal = sin(TAU64*cycles_per_frame*((f64)i*step - delay));
+		*max_error = max(*max_error, fabs(ideal - output[i]));
+	}
+	
+	audio_resampler_destroy(&r);
+	dealloc(get_heap_allocator(), output);
+	dealloc(get_heap_allocator(), input);
+	
+	return peak;
+}
+void test_audio_resampler() {
+	f64 err;
+	
+	// Passband: low tone should survive every quality and step with no seams between chunks.
+	// Chunk sizes are deliberately odd so the carried phase is never a whole number.
+	for (Audio_Resample_Quality q = AUDIO_RESAMPLE_QUALITY_LINEAR; q < AUDIO_RESAMPLE_QUALITY_COUNT; q++) {
+		f64 peak = resample_test_sine(q, 0.01, 44100.0/48000.0, 480, &err);
+		assert(peak > 0.99 && peak < 1.01, "Failed: resampler passband gain (%.4f)", peak);
+		assert(err < 0.01, "Failed: resampler output is not continuous (%.5f)", err);
+		
+		peak = resample_test_sine(q, 0.01, 1.37, 333, &err);
+		assert(peak > 0.99 && peak < 1.01, "Failed: resampler passband gain when speeding up (%.4f)", peak);
+		assert(err < 0.01, "Failed: resampler output is not continuous when speeding up (%.5f)", err);
+		
+		peak = resample_test_sine(q, 0.02, 0.5, 17, &err);
+		assert(err < 0.01, "Failed: resampler output is not continuous when slowing down (%.5f)", err);
+	}
+	
+	// Stopband: when reading twice as fast, a tone at 0.4 of the input rate is above the output nyquist 
+	// and would alias. The sinc qualities should kill it, the higher the better.
+	f64 low    = resample_test_sine(AUDIO_RESAMPLE_QUALITY_LOW,    0.4, 2.0, 480, &err);
+	f64 medium = resample_test_sine(AUDIO_RESAMPLE_QUALITY_MEDIUM, 0.4, 2.0, 480, &err);
+	f64 high   = resample_test_sine(AUDIO_RESAMPLE_QUALITY_HIGH,   0.4, 2.0, 480, &err);
+	assert(low < 0.1,      "Failed: resampler aliasing too loud on low quality (%.4f)", low);
+	assert(medium < 0.005, "Failed: resampler aliasing too loud on medium quality (%.4f)", medium);
+	assert(high < medium,  "Failed: high quality resampler should attenuate more than medium");
+
+	// Available output for chunked input must be the most we can produce without overreading
+	for (Audio_Resample_Quality q = AUDIO_RESAMPLE_QUALITY_LINEAR; q < AUDIO_RESAMPLE_QUALITY_COUNT; q++) {
+		f64 steps[] = {44100.0/48000.0, 48000.0/44100.0, 22050.0/48000.0, 1.0};
+		for (u64 s = 0; s < sizeof(steps)/sizeof(steps[0]); s++) {
+			Audio_Resampler r = ZERO(Audio_Resampler);
+			for (u64 n_in = 0; n_in < 300; n_in += 7) {
+				u64 n_out = audio_resampler_get_available_output_frames(&r, q, 2, steps[s], n_in);
+				if (n_out > 0) {
+					assert(audio_resampler_get_required_input_frames(&r, q, 2, steps[s], n_out) <= n_in, "Failed: available output frames overreads input");
+				}
+				assert(audio_resampler_get_required_input_frames(&r, q, 2, steps[s], n_out+1) > n_in, "Failed: available output frames is not maximal");
+			}
+			audio_resampler_destroy(&r);
+		}
+	}
+
+	// Changing the channel count (like when the output device changes) must not keep using the
+	// buffer laid out for the old count
+	{
+		Audio_Resampler r = ZERO(Audio_Resampler);
+		f32 in[64*6];
+		f32 out[64*6];
+		for (u64 i = 0; i < 64*6; i++) in[i] = 0.5f;
+		u64 channel_counts[] = {2, 6, 1, 6};
+		for (u64 c = 0; c < sizeof(channel_counts)/sizeof(channel_counts[0]); c++) {
+			u64 required = audio_resampler_get_required_input_frames(&r, AUDIO_RESAMPLE_QUALITY_HIGH, channel_counts[c], 1.0, 32);
+			assert(required <= 64);
+			audio_resampler_process(&r, in, required, out, 32, 1.0);
+			assert(r.channels == channel_counts[c], "Failed: resampler channel count change");
+		}
+		audio_resampler_destroy(&r);
+	}
+
+	// Throughput, stereo 44.1k -> 48k in 480 frame callbacks like the audio thread would
+	u64 channels = 2;
+	u64 chunk = 480;
+	u64 callbacks = 2000;
+	f64 step = 44100.0/48000.0;
+	f32 *input  = alloc(get_heap_allocator(), chunk*channels*sizeof(f32));
+	f32 *output = alloc(get_heap_allocator(), chunk*channels*sizeof(f32));
+	for (u64 i = 0; i < chunk*channels; i++) input[i] = get_random_float32_in_range(-1, 1);
+	
+	for (Audio_Resample_Quality q = AUDIO_RESAMPLE_QUALITY_LINEAR; q < AUDIO_RESAMPLE_QUALITY_COUNT; q++) {
+		Audio_Resampler r = ZERO(Audio_Resampler);
+		
+		float64 start_seconds = os_get_elapsed_seconds();
+		u64 start_cycles = rdtsc();
+		for (u64 i = 0; i < callbacks; i++) {
+			u64 required = audio_resampler_get_required_input_frames(&r, q, channels, step, chunk);
+			assert(required <= chunk);
+			audio_resampler_process(&r, input, required, output, chunk, step);
+		}
+		u64 end_cycles = rdtsc();
+		float64 end_seconds = os_get_elapsed_seconds();
+		
+		f64 frames = (f64)(callbacks*chunk);
+		print("Resampler %llu taps: %.2f cycles/frame, %.1fx realtime\n", 
+			r.taps, 
+			(f64)(end_cycles-start_cycles)/frames, 
+			(frames/48000.0)/(end_seconds-start_seconds));
+		
+		audio_resampler_destroy(&r);
+	}
+	
+	dealloc(get_heap_allocator(), input);
+	dealloc(get_heap_allocator(), output);
+}
+void test_audio_offline_render() {
+	Audio_Format format = { AUDIO_BITS_32, 2, 48000 };
+	u64 frame_count = 48000;
+	u64 frame_size = sizeof(f32)*format.channels;
+	
+	// Make a source to play by round tripping a sine through a wave file
+	f32 *sine = alloc(get_heap_allocator(), frame_count*frame_size);
+	for (u64 i = 0; i < frame_count; i++) {
+		f32 s = (f32)(sin(TAU64*440.0*(f64)i/(f64)format.sample_rate)*0.5);
+		sine[i*2+0] = s;
+		sine[i*2+1] = -s;
+	}
+	
+	bool ok = wav_write_file(STR("offline_test_source.wav"), sine, frame_count, format);
+	assert(ok, "Failed: wav_write_file");
+	
+	Audio_Source src;
+	ok = audio_open_source_load_format(&src, STR("offline_test_source.wav"), format, get_heap_allocator());
+	assert(ok, "Failed: audio_open_source_load_format on written wav");
+	assert(src.number_of_frames == frame_count, "Failed: written wav has wrong frame count %llu", src.number_of_frames);
+	assert(bytes_match(src.pcm_frames, sine, frame_count*frame_size), "Failed: wav write/load round trip mismatch");
+	
+	Audio_Player *player = audio_player_get_one();
+	audio_player_set_source(player, src);
+	audio_player_set_state(player, AUDIO_PLAYER_STATE_PLAYING);
+	
+	f32 *output = alloc(get_heap_allocator(), frame_count*frame_size);
+	Audio_Render_Stats stats;
+	ok = audio_render_offline(output, frame_count, format, 0, &stats);
+	assert(ok, "Failed: audio_render_offline");
+	
+	// Same format, volume 1, no spacialization, so after the fade in the output is the source
+	u64 fade_frames = (AUDIO_SMOOTH_TRANSITION_TIME_MS*format.sample_rate)/1000;
+	for (u64 i = fade_frames*format.channels; i < frame_count*format.channels; i++) {
+		assert(output[i] == sine[i], "Failed: offline render doesn't match source at sample %llu (%f vs %f)", i, output[i], sine[i]);
+	}
+	assert(audio_player_at_source_end(player), "Failed: player should have reached the end of the source");
+	assert(stats.stages.callbacks == (frame_count+AUDIO_OFFLINE_DEFAULT_FRAMES_PER_CALLBACK-1)/AUDIO_OFFLINE_DEFAULT_FRAMES_PER_CALLBACK, "Failed: offline render callback count");
+	
+	// Benchmark a bunch of voices at odd speeds so the resampler and all stages show up
+	const u64 voice_count = 32;
+	Audio_Player *voices[32];
+	for (u64 i = 0; i < voice_count; i++) {
+		voices[i] = audio_player_get_one();
+		audio_player_set_source(voices[i], src);
+		audio_player_set_looping(voices[i], true);
+		audio_player_set_time_stamp(voices[i], 0.01*(f64)i); // Don't trip :PhaseCancellation
+		voices[i]->config.volume = 1.0/(f32)voice_count;
+		voices[i]->config.playback_speed = 0.5 + (f32)i/(f32)voice_count;
+		voices[i]->config.enable_spacialization = i % 2 == 0;
+		voices[i]->config.position_ndc = v3(-1.0 + 2.0*(f32)i/(f32)voice_count, 0, 0);
+		audio_player_set_state(voices[i], AUDIO_PLAYER_STATE_PLAYING);
+	}
+	
+	ok = audio_render_offline_to_wav(STR("offline_test_render.wav"), frame_count, format, 0, &stats);
+	assert(ok, "Failed: audio_render_offline_to_wav");
+	assert(stats.stages.voices >= voice_count*stats.stages.callbacks, "Failed: not all voices were mixed");
+	print("\n");
+	audio_print_render_stats(stats);
+	
+	Audio_Source rendered;
+	ok = audio_open_source_load_format(&rendered, STR("offline_test_render.wav"), format, get_heap_allocator());
+	assert(ok, "Failed: loading offline rendered wav");
+	assert(rendered.number_of_frames == frame_count, "Failed: offline rendered wav has wrong frame count");
+	audio_source_destroy(&rendered);
+	
+	for (u64 i = 0; i < voice_count; i++) {
+		audio_player_clear_source(voices[i]);
+		audio_player_release(voices[i]);
+	}
+	audio_player_clear_source(player);
+	audio_player_release(player);
+	
+	// Let the mixer actually release them before the source goes away
+	audio_render_offline(output, 1, format, 0, 0);
+	
+	audio_source_destroy(&src);
+	dealloc(get_heap_allocator(), sine);
+	dealloc(get_heap_allocator(), output);
+	
+	ok = os_file_delete(STR("offline_test_source.wav"));
+	assert(ok, "Failed: os_file_delete");
+	ok = os_file_delete(STR("offline_test_render.wav"));
+	assert(ok, "Failed: os_file_delete");
+}
+
+// Writes a sine to a wave file and loads it back as a memory source.
+// The file stays mapped until the source is destroyed, so delete it after that.
+bool make_test_sine_source(Audio_Source *src, string path, f64 hz, f32 amplitude, Audio_Format format, u64 frame_count) {
+	u64 frame_size = get_audio_bit_width_byte_size(format.bit_width)*format.channels;
+	f32 *frames = alloc(get_heap_allocator(), frame_count*frame_size);
+	for (u64 i = 0; i < frame_count; i++) {
+		f32 s = (f32)(sin(TAU64*hz*(f64)i/(f64)format.sample_rate))*amplitude;
+		for (u64 c = 0; c < format.channels; c++) frames[i*format.channels+c] = s;
+	}
+	bool ok = wav_write_file(path, frames, frame_count, format);
+	dealloc(get_heap_allocator(), frames);
+	if (!ok) return false;
+	return audio_open_source_load_format(src, path, format, get_heap_allocator());
+}
+f32 test_peak_after(f32 *frames, u64 first_sample, u64 sample_count) {
+	f32 peak = 0;
+	for (u64 i = first_sample; i < sample_count; i++) peak = max(peak, fabsf(frames[i]));
+	return peak;
+}
+void test_audio_buses() {
+	Audio_Format format = { AUDIO_BITS_32, 2, 48000 };
+	u64 frame_count = 24000;
+	u64 settle = 4800*format.channels; // Past the player fade in and the filter settling
+	u64 sample_count = frame_count*format.channels;
+	
+	Audio_Source low, high;
+	bool ok = make_test_sine_source(&low, STR("bus_test_low.wav"), 100.0, 0.5, format, frame_count);
+	assert(ok, "Failed: making test source");
+	ok = make_test_sine_source(&high, STR("bus_test_high.wav"), 8000.0, 0.5, format, frame_count);
+	assert(ok, "Failed: making test source");
+	
+	f32 *output = alloc(get_heap_allocator(), frame_count*sizeof(f32)*format.channels);
+	
+	Audio_Bus *music = audio_get_bus(AUDIO_BUS_MUSIC);
+	Audio_Bus *sfx = audio_get_bus(AUDIO_BUS_SFX);
+	Audio_Bus *master = audio_get_bus(AUDIO_BUS_MASTER);
+	Audio_Bus_Id footsteps_id = audio_bus_create(AUDIO_BUS_SFX);
+	Audio_Bus *footsteps = audio_get_bus(footsteps_id);
+	assert(footsteps->parent == AUDIO_BUS_SFX, "Failed: audio_bus_create parent");
+	
+	Audio_Player *music_player = audio_player_get_one();
+	music_player->config.bus = AUDIO_BUS_MUSIC;
+	audio_player_set_source(music_player, high);
+	audio_player_set_state(music_player, AUDIO_PLAYER_STATE_PLAYING);
+	
+	Audio_Player *step_player = audio_player_get_one();
+	step_player->config.bus = footsteps_id;
+	audio_player_set_source(step_player, low);
+	audio_player_set_state(step_player, AUDIO_PLAYER_STATE_PLAYING);
+	
+	// Muting sfx mutes everything under it, so only music is left
+	sfx->config.volume = 0.0;
+	ok = audio_render_offline(output, frame_count, format, 0, 0);
+	assert(ok, "Failed: audio_render_offline");
+	f32 peak = test_peak_after(output, settle, sample_count);
+	assert(fabsf(peak - 0.5f) < 0.01f, "Failed: music bus should pass through untouched (%f)", peak);
+	
+	// Low-pass on music kills the 8k tone, sfx back at full volume brings the 100hz one back
+	audio_player_set_time_stamp(music_player, 0.0);
+	audio_player_set_time_stamp(step_player, 0.0);
+	sfx->config.volume = 1.0;
+	music->config.lowpass_cutoff_hz = 500.0;
+	ok = audio_render_offline(output, frame_count, format, 0, 0);
+	assert(ok, "Failed: audio_render_offline");
+	f32 high_left = 0;
+	for (u64 i = settle; i < sample_count; i += format.channels) {
+		// What's left after subtracting the 100hz tone we know comes through unfiltered
+		f32 expected = (f32)(sin(TAU64*100.0*(f64)(i/format.channels)/(f64)format.sample_rate))*0.5f;
+		high_left = max(high_left, fabsf(output[i] - expected));
+	}
+	assert(high_left < 0.01f, "Failed: music bus low-pass let too much through (%f)", high_left);
+	
+	// Limiter on master keeps a way too hot mix under the ceiling
+	audio_player_set_time_stamp(music_player, 0.0);
+	audio_player_set_time_stamp(step_player, 0.0);
+	music->config.lowpass_cutoff_hz = 0;
+	music_player->config.volume = 3.0;
+	step_player->config.volume = 3.0;
+	master->config.enable_limiter = true;
+	master->config.limiter_ceiling = 0.8;
+	ok = audio_render_offline(output, frame_count, format, 0, 0);
+	assert(ok, "Failed: audio_render_offline");
+	peak = test_peak_after(output, 0, sample_count);
+	assert(peak <= 0.8f + 0.0001f, "Failed: master limiter let through %f", peak);
+	
+	// Compressor pulls the level down towards the threshold
+	audio_player_set_time_stamp(music_player, 0.0);
+	audio_player_set_time_stamp(step_player, 0.0);
+	master->config.enable_limiter = false;
+	music_player->config.volume = 1.0;
+	audio_player_set_state(step_player, AUDIO_PLAYER_STATE_PAUSED);
+	music->config.compressor.enabled = true;
+	music->config.compressor.threshold_db = -20.0;
+	music->config.compressor.ratio = 10.0;
+	ok = audio_render_offline(output, frame_count, format, 0, 0);
+	assert(ok, "Failed: audio_render_offline");
+	peak = test_peak_after(output, settle, sample_count);
+	assert(peak < 0.25f && peak > 0.05f, "Failed: music bus compressor (%f)", peak);
+	
+	audio_player_clear_source(music_player);
+	audio_player_release(music_player);
+	audio_player_clear_source(step_player);
+	audio_player_release(step_player);
+	audio_render_offline(output, 1, format, 0, 0);
+	
+	music->config  = audio_bus_default_config();
+	sfx->config    = audio_bus_default_config();
+	master->config = audio_bus_default_config();
+	
+	audio_source_destroy(&low);
+	audio_source_destroy(&high);
+	os_file_delete(STR("bus_test_low.wav"));
+	os_file_delete(STR("bus_test_high.wav"));
+	dealloc(get_heap_allocator(), output);
+}
+void test_audio_mapped_source() {
+	// Bit width conversion, odd count so the scalar tail runs too
+	s16 ints[19];
+	f32 floats[19];
+	s16 back[19];
+	for (u64 i = 0; i < 19; i++) ints[i] = (s16)(i*3449 - 32768);
+	convert_s16_to_f32(floats, ints, 19);
+	convert_f32_to_s16(back, floats, 19);
+	for (u64 i = 0; i < 19; i++) {
+		assert(floats[i] == (f32)ints[i]/32768.0f, "Failed: convert_s16_to_f32 at %llu", i);
+		assert(back[i] == ints[i], "Failed: s16 -> f32 -> s16 round trip at %llu (%d vs %d)", i, back[i], ints[i]);
+	}
+	f32 loud[8] = { 1.5f, -1.5f, 1.0f, -1.0f, 0.5f, -0.5f, 0.0f, 2.0f };
+	convert_f32_to_s16(back, loud, 8);
+	assert(back[0] == 32767 && back[1] == -32768 && back[2] == 32767 && back[3] == -32768, "Failed: convert_f32_to_s16 should saturate");
+	assert(back[4] == 16384 && back[5] == -16384 && back[6] == 0, "Failed: convert_f32_to_s16");
+	
+	Audio_Format file_format = { AUDIO_BITS_16, 2, 44100 };
+	u64 frame_count = 10000;
+	s16 *frames = alloc(get_heap_allocator(), frame_count*2*sizeof(s16));
+	for (u64 i = 0; i < frame_count*2; i++) frames[i] = (s16)get_random_int_in_range(-32768, 32767);
+	bool ok = wav_write_file(STR("mapped_test.wav"), frames, frame_count, file_format);
+	assert(ok, "Failed: wav_write_file");
+	
+	// Loading in the file's own format points straight into the file
+	Audio_Source same;
+	ok = audio_open_source_load_format(&same, STR("mapped_test.wav"), file_format, get_heap_allocator());
+	assert(ok, "Failed: audio_open_source_load_format");
+	assert(same.mapping.data != 0, "Failed: matching wav should be mapped, not copied");
+	assert(same.number_of_frames == frame_count, "Failed: mapped wav frame count");
+	assert(bytes_match(same.pcm_frames, frames, frame_count*2*sizeof(s16)), "Failed: mapped wav frames mismatch");
+	
+	// Different format converts when sampled, and keeps the file's sample rate
+	Audio_Source mapped;
+	ok = audio_open_source_map_format(&mapped, STR("mapped_test.wav"), (Audio_Format){ AUDIO_BITS_32, 2, 48000 }, get_heap_allocator());
+	assert(ok, "Failed: audio_open_source_map_format");
+	assert(mapped.kind == AUDIO_SOURCE_MAPPED, "Failed: expected a converting mapped source");
+	assert(mapped.format.sample_rate == 44100, "Failed: mapped source should keep the file sample rate");
+	
+	u64 chunk = 4096;
+	f32 *sampled = alloc(get_heap_allocator(), chunk*2*sizeof(f32));
+	u64 first = frame_count-1000; // Wraps around since it's looping
+	u64 next = audio_source_sample_next_frames(&mapped, first, chunk, sampled, true);
+	assert(next == chunk-1000, "Failed: looping mapped source next frame index %llu", next);
+	for (u64 f = 0; f < chunk; f++) {
+		u64 src_frame = (first+f) % frame_count;
+		for (u64 c = 0; c < 2; c++) {
+			f32 expected = (f32)frames[src_frame*2+c]/32768.0f;
+			assert(sampled[f*2+c] == expected, "Failed: mapped source conversion at frame %llu", f);
+		}
+	}
+	
+	audio_source_destroy(&same);
+	audio_source_destroy(&mapped);
+	dealloc(get_heap_allocator(), sampled);
+	dealloc(get_heap_allocator(), frames);
+	
+	ok = os_file_delete(STR("mapped_test.wav"));
+	assert(ok, "Failed: os_file_delete after unmapping");
+}
+
 typedef struct Test_Thing {
     int foo;
     float bar;
@@ -1361,6 +3211,46 @@ void test_growing_array() {
     assert(!bytes_match(&copy, thing, sizeof(Test_Thing)), "Failed: growing_array_unordered_remove_by_pointer");
     
     assert(growing_array_get_valid_count(things) == 99, "Failed: growing_array_get_valid_count");
+    
+    growing_array_deinit((void**)&things);
+    
+    // Bulk operations
+    u32 *ints;
+    growing_array_init((void**)&ints, sizeof(u32), get_heap_allocator());
+    growing_array_set_growth_factor((void**)&ints, 1.5);
+    
+    u32 range[1000];
+    for (u32 i = 0; i < 1000; i++) range[i] = i;
+    growing_array_add_many((void**)&ints, range, 1000);
+    assert(growing_array_get_valid_count(ints) == 1000, "Failed: growing_array_add_many");
+    for (u32 i = 0; i < 1000; i++) assert(ints[i] == i, "Failed: growing_array_add_many");
+    
+    u32 inserted[3] = {7777, 8888, 9999};
+    growing_array_insert_range((void**)&ints, 10, inserted, 3);
+    assert(growing_array_get_valid_count(ints) == 1003, "Failed: growing_array_insert_range");
+    assert(ints[9] == 9 && ints[10] == 7777 && ints[12] == 9999 && ints[13] == 10 && ints[1002] == 999, "Failed: growing_array_insert_range");
+    
+    assert(growing_array_find_index_from_left_by_value((void**)&ints, &inserted[1]) == 11, "Failed: growing_array_find_index_from_left_by_value");
+    assert(growing_array_find_index_from_left_by_pointer((void**)&ints, &ints[500]) == 500, "Failed: growing_array_find_index_from_left_by_pointer");
+    u32 missing = 123456;
+    assert(growing_array_find_index_from_left_by_value((void**)&ints, &missing) == -1, "Failed: growing_array_find_index_from_left_by_value");
+    
+    growing_array_remove_range((void**)&ints, 10, 3);
+    growing_array_remove_range((void**)&ints, 0, 100);
+    assert(growing_array_get_valid_count(ints) == 900, "Failed: growing_array_remove_range");
+    for (u32 i = 0; i < 900; i++) assert(ints[i] == i+100, "Failed: growing_array_remove_range");
+    
+    // Removing from the front moves every item over the one before it
+    growing_array_ordered_remove_by_index((void**)&ints, 0);
+    for (u32 i = 0; i < 899; i++) assert(ints[i] == i+101, "Failed: growing_array_ordered_remove_by_index");
+    
+    growing_array_clear((void**)&ints);
+    for (u32 i = 0; i < 5000; i++) growing_array_add_unchecked((void**)&ints, &i);
+    assert(growing_array_get_valid_count(ints) == 5000, "Failed: growing_array_add_unchecked");
+    assert(growing_array_get_allocated_count(ints) >= 5000, "Failed: growing_array_add_unchecked");
+    for (u32 i = 0; i < 5000; i++) assert(ints[i] == i, "Failed: growing_array_add_unchecked");
+    
+    growing_array_deinit((void**)&ints);
 }
 
 void oogabooga_run_tests() {
@@ -1373,6 +3263,42 @@ void oogabooga_run_tests() {
 	test_allocator(true);
 	print("OK!\n");
 	
+	print("Testing heap large allocations... ");
+	test_heap_large_allocations();
+	print("OK!\n");
+	
+	print("Testing heap resize and alignment... ");
+	test_heap_resize_and_alignment();
+	print("OK!\n");
+	
+	print("Testing heap stats... ");
+	test_heap_stats();
+	print("OK!\n");
+	
+	print("Testing zeroed allocations... ");
+	test_alloc_zeroed();
+	print("OK!\n");
+	
+	print("Testing arena... ");
+	test_arena();
+	print("OK!\n");
+	
+	print("Testing pool... ");
+	test_pool();
+	print("OK!\n");
+	
+	print("Testing temporary storage... ");
+	test_temporary_storage();
+	print("OK!\n");
+	
+	print("Testing third party allocator... ");
+	test_third_party_allocator();
+	print("OK!\n");
+	
+	print("Testing worker group... ");
+	test_worker_group();
+	print("OK!\n");
+	
 	print("Testing threads... ");
 	test_threads();
 	print("OK!\n");
@@ -1397,10 +3323,22 @@ void oogabooga_run_tests() {
 	test_simd();
 	print("OK!\n");
 	
+	print("Testing hash... ");
+	test_hash();
+	print("OK!\n");
+	
 	print("Testing hash table... ");
 	test_hash_table();
 	print("OK!\n");
 	
+	print("Testing slot map and sparse set... ");
+	test_slot_map_and_sparse_set();
+	print("OK!\n");
+	
+	print("Testing string interner... ");
+	test_string_interner();
+	print("OK!\n");
+	
 	print("Testing random distribution... ");
 	test_random_distribution();
 	print("OK!\n");
@@ -1408,6 +3346,26 @@ void oogabooga_run_tests() {
 	print("Testing mutex... ");
 	test_mutex();
 	print("OK!\n");
+	
+	print("Testing spinlocks... ");
+	test_spinlocks();
+	print("OK!\n");
+	
+	print("Testing parking primitives... ");
+	test_parking_primitives();
+	print("OK!\n");
+	
+	print("Testing rw lock and seqlock... ");
+	test_rw_lock_and_seqlock();
+	print("OK!\n");
+	
+	print("Testing queues... ");
+	test_queues();
+	print("OK!\n");
+	
+	print("Testing fibers... ");
+	test_fibers();
+	print("OK!\n");
 
 #ifndef OOGABOOGA_HEADLESS
 	print("Testing radix sort... ");
@@ -1415,6 +3373,22 @@ void oogabooga_run_tests() {
 	print("OK!\n");
 #endif
 
+	print("Testing audio resampler... ");
+	test_audio_resampler();
+	print("OK!\n");
+	
+	print("Testing audio offline render... ");
+	test_audio_offline_render();
+	print("OK!\n");
+	
+	print("Testing audio buses... ");
+	test_audio_buses();
+	print("OK!\n");
+	
+	print("Testing audio mapped sources... ");
+	test_audio_mapped_source();
+	print("OK!\n");
+
 	
 	
 	print("All tests ok!\n");
@@ -114,6 +114,8 @@ typedef signed   short  s16;
 typedef unsigned int    u32;
 typedef signed   int    s32;
 
+// Per thread so decoding can happen on several threads at once.
+// Set it with third_party_scope_begin() (memory.c), not directly.
 thread_local Allocator third_party_allocator = {0};
 void *third_party_malloc(size_t size) {
 	assert(third_party_allocator.proc, "No third party allocator was set, but it was used!");
@@ -124,13 +126,22 @@ void *third_party_realloc(void *p, size_t size) {
 	assert(third_party_allocator.proc, "No third party allocator was set, but it was used!");
 	if (!size) return 0;
 	if (!p) return third_party_malloc(size);
-	return third_party_allocator.proc(size, p, ALLOCATOR_REALLOCATE, 0);
+	return third_party_allocator.proc(size, p, ALLOCATOR_REALLOCATE, third_party_allocator.data);
+}
+void *third_party_realloc_sized(void *p, size_t old_size, size_t new_size) {
+	assert(third_party_allocator.proc, "No third party allocator was set, but it was used!");
+	if (!new_size) return 0;
+	// Works with allocators that can't reallocate too, since we know the old size
+	return reallocate_uninitialized(third_party_allocator, p, old_size, new_size);
 }
 void third_party_free(void *p) {
 	assert(third_party_allocator.proc, "No third party allocator was set, but it was used!");
 	if (!p) return;
 	dealloc(third_party_allocator, p);
 }
+// Decoder temporaries that don't outlive the call. These go in a per-thread scratch arena
+// which is reset when the third party scope ends, so there's nothing to free.
+void *third_party_scratch_alloc(size_t size);
 
 #define STBTT_malloc(x,u) ((void)(u),third_party_malloc(x))
 #define STBTT_free(x,u)    ((void)(u),third_party_free(x))
@@ -149,7 +160,8 @@ size_t stbtt_strlen(const char* str) {
 #define STBI_NO_STDIO
 #define STBI_ASSERT(x) {if (!(x)) *(volatile char*)0 = 0;}
 #define STBI_MALLOC(sz)           third_party_malloc(sz)
-#define STBI_REALLOC(p,newsz)     third_party_allocator.proc(newsz, p, ALLOCATOR_REALLOCATE, 0)
+#define STBI_REALLOC(p,newsz)     third_party_realloc(p,newsz)
+#define STBI_REALLOC_SIZED(p,oldsz,newsz) third_party_realloc_sized(p,oldsz,newsz)
 #define STBI_FREE(p)              third_party_free(p)
 #include "third_party/stb_image.h"
 
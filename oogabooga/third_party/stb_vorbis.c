@@ -1095,7 +1095,8 @@ static void *setup_temp_malloc(vorb *f, int sz)
       f->temp_offset -= sz;
       return (char *) f->alloc.alloc_buffer + f->temp_offset;
    }
-   return third_party_malloc(sz); // #Modified  malloc -> third_party_malloc  Charlie Malmqvist 2024-07-08
+   // #Modified  third_party_malloc -> third_party_scratch_alloc  2026-10-19
+   return third_party_scratch_alloc(sz); // #Modified  malloc -> third_party_malloc  Charlie Malmqvist 2024-07-08
 }
 
 static void setup_temp_free(vorb *f, void *p, int sz)
@@ -1104,7 +1105,8 @@ static void setup_temp_free(vorb *f, void *p, int sz)
       f->temp_offset += (sz+7)&~7;
       return;
    }
-   third_party_free(p); // #Modified  malloc -> third_party_malloc  Charlie Malmqvist 2024-07-11
+   // #Modified  third_party_free removed, scratch memory is popped when the third party scope ends  2026-10-19
+   // third_party_free(p); // #Modified  malloc -> third_party_malloc  Charlie Malmqvist 2024-07-11
 }
 
 #define CRC32_POLY    0x04c11db7   // from spec